@@ -0,0 +1,349 @@
+/**
+ * @file main.cpp
+ * @author Raphael Jouretz (rjouretz.com)
+ * @brief Headless benchmark that renders a USD file with Engine along a
+ * camera path, without any window or ImGui, and reports the stage load time,
+ * the first frame latency, the frame time percentiles and the peak memory.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include <pxr/base/gf/bbox3d.h>
+#include <pxr/base/gf/frustum.h>
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/imaging/hgi/blitCmds.h>
+#include <pxr/usd/sdf/layer.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usdGeom/bboxCache.h>
+#include <pxr/usd/usdGeom/tokens.h>
+#include <pxr/usdImaging/usdImaging/sceneIndices.h>
+#include <pxr/usdImaging/usdImaging/stageSceneIndex.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "engine.h"
+#include "glcontext.h"
+#include "memoryusage.h"
+#include "models/model.h"
+#include "rendercontext.h"
+
+PXR_NAMESPACE_USING_DIRECTIVE
+
+using namespace std;
+
+/**
+ * @brief A camera position of the camera path
+ *
+ */
+struct CameraKey {
+        GfVec3d eye, at;
+        int width, height;
+};
+
+/**
+ * @brief The options of the benchmark
+ *
+ */
+struct Options {
+        string usdFilePath;
+        string cameraPathFilePath;
+        TfTokenVector plugins;
+        int width = 1280;
+        int height = 720;
+        int frames = 120;
+        int warmupFrames = 5;
+};
+
+/**
+ * @brief Get the elapsed time since the given time point
+ *
+ * @param start the time point to measure from
+ * @return the elapsed time in milliseconds
+ */
+double GetElapsedMs(chrono::steady_clock::time_point start)
+{
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, milli>(end - start).count();
+}
+
+/**
+ * @brief Print the usage of the benchmark
+ *
+ */
+void PrintUsage()
+{
+    printf(
+        "usage: ImGuiHydraBenchmark file.usd [options]\n"
+        "  --renderer <plugin>   renderer plugin to benchmark, can be\n"
+        "                        repeated (default: default plugin)\n"
+        "  --camera-path <file>  camera path, one key per line:\n"
+        "                        eyeX eyeY eyeZ atX atY atZ [width height]\n"
+        "                        (default: orbit around the stage bounds)\n"
+        "  --size <W>x<H>        render size (default: 1280x720)\n"
+        "  --frames <N>          frames of the default orbit (default: 120)\n"
+        "  --warmup <N>          frames rendered before measuring (default: "
+        "5)\n");
+}
+
+/**
+ * @brief Parse the command line arguments
+ *
+ * @param argc the number of arguments
+ * @param argv the arguments
+ * @param options the parsed options
+ * @return true if the arguments are valid
+ * @return false otherwise
+ */
+bool ParseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--renderer" && hasValue)
+            options.plugins.push_back(TfToken(argv[++i]));
+        else if (arg == "--camera-path" && hasValue)
+            options.cameraPathFilePath = argv[++i];
+        else if (arg == "--size" && hasValue) {
+            if (sscanf(argv[++i], "%dx%d", &options.width, &options.height) !=
+                2)
+                return false;
+        }
+        else if (arg == "--frames" && hasValue)
+            options.frames = atoi(argv[++i]);
+        else if (arg == "--warmup" && hasValue)
+            options.warmupFrames = atoi(argv[++i]);
+        else if (arg[0] != '-' && options.usdFilePath.empty())
+            options.usdFilePath = arg;
+        else return false;
+    }
+
+    if (options.plugins.empty())
+        options.plugins.push_back(Engine::GetDefaultRendererPlugin());
+
+    return !options.usdFilePath.empty() && options.width > 0 &&
+           options.height > 0 && options.frames > 0;
+}
+
+/**
+ * @brief Load the camera path from a file
+ *
+ * @param filePath the path of the camera path file
+ * @param options the options that provide the default render size
+ * @param keys the loaded camera keys
+ * @return true if the file was loaded
+ * @return false otherwise
+ */
+bool LoadCameraPath(const string& filePath, const Options& options,
+                    vector<CameraKey>& keys)
+{
+    ifstream file(filePath);
+    if (!file) return false;
+
+    string line;
+    while (getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+
+        istringstream ss(line);
+        CameraKey key;
+        if (!(ss >> key.eye[0] >> key.eye[1] >> key.eye[2] >> key.at[0] >>
+              key.at[1] >> key.at[2]))
+            continue;
+        if (!(ss >> key.width >> key.height)) {
+            key.width = options.width;
+            key.height = options.height;
+        }
+        keys.push_back(key);
+    }
+    return !keys.empty();
+}
+
+/**
+ * @brief Create a camera path that orbits around the stage bounds
+ *
+ * @param stage the stage to orbit around
+ * @param options the options that provide the frames and the render size
+ * @return the camera keys
+ */
+vector<CameraKey> CreateOrbitCameraPath(UsdStageRefPtr stage,
+                                        const Options& options)
+{
+    UsdGeomBBoxCache bboxCache(UsdTimeCode::Default(),
+                               {UsdGeomTokens->default_, UsdGeomTokens->render,
+                                UsdGeomTokens->proxy},
+                               true);
+    GfRange3d range =
+        bboxCache.ComputeWorldBound(stage->GetPseudoRoot()).ComputeAlignedRange();
+
+    GfVec3d center(0);
+    double radius = 5;
+    if (!range.IsEmpty()) {
+        center = range.GetMidpoint();
+        radius = std::max(range.GetSize().GetLength(), 1.0);
+    }
+
+    vector<CameraKey> keys;
+    for (int i = 0; i < options.frames; i++) {
+        double angle = 2 * M_PI * i / options.frames;
+        GfVec3d eye = center + GfVec3d(cos(angle) * radius, radius * .5,
+                                       sin(angle) * radius);
+        keys.push_back({eye, center, options.width, options.height});
+    }
+    return keys;
+}
+
+/**
+ * @brief Wait until the GPU completed all the submitted work
+ *
+ * @param engine the engine that submitted the work
+ */
+void WaitForGpu(Engine& engine)
+{
+    Hgi* hgi = engine.GetHgi();
+    HgiBlitCmdsUniquePtr blitCmds = hgi->CreateBlitCmds();
+    hgi->SubmitCmds(blitCmds.get(), HgiSubmitWaitTypeWaitUntilCompleted);
+}
+
+/**
+ * @brief Render one frame of the camera path
+ *
+ * @param engine the engine to render with
+ * @param key the camera key to render from
+ * @return the frame time in milliseconds, GPU work included
+ */
+double RenderFrame(Engine& engine, const CameraKey& key)
+{
+    auto start = chrono::steady_clock::now();
+
+    GfMatrix4d view = GfMatrix4d().SetLookAt(key.eye, key.at, GfVec3d::YAxis());
+    GfFrustum frustum;
+    frustum.SetPerspective(45.f, true, double(key.width) / key.height, 0.1f,
+                           10000.f);
+
+    engine.SetRenderSize(key.width, key.height);
+    engine.SetCameraMatrices(view, frustum.ComputeProjectionMatrix());
+    engine.Prepare();
+    engine.Render();
+    WaitForGpu(engine);
+
+    return GetElapsedMs(start);
+}
+
+/**
+ * @brief Get the percentile of sorted values
+ *
+ * @param sortedValues the values, sorted in ascending order
+ * @param percentile the percentile to get, between 0 and 100
+ * @return the percentile value
+ */
+double GetPercentile(const vector<double>& sortedValues, double percentile)
+{
+    if (sortedValues.empty()) return 0;
+    size_t index = size_t(percentile / 100 * (sortedValues.size() - 1) + .5);
+    return sortedValues[std::min(index, sortedValues.size() - 1)];
+}
+
+/**
+ * @brief Main function
+ *
+ */
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 1;
+    }
+
+    // HgiGL needs a current GL context, but no window is ever shown
+    OffscreenContext context;
+    CreateOffscreenContext(context);
+
+    // load the stage the same way the editor does
+    auto start = chrono::steady_clock::now();
+    SdfLayerRefPtr rootLayer = SdfLayer::FindOrOpen(options.usdFilePath);
+    if (!rootLayer) {
+        fprintf(stderr, "Error: unable to open %s\n",
+                options.usdFilePath.c_str());
+        return 1;
+    }
+    UsdStageRefPtr stage =
+        UsdStage::Open(rootLayer, SdfLayer::CreateAnonymous());
+    double stageOpenMs = GetElapsedMs(start);
+
+    start = chrono::steady_clock::now();
+    Model model;
+    UsdImagingCreateSceneIndicesInfo info;
+    info.displayUnloadedPrimsWithBounds = false;
+    UsdImagingSceneIndices sceneIndices = UsdImagingCreateSceneIndices(info);
+    model.AddSceneIndexBase(sceneIndices.finalSceneIndex);
+    sceneIndices.stageSceneIndex->SetStage(stage);
+    sceneIndices.stageSceneIndex->SetTime(UsdTimeCode::Default());
+    model.SetStage(stage);
+    double scenePopulateMs = GetElapsedMs(start);
+
+    vector<CameraKey> keys;
+    if (!options.cameraPathFilePath.empty()) {
+        if (!LoadCameraPath(options.cameraPathFilePath, options, keys)) {
+            fprintf(stderr, "Error: invalid camera path %s\n",
+                    options.cameraPathFilePath.c_str());
+            return 1;
+        }
+    }
+    else keys = CreateOrbitCameraPath(stage, options);
+
+    printf("file              %s\n", options.usdFilePath.c_str());
+    printf("stage open        %10.2f ms\n", stageOpenMs);
+    printf("scene populate    %10.2f ms\n", scenePopulateMs);
+    printf("camera keys       %10zu\n", keys.size());
+
+    for (auto&& plugin : options.plugins) {
+        // engine creation includes the render delegate switch cost
+        start = chrono::steady_clock::now();
+        Engine* engine = new Engine(model.GetFinalSceneIndex(), plugin);
+        engine->SetRenderOnDemand(false);
+        double initializeMs = GetElapsedMs(start);
+
+        // first frame includes the initial sync of the whole scene
+        double firstFrameMs = RenderFrame(*engine, keys[0]);
+
+        for (int i = 0; i < options.warmupFrames; i++)
+            RenderFrame(*engine, keys[i % keys.size()]);
+
+        vector<double> frameTimes;
+        for (auto&& key : keys) frameTimes.push_back(RenderFrame(*engine, key));
+        sort(frameTimes.begin(), frameTimes.end());
+
+        // the render index isn't kept idle, so that the teardown is measured
+        // and the next renderer starts cold
+        start = chrono::steady_clock::now();
+        delete engine;
+        RenderContext::ReleaseIdleContexts();
+        double teardownMs = GetElapsedMs(start);
+
+        printf("\nrenderer          %s\n", plugin.GetText());
+        printf("engine initialize %10.2f ms\n", initializeMs);
+        printf("first frame       %10.2f ms\n", firstFrameMs);
+        printf("frame p50         %10.2f ms\n", GetPercentile(frameTimes, 50));
+        printf("frame p90         %10.2f ms\n", GetPercentile(frameTimes, 90));
+        printf("frame p99         %10.2f ms\n", GetPercentile(frameTimes, 99));
+        printf("frame max         %10.2f ms\n", frameTimes.back());
+        printf("engine teardown   %10.2f ms\n", teardownMs);
+    }
+
+    printf("\npeak RSS          %10.2f MB\n",
+           GetPeakResidentMemory() / (1024.0 * 1024.0));
+
+    DestroyOffscreenContext(context);
+
+    return 0;
+}
@@ -0,0 +1,180 @@
+#include "aovreadbackring.h"
+
+#include <pxr/base/trace/trace.h>
+#include <pxr/imaging/hgi/blitCmds.h>
+#include <pxr/imaging/hgi/blitCmdsOps.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "metalreadback.h"
+#include "profiler.h"
+
+extern "C"
+int LabCreateRGBAf16Texture(int width, int height, uint8_t* rgba_pixels);
+extern "C"
+void* LabTextureHardwareHandle(int texture);
+extern "C"
+void LabRemoveTexture(int texture);
+extern "C"
+void LabUpdateRGBAf16Texture(int texture, uint8_t* rgba_pixels);
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+AovReadbackRing::AovReadbackRing(size_t depth)
+    : _slots(std::max<size_t>(depth, 2)),
+      _frame(0),
+      _presentedFrame(0),
+      _texture(-1),
+      _textureWidth(0),
+      _textureHeight(0)
+{
+}
+
+AovReadbackRing::~AovReadbackRing()
+{
+    for (auto&& slot : _slots) {
+        free(slot.buffer);
+#if defined(__APPLE__)
+        DeleteMetalReadback(slot.readback);
+#endif
+    }
+    if (_texture >= 0) LabRemoveTexture(_texture);
+}
+
+void* AovReadbackRing::Update(Hgi* hgi, HgiTextureHandle const& texture)
+{
+    if (!hgi || !texture) return Present();
+
+    TRACE_FUNCTION();
+
+    // the completed slots are uploaded or superseded first, so that they
+    // can be reused by this readback
+    _UploadCompletedSlot();
+
+    // the slots still in flight are never waited on, the readback of this
+    // render is skipped if they all are
+    _Slot* slot = nullptr;
+    for (auto&& candidate : _slots) {
+        if (!candidate.pending) {
+            slot = &candidate;
+            break;
+        }
+    }
+    if (!slot) {
+        if (_texture < 0) return nullptr;
+        return LabTextureHardwareHandle(_texture);
+    }
+
+    HgiTextureDesc const& desc = texture->GetDescriptor();
+    slot->width = desc.dimensions[0];
+    slot->height = desc.dimensions[1];
+    slot->frame = ++_frame;
+    slot->pending = true;
+    const size_t byteSize =
+        slot->width * slot->height * HgiGetDataSizeOfFormat(desc.format);
+
+    {
+        ProfilerScope scope(_profilerPrefix + "readback");
+#if defined(__APPLE__)
+        if (IsMetalReadbackSupported(hgi)) {
+            slot->readback = StartMetalReadback(hgi, texture, slot->readback);
+            slot->byteSize = byteSize;
+        }
+        else
+#endif
+        {
+            if (!slot->buffer || slot->byteSize < byteSize) {
+                free(slot->buffer);
+                slot->buffer = (uint8_t*)malloc(byteSize);
+                slot->byteSize = byteSize;
+            }
+
+            HgiTextureGpuToCpuOp copyOp;
+            copyOp.gpuSourceTexture = texture;
+            copyOp.sourceTexelOffset = GfVec3i(0);
+            copyOp.mipLevel = 0;
+            copyOp.cpuDestinationBuffer = slot->buffer;
+            copyOp.destinationByteOffset = 0;
+            copyOp.destinationBufferByteSize = byteSize;
+
+            // without a completion to poll, the copy is waited on
+            HgiBlitCmdsUniquePtr blitCmds = hgi->CreateBlitCmds();
+            blitCmds->CopyTextureGpuToCpu(copyOp);
+            hgi->SubmitCmds(blitCmds.get(),
+                            HgiSubmitWaitTypeWaitUntilCompleted);
+        }
+    }
+
+    return Present();
+}
+
+void* AovReadbackRing::Present()
+{
+    _UploadCompletedSlot();
+
+    if (_texture < 0) return nullptr;
+    return LabTextureHardwareHandle(_texture);
+}
+
+void AovReadbackRing::SetProfilerPrefix(const string& prefix)
+{
+    _profilerPrefix = prefix;
+}
+
+size_t AovReadbackRing::GetStagingByteSize() const
+{
+    size_t byteSize = 0;
+    for (auto&& slot : _slots) byteSize += slot.byteSize;
+    return byteSize;
+}
+
+bool AovReadbackRing::_IsCompleted(const _Slot& slot) const
+{
+#if defined(__APPLE__)
+    if (slot.readback) return IsMetalReadbackCompleted(slot.readback);
+#endif
+    return true;
+}
+
+void AovReadbackRing::_UploadCompletedSlot()
+{
+    // find the most recent readback the GPU is done with, the completed
+    // readbacks older than the presented one being superseded
+    _Slot* completed = nullptr;
+    for (auto&& slot : _slots) {
+        if (!slot.pending || !_IsCompleted(slot)) continue;
+
+        // the slot is uploaded below or superseded, and can be reused
+        slot.pending = false;
+        if (slot.frame <= _presentedFrame) continue;
+
+        if (!completed || slot.frame > completed->frame) completed = &slot;
+    }
+    if (!completed) return;
+
+    TRACE_FUNCTION();
+    ProfilerScope scope(_profilerPrefix + "upload");
+
+    _presentedFrame = completed->frame;
+
+    uint8_t* pixels = completed->buffer;
+#if defined(__APPLE__)
+    if (completed->readback)
+        pixels = GetMetalReadbackData(completed->readback);
+#endif
+
+    if (_texture < 0 || _textureWidth != completed->width ||
+        _textureHeight != completed->height) {
+        if (_texture >= 0) LabRemoveTexture(_texture);
+        _textureWidth = completed->width;
+        _textureHeight = completed->height;
+        _texture =
+            LabCreateRGBAf16Texture(_textureWidth, _textureHeight, pixels);
+    }
+    else {
+        LabUpdateRGBAf16Texture(_texture, pixels);
+    }
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
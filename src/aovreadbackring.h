@@ -0,0 +1,129 @@
+/**
+ * @file aovreadbackring.h
+ * @author Raphael Jouretz (rjouretz.com)
+ * @brief AovReadbackRing reads the Hydra color AOV back to the CPU through a
+ * ring of staging buffers without stalling the UI thread, and uploads the
+ * completed readbacks to a UI texture.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <pxr/imaging/hgi/hgi.h>
+#include <pxr/imaging/hgi/texture.h>
+
+#include <string>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+using namespace std;
+
+/**
+ * @brief AovReadbackRing reads the Hydra color AOV back to the CPU through a
+ * ring of staging buffers without stalling the UI thread, and uploads the
+ * completed readbacks to a UI texture.
+ *
+ * Readbacks are submitted without waiting on the GPU, and one is only
+ * uploaded once polling it shows that the GPU is done with its copy: Hgi has
+ * no fences, so with HgiMetal the copy goes to a shared Metal buffer whose
+ * command buffer has a completion handler. Each draw presents the newest
+ * completed readback, and keeps the UI texture as-is when none completed
+ * since the last one. A readback is skipped when all the slots are still in
+ * flight. The other backends (e.g. Vulkan) have no such completion, so
+ * their readbacks are waited on as they are submitted.
+ *
+ */
+class AovReadbackRing {
+    public:
+        /**
+         * @brief Construct a new Aov Readback Ring object
+         *
+         * @param depth the number of staging buffers of the ring (at least 2)
+         */
+        AovReadbackRing(size_t depth = 3);
+
+        /**
+         * @brief Destroy the Aov Readback Ring object
+         *
+         */
+        ~AovReadbackRing();
+
+        /**
+         * @brief Submit a non-blocking readback of the given texture, unless
+         * all the slots are in flight, and upload the latest completed
+         * readback to the UI texture
+         *
+         * @param hgi the Hgi that owns the texture
+         * @param texture the texture to read back
+         * @return the native handle of the UI texture, or nullptr if no
+         * readback has completed yet
+         */
+        void* Update(Hgi* hgi, HgiTextureHandle const& texture);
+
+        /**
+         * @brief Upload the latest completed readback to the UI texture
+         * without submitting a new one (e.g. when nothing was rendered),
+         * without waiting on the pending readbacks
+         *
+         * @return the native handle of the UI texture, or nullptr if no
+         * readback has completed yet
+         */
+        void* Present();
+
+        /**
+         * @brief Set the prefix of the Profiler samples of the ring. The
+         * readback and the upload are respectively sampled as
+         * '<prefix>readback' and '<prefix>upload'.
+         *
+         * @param prefix the prefix of the samples
+         */
+        void SetProfilerPrefix(const string& prefix);
+
+        /**
+         * @brief Get the total size of the staging buffers
+         *
+         * @return the size in bytes
+         */
+        size_t GetStagingByteSize() const;
+
+    private:
+        struct _Slot {
+                // the CPU copy, or the Metal readback
+                uint8_t* buffer = nullptr;
+                size_t byteSize = 0;
+                void* readback = nullptr;
+                int width = 0;
+                int height = 0;
+                size_t frame = 0;
+                // submitted, and neither uploaded nor superseded
+                bool pending = false;
+        };
+
+        vector<_Slot> _slots;
+        // the number of submitted readbacks, and the last one uploaded
+        size_t _frame, _presentedFrame;
+
+        int _texture, _textureWidth, _textureHeight;
+        string _profilerPrefix;
+
+        /**
+         * @brief Check if the GPU is done with the readback of a slot,
+         * without waiting for it
+         *
+         * @param slot the slot
+         * @return true if its pixels can be uploaded
+         * @return false otherwise
+         */
+        bool _IsCompleted(const _Slot& slot) const;
+
+        /**
+         * @brief Upload the most recent completed slot to the UI texture,
+         * if any
+         *
+         */
+        void _UploadCompletedSlot();
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
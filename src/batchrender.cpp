@@ -0,0 +1,527 @@
+#include "batchrender.h"
+
+#include <pxr/base/gf/camera.h>
+#include <pxr/base/gf/frustum.h>
+#include <pxr/base/gf/half.h>
+#include <pxr/base/tf/fileUtils.h>
+#include <pxr/base/tf/pathUtils.h>
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/base/trace/trace.h>
+#include <pxr/imaging/cameraUtil/conformWindow.h>
+#include <pxr/imaging/hd/cameraSchema.h>
+#include <pxr/imaging/hd/tokens.h>
+#include <pxr/imaging/hd/xformSchema.h>
+#include <pxr/imaging/hgi/blitCmds.h>
+#include <pxr/imaging/hgi/blitCmdsOps.h>
+#include <pxr/imaging/hio/image.h>
+#include <pxr/usd/sdf/layer.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usdImaging/usdImaging/sceneIndices.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "rendercontext.h"
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+// the image formats written with floating point pixels, the others are
+// quantized to 8 bits
+const vector<string> HDR_EXTENSIONS = {"exr", "hdr"};
+}  // namespace
+
+bool BatchRender::ParseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--batch" && hasValue)
+            options.usdFilePath = argv[++i];
+        else if (arg == "--output" && hasValue)
+            options.outputPattern = argv[++i];
+        else if (arg == "--camera" && hasValue)
+            options.camera = SdfPath(argv[++i]);
+        else if (arg == "--renderer" && hasValue)
+            options.plugin = TfToken(argv[++i]);
+        else if (arg == "--aov" && hasValue)
+            options.aovs.push_back(TfToken(argv[++i]));
+        else if (arg == "--size" && hasValue) {
+            if (sscanf(argv[++i], "%dx%d", &options.width, &options.height) !=
+                2)
+                return false;
+        }
+        else if (arg == "--frames" && hasValue) {
+            int count = sscanf(argv[++i], "%lf:%lf:%lf", &options.startFrame,
+                               &options.endFrame, &options.frameStep);
+            if (count < 1) return false;
+            if (count == 1) options.endFrame = options.startFrame;
+            options.hasFrameRange = true;
+        }
+        // the options of the editor that don't change the batch render
+        else if (arg == "--no-shader-cache" || arg == "--malloc-tags" ||
+                 arg == "--render-thread")
+            continue;
+        else return false;
+    }
+
+    return !options.usdFilePath.empty() && !options.outputPattern.empty() &&
+           options.width > 0 && options.height > 0 && options.frameStep > 0 &&
+           options.endFrame >= options.startFrame;
+}
+
+void BatchRender::PrintUsage()
+{
+    printf(
+        "usage: ImGuiHydraEditor --batch file.usd --output <pattern> "
+        "[options]\n"
+        "  --output <pattern>    image path, the '#' are replaced by the\n"
+        "                        padded frame number (e.g. out/beauty.####"
+        ".exr)\n"
+        "  --camera <path>       camera prim (default: first camera)\n"
+        "  --frames <S>:<E>[:<step>]\n"
+        "                        frame range (default: stage time range),\n"
+        "                        each frame written as a whole frame\n"
+        "  --renderer <plugin>   renderer plugin (default: default plugin)\n"
+        "  --size <W>x<H>        render size (default: 1920x1080)\n"
+        "  --aov <name>          AOV written next to the color, can be\n"
+        "                        repeated (e.g. depth, normal, primId)\n");
+}
+
+BatchRender::BatchRender(const Options& options) : _options(options) {}
+
+bool BatchRender::Run()
+{
+    if (!_OpenStage()) return false;
+
+    vector<double> frames = _GetFrames();
+    if (!_CheckFrames(frames)) return false;
+
+    TfToken plugin = _options.plugin.IsEmpty()
+                         ? Engine::GetDefaultRendererPlugin()
+                         : _options.plugin;
+
+    bool isWritten = true;
+    {
+        Engine engine(_model.GetFinalSceneIndex(), plugin);
+        engine.SetRenderOnDemand(false);
+        engine.SetGridEnabled(false);
+        engine.SetAovPickingEnabled(false);
+        engine.SetExtraRenderOutputs(_options.aovs);
+        engine.SetRenderSize(_options.width, _options.height);
+
+        _Slot* previous = nullptr;
+        for (size_t i = 0; i < frames.size() && isWritten; i++) {
+            TRACE_SCOPE("BatchRender frame");
+
+            // the slot was written by a worker three frames ago
+            _Slot& slot = _slots[i % _SLOT_COUNT];
+            if (slot.isWritten.valid()) isWritten &= slot.isWritten.get();
+
+            // the default time is a NaN, written as the frame 0
+            const bool isDefault = std::isnan(frames[i]);
+            _model.SetTime(isDefault ? UsdTimeCode::Default()
+                                     : UsdTimeCode(frames[i]));
+
+            GfMatrix4d view, proj;
+            if (!_GetCameraMatrices(&view, &proj)) {
+                fprintf(stderr, "Error: no camera to render from\n");
+                isWritten = false;
+                break;
+            }
+
+            // the readback of the previous frame must complete before its
+            // AOVs are rendered again, then it is written in the background
+            _WaitForGpu(engine.GetHgi());
+            if (previous) {
+                previous->isWritten =
+                    async(launch::async, [this, previous]() {
+                        return _WriteImages(previous->aovs, previous->frame);
+                    });
+                previous->isPending = false;
+            }
+
+            engine.SetCameraMatrices(view, proj);
+            do {
+                engine.Prepare();
+                engine.Render();
+            } while (!engine.IsConverged());
+
+            slot.frame = isDefault ? 0 : int(std::round(frames[i]));
+            slot.isPending = true;
+            _SubmitReadback(engine, slot);
+            previous = &slot;
+        }
+
+        _WaitForGpu(engine.GetHgi());
+        if (previous && previous->isPending && isWritten) {
+            previous->isWritten = async(launch::async, [this, previous]() {
+                return _WriteImages(previous->aovs, previous->frame);
+            });
+            previous->isPending = false;
+        }
+        for (auto&& slot : _slots) {
+            if (slot.isWritten.valid()) isWritten &= slot.isWritten.get();
+        }
+    }
+
+    // the render index isn't kept idle, there is no next render
+    RenderContext::ReleaseIdleContexts();
+
+    return isWritten;
+}
+
+bool BatchRender::_OpenStage()
+{
+    SdfLayerRefPtr rootLayer = SdfLayer::FindOrOpen(_options.usdFilePath);
+    if (!rootLayer) {
+        fprintf(stderr, "Error: unable to open %s\n",
+                _options.usdFilePath.c_str());
+        return false;
+    }
+    _stage = UsdStage::Open(rootLayer, SdfLayer::CreateAnonymous());
+
+    // same scene indices as the session layer, so that the render matches
+    // the one of the editor
+    UsdImagingCreateSceneIndicesInfo info;
+    info.displayUnloadedPrimsWithBounds = false;
+    UsdImagingSceneIndices sceneIndices = UsdImagingCreateSceneIndices(info);
+    sceneIndices.stageSceneIndex->SetStage(_stage);
+
+    _timeCache = TimeCacheSceneIndex::New(
+        sceneIndices.finalSceneIndex, sceneIndices.stageSceneIndex, _stage);
+    _model.AddSceneIndexBase(_timeCache);
+    _model.SetStage(_stage);
+    _model.SetTimeCacheSceneIndex(_timeCache);
+
+    return true;
+}
+
+vector<double> BatchRender::_GetFrames()
+{
+    double startFrame = _options.startFrame;
+    double endFrame = _options.endFrame;
+    if (!_options.hasFrameRange) {
+        // a stage without time range is rendered once at the default time
+        if (!_stage->HasAuthoredTimeCodeRange())
+            return {UsdTimeCode::Default().GetValue()};
+
+        startFrame = _stage->GetStartTimeCode();
+        endFrame = _stage->GetEndTimeCode();
+    }
+
+    vector<double> frames;
+    for (double frame = startFrame; frame <= endFrame + 1e-6;
+         frame += _options.frameStep)
+        frames.push_back(frame);
+    return frames;
+}
+
+bool BatchRender::_CheckFrames(const vector<double>& frames) const
+{
+    if (frames.size() > 1 &&
+        _options.outputPattern.find('#') == string::npos) {
+        fprintf(stderr,
+                "Error: %zu frames but the output pattern %s has no '#' for "
+                "the frame number\n",
+                frames.size(), _options.outputPattern.c_str());
+        return false;
+    }
+
+    // the images are numbered by whole frames, and the frames are sorted
+    for (size_t i = 1; i < frames.size(); i++) {
+        if (std::round(frames[i]) != std::round(frames[i - 1])) continue;
+
+        fprintf(stderr,
+                "Error: the frames %g and %g are both written as the frame "
+                "%d, the frame step must be at least 1\n",
+                frames[i - 1], frames[i], int(std::round(frames[i])));
+        return false;
+    }
+    return true;
+}
+
+bool BatchRender::_GetCameraMatrices(GfMatrix4d* view, GfMatrix4d* proj)
+{
+    SdfPath cameraPath = _options.camera;
+    if (cameraPath.IsEmpty()) {
+        SdfPathVector cameras = _model.GetCameras();
+        if (cameras.empty()) return false;
+        cameraPath = cameras[0];
+    }
+
+    HdSceneIndexPrim prim = _model.GetFinalSceneIndex()->GetPrim(cameraPath);
+    if (prim.primType != HdPrimTypeTokens->camera) return false;
+
+    // the data sources are sampled at the current time of the Model
+    HdSampledDataSource::Time time(0);
+
+    HdXformSchema xformSchema = HdXformSchema::GetFromParent(prim.dataSource);
+    HdCameraSchema camSchema = HdCameraSchema::GetFromParent(prim.dataSource);
+    if (!xformSchema.GetMatrix() || !camSchema.IsDefined()) return false;
+
+    GfCamera cam;
+    cam.SetTransform(
+        xformSchema.GetMatrix()->GetValue(time).Get<GfMatrix4d>());
+    cam.SetProjection(
+        camSchema.GetProjection()->GetValue(time).Get<TfToken>() ==
+                HdCameraSchemaTokens->orthographic
+            ? GfCamera::Orthographic
+            : GfCamera::Perspective);
+    cam.SetHorizontalAperture(
+        camSchema.GetHorizontalAperture()->GetValue(time).Get<float>() /
+        GfCamera::APERTURE_UNIT);
+    cam.SetVerticalAperture(
+        camSchema.GetVerticalAperture()->GetValue(time).Get<float>() /
+        GfCamera::APERTURE_UNIT);
+    cam.SetHorizontalApertureOffset(
+        camSchema.GetHorizontalApertureOffset()->GetValue(time).Get<float>() /
+        GfCamera::APERTURE_UNIT);
+    cam.SetVerticalApertureOffset(
+        camSchema.GetVerticalApertureOffset()->GetValue(time).Get<float>() /
+        GfCamera::APERTURE_UNIT);
+    cam.SetFocalLength(
+        camSchema.GetFocalLength()->GetValue(time).Get<float>() /
+        GfCamera::FOCAL_LENGTH_UNIT);
+    GfVec2f clippingRange =
+        camSchema.GetClippingRange()->GetValue(time).Get<GfVec2f>();
+    cam.SetClippingRange(GfRange1f(clippingRange[0], clippingRange[1]));
+
+    // the aperture is fitted to the aspect ratio of the images
+    GfFrustum frustum = cam.GetFrustum();
+    CameraUtilConformWindow(&frustum, CameraUtilFit,
+                            double(_options.width) / _options.height);
+
+    *view = frustum.ComputeViewMatrix();
+    *proj = frustum.ComputeProjectionMatrix();
+    return true;
+}
+
+/**
+ * @brief Get the pixel format of an Hgi texture format
+ *
+ * @param format the Hgi format
+ * @return the pixel format, with an invalid component format if the format
+ * can't be written
+ */
+static HdFormat _GetComponentFormat(HgiFormat format)
+{
+    switch (format) {
+        case HgiFormatUNorm8:
+        case HgiFormatUNorm8Vec2:
+        case HgiFormatUNorm8Vec4: return HdFormatUNorm8;
+        case HgiFormatFloat16:
+        case HgiFormatFloat16Vec2:
+        case HgiFormatFloat16Vec3:
+        case HgiFormatFloat16Vec4: return HdFormatFloat16;
+        case HgiFormatFloat32:
+        case HgiFormatFloat32Vec2:
+        case HgiFormatFloat32Vec3:
+        case HgiFormatFloat32Vec4: return HdFormatFloat32;
+        case HgiFormatInt32:
+        case HgiFormatInt32Vec2:
+        case HgiFormatInt32Vec3:
+        case HgiFormatInt32Vec4: return HdFormatInt32;
+        default: return HdFormatInvalid;
+    }
+}
+
+void BatchRender::_SubmitReadback(Engine& engine, _Slot& slot)
+{
+    TRACE_FUNCTION();
+
+    TfTokenVector aovNames{HdAovTokens->color};
+    for (auto&& aov : _options.aovs) {
+        if (aov != HdAovTokens->color) aovNames.push_back(aov);
+    }
+    slot.aovs.resize(aovNames.size());
+
+    Hgi* hgi = engine.GetHgi();
+    HgiBlitCmdsUniquePtr blitCmds = hgi->CreateBlitCmds();
+    bool hasCopies = false;
+
+    for (size_t i = 0; i < aovNames.size(); i++) {
+        _Aov& aov = slot.aovs[i];
+        aov.name = aovNames[i];
+        aov.width = 0;
+        aov.height = 0;
+
+        HgiTextureHandle texture = engine.GetAovTexture(aov.name);
+        if (texture) {
+            HgiTextureDesc const& desc = texture->GetDescriptor();
+            aov.format.componentFormat = _GetComponentFormat(desc.format);
+            aov.format.componentCount = HgiGetComponentCount(desc.format);
+            aov.format.pixelSize = HgiGetDataSizeOfFormat(desc.format);
+            if (aov.format.componentFormat == HdFormatInvalid) continue;
+
+            aov.width = desc.dimensions[0];
+            aov.height = desc.dimensions[1];
+            aov.pixels.resize(aov.width * aov.height * aov.format.pixelSize);
+
+            HgiTextureGpuToCpuOp copyOp;
+            copyOp.gpuSourceTexture = texture;
+            copyOp.sourceTexelOffset = GfVec3i(0);
+            copyOp.mipLevel = 0;
+            copyOp.cpuDestinationBuffer = aov.pixels.data();
+            copyOp.destinationByteOffset = 0;
+            copyOp.destinationBufferByteSize = aov.pixels.size();
+            blitCmds->CopyTextureGpuToCpu(copyOp);
+            hasCopies = true;
+            continue;
+        }
+
+        // the AOVs of the CPU renderers have no texture and are copied as-is
+        HdRenderBuffer* buffer = engine.GetRenderBuffer(aov.name);
+        if (!buffer) continue;
+
+        buffer->Resolve();
+        HdFormat format = buffer->GetFormat();
+        aov.format.componentFormat = HdGetComponentFormat(format);
+        aov.format.componentCount = int(HdGetComponentCount(format));
+        aov.format.pixelSize = HdDataSizeOfFormat(format);
+        if (aov.format.componentFormat == HdFormatInvalid) continue;
+
+        aov.width = buffer->GetWidth();
+        aov.height = buffer->GetHeight();
+        aov.pixels.resize(aov.width * aov.height * aov.format.pixelSize);
+
+        void* data = buffer->Map();
+        if (data) memcpy(aov.pixels.data(), data, aov.pixels.size());
+        buffer->Unmap();
+    }
+
+    // the copies run on the GPU after the render, while the previous frames
+    // are written
+    if (hasCopies) hgi->SubmitCmds(blitCmds.get(), HgiSubmitWaitTypeNoWait);
+}
+
+void BatchRender::_WaitForGpu(Hgi* hgi)
+{
+    TRACE_FUNCTION();
+
+    HgiBlitCmdsUniquePtr blitCmds = hgi->CreateBlitCmds();
+    hgi->SubmitCmds(blitCmds.get(), HgiSubmitWaitTypeWaitUntilCompleted);
+}
+
+string BatchRender::_GetImagePath(int frame, TfToken aov) const
+{
+    string path = _options.outputPattern;
+
+    // the first run of '#' is the padded frame number
+    size_t first = path.find('#');
+    if (first != string::npos) {
+        size_t last = path.find_first_not_of('#', first);
+        size_t padding = (last == string::npos ? path.size() : last) - first;
+        path.replace(first, padding,
+                     TfStringPrintf("%0*d", int(padding), frame));
+    }
+
+    // the other AOVs are written next to the color
+    if (aov != HdAovTokens->color) {
+        string extension = TfGetExtension(path);
+        path = path.substr(0, path.size() - extension.size() - 1) + "." +
+               aov.GetString() + "." + extension;
+    }
+    return path;
+}
+
+bool BatchRender::_WriteImages(const vector<_Aov>& aovs, int frame) const
+{
+    TRACE_FUNCTION();
+
+    bool isWritten = true;
+    for (auto&& aov : aovs) {
+        string path = _GetImagePath(frame, aov.name);
+        if (aov.width <= 0 || aov.height <= 0) {
+            fprintf(stderr, "Error: AOV %s is not rendered\n",
+                    aov.name.GetText());
+            isWritten = false;
+            continue;
+        }
+
+        string extension = TfStringToLower(TfGetExtension(path));
+        const bool isHdr =
+            std::find(HDR_EXTENSIONS.begin(), HDR_EXTENSIONS.end(),
+                      extension) != HDR_EXTENSIONS.end();
+
+        // the images are written with 1, 2 or 4 channels
+        const int srcCount = aov.format.componentCount;
+        const int dstCount = srcCount == 3 ? 4 : std::min(srcCount, 4);
+        const size_t pixelCount = size_t(aov.width) * aov.height;
+
+        vector<float> hdrPixels(isHdr ? pixelCount * dstCount : 0);
+        vector<uint8_t> ldrPixels(isHdr ? 0 : pixelCount * dstCount);
+
+        // the rows are read back from the bottom to the top
+        for (int y = 0; y < aov.height; y++) {
+            const uint8_t* srcRow = aov.pixels.data() +
+                                    size_t(aov.height - 1 - y) * aov.width *
+                                        aov.format.pixelSize;
+            for (int x = 0; x < aov.width; x++) {
+                const uint8_t* src = srcRow + x * aov.format.pixelSize;
+                size_t dst = (size_t(y) * aov.width + x) * dstCount;
+                for (int c = 0; c < dstCount; c++) {
+                    float value = 1.f;
+                    if (c < srcCount) {
+                        switch (aov.format.componentFormat) {
+                            case HdFormatUNorm8:
+                                value = src[c] / 255.f;
+                                break;
+                            case HdFormatFloat16:
+                                value = float(
+                                    reinterpret_cast<const GfHalf*>(src)[c]);
+                                break;
+                            case HdFormatFloat32:
+                                value = reinterpret_cast<const float*>(src)[c];
+                                break;
+                            case HdFormatInt32:
+                                value = float(
+                                    reinterpret_cast<const int32_t*>(src)[c]);
+                                break;
+                            default: break;
+                        }
+                    }
+                    if (isHdr)
+                        hdrPixels[dst + c] = value;
+                    else
+                        ldrPixels[dst + c] = uint8_t(
+                            std::clamp(value, 0.f, 1.f) * 255.f + .5f);
+                }
+            }
+        }
+
+        const HioFormat hdrFormats[] = {HioFormatFloat32, HioFormatFloat32Vec2,
+                                        HioFormatFloat32Vec3,
+                                        HioFormatFloat32Vec4};
+        const HioFormat ldrFormats[] = {HioFormatUNorm8, HioFormatUNorm8Vec2,
+                                        HioFormatUNorm8Vec3,
+                                        HioFormatUNorm8Vec4};
+
+        HioImage::StorageSpec storage;
+        storage.width = aov.width;
+        storage.height = aov.height;
+        storage.depth = 1;
+        storage.format =
+            isHdr ? hdrFormats[dstCount - 1] : ldrFormats[dstCount - 1];
+        storage.flipped = false;
+        storage.data = isHdr ? (void*)hdrPixels.data()
+                             : (void*)ldrPixels.data();
+
+        string dir = TfGetPathName(path);
+        if (!dir.empty()) TfMakeDirs(dir, -1, true);
+
+        HioImageSharedPtr image = HioImage::OpenForWriting(path);
+        if (!image || !image->Write(storage)) {
+            fprintf(stderr, "Error: unable to write %s\n", path.c_str());
+            isWritten = false;
+            continue;
+        }
+        printf("wrote %s\n", path.c_str());
+    }
+    return isWritten;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
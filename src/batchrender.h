@@ -0,0 +1,214 @@
+/**
+ * @file batchrender.h
+ * @author Raphael Jouretz (rjouretz.com)
+ * @brief BatchRender renders a stage over a frame range from one of its
+ * cameras to image files, without any UI (e.g. for turntables rendered on
+ * headless GPU nodes).
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <pxr/base/tf/token.h>
+#include <pxr/imaging/hd/renderBuffer.h>
+#include <pxr/imaging/hgi/hgi.h>
+#include <pxr/usd/sdf/path.h>
+#include <pxr/usd/usd/timeCode.h>
+
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "engine.h"
+#include "models/model.h"
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+using namespace std;
+
+/**
+ * @brief BatchRender renders a stage over a frame range from one of its
+ * cameras to image files, without any UI (e.g. for turntables rendered on
+ * headless GPU nodes).
+ *
+ * The frames are pipelined: the readback of a frame is submitted right after
+ * its render without waiting on the GPU, and its encoding and writing run on
+ * a worker thread while the next frames render. Hgi doesn't expose fences,
+ * so the GPU is only waited on once per frame, before the next render is
+ * submitted, and a frame is never read back while the renderer writes to its
+ * AOVs.
+ *
+ */
+class BatchRender {
+    public:
+        /**
+         * @brief The options of the batch render
+         *
+         */
+        struct Options {
+                string usdFilePath;
+                // the '#' characters are replaced by the padded frame number
+                string outputPattern;
+                SdfPath camera;
+                TfToken plugin;
+                // the color AOV is always written
+                TfTokenVector aovs;
+                int width = 1920;
+                int height = 1080;
+                bool hasFrameRange = false;
+                double startFrame = 0, endFrame = 0, frameStep = 1;
+        };
+
+        /**
+         * @brief Parse the batch render options of the command line
+         *
+         * @param argc the number of arguments
+         * @param argv the arguments
+         * @param options the parsed options
+         * @return true if the arguments are valid
+         * @return false otherwise
+         */
+        static bool ParseOptions(int argc, char** argv, Options& options);
+
+        /**
+         * @brief Print the usage of the batch render
+         *
+         */
+        static void PrintUsage();
+
+        /**
+         * @brief Construct a new Batch Render object
+         *
+         * @param options the options of the render
+         */
+        BatchRender(const Options& options);
+
+        /**
+         * @brief Render all the frames and write them. Must be called with a
+         * current graphics context for the Hgi backends that need one.
+         *
+         * @return true if all the frames were written
+         * @return false otherwise
+         */
+        bool Run();
+
+    private:
+        // the number of frames in flight: rendered, read back and encoded
+        static const int _SLOT_COUNT = 3;
+
+        /**
+         * @brief The pixel format of a read back AOV
+         *
+         */
+        struct _Format {
+                HdFormat componentFormat = HdFormatInvalid;
+                int componentCount = 0;
+                size_t pixelSize = 0;
+        };
+
+        /**
+         * @brief An AOV read back to the CPU
+         *
+         */
+        struct _Aov {
+                TfToken name;
+                _Format format;
+                int width = 0;
+                int height = 0;
+                vector<uint8_t> pixels;
+        };
+
+        /**
+         * @brief The AOVs of a frame in flight
+         *
+         */
+        struct _Slot {
+                vector<_Aov> aovs;
+                int frame = 0;
+                bool isPending = false;
+                future<bool> isWritten;
+        };
+
+        Options _options;
+        Model _model;
+        UsdStageRefPtr _stage;
+        TimeCacheSceneIndexRefPtr _timeCache;
+        _Slot _slots[_SLOT_COUNT];
+
+        /**
+         * @brief Open the stage and feed it to the Model the same way the
+         * editor does
+         *
+         * @return true if the stage was opened
+         * @return false otherwise
+         */
+        bool _OpenStage();
+
+        /**
+         * @brief Get the frames to render, from the options or the stage
+         *
+         * @return the frames to render
+         */
+        vector<double> _GetFrames();
+
+        /**
+         * @brief Check that every frame is written to its own images, i.e.
+         * that the output pattern has a frame number if there are several
+         * frames, and that no two frames round to the same number
+         *
+         * @param frames the frames to render
+         * @return true if the frames are written to distinct images
+         * @return false otherwise, after printing the error
+         */
+        bool _CheckFrames(const vector<double>& frames) const;
+
+        /**
+         * @brief Compute the matrices of the camera at the current time,
+         * conformed to the render size
+         *
+         * @param view the view matrix
+         * @param proj the projection matrix
+         * @return true if the camera was found
+         * @return false otherwise
+         */
+        bool _GetCameraMatrices(GfMatrix4d* view, GfMatrix4d* proj);
+
+        /**
+         * @brief Submit the readback of the AOVs of the last render to the
+         * given slot, without waiting on the GPU
+         *
+         * @param engine the Engine of the render
+         * @param slot the slot to read back to
+         */
+        void _SubmitReadback(Engine& engine, _Slot& slot);
+
+        /**
+         * @brief Wait until the GPU completed all the submitted work
+         *
+         * @param hgi the Hgi of the submitted work
+         */
+        void _WaitForGpu(Hgi* hgi);
+
+        /**
+         * @brief Get the path of the image of an AOV of a frame
+         *
+         * @param frame the frame number
+         * @param aov the name of the AOV
+         * @return the path of the image
+         */
+        string _GetImagePath(int frame, TfToken aov) const;
+
+        /**
+         * @brief Encode the AOVs of a slot and write them, on a worker thread
+         *
+         * @param aovs the AOVs to write
+         * @param frame the frame number
+         * @return true if all the AOVs were written
+         * @return false otherwise
+         */
+        bool _WriteImages(const vector<_Aov>& aovs, int frame) const;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
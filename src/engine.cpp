@@ -2,13 +2,23 @@
 
 #include <pxr/base/gf/camera.h>
 #include <pxr/base/gf/frustum.h>
+#include <pxr/base/trace/trace.h>
 #include <pxr/imaging/cameraUtil/conformWindow.h>
+#include <pxr/imaging/hd/aov.h>
 #include <pxr/imaging/hd/rendererPlugin.h>
 #include <pxr/imaging/hd/rendererPluginRegistry.h>
+#include <pxr/imaging/hd/resourceRegistry.h>
+#include <pxr/imaging/hd/tokens.h>
 #include <pxr/imaging/hdx/pickTask.h>
 #include <pxr/imaging/hgi/tokens.h>
 #include <pxr/imaging/hdSt/renderBuffer.h>
 
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#include "pickbuffer.h"
+
 #ifdef USE_GLINTEROP
 #include <pxr/imaging/garch/glApi.h>
 #endif
@@ -16,15 +26,24 @@
 PXR_NAMESPACE_OPEN_SCOPE
 
 Engine::Engine(HdSceneIndexBaseRefPtr sceneIndex, TfToken plugin)
-: _sceneIndex(sceneIndex),
-  _curRendererPlugin(plugin),
-  _hgi(Hgi::CreatePlatformDefaultHgi()),
-  _hgiDriver{HgiTokens->renderDriver, VtValue(_hgi.get())},
-  _engine(),
-  _renderDelegate(nullptr),
-  _renderIndex(nullptr),
+: _selectionGeneration(-1),
+  _culledGeneration(-1),
+  _renderOnDemand(true),
+  _isDirty(true),
+  _isCameraDirty(true),
+  _isHighlightDirty(false),
+  _isRenderSizeSet(false),
+  _isGridEnabled(true),
+  _isAovPickingEnabled(false),
+  _renderCount(0),
+  _sceneIndexObserver(this),
+  _context(RenderContext::Get(sceneIndex, plugin)),
+  _taskContext(),
+  _renderIndex(_context->GetRenderIndex()),
   _taskController(nullptr),
-  _taskControllerId("/defaultTaskController")
+  _sceneIndex(sceneIndex),
+  _taskControllerId(_context->CreateTaskControllerId()),
+  _curRendererPlugin(plugin)
 {
     _width = 512;
     _height = 512;
@@ -39,26 +58,26 @@ Engine::~Engine()
     _drawTarget = GlfDrawTargetRefPtr();
 #endif
 
-    // Destroy objects in opposite order of construction.
-    delete _taskController;
-
-    if (_renderIndex && _sceneIndex) {
-        _renderIndex->RemoveSceneIndex(_sceneIndex);
-        _sceneIndex = nullptr;
+    if (_sceneIndex) {
+        _sceneIndex->RemoveObserver(
+            HdSceneIndexObserverPtr(&_sceneIndexObserver));
     }
 
-    delete _renderIndex;
-    _renderDelegate = nullptr;
+    // the render index stays alive in the idle contexts after the last
+    // Engine of the context is destroyed
+    _gridTask = nullptr;
+    _renderIndex->RemoveTask(_gridTaskId);
+    delete _taskController;
+    RenderContext::Release(std::move(_context));
 }
 
 Hgi* Engine::GetHgi() const {
-    return _hgi.get();
+    return _context->GetHgi();
 }
 
-void Engine::RemoveSceneIndex(HdSceneIndexBaseRefPtr index) {
-    if (_renderIndex && index) {
-        _renderIndex->RemoveSceneIndex(_sceneIndex);
-    }
+RenderContextSharedPtr Engine::GetRenderContext() const
+{
+    return _context;
 }
 
 void Engine::Initialize()
@@ -73,13 +92,8 @@ void Engine::Initialize()
     _drawTarget->Unbind();
 #endif
 
-    // init render delegate
-    _renderDelegate = GetRenderDelegateFromPlugin(_curRendererPlugin);
-
-    // init render index
-    _renderIndex = HdRenderIndex::New(_renderDelegate.Get(), {&_hgiDriver});
-
-    _renderIndex->InsertSceneIndex(_sceneIndex, _taskControllerId);
+    // observe the scene to know when a new render is needed
+    _sceneIndex->AddObserver(HdSceneIndexObserverPtr(&_sceneIndexObserver));
 
     // init task controller
 
@@ -100,73 +114,78 @@ void Engine::Initialize()
     _taskController->SetRenderTags(TfTokenVector());
 
     // init AOVs
-    TfTokenVector _aovOutputs{HdAovTokens->color};
-    _taskController->SetRenderOutputs(_aovOutputs);
-
-    GfVec4f clearColor = GfVec4f(.2f, .2f, .2f, 1.0f);
-    HdAovDescriptor colorAovDesc =
-        _taskController->GetRenderOutputSettings(HdAovTokens->color);
-    if (colorAovDesc.format != HdFormatInvalid) {
-        colorAovDesc.clearValue = VtValue(clearColor);
-        _taskController->SetRenderOutputSettings(HdAovTokens->color,
-                                                 colorAovDesc);
-    }
+    _UpdateRenderOutputs();
 
-    // init selection
+    // init selection, the hovered prim is highlighted as located
     GfVec4f selectionColor = GfVec4f(1.f, 1.f, 0.f, .5f);
-    _selTracker = std::make_shared<HdxSelectionTracker>();
+    GfVec4f locateColor = GfVec4f(0.f, .7f, 1.f, .3f);
+    _selTracker = std::make_shared<_HighlightTracker>();
 
     _taskController->SetEnableSelection(true);
     _taskController->SetSelectionColor(selectionColor);
+    _taskController->SetSelectionLocateColor(locateColor);
 
-    VtValue selectionValue(_selTracker);
-    _engine.SetTaskContextData(HdxTokens->selectionState, selectionValue);
+    VtValue selectionValue(HdxSelectionTrackerSharedPtr(_selTracker));
+    _taskContext[HdxTokens->selectionState] = selectionValue;
 
     _taskController->SetOverrideWindowPolicy(CameraUtilFit);
+
+    // init grid, drawn over the AOVs of the task controller
+    _gridTaskId = _taskControllerId.AppendChild(TfToken("gridTask"));
+    _renderIndex->InsertTask<GridTask>(nullptr, _gridTaskId);
+    _gridTask = std::static_pointer_cast<GridTask>(
+        _renderIndex->GetTask(_gridTaskId));
 }
 
-TfTokenVector Engine::GetRendererPlugins()
+const HfPluginDescVector& Engine::_GetPluginDescriptors()
 {
-    HfPluginDescVector pluginDescriptors;
-    HdRendererPluginRegistry::GetInstance().GetPluginDescs(&pluginDescriptors);
+    // the plugins are discovered once, the menus query them on every frame
+    static const HfPluginDescVector pluginDescriptors = []() {
+        HfPluginDescVector descriptors;
+        HdRendererPluginRegistry::GetInstance().GetPluginDescs(&descriptors);
+        return descriptors;
+    }();
+    return pluginDescriptors;
+}
 
-    TfTokenVector plugins;
-    for (size_t i = 0; i < pluginDescriptors.size(); ++i) {
-        plugins.push_back(pluginDescriptors[i].id);
-    }
+TfTokenVector Engine::GetRendererPlugins()
+{
+    static const TfTokenVector plugins = []() {
+        TfTokenVector ids;
+        for (auto&& pluginDescriptor : _GetPluginDescriptors())
+            ids.push_back(pluginDescriptor.id);
+        return ids;
+    }();
     return plugins;
 }
 
 TfToken Engine::GetDefaultRendererPlugin()
 {
-    HdRendererPluginRegistry& registry =
-        HdRendererPluginRegistry::GetInstance();
-    return registry.GetDefaultPluginId(true);
+    static const TfToken plugin =
+        HdRendererPluginRegistry::GetInstance().GetDefaultPluginId(true);
+    return plugin;
 }
 
-TfToken Engine::GetCurrentRendererPlugin()
+bool Engine::IsFrustumCullingNative(TfToken plugin)
 {
-    return _curRendererPlugin;
+    return plugin == TfToken("HdStormRendererPlugin");
 }
 
-HdPluginRenderDelegateUniqueHandle Engine::GetRenderDelegateFromPlugin(
-    TfToken plugin)
+TfToken Engine::GetCurrentRendererPlugin()
 {
-    HdRendererPluginRegistry& registry =
-        HdRendererPluginRegistry::GetInstance();
-
-    TfToken resolvedId = registry.GetDefaultPluginId(true);
-
-    return registry.CreateRenderDelegate(plugin);
+    return _curRendererPlugin;
 }
 
 string Engine::GetRendererPluginName(TfToken plugin)
 {
-    HfPluginDesc pluginDescriptor;
-    bool foundPlugin = HdRendererPluginRegistry::GetInstance().GetPluginDesc(
-        plugin, &pluginDescriptor);
+    const HfPluginDescVector& pluginDescriptors = _GetPluginDescriptors();
+    auto it = std::find_if(pluginDescriptors.begin(), pluginDescriptors.end(),
+                           [&plugin](const HfPluginDesc& pluginDescriptor) {
+                               return pluginDescriptor.id == plugin;
+                           });
 
-    if (!foundPlugin) { return std::string(); }
+    if (it == pluginDescriptors.end()) { return std::string(); }
+    const HfPluginDesc& pluginDescriptor = *it;
 
     // TODO: fix that will be eventually delegate to Hgi
 #if defined(__APPLE__)
@@ -180,29 +199,86 @@ string Engine::GetRendererPluginName(TfToken plugin)
 
 void Engine::SetCameraMatrices(GfMatrix4d view, GfMatrix4d proj)
 {
+    if (view == _camView && proj == _camProj) return;
+
     _camView = view;
     _camProj = proj;
+    _isCameraDirty = true;
+    _isDirty = true;
+    _pickCache.isValid = false;
 }
 
-void Engine::SetSelection(SdfPathVector paths)
+void Engine::SetSelection(const SdfPathVector& paths, int generation)
 {
-    HdSelectionSharedPtr const selection = std::make_shared<HdSelection>();
+    if (generation == _selectionGeneration) return;
 
-    HdSelection::HighlightMode mode = HdSelection::HighlightModeSelect;
+    _selectionGeneration = generation;
 
+    // the paths are converted once per selection, not on every update of
+    // the hovered path
+    const SdfPath scenePrefix = _context->GetScenePrefix();
+    const bool isPrefixed = scenePrefix != SdfPath::AbsoluteRootPath();
+    SdfPathVector selection;
+    selection.reserve(paths.size());
     for (auto&& path : paths) {
-        SdfPath realPath =
-            path.ReplacePrefix(SdfPath::AbsoluteRootPath(), _taskControllerId);
-        selection->AddRprim(mode, realPath);
+        selection.push_back(
+            isPrefixed
+                ? path.ReplacePrefix(SdfPath::AbsoluteRootPath(), scenePrefix)
+                : path);
     }
 
-    _selTracker->SetSelection(selection);
+    // the selection task draws the highlight over the next render, which
+    // leaves the pick buffers and the picked regions valid
+    _selTracker->SetSelectedPaths(selection);
+    _isHighlightDirty = true;
+}
+
+void Engine::SetCulledPaths(const SdfPathVector& paths, int generation)
+{
+    if (generation == _culledGeneration) return;
+
+    _culledGeneration = generation;
+
+    const SdfPath scenePrefix = _context->GetScenePrefix();
+    SdfPathVector excludePaths;
+    excludePaths.reserve(paths.size());
+    for (auto&& path : paths) {
+        excludePaths.push_back(
+            path.ReplacePrefix(SdfPath::AbsoluteRootPath(), scenePrefix));
+    }
+    if (excludePaths == _collection.GetExcludePaths()) return;
+
+    // only the draw items of this task controller are filtered again, the
+    // culled prims stay synced
+    _collection.SetExcludePaths(excludePaths);
+    _taskController->SetCollection(_collection);
+    _isDirty = true;
+    _pickCache.isValid = false;
+}
+
+void Engine::SetHoveredPath(SdfPath path)
+{
+    if (path == _hoveredPath) return;
+
+    _hoveredPath = path;
+
+    // only the locate offsets of the hovered prim are computed again
+    _selTracker->SetHoveredPath(
+        path.IsEmpty() ? path
+                       : path.ReplacePrefix(SdfPath::AbsoluteRootPath(),
+                                            _context->GetScenePrefix()));
+    _isHighlightDirty = true;
 }
 
 void Engine::SetRenderSize(int width, int height)
 {
+    if (_isRenderSizeSet && width == _width && height == _height) return;
+
     _width = width;
     _height = height;
+    _isRenderSizeSet = true;
+    _isDirty = true;
+    _pickCache.isValid = false;
 
     _taskController->SetRenderViewport(GfVec4f(0, 0, width, height));
     _taskController->SetRenderBufferSize(GfVec2i(width, height));
@@ -214,7 +290,7 @@ void Engine::SetRenderSize(int width, int height)
 
     _taskController->SetFraming(framing);
 
-#ifdef USD_GLINTEROP
+#ifdef USE_GLINTEROP
     _drawTarget->Bind();
     _drawTarget->SetSize(GfVec2i(width, height));
     _drawTarget->Unbind();
@@ -223,18 +299,14 @@ void Engine::SetRenderSize(int width, int height)
 
 void Engine::Present()
 {
-    VtValue aov;
-    HgiTextureHandle aovTexture;
-
-    if (_engine.GetTaskContextData(HdAovTokens->color, &aov)) {
-        if (aov.IsHolding<HgiTextureHandle>()) {
-            aovTexture = aov.Get<HgiTextureHandle>();
-        }
-    }
+#ifdef USE_GLINTEROP
+    HgiTextureHandle aovTexture = GetRenderTexture();
+    if (!aovTexture) return;
 
-#ifdef USD_GLINTEROP
-    uint32_t framebuffer = 0;
-    _interop.TransferToApp(_hgi.get(), aovTexture,
+    // composite the AOV into the draw target so that its color attachment
+    // can be handed to the UI without leaving the GPU
+    uint32_t framebuffer = _drawTarget->GetFramebufferId();
+    _interop.TransferToApp(GetHgi(), aovTexture,
                            /*srcDepth*/ HgiTextureHandle(), HgiTokens->OpenGL,
                            VtValue(framebuffer),
                            GfVec4i(0, 0, _width, _height));
@@ -266,14 +338,63 @@ void Engine::PrepareDefaultLighting()
     _taskController->SetLightingState(lightingContextState);
 }
 
+void Engine::SetGridEnabled(bool enable)
+{
+    if (enable == _isGridEnabled) return;
+
+    _isGridEnabled = enable;
+    _isDirty = true;
+}
+
+bool Engine::IsGridEnabled() const
+{
+    return _isGridEnabled;
+}
+
+void Engine::SetRenderOnDemand(bool enable)
+{
+    _renderOnDemand = enable;
+}
+
+bool Engine::IsRenderOnDemand() const
+{
+    return _renderOnDemand;
+}
+
+bool Engine::NeedsRender()
+{
+    return !_renderOnDemand || _isDirty || _isHighlightDirty ||
+           !IsConverged();
+}
+
+void Engine::SetDirty()
+{
+    _isDirty = true;
+    _pickCache.isValid = false;
+}
+
+bool Engine::IsConverged() const
+{
+    return _taskController->IsConverged();
+}
+
 void Engine::Prepare()
 {
+    TRACE_FUNCTION();
+
+    // the default light follows the camera, so only rebuild the lighting
+    // context when the camera moved
+    if (!_isCameraDirty) return;
+
     PrepareDefaultLighting();
     _taskController->SetFreeCameraMatrices(_camView, _camProj);
+    _isCameraDirty = false;
 }
 
-void Engine::Render()
+void Engine::Render(recursive_mutex* sceneMutex)
 {
+    TRACE_FUNCTION();
+
 #ifdef USE_GLINTEROP
     _drawTarget->Bind();
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
@@ -281,8 +402,35 @@ void Engine::Render()
 #else
     _taskController->SetEnablePresentation(false);
 #endif
+    // a render only needed by the highlight leaves the picking AOVs as they
+    // were, so it keeps the render count of the captured pick buffers
+    const bool isHighlightOnly =
+        _renderOnDemand && _isHighlightDirty && !_isDirty && IsConverged();
+
+    // consume the dirty state before executing so that changes happening
+    // during the render trigger another one
+    _isDirty = false;
+    _isHighlightDirty = false;
+
     HdTaskSharedPtrVector tasks = _taskController->GetRenderingTasks();
-    _engine.Execute(_renderIndex, &tasks);
+
+    // the grid is drawn once the AOV input task has published the AOVs, so
+    // that the selection and the color correction apply over it
+    GridTaskParams gridParams;
+    gridParams.enabled = _isGridEnabled;
+    gridParams.viewMatrix = _camView;
+    gridParams.projectionMatrix = _camProj;
+    _gridTask->SetParams(gridParams);
+
+    auto it = std::find_if(tasks.begin(), tasks.end(),
+                           [](const HdTaskSharedPtr& task) {
+                               return task->GetId().GetName() ==
+                                      "aovInputTask";
+                           });
+    tasks.insert(it == tasks.end() ? it : it + 1, _gridTask);
+
+    _Execute(&tasks, sceneMutex);
+    if (!isHighlightOnly) _renderCount++;
 
     Present();
 
@@ -291,60 +439,569 @@ void Engine::Render()
 #endif
 }
 
+void Engine::_Execute(HdTaskSharedPtrVector* tasks,
+                      recursive_mutex* sceneMutex)
+{
+    // the sync reads the scene and applies its notices to the render index,
+    // so it is done with the scene mutex locked
+    {
+        unique_lock<recursive_mutex> sceneLock;
+        if (sceneMutex) sceneLock = unique_lock<recursive_mutex>(*sceneMutex);
+
+        _context->SetNoticeBatchingEnabled(false);
+        _context->SyncAll(tasks, &_taskContext);
+        for (auto&& task : *tasks) task->Prepare(&_taskContext, _renderIndex);
+
+        // the edits made while the tasks execute only queue their notices
+        if (sceneMutex) _context->SetNoticeBatchingEnabled(true);
+    }
+
+    for (auto&& task : *tasks) task->Execute(&_taskContext);
+
+    if (sceneMutex) {
+        lock_guard<recursive_mutex> sceneLock(*sceneMutex);
+        _context->SetNoticeBatchingEnabled(false);
+    }
+}
+
 Engine::IntersectionResult Engine::FindIntersection(GfVec2f screenPos)
 {
-    // create a narrowed frustum on the given position
-    float normalizedXPos = screenPos[0] / _width;
-    float normalizedYPos = screenPos[1] / _height;
+    TRACE_FUNCTION();
+
+    // a click picks the single pixel under the cursor, the cached region of
+    // FindIntersections would resolve all the prims of a whole tile
+    GfVec2i pixel(floor(screenPos[0]), floor(screenPos[1]));
+    HdxPickHitVector hits = _Pick(pixel, pixel + GfVec2i(1, 1),
+                                  HdxPickTokens->resolveNearestToCenter);
+    if (hits.empty()) return {};
+
+    return _ToIntersectionResult(hits[0]);
+}
+
+vector<Engine::IntersectionResult> Engine::FindIntersections(
+    GfVec2f screenMin, GfVec2f screenMax)
+{
+    TRACE_FUNCTION();
+
+    GfVec2i min(floor(std::min(screenMin[0], screenMax[0])),
+                floor(std::min(screenMin[1], screenMax[1])));
+    GfVec2i max(ceil(std::max(screenMin[0], screenMax[0])),
+                ceil(std::max(screenMin[1], screenMax[1])));
+
+    HdxPickHitVector hits = _Pick(min, max, HdxPickTokens->resolveUnique);
 
-    GfVec2d size(1.0 / _width, 1.0 / _height);
+    // instances of the same prim are reported as a single intersection
+    vector<IntersectionResult> results;
+    SdfPathSet paths;
+    for (auto&& hit : hits) {
+        IntersectionResult result = _ToIntersectionResult(hit);
+        if (paths.insert(result.path).second) results.push_back(result);
+    }
+    return results;
+}
+
+vector<Engine::IntersectionResult> Engine::FindIntersections(
+    const vector<GfVec2f>& screenPositions)
+{
+    TRACE_FUNCTION();
+
+    vector<IntersectionResult> results(screenPositions.size());
+    if (screenPositions.empty()) return results;
+
+    GfVec2i min(INT_MAX, INT_MAX), max(INT_MIN, INT_MIN);
+    for (auto&& pos : screenPositions) {
+        GfVec2i pixel(floor(pos[0]), floor(pos[1]));
+        min = GfVec2i(std::min(min[0], pixel[0]), std::min(min[1], pixel[1]));
+        max = GfVec2i(std::max(max[0], pixel[0] + 1),
+                      std::max(max[1], pixel[1] + 1));
+    }
+
+    // only execute the picking tasks if the positions leave the cached region
+    if (!_pickCache.isValid || min[0] < _pickCache.min[0] ||
+        min[1] < _pickCache.min[1] || max[0] > _pickCache.max[0] ||
+        max[1] > _pickCache.max[1]) {
+        _UpdatePickCache(min, max);
+    }
+
+    const int cacheWidth = _pickCache.max[0] - _pickCache.min[0];
+    for (size_t i = 0; i < screenPositions.size(); i++) {
+        int x = int(floor(screenPositions[i][0])) - _pickCache.min[0];
+        int y = int(floor(screenPositions[i][1])) - _pickCache.min[1];
+        if (x < 0 || y < 0 || x >= cacheWidth ||
+            y >= _pickCache.max[1] - _pickCache.min[1])
+            continue;
+
+        int hitIndex = _pickCache.hitIndices[y * cacheWidth + x];
+        if (hitIndex >= 0)
+            results[i] = _ToIntersectionResult(_pickCache.hits[hitIndex]);
+    }
+    return results;
+}
+
+bool Engine::IsPickingSupported()
+{
+    if (_curRendererPlugin == TfToken("HdStormRendererPlugin")) return true;
+
+    // the other renderers pick from their prim id AOV, if they have one
+    HdRenderDelegate* renderDelegate = _renderIndex->GetRenderDelegate();
+    return renderDelegate->GetDefaultAovDescriptor(HdAovTokens->primId)
+               .format != HdFormatInvalid;
+}
+
+void Engine::SetAovPickingEnabled(bool enable)
+{
+    if (enable == _isAovPickingEnabled) return;
+
+    _isAovPickingEnabled = enable;
+    _UpdateRenderOutputs();
+    _isDirty = true;
+}
+
+bool Engine::IsAovPickingEnabled() const
+{
+    return _isAovPickingEnabled;
+}
+
+bool Engine::IsAovPickingSupported()
+{
+    return _isAovPickingEnabled &&
+           _taskController->GetRenderOutput(HdAovTokens->primId) &&
+           _taskController->GetRenderOutput(HdAovTokens->depth);
+}
+
+bool Engine::UpdatePickBuffer(PickBuffer* pickBuffer)
+{
+    if (!pickBuffer || !IsAovPickingSupported()) return false;
+    if (_renderCount == 0) return false;
+    if (pickBuffer->IsValid() && !pickBuffer->IsTile() &&
+        pickBuffer->GetRenderCount() == _renderCount)
+        return true;
+
+    TRACE_FUNCTION();
+
+    HdRenderBuffer* primIdBuffer =
+        _taskController->GetRenderOutput(HdAovTokens->primId);
+    HdRenderBuffer* instanceIdBuffer =
+        _taskController->GetRenderOutput(HdAovTokens->instanceId);
+    HdRenderBuffer* depthBuffer =
+        _taskController->GetRenderOutput(HdAovTokens->depth);
+
+    const int width = primIdBuffer->GetWidth();
+    const int height = primIdBuffer->GetHeight();
+    if (primIdBuffer->GetFormat() != HdFormatInt32 ||
+        depthBuffer->GetFormat() != HdFormatFloat32 ||
+        int(depthBuffer->GetWidth()) != width ||
+        int(depthBuffer->GetHeight()) != height)
+        return false;
+
+    if (instanceIdBuffer && (instanceIdBuffer->GetFormat() != HdFormatInt32 ||
+                             int(instanceIdBuffer->GetWidth()) != width ||
+                             int(instanceIdBuffer->GetHeight()) != height))
+        instanceIdBuffer = nullptr;
+
+    // the multi-sampled buffers are resolved before being read back
+    primIdBuffer->Resolve();
+    depthBuffer->Resolve();
+    if (instanceIdBuffer) instanceIdBuffer->Resolve();
+
+    const int32_t* primIds =
+        static_cast<const int32_t*>(primIdBuffer->Map());
+    const float* depths = static_cast<const float*>(depthBuffer->Map());
+    const int32_t* instanceIds =
+        instanceIdBuffer ? static_cast<const int32_t*>(instanceIdBuffer->Map())
+                         : nullptr;
+
+    pickBuffer->Capture(
+        width, height, primIds, instanceIds, depths,
+        [this](int primId) { return _GetPrimIdPath(primId); },
+        _camView * _camProj, _renderCount);
+
+    primIdBuffer->Unmap();
+    depthBuffer->Unmap();
+    if (instanceIdBuffer) instanceIdBuffer->Unmap();
+
+    return pickBuffer->IsValid();
+}
+
+bool Engine::UpdatePickTile(GfVec2f pos, PickBuffer* pickBuffer)
+{
+    if (!pickBuffer || !IsAovPickingSupported()) return false;
+    if (_renderCount == 0) return false;
+
+    // the CPU renderers have no AOV textures, and mapping their buffers
+    // doesn't wait on a GPU
+    HgiTextureHandle primIds = GetAovTexture(HdAovTokens->primId);
+    HgiTextureHandle depths = GetAovTexture(HdAovTokens->depth);
+    if (!PickTileReadback::IsSupported(GetHgi()) || !primIds || !depths)
+        return UpdatePickBuffer(pickBuffer) && pickBuffer->IsCovering(pos);
+
+    TRACE_FUNCTION();
+
+    // a finished readback is captured even if a newer render happened, so
+    // that the hover has a tile to sample meanwhile
+    _pickTileReadback.Capture(
+        pickBuffer, [this](int primId) { return _GetPrimIdPath(primId); });
+
+    if (pickBuffer->GetRenderCount() == _renderCount &&
+        pickBuffer->IsCovering(pos))
+        return true;
+    if (_pickTileReadback.IsPending()) return false;
+
+    // the tile is centered on the position, the AOV rows going from the
+    // bottom to the top
+    const GfVec3i renderSize = primIds->GetDescriptor().dimensions;
+    const GfVec2i size(std::min(_PICK_TILE_SIZE, renderSize[0]),
+                       std::min(_PICK_TILE_SIZE, renderSize[1]));
+    const int x = int(floor(pos[0] * renderSize[0]));
+    const int row = renderSize[1] - 1 - int(floor(pos[1] * renderSize[1]));
+    const GfVec2i offset(
+        std::clamp(x - size[0] / 2, 0, renderSize[0] - size[0]),
+        std::clamp(row - size[1] / 2, 0, renderSize[1] - size[1]));
+
+    if (!_pickTileReadback.Start(primIds,
+                                 GetAovTexture(HdAovTokens->instanceId),
+                                 depths, offset, size, _camView * _camProj,
+                                 _renderCount))
+        return UpdatePickBuffer(pickBuffer) && pickBuffer->IsCovering(pos);
+
+    return false;
+}
+
+SdfPath Engine::_GetPrimIdPath(int primId) const
+{
+    SdfPath path = _renderIndex->GetRprimPathFromPrimId(primId);
+    if (path.IsEmpty()) return path;
+
+    return path.ReplacePrefix(_context->GetScenePrefix(),
+                              SdfPath::AbsoluteRootPath());
+}
+
+void Engine::_UpdateRenderOutputs()
+{
+    // the depth is needed by the grid for all the renderers
+    TfTokenVector aovOutputs{HdAovTokens->color, HdAovTokens->depth};
+
+    // the picking AOVs are only rendered if the render delegate has them
+    HdRenderDelegate* renderDelegate = _renderIndex->GetRenderDelegate();
+    if (_isAovPickingEnabled &&
+        renderDelegate->GetDefaultAovDescriptor(HdAovTokens->primId).format !=
+            HdFormatInvalid) {
+        aovOutputs.push_back(HdAovTokens->primId);
+        if (renderDelegate->GetDefaultAovDescriptor(HdAovTokens->instanceId)
+                .format != HdFormatInvalid)
+            aovOutputs.push_back(HdAovTokens->instanceId);
+    }
+
+    for (auto&& aov : _extraAovs) {
+        if (std::find(aovOutputs.begin(), aovOutputs.end(), aov) !=
+                aovOutputs.end() ||
+            renderDelegate->GetDefaultAovDescriptor(aov).format ==
+                HdFormatInvalid)
+            continue;
+        aovOutputs.push_back(aov);
+    }
+
+    _taskController->SetRenderOutputs(aovOutputs);
+    _renderOutputs = aovOutputs;
+    _taskController->SetViewportRenderOutput(HdAovTokens->color);
+
+    GfVec4f clearColor = GfVec4f(.2f, .2f, .2f, 1.0f);
+    HdAovDescriptor colorAovDesc =
+        _taskController->GetRenderOutputSettings(HdAovTokens->color);
+    if (colorAovDesc.format != HdFormatInvalid) {
+        colorAovDesc.clearValue = VtValue(clearColor);
+        _taskController->SetRenderOutputSettings(HdAovTokens->color,
+                                                 colorAovDesc);
+    }
+}
+
+HdxPickHitVector Engine::_Pick(GfVec2i screenMin, GfVec2i screenMax,
+                               TfToken resolveMode)
+{
+    TRACE_FUNCTION();
+
+    GfVec2i resolution(std::max(screenMax[0] - screenMin[0], 1),
+                       std::max(screenMax[1] - screenMin[1], 1));
+
+    // create a narrowed frustum on the given rectangle, whose size is the
+    // half extent of the rectangle in normalized coordinates
+    GfVec2d center((screenMin[0] + resolution[0] * 0.5) / _width,
+                   (screenMin[1] + resolution[1] * 0.5) / _height);
+    GfVec2d size(double(resolution[0]) / _width,
+                 double(resolution[1]) / _height);
 
     GfCamera gfCam;
     gfCam.SetFromViewAndProjectionMatrix(_camView, _camProj);
     GfFrustum frustum = gfCam.GetFrustum();
 
     auto nFrustum = frustum.ComputeNarrowedFrustum(
-        GfVec2d(2.0 * normalizedXPos - 1.0,
-                2.0 * (1.0 - normalizedYPos) - 1.0),
-        size);
+        GfVec2d(2.0 * center[0] - 1.0, 2.0 * (1.0 - center[1]) - 1.0), size);
 
-    // check the intersection from the narrowed frustum
+    // check the intersections from the narrowed frustum
     HdxPickHitVector allHits;
     HdxPickTaskContextParams pickParams;
-    pickParams.resolveMode = HdxPickTokens->resolveNearestToCenter;
+    pickParams.resolution = resolution;
+    pickParams.resolveMode = resolveMode;
     pickParams.viewMatrix = nFrustum.ComputeViewMatrix();
     pickParams.projectionMatrix = nFrustum.ComputeProjectionMatrix();
     pickParams.collection = _collection;
     pickParams.outHits = &allHits;
     const VtValue vtPickParams(pickParams);
 
-    _engine.SetTaskContextData(HdxPickTokens->pickParams, vtPickParams);
+    _taskContext[HdxPickTokens->pickParams] = vtPickParams;
 
     // render with the picking task
     HdTaskSharedPtrVector tasks = _taskController->GetPickingTasks();
-    _engine.Execute(_renderIndex, &tasks);
+    _Execute(&tasks, nullptr);
 
-    // get the hitting point
-    if (allHits.size() != 1) return {};
+    return allHits;
+}
 
-    const SdfPath path = allHits[0].objectId.ReplacePrefix(
-        _taskControllerId, SdfPath::AbsoluteRootPath());
+Engine::IntersectionResult Engine::_ToIntersectionResult(
+    const HdxPickHit& hit)
+{
+    const SdfPath path = hit.objectId.ReplacePrefix(
+        _context->GetScenePrefix(), SdfPath::AbsoluteRootPath());
 
-    return { path, GfVec3f(allHits[0].worldSpaceHitPoint), GfVec3f(allHits[0].worldSpaceHitNormal) };
+    return {path, GfVec3f(hit.worldSpaceHitPoint),
+            GfVec3f(hit.worldSpaceHitNormal), hit.instanceIndex};
+}
+
+void Engine::_UpdatePickCache(GfVec2i screenMin, GfVec2i screenMax)
+{
+    TRACE_FUNCTION();
+
+    // grow the region to a tile so that the next positions (e.g. hovering)
+    // are likely to hit the cache
+    for (int i = 0; i < 2; i++) {
+        int extent = screenMax[i] - screenMin[i];
+        if (extent < _PICK_TILE_SIZE) {
+            screenMin[i] -= (_PICK_TILE_SIZE - extent) / 2;
+            screenMax[i] = screenMin[i] + _PICK_TILE_SIZE;
+        }
+    }
+
+    _pickCache.min = screenMin;
+    _pickCache.max = screenMax;
+    _pickCache.hits = _Pick(screenMin, screenMax, HdxPickTokens->resolveAll);
+    _pickCache.isValid = true;
+
+    const int width = screenMax[0] - screenMin[0];
+    const int height = screenMax[1] - screenMin[1];
+    _pickCache.hitIndices.assign(width * height, -1);
+
+    // the hits don't carry their pixel, so bin them by projecting their
+    // world space position back on the screen
+    GfMatrix4d viewProj = _camView * _camProj;
+    for (size_t i = 0; i < _pickCache.hits.size(); i++) {
+        const HdxPickHit& hit = _pickCache.hits[i];
+        GfVec3d ndc = viewProj.Transform(hit.worldSpaceHitPoint);
+
+        int x = int(floor((ndc[0] + 1) * 0.5 * _width)) - screenMin[0];
+        int y = int(floor((1 - ndc[1]) * 0.5 * _height)) - screenMin[1];
+        if (x < 0 || y < 0 || x >= width || y >= height) continue;
+
+        // keep the nearest hit of each pixel
+        int& hitIndex = _pickCache.hitIndices[y * width + x];
+        if (hitIndex < 0 ||
+            hit.normalizedDepth < _pickCache.hits[hitIndex].normalizedDepth)
+            hitIndex = int(i);
+    }
 }
 
 HdxTaskController* Engine::GetHdxTaskController() const {
     return _taskController;
 }
 
+void Engine::SetExtraRenderOutputs(const TfTokenVector& aovs)
+{
+    if (aovs == _extraAovs) return;
+
+    _extraAovs = aovs;
+    _UpdateRenderOutputs();
+    _isDirty = true;
+}
+
+HgiTextureHandle Engine::GetRenderTexture()
+{
+    return GetAovTexture(HdAovTokens->color);
+}
+
+HgiTextureHandle Engine::GetAovTexture(TfToken aovName)
+{
+    // the task context holds the final color AOV (after color correction)
+    auto aov = _taskContext.find(HdAovTokens->color);
+    if (aovName == HdAovTokens->color && aov != _taskContext.end() &&
+        aov->second.IsHolding<HgiTextureHandle>()) {
+        return aov->second.Get<HgiTextureHandle>();
+    }
+
+    // otherwise, fall back to the resource of the render buffer
+    HdRenderBuffer* buffer = _taskController->GetRenderOutput(aovName);
+    if (!buffer) return HgiTextureHandle();
+
+    buffer->Resolve();
+    VtValue resource = buffer->GetResource(false);
+    if (resource.IsHolding<HgiTextureHandle>())
+        return resource.Get<HgiTextureHandle>();
+
+    return HgiTextureHandle();
+}
+
+HdRenderBuffer* Engine::GetRenderBuffer(TfToken aov)
+{
+    return _taskController->GetRenderOutput(aov);
+}
+
+VtDictionary Engine::GetResourceAllocation() const
+{
+    return _renderIndex->GetResourceRegistry()->GetResourceAllocation();
+}
+
+size_t Engine::GetRenderBufferByteSize()
+{
+    size_t byteSize = 0;
+    for (auto&& aov : _renderOutputs) {
+        HdRenderBuffer* buffer = _taskController->GetRenderOutput(aov);
+        if (!buffer) continue;
+
+        byteSize += size_t(buffer->GetWidth()) * buffer->GetHeight() *
+                    HdDataSizeOfFormat(buffer->GetFormat());
+    }
+    return byteSize;
+}
+
 void* Engine::GetRenderBufferData()
 {
-#if USE_GLINTEROP
-    GLint id =
-    _drawTarget->GetAttachment(HdAovTokens->color)->GetGlTextureName();
+#ifdef USE_GLINTEROP
+    GLuint id =
+        _drawTarget->GetAttachment(HdAovTokens->color)->GetGlTextureName();
     return (void*)(uintptr_t)id;
+#else
+    // the UI renders with OpenGL, so only a GL texture can be shared as-is;
+    // other Hgi backends (e.g. Metal) must go through the readback
+    if (GetHgi()->GetAPIName() != HgiTokens->OpenGL) return nullptr;
+
+    HgiTextureHandle texture = GetRenderTexture();
+    if (!texture) return nullptr;
+
+    return (void*)(uintptr_t)texture->GetRawResource();
 #endif
-    return nullptr;
+}
+
+Engine::_HighlightTracker::_HighlightTracker()
+    : _selectTracker(std::make_shared<HdxSelectionTracker>()),
+      _locateTracker(std::make_shared<HdxSelectionTracker>()),
+      _isRprimChanged(false),
+      _hasSelectOffsets(false),
+      _selectOffsetsVersion(-1)
+{
+}
+
+void Engine::_HighlightTracker::SetSelectedPaths(const SdfPathVector& paths)
+{
+    HdSelectionSharedPtr const selection = std::make_shared<HdSelection>();
+    for (auto&& path : paths)
+        selection->AddRprim(HdSelection::HighlightModeSelect, path);
+
+    _selectTracker->SetSelection(selection);
+    _IncrementVersion();
+}
+
+void Engine::_HighlightTracker::SetHoveredPath(const SdfPath& path)
+{
+    HdSelectionSharedPtr const selection = std::make_shared<HdSelection>();
+    if (!path.IsEmpty())
+        selection->AddRprim(HdSelection::HighlightModeLocate, path);
+
+    _locateTracker->SetSelection(selection);
+    _IncrementVersion();
+}
+
+void Engine::_HighlightTracker::InvalidateOffsets()
+{
+    _isRprimChanged = true;
+}
+
+void Engine::_HighlightTracker::UpdateSelection(HdRenderIndex* index)
+{
+    if (_isRprimChanged.exchange(false)) {
+        _selectOffsetsVersion = -1;
+        _IncrementVersion();
+    }
+
+    HdxSelectionTracker::UpdateSelection(index);
+}
+
+bool Engine::_HighlightTracker::GetSelectionOffsetBuffer(
+    HdRenderIndex const* index, bool enableSelectionHighlight,
+    bool enableLocateHighlight, VtIntArray* offsets) const
+{
+    TRACE_FUNCTION();
+
+    if (_selectOffsetsVersion != _selectTracker->GetVersion()) {
+        _hasSelectOffsets = _selectTracker->GetSelectionOffsetBuffer(
+            index, true, false, &_selectOffsets);
+        _selectOffsetsVersion = _selectTracker->GetVersion();
+    }
+    const bool hasSelect = enableSelectionHighlight && _hasSelectOffsets;
+
+    VtIntArray locateOffsets;
+    const bool hasLocate =
+        enableLocateHighlight &&
+        _locateTracker->GetSelectionOffsetBuffer(index, false, true,
+                                                 &locateOffsets);
+
+    if (!hasLocate) {
+        if (hasSelect) *offsets = _selectOffsets;
+        return hasSelect;
+    }
+    if (!hasSelect) {
+        *offsets = locateOffsets;
+        return true;
+    }
+
+    // the locate offsets are appended to the select ones, and the header
+    // points to them
+    const size_t locateIndex = HdSelection::HighlightModeLocate + 1;
+    const size_t locateOffset = locateOffsets[locateIndex];
+    const size_t selectSize = _selectOffsets.size();
+    *offsets = _selectOffsets;
+    offsets->resize(selectSize + locateOffsets.size() - locateOffset);
+    std::copy(locateOffsets.cbegin() + locateOffset, locateOffsets.cend(),
+              offsets->begin() + selectSize);
+    (*offsets)[locateIndex] = int(selectSize);
+    return true;
+}
+
+void Engine::_SceneIndexObserver::PrimsAdded(const HdSceneIndexBase& sender,
+                                             const AddedPrimEntries& entries)
+{
+    _engine->_isDirty = true;
+    _engine->_pickCache.isValid = false;
+    if (_engine->_selTracker) _engine->_selTracker->InvalidateOffsets();
+}
+
+void Engine::_SceneIndexObserver::PrimsRemoved(
+    const HdSceneIndexBase& sender, const RemovedPrimEntries& entries)
+{
+    _engine->_isDirty = true;
+    _engine->_pickCache.isValid = false;
+    if (_engine->_selTracker) _engine->_selTracker->InvalidateOffsets();
+}
+
+void Engine::_SceneIndexObserver::PrimsDirtied(
+    const HdSceneIndexBase& sender, const DirtiedPrimEntries& entries)
+{
+    _engine->_isDirty = true;
+    _engine->_pickCache.isValid = false;
+}
+
+void Engine::_SceneIndexObserver::PrimsRenamed(
+    const HdSceneIndexBase& sender, const RenamedPrimEntries& entries)
+{
+    _engine->_isDirty = true;
+    _engine->_pickCache.isValid = false;
 }
 
 GfFrustum Engine::GetFrustum()
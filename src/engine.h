@@ -11,24 +11,40 @@
 
 #include <pxr/base/tf/token.h>
 #include <pxr/imaging/glf/drawTarget.h>
-#include <pxr/imaging/hd/engine.h>
+#include <pxr/imaging/hd/task.h>
 #include <pxr/imaging/hd/pluginRenderDelegateUniqueHandle.h>
 #include <pxr/imaging/hd/renderDelegate.h>
 #include <pxr/imaging/hd/sceneIndex.h>
+#include <pxr/imaging/hdx/pickTask.h>
+#include <pxr/imaging/hdx/selectionTracker.h>
 #include <pxr/imaging/hdx/taskController.h>
+#include <pxr/imaging/hf/pluginDesc.h>
 #include <pxr/imaging/hgi/hgi.h>
 #include <pxr/imaging/hgiInterop/hgiInterop.h>
 #include <pxr/usd/usd/prim.h>
 
+#include <atomic>
+#include <mutex>
+
+#include "gridtask.h"
+#include "picktilereadback.h"
+#include "rendercontext.h"
+
 PXR_NAMESPACE_OPEN_SCOPE
 
-using HgiUniquePtr = std::unique_ptr<class Hgi>;
 using namespace std;
 
+class PickBuffer;
+
 /**
  * @brief Engine is the renderer that renders a stage according to a given
  * renderer plugin.
  *
+ * The render index is held by a RenderContext that may be shared with the
+ * Engines of other views rendering the same Scene Index with the same
+ * plugin. Each Engine has its own task controller, so the camera, the render
+ * size and the AOVs stay per view.
+ *
  */
 class Engine {
     public:
@@ -48,6 +64,13 @@ class Engine {
 
         Hgi* GetHgi() const;
 
+        /**
+         * @brief Get the render context of the Engine
+         *
+         * @return the render context, possibly shared with other Engines
+         */
+        RenderContextSharedPtr GetRenderContext() const;
+
         /**
          * @brief Get the list of available renderer plugins
          *
@@ -67,7 +90,18 @@ class Engine {
          *
          * @return the name of a renderer plugin
          */
-        string GetRendererPluginName(TfToken plugin);
+        static string GetRendererPluginName(TfToken plugin);
+
+        /**
+         * @brief Check if a renderer plugin culls the prims outside of the
+         * camera frustum by itself (Storm culls its draw items), which makes
+         * the culled paths of the Engine redundant
+         *
+         * @param plugin the renderer plugin
+         * @return true if the renderer culls by itself
+         * @return false otherwise
+         */
+        static bool IsFrustumCullingNative(TfToken plugin);
 
         /**
          * @brief Get the current renderer plugin
@@ -85,11 +119,33 @@ class Engine {
         void SetCameraMatrices(GfMatrix4d view, GfMatrix4d proj);
 
         /**
-         * @brief Set the current selection
+         * @brief Set the current selection. The selection is only pushed to
+         * Hydra when its generation changes, so that the selection tracker
+         * keeps its version and the highlights are not uploaded again.
          *
          * @param paths a vector of SDF Paths
+         * @param generation the generation of the selection (see
+         * Model::GetSelectionGeneration)
+         */
+        void SetSelection(const SdfPathVector& paths, int generation);
+
+        /**
+         * @brief Set the Prims culled by this Engine. They are excluded from
+         * its collection, so the other Engines sharing the render index still
+         * draw them. The collection is only updated when the generation
+         * changes.
+         *
+         * @param paths the sorted paths of the culled Prims
+         * @param generation the generation of the culled paths
          */
-        void SetSelection(SdfPathVector paths);
+        void SetCulledPaths(const SdfPathVector& paths, int generation);
+
+        /**
+         * @brief Set the Prim highlighted under the cursor
+         *
+         * @param path the path of the hovered Prim, or an empty path
+         */
+        void SetHoveredPath(SdfPath path);
 
         /**
          * @brief Set the render size
@@ -99,18 +155,80 @@ class Engine {
          */
         void SetRenderSize(int width, int height);
 
+        /**
+         * @brief Enable or disable the grid drawn on the ground plane
+         *
+         * @param enable true to draw the grid
+         */
+        void SetGridEnabled(bool enable);
+
+        /**
+         * @brief Check if the grid is drawn
+         *
+         * @return true if the grid is drawn
+         * @return false otherwise
+         */
+        bool IsGridEnabled() const;
+
+        /**
+         * @brief Enable or disable the render on demand. When enabled,
+         * NeedsRender only returns true if the camera, the render size, the
+         * selection or the scene changed since the last render, or if the
+         * render has not converged yet.
+         *
+         * @param enable true to enable the render on demand
+         */
+        void SetRenderOnDemand(bool enable);
+
+        /**
+         * @brief Check if the render on demand is enabled
+         *
+         * @return true if the render on demand is enabled
+         * @return false otherwise
+         */
+        bool IsRenderOnDemand() const;
+
+        /**
+         * @brief Check if the last render is out of date and a new one must
+         * be done
+         *
+         * @return true if Prepare and Render must be called
+         * @return false if the last render texture can be reused as-is
+         */
+        bool NeedsRender();
+
+        /**
+         * @brief Force the next call to NeedsRender to return true
+         */
+        void SetDirty();
+
+        /**
+         * @brief Check if the render delegate has converged (e.g. all the
+         * samples of a progressive renderer are accumulated)
+         *
+         * @return true if the render has converged
+         * @return false otherwise
+         */
+        bool IsConverged() const;
+
         /**
          * @brief Prepare the renderer
          */
         void Prepare();
 
         /**
-         * @brief Render the current state
+         * @brief Render the current state. Without a scene mutex, the scene
+         * must not be edited during the render.
+         *
+         * @param sceneMutex the mutex locked while the render index is
+         * synced with the scene, and unlocked while the tasks execute, or
+         * nullptr if the caller already locked the scene
          */
-        void Render();
+        void Render(recursive_mutex* sceneMutex = nullptr);
 
         /**
-         * @brief Find the visible USD Prim at the given screen position
+         * @brief Find the visible USD Prim at the given screen position by
+         * picking the single pixel under it (e.g. on click)
          *
          * @param screenPos the position of the screen
          *
@@ -121,62 +239,363 @@ class Engine {
             SdfPath path;
             GfVec3f worldSpaceHitPoint;
             GfVec3f worldSpaceHitNormal;
+            int instanceIndex = -1;
         };
         IntersectionResult FindIntersection(GfVec2f screenPos);
 
         /**
-         * @brief Get the data from the render buffer
+         * @brief Find all the visible USD Prims inside the given screen
+         * rectangle with a single execution of the picking tasks
+         *
+         * @param screenMin the top left corner of the rectangle
+         * @param screenMax the bottom right corner of the rectangle
+         *
+         * @return one intersection per visible Prim
+         */
+        vector<IntersectionResult> FindIntersections(GfVec2f screenMin,
+                                                     GfVec2f screenMax);
+
+        /**
+         * @brief Find the visible USD Prim at each of the given screen
+         * positions with a single execution of the picking tasks. The hits
+         * are cached while the camera and the scene don't change, so picking
+         * again inside the same region (e.g. on hover) doesn't execute the
+         * picking tasks. The whole cached tile is resolved, so a single
+         * pick (e.g. on click) should use FindIntersection instead.
+         *
+         * @param screenPositions the positions on the screen
+         *
+         * @return one intersection per position, with an empty path where
+         * no Prim is visible
+         */
+        vector<IntersectionResult> FindIntersections(
+            const vector<GfVec2f>& screenPositions);
+
+        /**
+         * @brief Check if the renderer plugin supports the picking tasks,
+         * either natively (Storm) or from a prim id AOV
+         *
+         * @return true if the intersections can be found by rendering
+         * @return false otherwise
+         */
+        bool IsPickingSupported();
+
+        /**
+         * @brief Enable or disable the prim id, instance id and depth AOVs
+         * rendered along the color, which the pick buffers are captured from
+         *
+         * @param enable true to render the picking AOVs
+         */
+        void SetAovPickingEnabled(bool enable);
+
+        /**
+         * @brief Check if the picking AOVs are enabled
+         *
+         * @return true if the picking AOVs are enabled
+         * @return false otherwise
+         */
+        bool IsAovPickingEnabled() const;
+
+        /**
+         * @brief Check if the picking AOVs are enabled and rendered by the
+         * renderer plugin
+         *
+         * @return true if a pick buffer can be captured
+         * @return false otherwise
+         */
+        bool IsAovPickingSupported();
+
+        /**
+         * @brief Capture the picking AOVs of the last render in the given
+         * pick buffer, unless it already holds them. Reading the AOVs back
+         * waits on the GPU, so it is only done when a pick is needed.
+         *
+         * @param pickBuffer the pick buffer to update
+         * @return true if the pick buffer holds the last render
+         * @return false if the picking AOVs are not supported
+         */
+        bool UpdatePickBuffer(PickBuffer* pickBuffer);
+
+        /**
+         * @brief Capture a tile of the picking AOVs of the last render
+         * around the given position in the given pick buffer, for the
+         * hover. With HgiGL, the tile is read back asynchronously and only
+         * captured by a later call once the GPU is done with it, so that
+         * the calls never wait on the GPU; the whole AOVs are captured with
+         * the other backends.
+         *
+         * @param pos the normalized position, from the top left
+         * @param pickBuffer the pick buffer to update
+         * @return true if the pick buffer covers the position for the last
+         * render
+         * @return false if the tile is still read back, or if the picking
+         * AOVs are not supported
+         */
+        bool UpdatePickTile(GfVec2f pos, PickBuffer* pickBuffer);
+
+        /**
+         * @brief Set the AOVs rendered in addition to the color, the depth
+         * and the picking ones (e.g. normals for an offline render). The
+         * AOVs unknown to the render delegate are ignored.
+         *
+         * @param aovs the names of the AOVs
+         */
+        void SetExtraRenderOutputs(const TfTokenVector& aovs);
+
+        /**
+         * @brief Get the color AOV texture of the last render
          *
-         * @return the data from the render buffer
+         * @return the Hgi handle of the color AOV texture, or an empty handle
+         * if no render is available
+         */
+        HgiTextureHandle GetRenderTexture();
+
+        /**
+         * @brief Get the texture of the given AOV of the last render
+         *
+         * @param aov the name of the AOV
+         * @return the Hgi handle of the AOV texture, or an empty handle if the
+         * AOV is not rendered or not held by a texture (e.g. a CPU renderer)
+         */
+        HgiTextureHandle GetAovTexture(TfToken aov);
+
+        /**
+         * @brief Get the render buffer of the given AOV, to read the AOVs
+         * that are not held by a texture
+         *
+         * @param aov the name of the AOV
+         * @return the render buffer, or nullptr if the AOV is not rendered
+         */
+        HdRenderBuffer* GetRenderBuffer(TfToken aov);
+
+        /**
+         * @brief Get a native handle of the color render texture that can be
+         * displayed as-is by the UI (e.g. as an ImTextureID)
+         *
+         * @return the native texture handle, or nullptr if the render texture
+         * can't be shared with the UI and must be read back instead
          */
         void *GetRenderBufferData();
 
-        HdxTaskController* GetHdxTaskController() const;
+        /**
+         * @brief Get the resources allocated by the render delegate for the
+         * scene, as reported by its resource registry. The resources are
+         * shared by the Engines of the render context.
+         *
+         * @return the allocations in bytes, by resource type
+         */
+        VtDictionary GetResourceAllocation() const;
 
-        void RemoveSceneIndex(HdSceneIndexBaseRefPtr);
+        /**
+         * @brief Get the size of the rendered AOVs, without their
+         * multisampled copies
+         *
+         * @return the size in bytes
+         */
+        size_t GetRenderBufferByteSize();
+
+        HdxTaskController* GetHdxTaskController() const;
 
 
     private:
+        /**
+         * @brief Scene Index Observer that marks the Engine dirty when the
+         * rendered scene changes
+         *
+         */
+        class _SceneIndexObserver : public HdSceneIndexObserver {
+            public:
+                _SceneIndexObserver(Engine* engine) : _engine(engine) {}
+
+                void PrimsAdded(const HdSceneIndexBase& sender,
+                                const AddedPrimEntries& entries) override;
+                void PrimsRemoved(const HdSceneIndexBase& sender,
+                                  const RemovedPrimEntries& entries) override;
+                void PrimsDirtied(const HdSceneIndexBase& sender,
+                                  const DirtiedPrimEntries& entries) override;
+                void PrimsRenamed(const HdSceneIndexBase& sender,
+                                  const RenamedPrimEntries& entries) override;
+
+            private:
+                Engine* _engine;
+        };
+
+        /**
+         * @brief Selection tracker of the selected and the hovered prims.
+         * The offsets of the selected prims are cached until the selection
+         * or the rprims change, so that the hover only computes the offsets
+         * of the hovered prim.
+         *
+         * The offsets of the two highlight modes are computed by a tracker
+         * each, and merged following the layout of HdxSelectionTracker: a
+         * header of one offset per mode followed by the offsets of each
+         * mode. The hovered rprims are always whole, so the locate offsets
+         * hold no offset into the buffer and can be moved after the select
+         * ones as-is.
+         *
+         */
+        class _HighlightTracker : public HdxSelectionTracker {
+            public:
+                /**
+                 * @brief Construct a new Highlight Tracker object
+                 *
+                 */
+                _HighlightTracker();
+
+                /**
+                 * @brief Set the selected prims
+                 *
+                 * @param paths the paths in the render index
+                 */
+                void SetSelectedPaths(const SdfPathVector& paths);
+
+                /**
+                 * @brief Set the hovered prim
+                 *
+                 * @param path the path in the render index, or an empty path
+                 */
+                void SetHoveredPath(const SdfPath& path);
+
+                /**
+                 * @brief Invalidate the cached offsets, the rprims ids having
+                 * changed. May be called from any thread.
+                 *
+                 */
+                void InvalidateOffsets();
+
+                /**
+                 * @brief Bump the version of the tracker if the rprims
+                 * changed, so that the selection task gets the offsets again
+                 *
+                 * @param index the render index
+                 */
+                void UpdateSelection(HdRenderIndex* index) override;
+
+                /**
+                 * @brief Get the offsets of the selected and the hovered
+                 * prims, only computing the select ones if out of date
+                 *
+                 * @param index the render index
+                 * @param enableSelectionHighlight true to get the select
+                 * offsets
+                 * @param enableLocateHighlight true to get the locate offsets
+                 * @param offsets the offsets
+                 * @return true if a prim is highlighted
+                 * @return false otherwise
+                 */
+                bool GetSelectionOffsetBuffer(
+                    HdRenderIndex const* index, bool enableSelectionHighlight,
+                    bool enableLocateHighlight,
+                    VtIntArray* offsets) const override;
+
+            private:
+                HdxSelectionTrackerSharedPtr _selectTracker, _locateTracker;
+                atomic<bool> _isRprimChanged;
+
+                // the select offsets of the last version of the select
+                // tracker, -1 if not computed
+                mutable VtIntArray _selectOffsets;
+                mutable bool _hasSelectOffsets;
+                mutable int _selectOffsetsVersion;
+        };
+
+        /**
+         * @brief Per-pixel hits of the last region picked at positions
+         *
+         */
+        struct _PickCache {
+                GfVec2i min, max;
+                vector<int> hitIndices;
+                HdxPickHitVector hits;
+                // invalidated by the notices of the scene edits
+                atomic<bool> isValid = false;
+        };
+
+        // minimum size of the region picked at positions, and size of the
+        // tiles read back for the hover, in pixels
+        inline static const int _PICK_TILE_SIZE = 64;
+
         UsdStageWeakPtr _stage;
 
-#ifdef USD_GLINTEROP
+#ifdef USE_GLINTEROP
         GlfDrawTargetRefPtr _drawTarget;
         HgiInterop _interop;
 #endif
 
         GfMatrix4d _camView, _camProj;
         int _width, _height;
-
-        HgiUniquePtr _hgi;
-        HdDriver _hgiDriver;
-
-        HdEngine _engine;
-        HdPluginRenderDelegateUniqueHandle _renderDelegate;
+        int _selectionGeneration;
+        SdfPath _hoveredPath;
+        int _culledGeneration;
+        TfTokenVector _extraAovs, _renderOutputs;
+
+        // the dirty flags are set by the notices of the scene edits, which
+        // may come from another thread than the render. The highlight only
+        // changes the color of the render, not its picking AOVs
+        bool _renderOnDemand;
+        atomic<bool> _isDirty, _isCameraDirty;
+        bool _isHighlightDirty, _isRenderSizeSet;
+        bool _isGridEnabled, _isAovPickingEnabled;
+        size_t _renderCount;
+        _SceneIndexObserver _sceneIndexObserver;
+        _PickCache _pickCache;
+        PickTileReadback _pickTileReadback;
+
+        RenderContextSharedPtr _context;
+
+        // the tasks are executed by the Engine rather than by an HdEngine,
+        // so that the scene mutex is only locked by their sync
+        HdTaskContext _taskContext;
         HdRenderIndex *_renderIndex;
         HdxTaskController *_taskController;
         HdRprimCollection _collection;
         HdSceneIndexBaseRefPtr _sceneIndex;
         SdfPath _taskControllerId;
+        SdfPath _gridTaskId;
+        GridTaskSharedPtr _gridTask;
 
-        HdxSelectionTrackerSharedPtr _selTracker;
+        std::shared_ptr<_HighlightTracker> _selTracker;
 
         TfToken _curRendererPlugin;
 
         /**
-         * @brief Get the render delegate from the given renderer plugin
-         *
-         * @param plugin the renderer plugin
+         * @brief Get the descriptors of the renderer plugins, queried from
+         * the registry on the first call only
          *
-         * @return the renderer delegate fro, the given renderer plugin
+         * @return the descriptors of the renderer plugins
          */
-        static HdPluginRenderDelegateUniqueHandle GetRenderDelegateFromPlugin(
-            TfToken plugin);
+        static const HfPluginDescVector& _GetPluginDescriptors();
 
         /**
          * @brief Initialize the renderer
          */
         void Initialize();
 
+        /**
+         * @brief Set the AOVs of the task controller, with the picking ones
+         * if they are enabled and supported
+         */
+        void _UpdateRenderOutputs();
+
+        /**
+         * @brief Get the path of the Prim of a prim id of the picking AOVs
+         *
+         * @param primId the prim id
+         * @return the path in the scene, or an empty path if the id has no
+         * Prim
+         */
+        SdfPath _GetPrimIdPath(int primId) const;
+
+        /**
+         * @brief Sync, prepare and execute the given tasks, as HdEngine does
+         *
+         * @param tasks the tasks to execute
+         * @param sceneMutex the mutex only locked while the render index is
+         * synced, or nullptr if the caller already locked the scene
+         */
+        void _Execute(HdTaskSharedPtrVector* tasks,
+                      recursive_mutex* sceneMutex);
+
         /**
          * @brief Prepare the default lighting
          */
@@ -193,6 +612,37 @@ class Engine {
          * @return the current frustum
          */
         GfFrustum GetFrustum();
+
+        /**
+         * @brief Execute the picking tasks on the given screen rectangle,
+         * with one pick buffer pixel per screen pixel
+         *
+         * @param screenMin the top left corner of the rectangle, in pixels
+         * @param screenMax the bottom right corner of the rectangle, in pixels
+         * @param resolveMode the resolve mode of the pick task
+         *
+         * @return the hits of the picking tasks
+         */
+        HdxPickHitVector _Pick(GfVec2i screenMin, GfVec2i screenMax,
+                               TfToken resolveMode);
+
+        /**
+         * @brief Convert a pick hit to an intersection result
+         *
+         * @param hit the pick hit
+         *
+         * @return the intersection result of the hit
+         */
+        IntersectionResult _ToIntersectionResult(const HdxPickHit& hit);
+
+        /**
+         * @brief Pick the region around the given positions and cache its hit
+         * per pixel
+         *
+         * @param screenMin the top left corner of the positions, in pixels
+         * @param screenMax the bottom right corner of the positions, in pixels
+         */
+        void _UpdatePickCache(GfVec2i screenMin, GfVec2i screenMax);
 };
 
 PXR_NAMESPACE_CLOSE_SCOPE
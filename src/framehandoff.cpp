@@ -0,0 +1,234 @@
+#include "framehandoff.h"
+
+#include <pxr/base/trace/trace.h>
+#include <pxr/imaging/garch/glApi.h>
+#include <pxr/imaging/hgi/blitCmds.h>
+#include <pxr/imaging/hgi/blitCmdsOps.h>
+#include <pxr/imaging/hgi/tokens.h>
+
+extern "C"
+int LabCreateRGBAf16Texture(int width, int height, uint8_t* rgba_pixels);
+extern "C"
+void* LabTextureHardwareHandle(int texture);
+extern "C"
+void LabRemoveTexture(int texture);
+extern "C"
+void LabUpdateRGBAf16Texture(int texture, uint8_t* rgba_pixels);
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+/**
+ * @brief Get the GL internal format of an Hgi texture format
+ *
+ * @param format the Hgi format
+ * @return the GL internal format, or 0 if it has none
+ */
+GLenum GetGlInternalFormat(HgiFormat format)
+{
+    switch (format) {
+        case HgiFormatUNorm8Vec4: return GL_RGBA8;
+        case HgiFormatFloat16Vec4: return GL_RGBA16F;
+        case HgiFormatFloat32Vec4: return GL_RGBA32F;
+        default: return 0;
+    }
+}
+
+/**
+ * @brief Make the GPU wait for the given fence and delete it
+ *
+ * @param fence the fence, reset to nullptr
+ */
+void WaitFence(void*& fence)
+{
+    if (!fence) return;
+
+    glWaitSync((GLsync)fence, 0, GL_TIMEOUT_IGNORED);
+    glDeleteSync((GLsync)fence);
+    fence = nullptr;
+}
+
+/**
+ * @brief Insert a fence after the GL commands submitted so far
+ *
+ * @return the fence
+ */
+void* InsertFence()
+{
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    // the fence is waited on by the other context, so it must be flushed
+    glFlush();
+    return (void*)fence;
+}
+}  // namespace
+
+FrameHandoff::FrameHandoff()
+    : _latest(1),
+      _back(0),
+      _front(2),
+      _isConverged(true),
+      _byteSize(0),
+      _texture(-1),
+      _textureWidth(0),
+      _textureHeight(0),
+      _renderMs(0)
+{
+}
+
+FrameHandoff::~FrameHandoff()
+{
+    if (_texture >= 0) LabRemoveTexture(_texture);
+
+    for (auto&& frame : _frames) {
+        if (frame.fence) glDeleteSync((GLsync)frame.fence);
+        if (frame.glTexture) glDeleteTextures(1, &frame.glTexture);
+    }
+}
+
+void FrameHandoff::Publish(Hgi* hgi, HgiTextureHandle const& texture,
+                           bool isConverged, double renderMs)
+{
+    if (!hgi || !texture) return;
+
+    TRACE_FUNCTION();
+
+    _Frame& frame = _frames[_back];
+    if (hgi->GetAPIName() != HgiTokens->OpenGL ||
+        !_CopyGlTexture(texture, frame))
+        _ReadbackTexture(hgi, texture, frame);
+    frame.renderMs = renderMs;
+
+    _isConverged = isConverged;
+    _back = _latest.exchange(_back | _NEW_FRAME) & ~_NEW_FRAME;
+}
+
+void* FrameHandoff::Present()
+{
+    if (_latest.load() & _NEW_FRAME) {
+        TRACE_FUNCTION();
+
+        // the previous front texture is reused by the render thread once
+        // the draws of the UI sampling it are done
+        _Frame& previous = _frames[_front];
+        if (previous.glTexture) previous.fence = InsertFence();
+
+        _front = _latest.exchange(_front) & ~_NEW_FRAME;
+        _Frame& frame = _frames[_front];
+        _renderMs = frame.renderMs;
+
+        if (frame.glTexture) {
+            // the UI draws wait for the copy of the render thread
+            WaitFence(frame.fence);
+        }
+        else if (_texture < 0 || _textureWidth != frame.width ||
+                 _textureHeight != frame.height) {
+            if (_texture >= 0) LabRemoveTexture(_texture);
+            _textureWidth = frame.width;
+            _textureHeight = frame.height;
+            _texture = LabCreateRGBAf16Texture(_textureWidth, _textureHeight,
+                                               frame.pixels.data());
+        }
+        else {
+            LabUpdateRGBAf16Texture(_texture, frame.pixels.data());
+        }
+    }
+
+    const _Frame& frame = _frames[_front];
+    if (frame.glTexture) return (void*)(uintptr_t)frame.glTexture;
+    if (_texture < 0) return nullptr;
+    return LabTextureHardwareHandle(_texture);
+}
+
+bool FrameHandoff::IsConverged() const
+{
+    return _isConverged;
+}
+
+double FrameHandoff::TakeRenderMs()
+{
+    double renderMs = _renderMs;
+    _renderMs = 0;
+    return renderMs;
+}
+
+size_t FrameHandoff::GetByteSize() const
+{
+    return _byteSize;
+}
+
+bool FrameHandoff::_CopyGlTexture(HgiTextureHandle const& texture,
+                                  _Frame& frame)
+{
+    HgiTextureDesc const& desc = texture->GetDescriptor();
+    const GLenum internalFormat = GetGlInternalFormat(desc.format);
+    if (internalFormat == 0) return false;
+
+    const int width = desc.dimensions[0];
+    const int height = desc.dimensions[1];
+    if (!frame.glTexture || frame.width != width || frame.height != height ||
+        frame.format != desc.format) {
+        // the fence of the previous texture is no use for the new one
+        WaitFence(frame.fence);
+        if (frame.glTexture) {
+            glDeleteTextures(1, &frame.glTexture);
+            _byteSize -= size_t(frame.width) * frame.height *
+                         HgiGetDataSizeOfFormat(frame.format);
+        }
+
+        glGenTextures(1, &frame.glTexture);
+        glBindTexture(GL_TEXTURE_2D, frame.glTexture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        frame.width = width;
+        frame.height = height;
+        frame.format = desc.format;
+        _byteSize += size_t(width) * height *
+                     HgiGetDataSizeOfFormat(desc.format);
+    }
+
+    // the copy waits for the UI draws that sampled the texture, and the UI
+    // draws will wait for the copy
+    WaitFence(frame.fence);
+    glCopyImageSubData(GLuint(texture->GetRawResource()), GL_TEXTURE_2D, 0, 0,
+                       0, 0, frame.glTexture, GL_TEXTURE_2D, 0, 0, 0, 0, width,
+                       height, 1);
+    frame.fence = InsertFence();
+    return true;
+}
+
+void FrameHandoff::_ReadbackTexture(Hgi* hgi, HgiTextureHandle const& texture,
+                                    _Frame& frame)
+{
+    HgiTextureDesc const& desc = texture->GetDescriptor();
+    const int width = desc.dimensions[0];
+    const int height = desc.dimensions[1];
+    const size_t byteSize =
+        width * height * HgiGetDataSizeOfFormat(desc.format);
+
+    if (frame.pixels.size() != byteSize) {
+        _byteSize += byteSize;
+        _byteSize -= frame.pixels.size();
+        frame.pixels.resize(byteSize);
+    }
+    frame.width = width;
+    frame.height = height;
+
+    HgiTextureGpuToCpuOp copyOp;
+    copyOp.gpuSourceTexture = texture;
+    copyOp.sourceTexelOffset = GfVec3i(0);
+    copyOp.mipLevel = 0;
+    copyOp.cpuDestinationBuffer = frame.pixels.data();
+    copyOp.destinationByteOffset = 0;
+    copyOp.destinationBufferByteSize = byteSize;
+
+    // the render thread waits for the readback, the UI thread doesn't
+    HgiBlitCmdsUniquePtr blitCmds = hgi->CreateBlitCmds();
+    blitCmds->CopyTextureGpuToCpu(copyOp);
+    hgi->SubmitCmds(blitCmds.get(), HgiSubmitWaitTypeWaitUntilCompleted);
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
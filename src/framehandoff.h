@@ -0,0 +1,151 @@
+/**
+ * @file framehandoff.h
+ * @author Raphael Jouretz (rjouretz.com)
+ * @brief FrameHandoff hands the frames rendered on the render thread to the
+ * UI thread through a lock-free triple buffer of GL textures, or of
+ * readbacks uploaded to a UI texture for the other Hgi backends.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <pxr/imaging/hgi/hgi.h>
+#include <pxr/imaging/hgi/texture.h>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+using namespace std;
+
+/**
+ * @brief FrameHandoff hands the frames rendered on the render thread to the
+ * UI thread through a lock-free triple buffer of GL textures, or of
+ * readbacks uploaded to a UI texture for the other Hgi backends.
+ *
+ * The render thread copies the color AOV to the back frame and publishes
+ * it, the UI thread swaps the latest published frame with its front frame
+ * and draws it. Neither thread ever waits on the other, and the frames
+ * published while the UI is busy are superseded by the newer ones.
+ *
+ * With HgiGL, the frames are GL textures of the context shared by the two
+ * threads: the copy stays on the GPU, and the fence of a frame makes the
+ * next user of its texture wait on the GPU (not on the CPU) for the
+ * previous one, the copy of the render thread or the draw of the UI.
+ * Metal has no context shared with the GL UI, so its frames are read back
+ * and uploaded.
+ *
+ */
+class FrameHandoff {
+    public:
+        /**
+         * @brief Construct a new Frame Handoff object
+         *
+         */
+        FrameHandoff();
+
+        /**
+         * @brief Destroy the Frame Handoff object and its UI texture. Must be
+         * called on the UI thread.
+         *
+         */
+        ~FrameHandoff();
+
+        /**
+         * @brief Copy the given texture to the back frame and publish it.
+         * Must be called on the render thread.
+         *
+         * @param hgi the Hgi that owns the texture
+         * @param texture the texture to read back
+         * @param isConverged true if the render of the frame is converged
+         * @param renderMs the duration of the render of the frame
+         */
+        void Publish(Hgi* hgi, HgiTextureHandle const& texture,
+                     bool isConverged, double renderMs);
+
+        /**
+         * @brief Swap the latest published frame to the front, if a new one
+         * was published, and upload it if it was read back. Must be called
+         * on the UI thread.
+         *
+         * @return the native handle of the front texture, or nullptr if no
+         * frame was published yet
+         */
+        void* Present();
+
+        /**
+         * @brief Check if the render of the latest published frame is
+         * converged
+         *
+         * @return true if the render is converged
+         * @return false otherwise
+         */
+        bool IsConverged() const;
+
+        /**
+         * @brief Get the render duration of the last frame swapped to the
+         * front, once per frame. Must be called on the UI thread.
+         *
+         * @return the duration in milliseconds, or 0 if no frame was swapped
+         * to the front since the last call
+         */
+        double TakeRenderMs();
+
+        /**
+         * @brief Get the total size of the frames
+         *
+         * @return the size in bytes
+         */
+        size_t GetByteSize() const;
+
+    private:
+        // the latest frame index is flagged when it wasn't presented yet
+        static constexpr int _NEW_FRAME = 4;
+
+        struct _Frame {
+                vector<uint8_t> pixels;
+                int width = 0;
+                int height = 0;
+                // the GL texture of the frame and the fence of its last use,
+                // 0 if the frame is read back
+                uint32_t glTexture = 0;
+                HgiFormat format = HgiFormatInvalid;
+                void* fence = nullptr;
+                double renderMs = 0;
+        };
+
+        _Frame _frames[3];
+        atomic<int> _latest;
+        int _back, _front;
+        atomic<bool> _isConverged;
+        atomic<size_t> _byteSize;
+
+        int _texture, _textureWidth, _textureHeight;
+        double _renderMs;
+
+        /**
+         * @brief Copy the given GL texture to the GL texture of a frame
+         *
+         * @param texture the texture to copy
+         * @param frame the frame to copy the texture to
+         * @return true if the texture was copied
+         * @return false if its format has no GL texture equivalent
+         */
+        bool _CopyGlTexture(HgiTextureHandle const& texture, _Frame& frame);
+
+        /**
+         * @brief Read the given texture back to the pixels of a frame, and
+         * wait for the readback
+         *
+         * @param hgi the Hgi that owns the texture
+         * @param texture the texture to read back
+         * @param frame the frame to read the texture back to
+         */
+        void _ReadbackTexture(Hgi* hgi, HgiTextureHandle const& texture,
+                              _Frame& frame);
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
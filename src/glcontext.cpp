@@ -0,0 +1,170 @@
+#include "glcontext.h"
+
+#include <GLFW/glfw3.h>
+#if defined(USE_EGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace {
+#if defined(USE_EGL)
+/**
+ * @brief Get the EGL display of the first GPU, which needs no X or Wayland
+ * server, or the default display if the GPUs can't be enumerated
+ *
+ * @return the EGL display, or EGL_NO_DISPLAY if there is none
+ */
+EGLDisplay GetEglDisplay()
+{
+    auto queryDevices = reinterpret_cast<PFNEGLQUERYDEVICESEXTPROC>(
+        eglGetProcAddress("eglQueryDevicesEXT"));
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT"));
+
+    EGLDeviceEXT device;
+    EGLint deviceCount = 0;
+    if (queryDevices && getPlatformDisplay &&
+        queryDevices(1, &device, &deviceCount) && deviceCount > 0) {
+        EGLDisplay display =
+            getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, device, NULL);
+        if (display != EGL_NO_DISPLAY) return display;
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+/**
+ * @brief Destroy the EGL context of an offscreen context and release its
+ * display
+ *
+ * @param context the offscreen context, whose EGL handles are reset
+ */
+void DestroyEglContext(OffscreenContext& context)
+{
+    EGLDisplay display = context.eglDisplay;
+    if (display == EGL_NO_DISPLAY) return;
+
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context.eglContext != EGL_NO_CONTEXT)
+        eglDestroyContext(display, context.eglContext);
+    if (context.eglSurface != EGL_NO_SURFACE)
+        eglDestroySurface(display, context.eglSurface);
+    eglTerminate(display);
+
+    context.eglDisplay = EGL_NO_DISPLAY;
+    context.eglSurface = EGL_NO_SURFACE;
+    context.eglContext = EGL_NO_CONTEXT;
+}
+
+/**
+ * @brief Create a GL 4.5 core context with EGL and make it current
+ *
+ * @param context the offscreen context, whose EGL handles are set
+ * @return true if the context was created and made current
+ * @return false otherwise
+ */
+bool CreateEglContext(OffscreenContext& context)
+{
+    EGLDisplay display = GetEglDisplay();
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+        return false;
+    context.eglDisplay = display;
+
+    const EGLint configAttribs[] = {EGL_SURFACE_TYPE,
+                                    EGL_PBUFFER_BIT,
+                                    EGL_RENDERABLE_TYPE,
+                                    EGL_OPENGL_BIT,
+                                    EGL_RED_SIZE,
+                                    8,
+                                    EGL_GREEN_SIZE,
+                                    8,
+                                    EGL_BLUE_SIZE,
+                                    8,
+                                    EGL_NONE};
+    const EGLint surfaceAttribs[] = {EGL_WIDTH, 64, EGL_HEIGHT, 64,
+                                     EGL_NONE};
+    const EGLint contextAttribs[] = {EGL_CONTEXT_MAJOR_VERSION,
+                                     4,
+                                     EGL_CONTEXT_MINOR_VERSION,
+                                     5,
+                                     EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                     EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                     EGL_NONE};
+
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglBindAPI(EGL_OPENGL_API) ||
+        !eglChooseConfig(display, configAttribs, &config, 1, &configCount) ||
+        configCount == 0) {
+        DestroyEglContext(context);
+        return false;
+    }
+
+    context.eglSurface =
+        eglCreatePbufferSurface(display, config, surfaceAttribs);
+    context.eglContext =
+        eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (context.eglSurface == EGL_NO_SURFACE ||
+        context.eglContext == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(display, context.eglSurface, context.eglSurface,
+                        context.eglContext)) {
+        DestroyEglContext(context);
+        return false;
+    }
+    return true;
+}
+#endif
+
+/**
+ * @brief Create a hidden GLFW window with a GL 4.5 core context and make it
+ * current
+ *
+ * @return the hidden window, or NULL if it failed to be created
+ */
+GLFWwindow* CreateHiddenWindow()
+{
+    if (!glfwInit()) return NULL;
+
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    GLFWwindow* window = glfwCreateWindow(64, 64, "", NULL, NULL);
+    if (!window) {
+        glfwTerminate();
+        return NULL;
+    }
+    glfwMakeContextCurrent(window);
+    return window;
+}
+}  // namespace
+
+bool CreateOffscreenContext(OffscreenContext& context)
+{
+    context = OffscreenContext();
+
+#if defined(__APPLE__)
+    // Metal doesn't need any GL context
+    return true;
+#else
+#if defined(USE_EGL)
+    if (CreateEglContext(context)) return true;
+#endif
+
+    context.window = CreateHiddenWindow();
+    return context.window != NULL;
+#endif
+}
+
+void DestroyOffscreenContext(OffscreenContext& context)
+{
+#if defined(USE_EGL)
+    DestroyEglContext(context);
+#endif
+
+    if (context.window) {
+        glfwDestroyWindow(context.window);
+        glfwTerminate();
+    }
+    context = OffscreenContext();
+}
@@ -0,0 +1,43 @@
+/**
+ * @file glcontext.h
+ * @author Raphael Jouretz (rjouretz.com)
+ * @brief Helpers to create a GL context without any window shown, for the
+ * renders without UI.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+struct GLFWwindow;
+
+/**
+ * @brief A GL context created without any window shown, either with EGL or
+ * with a hidden GLFW window
+ *
+ */
+struct OffscreenContext {
+        // the EGL display, surface and context, if created with EGL
+        void* eglDisplay = nullptr;
+        void* eglSurface = nullptr;
+        void* eglContext = nullptr;
+        GLFWwindow* window = nullptr;
+};
+
+/**
+ * @brief Create a GL 4.5 core context for the Hgi backends that need one and
+ * make it current. EGL is tried first where available, since it needs no X
+ * or Wayland server, then a hidden GLFW window. Metal needs no GL context.
+ *
+ * @param context the created context
+ * @return true if the context is current, or if none is needed
+ * @return false otherwise
+ */
+bool CreateOffscreenContext(OffscreenContext& context);
+
+/**
+ * @brief Destroy a context created by CreateOffscreenContext
+ *
+ * @param context the context, reset once destroyed
+ */
+void DestroyOffscreenContext(OffscreenContext& context);
@@ -0,0 +1,311 @@
+#include "gridtask.h"
+
+#include <pxr/base/gf/matrix4f.h>
+#include <pxr/base/tf/diagnostic.h>
+#include <pxr/base/trace/trace.h>
+#include <pxr/imaging/hd/renderIndex.h>
+#include <pxr/imaging/hd/tokens.h>
+#include <pxr/imaging/hgi/graphicsCmds.h>
+#include <pxr/imaging/hgi/graphicsCmdsDesc.h>
+#include <pxr/imaging/hgi/tokens.h>
+
+#include <cmath>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+// the full screen triangle is generated from the vertex ids
+const char* VERTEX_SHADER = R"(
+void main(void)
+{
+    int id = int(hd_VertexID);
+    vec2 ndc = vec2(id == 1 ? 3.0 : -1.0, id == 2 ? 3.0 : -1.0);
+    gl_Position = vec4(ndc, 0.0, 1.0);
+    ndcOut = ndc;
+}
+)";
+
+// the fragments are intersected with the y = 0 plane along their view ray
+const char* FRAGMENT_SHADER = R"(
+float GridLines(vec2 coord, float cellSize, vec2 footprint)
+{
+    vec2 offset = abs(fract(coord / cellSize + 0.5) - 0.5) * cellSize;
+    vec2 lines = 1.0 - clamp(offset / footprint, 0.0, 1.0);
+    return max(lines.x, lines.y);
+}
+
+void main(void)
+{
+    vec4 nearPoint = inverseViewProjection * vec4(ndcOut, -1.0, 1.0);
+    vec4 farPoint = inverseViewProjection * vec4(ndcOut, 1.0, 1.0);
+    vec3 rayStart = nearPoint.xyz / nearPoint.w;
+    vec3 rayEnd = farPoint.xyz / farPoint.w;
+
+    float t = -rayStart.y / (rayEnd.y - rayStart.y);
+    if (t <= 0.0 || t > 1.0) discard;
+
+    vec3 position = mix(rayStart, rayEnd, t);
+    vec2 coord = position.xz;
+    vec2 footprint = max(fwidth(coord), vec2(1e-6));
+
+    // the cells are subdivided by powers of ten, keeping at least a few
+    // pixels between the lines, and the finest level fades in
+    float lod = max(log(length(footprint) * 8.0 / spacing) / log(10.0), 0.0);
+    float cellSize = spacing * pow(10.0, floor(lod));
+    float lodFade = 1.0 - fract(lod);
+
+    float minor = GridLines(coord, cellSize, footprint) * lodFade;
+    float major = GridLines(coord, cellSize * 10.0, footprint);
+    float line = max(minor, major);
+
+    vec3 lineColor = gridColor.rgb;
+    vec2 axis = 1.0 - clamp(abs(coord) / footprint, 0.0, 1.0);
+    if (axis.y > 0.0) lineColor = mix(lineColor, vec3(0.9, 0.2, 0.2), axis.y);
+    if (axis.x > 0.0) lineColor = mix(lineColor, vec3(0.2, 0.2, 0.9), axis.x);
+    line = max(line, max(axis.x, axis.y));
+
+    // the fade distance follows the height of the camera, so that the grid
+    // is usable at any distance
+    float height = max(abs(eye.y), spacing);
+    float distanceToEye = length(position - eye.xyz);
+    float fade = 1.0 - smoothstep(0.25, 1.0,
+                                  distanceToEye / (height * fadeDistance));
+
+    float alpha = gridColor.a * line * fade;
+    if (alpha <= 0.001) discard;
+
+    vec4 clip = viewProjection * vec4(position, 1.0);
+    gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+    hd_FragColor = vec4(lineColor, alpha);
+}
+)";
+
+// must match the constant params of the fragment shader
+struct Uniforms {
+        GfMatrix4f viewProjection;
+        GfMatrix4f inverseViewProjection;
+        GfVec4f gridColor;
+        GfVec4f eye;
+        float spacing;
+        float fadeDistance;
+        float padding[2];
+};
+}  // namespace
+
+GridTask::GridTask(HdSceneDelegate* delegate, SdfPath const& id)
+    : HdTask(id),
+      _hgi(nullptr),
+      _hasCompileErrors(false),
+      _colorFormat(HgiFormatInvalid),
+      _depthFormat(HgiFormatInvalid)
+{
+}
+
+GridTask::~GridTask()
+{
+    _DestroyResources();
+}
+
+void GridTask::SetParams(GridTaskParams const& params)
+{
+    _params = params;
+}
+
+void GridTask::Sync(HdSceneDelegate* delegate, HdTaskContext* ctx,
+                    HdDirtyBits* dirtyBits)
+{
+    *dirtyBits = HdChangeTracker::Clean;
+}
+
+void GridTask::Prepare(HdTaskContext* ctx, HdRenderIndex* renderIndex)
+{
+    if (_hgi) return;
+
+    for (HdDriver* driver : renderIndex->GetDrivers()) {
+        if (driver->name == HgiTokens->renderDriver &&
+            driver->driver.IsHolding<Hgi*>()) {
+            _hgi = driver->driver.UncheckedGet<Hgi*>();
+        }
+    }
+}
+
+void GridTask::Execute(HdTaskContext* ctx)
+{
+    TRACE_FUNCTION();
+
+    if (!_params.enabled || !_hgi || _hasCompileErrors) return;
+
+    // the AOV input task publishes the AOV textures
+    HgiTextureHandle colorTexture, depthTexture;
+    if (!_GetTaskContextData(ctx, HdAovTokens->color, &colorTexture)) return;
+    _GetTaskContextData(ctx, HdAovTokens->depth, &depthTexture);
+
+    if (!_shaderProgram && !_CreateShaderProgram()) return;
+
+    HgiFormat colorFormat = colorTexture->GetDescriptor().format;
+    HgiFormat depthFormat =
+        depthTexture ? depthTexture->GetDescriptor().format : HgiFormatInvalid;
+    _CreatePipeline(colorFormat, depthFormat);
+    if (!_pipeline) return;
+
+    GfMatrix4d viewProjection = _params.viewMatrix * _params.projectionMatrix;
+    GfVec3d eye = _params.viewMatrix.GetInverse().ExtractTranslation();
+
+    Uniforms uniforms;
+    uniforms.viewProjection = GfMatrix4f(viewProjection);
+    uniforms.inverseViewProjection = GfMatrix4f(viewProjection.GetInverse());
+    uniforms.gridColor = _params.color;
+    uniforms.eye = GfVec4f(eye[0], eye[1], eye[2], 1);
+    uniforms.spacing = _params.spacing;
+    uniforms.fadeDistance = _params.fadeDistance;
+
+    HgiGraphicsCmdsDesc gfxDesc;
+    gfxDesc.colorAttachmentDescs.push_back(_GetColorAttachment());
+    gfxDesc.colorTextures.push_back(colorTexture);
+    if (depthTexture) {
+        gfxDesc.depthAttachmentDesc = _GetDepthAttachment();
+        gfxDesc.depthTexture = depthTexture;
+    }
+
+    GfVec3i dimensions = colorTexture->GetDescriptor().dimensions;
+
+    HgiGraphicsCmdsUniquePtr gfxCmds = _hgi->CreateGraphicsCmds(gfxDesc);
+    gfxCmds->PushDebugGroup("Grid");
+    gfxCmds->BindPipeline(_pipeline);
+    gfxCmds->SetViewport(GfVec4i(0, 0, dimensions[0], dimensions[1]));
+    gfxCmds->SetConstantValues(_pipeline, HgiShaderStageFragment, 0,
+                               sizeof(uniforms), &uniforms);
+    gfxCmds->Draw(3, 0, 1, 0);
+    gfxCmds->PopDebugGroup();
+    _hgi->SubmitCmds(gfxCmds.get());
+}
+
+bool GridTask::_CreateShaderProgram()
+{
+    HgiShaderFunctionDesc vertDesc;
+    vertDesc.debugName = "GridVertex";
+    vertDesc.shaderStage = HgiShaderStageVertex;
+    HgiShaderFunctionAddStageInput(&vertDesc, "hd_VertexID", "uint",
+                                   HgiShaderKeywordTokens->hdVertexID);
+    HgiShaderFunctionAddStageOutput(&vertDesc, "gl_Position", "vec4",
+                                    "position");
+    HgiShaderFunctionAddStageOutput(&vertDesc, "ndcOut", "vec2");
+    vertDesc.shaderCode = VERTEX_SHADER;
+
+    HgiShaderFunctionDesc fragDesc;
+    fragDesc.debugName = "GridFragment";
+    fragDesc.shaderStage = HgiShaderStageFragment;
+    HgiShaderFunctionAddStageInput(&fragDesc, "ndcOut", "vec2");
+    HgiShaderFunctionAddStageOutput(&fragDesc, "hd_FragColor", "vec4",
+                                    "color");
+    HgiShaderFunctionAddStageOutput(&fragDesc, "gl_FragDepth", "float",
+                                    "depth");
+    HgiShaderFunctionAddConstantParam(&fragDesc, "viewProjection", "mat4");
+    HgiShaderFunctionAddConstantParam(&fragDesc, "inverseViewProjection",
+                                      "mat4");
+    HgiShaderFunctionAddConstantParam(&fragDesc, "gridColor", "vec4");
+    HgiShaderFunctionAddConstantParam(&fragDesc, "eye", "vec4");
+    HgiShaderFunctionAddConstantParam(&fragDesc, "spacing", "float");
+    HgiShaderFunctionAddConstantParam(&fragDesc, "fadeDistance", "float");
+    HgiShaderFunctionAddConstantParam(&fragDesc, "padding0", "float");
+    HgiShaderFunctionAddConstantParam(&fragDesc, "padding1", "float");
+    fragDesc.shaderCode = FRAGMENT_SHADER;
+
+    HgiShaderProgramDesc programDesc;
+    programDesc.debugName = "Grid";
+    programDesc.shaderFunctions.push_back(
+        _hgi->CreateShaderFunction(vertDesc));
+    programDesc.shaderFunctions.push_back(
+        _hgi->CreateShaderFunction(fragDesc));
+    _shaderProgram = _hgi->CreateShaderProgram(programDesc);
+
+    if (!_shaderProgram->IsValid()) {
+        std::string errors = _shaderProgram->GetCompileErrors();
+        for (auto&& function : programDesc.shaderFunctions)
+            errors += function->GetCompileErrors();
+        TF_WARN("Failed to compile the grid shaders: %s", errors.c_str());
+
+        // don't try again every frame
+        _hasCompileErrors = true;
+        _DestroyResources();
+        return false;
+    }
+    return true;
+}
+
+void GridTask::_CreatePipeline(HgiFormat colorFormat, HgiFormat depthFormat)
+{
+    if (_pipeline && colorFormat == _colorFormat &&
+        depthFormat == _depthFormat)
+        return;
+
+    if (_pipeline) _hgi->DestroyGraphicsPipeline(&_pipeline);
+
+    _colorFormat = colorFormat;
+    _depthFormat = depthFormat;
+
+    HgiGraphicsPipelineDesc desc;
+    desc.debugName = "Grid";
+    desc.shaderProgram = _shaderProgram;
+    desc.colorAttachmentDescs.push_back(_GetColorAttachment());
+    desc.primitiveType = HgiPrimitiveTypeTriangleList;
+    desc.rasterizationState.cullMode = HgiCullModeNone;
+    desc.shaderConstantsDesc.stageUsage = HgiShaderStageFragment;
+    desc.shaderConstantsDesc.byteSize = sizeof(Uniforms);
+
+    // the grid is hidden by the scene but doesn't hide it
+    if (_depthFormat != HgiFormatInvalid) {
+        desc.depthAttachmentDesc = _GetDepthAttachment();
+        desc.depthState.depthTestEnabled = true;
+        desc.depthState.depthWriteEnabled = false;
+        desc.depthState.depthCompareFn = HgiCompareFunctionLEqual;
+    }
+    else {
+        desc.depthState.depthTestEnabled = false;
+        desc.depthState.depthWriteEnabled = false;
+    }
+
+    _pipeline = _hgi->CreateGraphicsPipeline(desc);
+}
+
+HgiAttachmentDesc GridTask::_GetColorAttachment() const
+{
+    HgiAttachmentDesc attachment;
+    attachment.format = _colorFormat;
+    attachment.usage = HgiTextureUsageBitsColorTarget;
+    attachment.loadOp = HgiAttachmentLoadOpLoad;
+    attachment.storeOp = HgiAttachmentStoreOpStore;
+    attachment.blendEnabled = true;
+    attachment.srcColorBlendFactor = HgiBlendFactorSrcAlpha;
+    attachment.dstColorBlendFactor = HgiBlendFactorOneMinusSrcAlpha;
+    attachment.colorBlendOp = HgiBlendOpAdd;
+    attachment.srcAlphaBlendFactor = HgiBlendFactorZero;
+    attachment.dstAlphaBlendFactor = HgiBlendFactorOne;
+    attachment.alphaBlendOp = HgiBlendOpAdd;
+    return attachment;
+}
+
+HgiAttachmentDesc GridTask::_GetDepthAttachment() const
+{
+    HgiAttachmentDesc attachment;
+    attachment.format = _depthFormat;
+    attachment.usage = HgiTextureUsageBitsDepthTarget;
+    attachment.loadOp = HgiAttachmentLoadOpLoad;
+    attachment.storeOp = HgiAttachmentStoreOpStore;
+    return attachment;
+}
+
+void GridTask::_DestroyResources()
+{
+    if (!_hgi) return;
+
+    if (_pipeline) _hgi->DestroyGraphicsPipeline(&_pipeline);
+    if (_shaderProgram) {
+        for (HgiShaderFunctionHandle function :
+             _shaderProgram->GetShaderFunctions())
+            _hgi->DestroyShaderFunction(&function);
+        _hgi->DestroyShaderProgram(&_shaderProgram);
+    }
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,148 @@
+/**
+ * @file gridtask.h
+ * @author Raphael Jouretz (rjouretz.com)
+ * @brief GridTask is a Hydra task that draws an infinite grid on the ground
+ * plane in a single full screen pass over the color and depth AOVs.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/gf/vec4f.h>
+#include <pxr/imaging/hd/task.h>
+#include <pxr/imaging/hgi/graphicsPipeline.h>
+#include <pxr/imaging/hgi/hgi.h>
+#include <pxr/imaging/hgi/shaderProgram.h>
+
+#include <memory>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+using namespace std;
+
+class GridTask;
+
+using GridTaskSharedPtr = shared_ptr<GridTask>;
+
+/**
+ * @brief Parameters of the GridTask
+ *
+ */
+struct GridTaskParams {
+        bool enabled = true;
+        GfMatrix4d viewMatrix = GfMatrix4d(1);
+        GfMatrix4d projectionMatrix = GfMatrix4d(1);
+        GfVec4f color = GfVec4f(.5f, .5f, .5f, .6f);
+        // size of the finest cells, in scene units
+        float spacing = 1.f;
+        // the grid fades out at this distance, in camera heights
+        float fadeDistance = 50.f;
+};
+
+/**
+ * @brief GridTask is a Hydra task that draws an infinite grid on the ground
+ * plane in a single full screen pass over the color and depth AOVs.
+ *
+ * The fragments of the full screen triangle are intersected with the ground
+ * plane, so no geometry is built on the CPU. The cells are subdivided by
+ * powers of ten according to their size on screen, and the grid fades out
+ * with the distance to the camera. The grid is depth tested against the
+ * scene without writing the depth.
+ *
+ * It must be executed after the AOV input task, which publishes the AOV
+ * textures in the task context. The task has no scene delegate, its
+ * parameters are set directly by its owner.
+ *
+ */
+class GridTask : public HdTask {
+    public:
+        /**
+         * @brief Construct a new Grid Task object
+         *
+         * @param delegate the scene delegate of the task, unused
+         * @param id the id of the task in the render index
+         */
+        GridTask(HdSceneDelegate* delegate, SdfPath const& id);
+
+        /**
+         * @brief Destroy the Grid Task object and its GPU resources
+         *
+         */
+        ~GridTask() override;
+
+        /**
+         * @brief Set the parameters of the task
+         *
+         * @param params the parameters
+         */
+        void SetParams(GridTaskParams const& params);
+
+        /**
+         * @brief Override of HdTask::Sync
+         *
+         */
+        void Sync(HdSceneDelegate* delegate, HdTaskContext* ctx,
+                  HdDirtyBits* dirtyBits) override;
+
+        /**
+         * @brief Override of HdTask::Prepare
+         *
+         */
+        void Prepare(HdTaskContext* ctx, HdRenderIndex* renderIndex) override;
+
+        /**
+         * @brief Override of HdTask::Execute
+         *
+         */
+        void Execute(HdTaskContext* ctx) override;
+
+    private:
+        GridTaskParams _params;
+        Hgi* _hgi;
+        bool _hasCompileErrors;
+        HgiShaderProgramHandle _shaderProgram;
+        HgiGraphicsPipelineHandle _pipeline;
+        HgiFormat _colorFormat, _depthFormat;
+
+        /**
+         * @brief Create the shader program of the grid
+         *
+         * @return true if the shaders compiled
+         * @return false otherwise
+         */
+        bool _CreateShaderProgram();
+
+        /**
+         * @brief Create the pipeline for the given attachment formats, if
+         * they changed
+         *
+         * @param colorFormat the format of the color AOV
+         * @param depthFormat the format of the depth AOV, or HgiFormatInvalid
+         * if the renderer has no depth AOV
+         */
+        void _CreatePipeline(HgiFormat colorFormat, HgiFormat depthFormat);
+
+        /**
+         * @brief Get the color attachment, blended over the scene
+         *
+         * @return the color attachment
+         */
+        HgiAttachmentDesc _GetColorAttachment() const;
+
+        /**
+         * @brief Get the depth attachment, only tested against
+         *
+         * @return the depth attachment
+         */
+        HgiAttachmentDesc _GetDepthAttachment() const;
+
+        /**
+         * @brief Destroy the GPU resources of the task
+         *
+         */
+        void _DestroyResources();
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -14,15 +14,70 @@
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 #include <imgui_internal.h>
+#include <pxr/base/tf/fileUtils.h>
+#include <pxr/base/tf/getenv.h>
+#include <pxr/base/tf/mallocTag.h>
+#include <pxr/base/tf/pathUtils.h>
+#include <pxr/base/tf/setenv.h>
 
+#include <cstring>
 #include <iostream>
 #include <ostream>
 
+#include "batchrender.h"
+#include "glcontext.h"
 #include "layouts/layout.h"
 #include "mainwindow.h"
 #include "models/model.h"
+#include "rendercontext.h"
+#include "renderthread.h"
 #include "style/imgui_spectrum.h"
 
+/**
+ * @brief Get the directory where the shader caches persist between runs
+ *
+ * @return the cache directory, or an empty string if no user directory is
+ * known
+ */
+std::string GetShaderCacheDir()
+{
+#if defined(_WIN32)
+    std::string root = pxr::TfGetenv("LOCALAPPDATA");
+#else
+    std::string root = pxr::TfGetenv("XDG_CACHE_HOME");
+    if (root.empty() && !pxr::TfGetenv("HOME").empty())
+        root = pxr::TfGetenv("HOME") + "/.cache";
+#endif
+    if (root.empty()) return std::string();
+
+    return pxr::TfStringCatPaths(root, "ImGuiHydraEditor/shaders");
+}
+
+/**
+ * @brief Move the shader caches of the NVIDIA and Mesa GL drivers to a
+ * directory of the editor, unless they are already configured. Those drivers
+ * cache the compiled shaders by default, so this only keeps the shaders of
+ * Storm apart from the other applications, and thus from being evicted by
+ * them when the shared cache is full. The other drivers and Metal are left
+ * as they are. Must be called before the GL context is created.
+ *
+ */
+void EnableShaderDiskCache()
+{
+    std::string cacheDir = GetShaderCacheDir();
+    if (cacheDir.empty() || !pxr::TfMakeDirs(cacheDir, -1, true)) return;
+
+    // NVIDIA
+    if (pxr::TfGetenv("__GL_SHADER_DISK_CACHE").empty() &&
+        pxr::TfGetenv("__GL_SHADER_DISK_CACHE_PATH").empty()) {
+        pxr::TfSetenv("__GL_SHADER_DISK_CACHE", "1");
+        pxr::TfSetenv("__GL_SHADER_DISK_CACHE_PATH", cacheDir);
+    }
+    // Mesa
+    if (pxr::TfGetenv("MESA_SHADER_CACHE_DIR").empty())
+        pxr::TfSetenv("MESA_SHADER_CACHE_DIR", cacheDir);
+}
+
 /**
  * @brief Initialize Glfw
  *
@@ -60,6 +115,80 @@ GLFWwindow* InitGlfw(const char* title)
     return window;
 }
 
+/**
+ * @brief Terminate Glfw
+ *
+ * @param window the current GL context
+ */
+void TerminateGlfw(GLFWwindow* window)
+{
+    glfwDestroyWindow(window);
+    glfwTerminate();
+}
+
+/**
+ * @brief Create a hidden Glfw window whose GL context is shared with the
+ * given one, to be made current on another thread
+ *
+ * @param window the window of the shared GL context
+ * @return a pointer to the hidden window
+ */
+GLFWwindow* CreateSharedContext(GLFWwindow* window)
+{
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* shared = glfwCreateWindow(1, 1, "", NULL, window);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    return shared;
+}
+
+/**
+ * @brief Render the frames given on the command line to images, without
+ * creating the UI
+ *
+ * @param argc the number of arguments
+ * @param argv the arguments
+ * @return the exit code of the application
+ */
+int RunBatchRender(int argc, char** argv)
+{
+    pxr::BatchRender::Options options;
+    if (!pxr::BatchRender::ParseOptions(argc, argv, options)) {
+        pxr::BatchRender::PrintUsage();
+        return 1;
+    }
+
+    // the render nodes usually have no display server for GLFW, so the
+    // context is created with EGL where available
+    OffscreenContext context;
+    if (!CreateOffscreenContext(context)) {
+        std::cout << "Failed to create the GL context" << std::endl;
+        return 1;
+    }
+
+    bool isWritten = pxr::BatchRender(options).Run();
+
+    DestroyOffscreenContext(context);
+
+    return isWritten ? 0 : 1;
+}
+
+/**
+ * @brief Check if the given option is part of the command line
+ *
+ * @param argc the number of arguments
+ * @param argv the arguments
+ * @param option the option to find
+ * @return true if the option is found
+ * @return false otherwise
+ */
+bool HasOption(int argc, char** argv, const char* option)
+{
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], option) == 0) return true;
+    }
+    return false;
+}
+
 /**
  * @brief initialize Glew
  *
@@ -113,17 +242,6 @@ bool InitImGui(GLFWwindow* window)
     return true;
 }
 
-/**
- * @brief Terminate Glfw
- *
- * @param window the current GL context
- */
-void TerminateGlfw(GLFWwindow* window)
-{
-    glfwDestroyWindow(window);
-    glfwTerminate();
-}
-
 /**
  * @brief Terminate ImGui
  *
@@ -143,32 +261,69 @@ int main(int argc, char** argv)
 {
     const char* TITLE = "ImGui Hydra Editor";
 
+    // the malloc tags must be initialized before the stage allocations
+    std::string mallocTagError;
+    if (HasOption(argc, argv, "--malloc-tags") &&
+        !pxr::TfMallocTag::Initialize(&mallocTagError))
+        std::cout << "Failed to initialize the malloc tags: "
+                  << mallocTagError << std::endl;
+
+    if (!HasOption(argc, argv, "--no-shader-cache")) EnableShaderDiskCache();
+
+    if (HasOption(argc, argv, "--batch")) return RunBatchRender(argc, argv);
+
     GLFWwindow* window = InitGlfw(TITLE);
     if (!window || !InitGlew() || !InitImGui(window)) return 1;
 
     glEnable(GL_DEPTH_TEST);
 
     pxr::Model model;
-    pxr::MainWindow mainWindow(&model);
 
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+    // with the render thread, Hydra syncs and renders on a shared GL context
+    // while the UI keeps presenting the latest finished frames
+    GLFWwindow* renderWindow = NULL;
+    if (HasOption(argc, argv, "--render-thread")) {
+        renderWindow = CreateSharedContext(window);
+        if (renderWindow) {
+            pxr::RenderThread::Start(&model.GetSceneMutex(), [renderWindow]() {
+                glfwMakeContextCurrent(renderWindow);
+            });
+        }
+    }
+
+    {
+        pxr::MainWindow mainWindow(&model);
 
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
+        while (!glfwWindowShouldClose(window)) {
+            glfwPollEvents();
 
-        ImGui::NewFrame();
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
 
-        mainWindow.Update();
+            ImGui::NewFrame();
 
-        ImGui::Render();
+            mainWindow.Update();
 
-        glClearColor(0.45f, 0.55f, 0.60f, 1.00f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            ImGui::Render();
 
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-        glfwSwapBuffers(window);
+            glClearColor(0.45f, 0.55f, 0.60f, 1.00f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+            glfwSwapBuffers(window);
+        }
+    }
+
+    // the cached renderers must be destroyed with the graphics context alive
+    if (pxr::RenderThread::IsRunning()) {
+        pxr::RenderThread::Post(
+            nullptr, []() { pxr::RenderContext::ReleaseIdleContexts(); });
+        pxr::RenderThread::Stop();
+    }
+    else {
+        pxr::RenderContext::ReleaseIdleContexts();
     }
+    if (renderWindow) glfwDestroyWindow(renderWindow);
 
     TerminateImGui();
     TerminateGlfw(window);
@@ -2,8 +2,12 @@
 
 #include <imgui.h>
 
+#include "memorytracker.h"
+#include "profiler.h"
 #include "views/editor.h"
+#include "views/memory.h"
 #include "views/outliner.h"
+#include "views/timeline.h"
 #include "views/usdsessionlayer.h"
 #include "views/view.h"
 #include "views/viewport.h"
@@ -17,6 +21,13 @@ MainWindow::MainWindow(Model* model) : _model(model)
 
 void MainWindow::Update()
 {
+    Profiler& profiler = Profiler::GetInstance();
+    profiler.BeginFrame();
+
+    // the memory budgets are polled at a low rate, whether the memory view
+    // is displayed or not
+    MemoryTracker::Update(&_model->GetSceneMutex());
+
     ImGui::DockSpaceOverViewport();
 
     if (ImGui::BeginMainMenuBar()) {
@@ -24,8 +35,12 @@ void MainWindow::Update()
             if (ImGui::BeginMenu("Add")) {
                 if (ImGui::MenuItem(Editor::VIEW_TYPE.c_str()))
                     AddView(Editor::VIEW_TYPE);
+                if (ImGui::MenuItem(Memory::VIEW_TYPE.c_str()))
+                    AddView(Memory::VIEW_TYPE);
                 if (ImGui::MenuItem(Outliner::VIEW_TYPE.c_str()))
                     AddView(Outliner::VIEW_TYPE);
+                if (ImGui::MenuItem(Timeline::VIEW_TYPE.c_str()))
+                    AddView(Timeline::VIEW_TYPE);
                 if (ImGui::MenuItem(UsdSessionLayer::VIEW_TYPE.c_str()))
                     AddView(UsdSessionLayer::VIEW_TYPE);
                 if (ImGui::MenuItem(Viewport::VIEW_TYPE.c_str()))
@@ -36,6 +51,28 @@ void MainWindow::Update()
             if (ImGui::MenuItem("Default views")) ResetDefaultViews();
             ImGui::EndMenu();
         }
+        if (ImGui::BeginMenu("Profiling")) {
+            bool countersEnabled = profiler.IsCountersEnabled();
+            if (ImGui::MenuItem("Hydra counters", NULL, countersEnabled))
+                profiler.SetCountersEnabled(!countersEnabled);
+
+            bool traceRecording = profiler.IsTraceRecording();
+            if (ImGui::MenuItem("Record trace", NULL, traceRecording))
+                profiler.SetTraceRecording(!traceRecording);
+            if (ImGui::MenuItem("Save Chrome trace"))
+                profiler.WriteChromeTrace("trace.json");
+            if (ImGui::MenuItem("Save trace report"))
+                profiler.WriteTraceReport("trace.txt");
+
+            // per view timings of the previous frame
+            ImGui::Separator();
+            for (auto view : _views) {
+                string label = view->GetViewLabel();
+                Profiler::Sample sample = profiler.GetSample("view/" + label);
+                ImGui::Text("%s: %.2f ms", label.c_str(), sample.averageMs);
+            }
+            ImGui::EndMenu();
+        }
 
         ImGui::EndMainMenuBar();
     }
@@ -44,7 +81,10 @@ void MainWindow::Update()
     _views.clear();
 
     for (auto view : viewsCopy) {
-        view->Update();
+        {
+            ProfilerScope scope("view/" + view->GetViewLabel());
+            view->Update();
+        }
         if (view->IsDisplayed()) _views.push_back(view);
         else delete view;
     }
@@ -78,9 +118,15 @@ void MainWindow::AddView(const string viewType)
     if (viewType == Editor::VIEW_TYPE) {
         _views.push_back(new Editor(_model, viewLabel));
     }
+    else if (viewType == Memory::VIEW_TYPE) {
+        _views.push_back(new Memory(_model, viewLabel));
+    }
     else if (viewType == Outliner::VIEW_TYPE) {
         _views.push_back(new Outliner(_model, viewLabel));
     }
+    else if (viewType == Timeline::VIEW_TYPE) {
+        _views.push_back(new Timeline(_model, viewLabel));
+    }
     else if (viewType == UsdSessionLayer::VIEW_TYPE) {
         _views.push_back(new UsdSessionLayer(_model, viewLabel));
     }
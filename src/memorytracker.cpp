@@ -0,0 +1,89 @@
+#include "memorytracker.h"
+
+#include <pxr/base/trace/trace.h>
+
+#include <set>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+int MemoryTracker::AddSource(Source source)
+{
+    lock_guard<mutex> lock(_mutex);
+    int id = _nextSourceId++;
+    _sources[id] = source;
+
+    // the new source is reported on the next update
+    _isUpdated = false;
+    return id;
+}
+
+void MemoryTracker::RemoveSource(int id)
+{
+    lock_guard<mutex> lock(_mutex);
+    _sources.erase(id);
+    _isUpdated = false;
+}
+
+void MemoryTracker::Update(recursive_mutex* sceneMutex)
+{
+    auto now = chrono::steady_clock::now();
+    {
+        lock_guard<mutex> lock(_mutex);
+        if (_isUpdated && now - _lastUpdate < _UPDATE_INTERVAL) return;
+    }
+
+    TRACE_FUNCTION();
+
+    // the UI never waits on the render thread for the poll, which is
+    // retried on the next update if the scene is busy
+    vector<Entry> entries;
+    {
+        unique_lock<recursive_mutex> sceneLock;
+        if (sceneMutex) {
+            sceneLock = unique_lock<recursive_mutex>(*sceneMutex, try_to_lock);
+            if (!sceneLock.owns_lock()) return;
+        }
+
+        lock_guard<mutex> lock(_mutex);
+        for (auto&& source : _sources) source.second(entries);
+    }
+
+    size_t cpuByteSize = 0, gpuByteSize = 0;
+    set<pair<const void*, string>> sharedEntries;
+    for (auto&& entry : entries) {
+        if (entry.isDetail) continue;
+        if (entry.sharedKey &&
+            !sharedEntries.insert({entry.sharedKey, entry.name}).second)
+            continue;
+
+        if (entry.isGpu) gpuByteSize += entry.byteSize;
+        else cpuByteSize += entry.byteSize;
+    }
+
+    lock_guard<mutex> lock(_mutex);
+    _entries.swap(entries);
+    _cpuByteSize = cpuByteSize;
+    _gpuByteSize = gpuByteSize;
+    _lastUpdate = now;
+    _isUpdated = true;
+}
+
+vector<MemoryTracker::Entry> MemoryTracker::GetEntries()
+{
+    lock_guard<mutex> lock(_mutex);
+    return _entries;
+}
+
+size_t MemoryTracker::GetCpuByteSize()
+{
+    lock_guard<mutex> lock(_mutex);
+    return _cpuByteSize;
+}
+
+size_t MemoryTracker::GetGpuByteSize()
+{
+    lock_guard<mutex> lock(_mutex);
+    return _gpuByteSize;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,115 @@
+/**
+ * @file memorytracker.h
+ * @author Raphael Jouretz (rjouretz.com)
+ * @brief MemoryTracker gathers at a low rate the CPU and GPU memory reported
+ * by the subsystems, for the memory view and the memory budgets.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <pxr/pxr.h>
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+using namespace std;
+
+/**
+ * @brief MemoryTracker gathers at a low rate the CPU and GPU memory reported
+ * by the subsystems, for the memory view and the memory budgets.
+ *
+ * The subsystems add a source that appends their entries when polled. The
+ * sources are polled with the scene mutex locked, so that the render thread
+ * doesn't render while the render delegates report their resources, and the
+ * last poll is kept so that reading the entries or the totals is cheap.
+ *
+ */
+class MemoryTracker {
+    public:
+        /**
+         * @brief A memory entry reported by a source
+         *
+         */
+        struct Entry {
+                // the subsystem of the entry (e.g. a viewport label)
+                string group;
+                string name;
+                size_t byteSize = 0;
+                bool isGpu = false;
+                // a detail of another entry of the group, not totaled
+                bool isDetail = false;
+                // the entries with the same key are only totaled once (e.g.
+                // the resources of a render context shared by viewports)
+                const void* sharedKey = nullptr;
+        };
+
+        using Source = function<void(vector<Entry>& entries)>;
+
+        /**
+         * @brief Add a source of memory entries
+         *
+         * @param source the function that appends the entries of the source
+         * @return the id of the source
+         */
+        static int AddSource(Source source);
+
+        /**
+         * @brief Remove a source of memory entries
+         *
+         * @param id the id of the source
+         */
+        static void RemoveSource(int id);
+
+        /**
+         * @brief Poll the sources if the last poll is older than the update
+         * interval. The poll is skipped if the scene mutex is already locked.
+         *
+         * @param sceneMutex the mutex locked while the sources are polled
+         */
+        static void Update(recursive_mutex* sceneMutex);
+
+        /**
+         * @brief Get the entries of the last poll
+         *
+         * @return the entries, in the order of the sources
+         */
+        static vector<Entry> GetEntries();
+
+        /**
+         * @brief Get the total CPU memory of the last poll
+         *
+         * @return the memory in bytes
+         */
+        static size_t GetCpuByteSize();
+
+        /**
+         * @brief Get the total GPU memory of the last poll
+         *
+         * @return the memory in bytes
+         */
+        static size_t GetGpuByteSize();
+
+    private:
+        inline static const chrono::milliseconds _UPDATE_INTERVAL =
+            chrono::milliseconds(1000);
+
+        inline static mutex _mutex;
+        inline static map<int, Source> _sources;
+        inline static int _nextSourceId = 0;
+        inline static vector<Entry> _entries;
+        inline static size_t _cpuByteSize = 0;
+        inline static size_t _gpuByteSize = 0;
+        inline static chrono::steady_clock::time_point _lastUpdate;
+        inline static bool _isUpdated = false;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
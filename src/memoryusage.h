@@ -0,0 +1,25 @@
+/**
+ * @file memoryusage.h
+ * @author Raphael Jouretz (rjouretz.com)
+ * @brief Helpers to query the memory usage of the current process.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <cstddef>
+
+/**
+ * @brief Get the resident memory (RSS) of the current process
+ *
+ * @return the resident memory in bytes, or 0 if unavailable
+ */
+size_t GetCurrentResidentMemory();
+
+/**
+ * @brief Get the peak resident memory (peak RSS) of the current process
+ *
+ * @return the peak resident memory in bytes, or 0 if unavailable
+ */
+size_t GetPeakResidentMemory();
@@ -0,0 +1,69 @@
+/**
+ * @file metalreadback.h
+ * @author Raphael Jouretz (rjouretz.com)
+ * @brief Non-blocking readbacks of HgiMetal textures, completed by a Metal
+ * completion handler that can be polled.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <pxr/imaging/hgi/hgi.h>
+#include <pxr/imaging/hgi/texture.h>
+
+#include <cstdint>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+/**
+ * @brief Check if the textures of the given Hgi can be read back with a
+ * Metal readback
+ *
+ * @param hgi the Hgi of the textures
+ * @return true if the Hgi backend is Metal
+ * @return false otherwise
+ */
+bool IsMetalReadbackSupported(Hgi* hgi);
+
+/**
+ * @brief Queue the copy of the given texture to a shared Metal buffer, on a
+ * command buffer committed after the pending Hgi work. Never waits on the
+ * GPU.
+ *
+ * @param hgi the HgiMetal that owns the texture
+ * @param texture the texture to read back
+ * @param readback a completed readback whose buffer is reused if large
+ * enough, or nullptr. It is deleted by the call.
+ * @return the opaque readback, to delete with DeleteMetalReadback
+ */
+void* StartMetalReadback(Hgi* hgi, HgiTextureHandle const& texture,
+                         void* readback);
+
+/**
+ * @brief Check if the GPU is done with the copy of a readback, without
+ * waiting for it
+ *
+ * @param readback the readback
+ * @return true if its completion handler was called
+ * @return false otherwise
+ */
+bool IsMetalReadbackCompleted(void* readback);
+
+/**
+ * @brief Get the pixels of a completed readback
+ *
+ * @param readback the readback
+ * @return the pixels, valid until the readback is deleted or reused
+ */
+uint8_t* GetMetalReadbackData(void* readback);
+
+/**
+ * @brief Delete a readback. Its buffer is only released once the GPU is
+ * done with it.
+ *
+ * @param readback the readback, or nullptr
+ */
+void DeleteMetalReadback(void* readback);
+
+PXR_NAMESPACE_CLOSE_SCOPE
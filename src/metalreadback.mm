@@ -0,0 +1,110 @@
+#include "metalreadback.h"
+
+#import <Metal/Metal.h>
+
+#include <pxr/imaging/hgi/tokens.h>
+#include <pxr/imaging/hgiMetal/hgi.h>
+#include <pxr/imaging/hgiMetal/texture.h>
+
+#include <atomic>
+#include <memory>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+using namespace std;
+
+namespace {
+/**
+ * @brief The state of a readback, shared with its completion handler so
+ * that the buffer outlives the copy even if the readback is deleted first
+ *
+ */
+struct MetalReadbackState {
+        id<MTLBuffer> buffer = nil;
+        size_t byteSize = 0;
+        atomic<bool> isCompleted{false};
+
+        ~MetalReadbackState() { [buffer release]; }
+};
+
+using MetalReadback = shared_ptr<MetalReadbackState>;
+}  // namespace
+
+bool IsMetalReadbackSupported(Hgi* hgi)
+{
+    return hgi && hgi->GetAPIName() == HgiTokens->Metal;
+}
+
+void* StartMetalReadback(Hgi* hgi, HgiTextureHandle const& texture,
+                         void* readback)
+{
+    HgiMetal* hgiMetal = static_cast<HgiMetal*>(hgi);
+    HgiMetalTexture* metalTexture =
+        static_cast<HgiMetalTexture*>(texture.Get());
+    HgiTextureDesc const& desc = texture->GetDescriptor();
+    const size_t width = desc.dimensions[0];
+    const size_t height = desc.dimensions[1];
+    const size_t bytesPerRow = width * HgiGetDataSizeOfFormat(desc.format);
+    const size_t byteSize = bytesPerRow * height;
+
+    // the buffer of the previous readback is reused, the state being renewed
+    // so that a late handler of the previous copy can't complete this one
+    id<MTLBuffer> buffer = nil;
+    if (readback) {
+        MetalReadback* previous = static_cast<MetalReadback*>(readback);
+        if ((*previous)->byteSize >= byteSize) {
+            buffer = (*previous)->buffer;
+            (*previous)->buffer = nil;
+        }
+        delete previous;
+    }
+    if (!buffer)
+        buffer = [hgiMetal->GetPrimaryDevice()
+            newBufferWithLength:byteSize
+                        options:MTLResourceStorageModeShared];
+
+    MetalReadback state = make_shared<MetalReadbackState>();
+    state->buffer = buffer;
+    state->byteSize = buffer.length;
+
+    // the render is committed first, the queue executing the command
+    // buffers in order of commit
+    hgiMetal->CommitPrimaryCommandBuffer();
+
+    id<MTLCommandBuffer> commandBuffer = [hgiMetal->GetQueue() commandBuffer];
+    id<MTLBlitCommandEncoder> blitEncoder = [commandBuffer blitCommandEncoder];
+    [blitEncoder copyFromTexture:metalTexture->GetTextureId()
+                     sourceSlice:0
+                     sourceLevel:0
+                    sourceOrigin:MTLOriginMake(0, 0, 0)
+                      sourceSize:MTLSizeMake(width, height, 1)
+                        toBuffer:buffer
+               destinationOffset:0
+          destinationBytesPerRow:bytesPerRow
+        destinationBytesPerImage:byteSize];
+    [blitEncoder endEncoding];
+    [commandBuffer addCompletedHandler:^(id<MTLCommandBuffer>) {
+        state->isCompleted = true;
+    }];
+    [commandBuffer commit];
+
+    return new MetalReadback(state);
+}
+
+bool IsMetalReadbackCompleted(void* readback)
+{
+    return (*static_cast<MetalReadback*>(readback))->isCompleted;
+}
+
+uint8_t* GetMetalReadbackData(void* readback)
+{
+    return static_cast<uint8_t*>(
+        [(*static_cast<MetalReadback*>(readback))->buffer contents]);
+}
+
+void DeleteMetalReadback(void* readback)
+{
+    delete static_cast<MetalReadback*>(readback);
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
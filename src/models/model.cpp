@@ -1,21 +1,38 @@
 #include "model.h"
 
-#include <pxr/imaging/hd/sceneIndexPrimView.h>
+#include <pxr/base/tf/hash.h>
 #include <pxr/imaging/hd/tokens.h>
 #include <pxr/usd/usd/stage.h>
 #include <pxr/usd/usdGeom/metrics.h>
 #include <pxr/usd/usdGeom/tokens.h>
 
+#include <algorithm>
+
 PXR_NAMESPACE_OPEN_SCOPE
 
 Model::Model()
+    : _time(UsdTimeCode::Default()), _sceneIndexObserver(this)
 {
     _sceneIndexBases = HdMergingSceneIndex::New();
     _finalSceneIndex = HdMergingSceneIndex::New();
-    _editableSceneIndex = _sceneIndexBases;
+
+    // observe before adding any input so that no Prim is missed
+    _finalSceneIndex->AddObserver(
+        HdSceneIndexObserverPtr(&_sceneIndexObserver));
+    _boundsSceneIndex = BoundsSceneIndex::New(_finalSceneIndex);
+
+    // the edits of all the views share a single overlay on the bases
+    _editOverlaySceneIndex = EditOverlaySceneIndex::New(_sceneIndexBases);
+    _editableSceneIndex = _editOverlaySceneIndex;
     SetEditableSceneIndex(_editableSceneIndex);
 }
 
+Model::~Model()
+{
+    _finalSceneIndex->RemoveObserver(
+        HdSceneIndexObserverPtr(&_sceneIndexObserver));
+}
+
 UsdStageRefPtr Model::GetStage()
 {
     return _stage;
@@ -24,13 +41,41 @@ UsdStageRefPtr Model::GetStage()
 void Model::SetStage(UsdStageRefPtr stage)
 {
     _stage = stage;
+    _payloadStreamer.SetStage(stage);
 }
 
 void Model::AddSceneIndexBase(HdSceneIndexBaseRefPtr sceneIndex)
 {
+    lock_guard<recursive_mutex> lock(_sceneMutex);
     _sceneIndexBases->AddInputScene(sceneIndex, SdfPath::AbsoluteRootPath());
 }
 
+void Model::RemoveSceneIndexBase(HdSceneIndexBaseRefPtr sceneIndex)
+{
+    if (!sceneIndex) return;
+
+    lock_guard<recursive_mutex> lock(_sceneMutex);
+
+    // the merging scene index sends a single removal for the whole input, so
+    // the render indices drop its Prims at once
+    _sceneIndexBases->RemoveInputScene(sceneIndex);
+}
+
+void Model::ReplaceSceneIndexBase(HdSceneIndexBaseRefPtr previous,
+                                  HdSceneIndexBaseRefPtr sceneIndex)
+{
+    if (previous == sceneIndex) return;
+
+    lock_guard<recursive_mutex> lock(_sceneMutex);
+    RemoveSceneIndexBase(previous);
+    if (sceneIndex) AddSceneIndexBase(sceneIndex);
+}
+
+recursive_mutex& Model::GetSceneMutex()
+{
+    return _sceneMutex;
+}
+
 HdSceneIndexBaseRefPtr Model::GetEditableSceneIndex()
 {
     return _editableSceneIndex;
@@ -38,6 +83,7 @@ HdSceneIndexBaseRefPtr Model::GetEditableSceneIndex()
 
 void Model::SetEditableSceneIndex(HdSceneIndexBaseRefPtr sceneIndex)
 {
+    lock_guard<recursive_mutex> lock(_sceneMutex);
     _finalSceneIndex->RemoveInputScene(_editableSceneIndex);
     _editableSceneIndex = sceneIndex;
     _finalSceneIndex->AddInputScene(_editableSceneIndex,
@@ -46,7 +92,17 @@ void Model::SetEditableSceneIndex(HdSceneIndexBaseRefPtr sceneIndex)
 
 HdSceneIndexBaseRefPtr Model::GetFinalSceneIndex()
 {
-    return _finalSceneIndex;
+    return _boundsSceneIndex;
+}
+
+BoundsSceneIndexRefPtr Model::GetBoundsSceneIndex()
+{
+    return _boundsSceneIndex;
+}
+
+EditOverlaySceneIndexRefPtr Model::GetEditOverlaySceneIndex()
+{
+    return _editOverlaySceneIndex;
 }
 
 HdSceneIndexPrim Model::GetPrim(SdfPath primPath)
@@ -66,26 +122,48 @@ UsdPrimRange Model::GetAllPrims()
 
 SdfPathVector Model::GetCameras()
 {
-    SdfPath root = SdfPath::AbsoluteRootPath();
-    HdSceneIndexPrimView primView(_finalSceneIndex, root);
-    SdfPathVector camPaths;
-    for (auto primPath : primView) {
-        HdSceneIndexPrim prim = _finalSceneIndex->GetPrim(primPath);
-        if (prim.primType == HdPrimTypeTokens->camera) {
-            camPaths.push_back(primPath);
-        }
+    return GetPrimsOfType(HdPrimTypeTokens->camera);
+}
+
+const SdfPathVector& Model::GetPrimsOfType(TfToken primType)
+{
+    _TypeIndex& typeIndex = _typeIndices[primType];
+    if (!typeIndex.isSortedPathsValid) {
+        typeIndex.sortedPaths.assign(typeIndex.paths.begin(),
+                                     typeIndex.paths.end());
+        sort(typeIndex.sortedPaths.begin(), typeIndex.sortedPaths.end());
+        typeIndex.isSortedPathsValid = true;
     }
-    return camPaths;
+    return typeIndex.sortedPaths;
 }
 
-SdfPathVector Model::GetSelection()
+const SdfPathVector& Model::GetSelection() const
 {
     return _selection;
 }
 
 void Model::SetSelection(SdfPathVector primPaths)
 {
-    _selection = primPaths;
+    // the hash rejects most of the different selections without comparing
+    // all the paths
+    size_t hash = TfHash()(primPaths);
+    if (hash == _selectionHash && primPaths == _selection) return;
+
+    _selection = std::move(primPaths);
+    _selectionSet.clear();
+    _selectionSet.insert(_selection.begin(), _selection.end());
+    _selectionHash = hash;
+    _selectionGeneration++;
+}
+
+int Model::GetSelectionGeneration() const
+{
+    return _selectionGeneration;
+}
+
+bool Model::IsSelected(const SdfPath& primPath) const
+{
+    return _selectionSet.count(primPath) > 0;
 }
 
 void Model::SetHit(GfVec3f hitPoint, GfVec3f hitNormal)
@@ -102,5 +180,139 @@ int Model::GetHit(GfVec3f& hitPoint, GfVec3f& hitNormal)
     return _hitGeneration;
 }
 
+void Model::SetLoadingStatus(const string& status)
+{
+    _loadingStatus = status;
+}
+
+string Model::GetLoadingStatus() const
+{
+    return _loadingStatus;
+}
+
+PayloadStreamer* Model::GetPayloadStreamer()
+{
+    return &_payloadStreamer;
+}
+
+void Model::SetTimeCacheSceneIndex(TimeCacheSceneIndexRefPtr sceneIndex)
+{
+    lock_guard<recursive_mutex> lock(_sceneMutex);
+
+    // the playback carries over to the new stage
+    bool isPrefetchEnabled = false;
+    if (_timeCacheSceneIndex) {
+        isPrefetchEnabled = _timeCacheSceneIndex->IsPrefetchEnabled();
+        _timeCacheSceneIndex->SetPrefetchEnabled(false);
+    }
+
+    _timeCacheSceneIndex = sceneIndex;
+    if (!_timeCacheSceneIndex) return;
+
+    _timeCacheSceneIndex->SetTime(_time);
+    _timeCacheSceneIndex->SetPrefetchEnabled(isPrefetchEnabled);
+}
+
+TimeCacheSceneIndexRefPtr Model::GetTimeCacheSceneIndex()
+{
+    return _timeCacheSceneIndex;
+}
+
+void Model::SetTime(UsdTimeCode time)
+{
+    lock_guard<recursive_mutex> lock(_sceneMutex);
+
+    _time = time;
+    if (_timeCacheSceneIndex) _timeCacheSceneIndex->SetTime(time);
+}
+
+UsdTimeCode Model::GetTime() const
+{
+    return _time;
+}
+
+void Model::_AddToTypeIndices(
+    const HdSceneIndexObserver::AddedPrimEntries& entries)
+{
+    for (auto&& entry : entries) {
+        // an added notice on an existing Prim may change its type
+        auto it = _primTypes.find(entry.primPath);
+        if (it != _primTypes.end()) {
+            if (it->second == entry.primType) continue;
+
+            _RemoveFromTypeIndex(entry.primPath, it->second);
+            if (entry.primType.IsEmpty()) {
+                _primTypes.erase(it);
+                _typedPaths.erase(entry.primPath);
+                continue;
+            }
+            it->second = entry.primType;
+        }
+        // untyped Prims (e.g. xforms, scopes) are not indexed
+        else if (entry.primType.IsEmpty()) continue;
+        else {
+            _primTypes.emplace(entry.primPath, entry.primType);
+            _typedPaths.insert(entry.primPath);
+        }
+
+        _TypeIndex& typeIndex = _typeIndices[entry.primType];
+        typeIndex.paths.insert(entry.primPath);
+        typeIndex.isSortedPathsValid = false;
+    }
+}
+
+void Model::_RemoveFromTypeIndex(const SdfPath& primPath,
+                                 const TfToken& primType)
+{
+    _TypeIndex& typeIndex = _typeIndices[primType];
+    if (typeIndex.paths.erase(primPath)) typeIndex.isSortedPathsValid = false;
+}
+
+void Model::_RemoveFromTypeIndices(
+    const HdSceneIndexObserver::RemovedPrimEntries& entries)
+{
+    for (auto&& entry : entries) {
+        // removing a Prim removes its whole subtree
+        auto range = SdfPathFindPrefixedRange(
+            _typedPaths.begin(), _typedPaths.end(), entry.primPath);
+        if (range.first == range.second) continue;
+
+        for (auto it = range.first; it != range.second; ++it) {
+            auto typeIt = _primTypes.find(*it);
+            _RemoveFromTypeIndex(*it, typeIt->second);
+            _primTypes.erase(typeIt);
+        }
+        _typedPaths.erase(range.first, range.second);
+    }
+}
+
+void Model::_SceneIndexObserver::PrimsAdded(const HdSceneIndexBase& sender,
+                                            const AddedPrimEntries& entries)
+{
+    _model->_AddToTypeIndices(entries);
+}
+
+void Model::_SceneIndexObserver::PrimsRemoved(
+    const HdSceneIndexBase& sender, const RemovedPrimEntries& entries)
+{
+    _model->_RemoveFromTypeIndices(entries);
+}
+
+void Model::_SceneIndexObserver::PrimsDirtied(
+    const HdSceneIndexBase& sender, const DirtiedPrimEntries& entries)
+{
+    // dirtied Prims keep their type
+}
+
+void Model::_SceneIndexObserver::PrimsRenamed(
+    const HdSceneIndexBase& sender, const RenamedPrimEntries& entries)
+{
+    AddedPrimEntries addedEntries;
+    RemovedPrimEntries removedEntries;
+    ConvertPrimsRenamedToRemovedAndAdded(sender, entries, &removedEntries,
+                                         &addedEntries);
+    _model->_RemoveFromTypeIndices(removedEntries);
+    _model->_AddToTypeIndices(addedEntries);
+}
 
 PXR_NAMESPACE_CLOSE_SCOPE
@@ -12,14 +12,23 @@
 #include <pxr/base/gf/vec3d.h>
 #include <pxr/imaging/hd/mergingSceneIndex.h>
 #include <pxr/imaging/hd/sceneIndex.h>
+#include <pxr/imaging/hd/sceneIndexObserver.h>
 #include <pxr/usd/usd/prim.h>
 #include <pxr/usd/usd/primRange.h>
 #include <pxr/usd/usd/stage.h>
 #include <pxr/usdImaging/usdImaging/sceneIndices.h>
 #include <pxr/usdImaging/usdImaging/stageSceneIndex.h>
 
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "payloadstreamer.h"
+#include "sceneindices/boundssceneindex.h"
+#include "sceneindices/editoverlaysceneindex.h"
+#include "sceneindices/timecachesceneindex.h"
+
 PXR_NAMESPACE_OPEN_SCOPE
 
 using namespace std;
@@ -37,6 +46,12 @@ class Model {
          */
         Model();
 
+        /**
+         * @brief Destroy the Model object
+         *
+         */
+        ~Model();
+
         /**
          * @brief Get a reference to the Usd Stage from the model
          *
@@ -58,6 +73,37 @@ class Model {
          */
         void AddSceneIndexBase(HdSceneIndexBaseRefPtr sceneIndex);
 
+        /**
+         * @brief Remove a Scene Index Base from the model. Its Prims are
+         * removed from the render indices in a single batch, and the Scene
+         * Index is released once no one else holds it.
+         *
+         * @param sceneIndex HdSceneIndexBaseRefPtr Scene Index to remove
+         */
+        void RemoveSceneIndexBase(HdSceneIndexBaseRefPtr sceneIndex);
+
+        /**
+         * @brief Replace a Scene Index Base of the model. The previous Scene
+         * Index is removed before the new one is added, so that the render
+         * indices never hold both.
+         *
+         * @param previous HdSceneIndexBaseRefPtr Scene Index to remove, or
+         * nullptr to only add the new one
+         * @param sceneIndex HdSceneIndexBaseRefPtr Scene Index to add
+         */
+        void ReplaceSceneIndexBase(HdSceneIndexBaseRefPtr previous,
+                                   HdSceneIndexBaseRefPtr sceneIndex);
+
+        /**
+         * @brief Get the mutex of the scene, locked by the render thread
+         * while it syncs the Engines. The UI thread must lock it to edit the
+         * scene (e.g. the Scene Indices or the Usd Stage), but not to read
+         * it.
+         *
+         * @return the mutex of the scene
+         */
+        recursive_mutex& GetSceneMutex();
+
         /**
          * @brief Get the Editable Scene Index from the model
          *
@@ -79,6 +125,22 @@ class Model {
          */
         HdSceneIndexBaseRefPtr GetFinalSceneIndex();
 
+        /**
+         * @brief Get the Bounds Scene Index at the end of the final Scene
+         * Index, which bounds, culls and picks its Prims on the CPU
+         *
+         * @return the Bounds Scene Index
+         */
+        BoundsSceneIndexRefPtr GetBoundsSceneIndex();
+
+        /**
+         * @brief Get the Edit Overlay Scene Index on top of the Scene Index
+         * Bases, which holds the interactive edits of all the views
+         *
+         * @return the Edit Overlay Scene Index
+         */
+        EditOverlaySceneIndexRefPtr GetEditOverlaySceneIndex();
+
         /**
          * @brief Get the Hydra Prim from the model at a specific path
          *
@@ -111,34 +173,189 @@ class Model {
          */
         SdfPathVector GetCameras();
 
+        /**
+         * @brief Get the paths of all the Hydra Prims of the given type. The
+         * paths are indexed from the notices of the final Scene Index, so no
+         * traversal of the scene happens on query.
+         *
+         * @param primType the Hydra Prim type (e.g. HdPrimTypeTokens->mesh)
+         *
+         * @return the sorted paths of the Prims of the given type
+         */
+        const SdfPathVector& GetPrimsOfType(TfToken primType);
+
         /**
          * @brief Get the current prim selection of the model
          *
          * @return SdfPathVector a vector of the selected prim paths
          */
-        SdfPathVector GetSelection();
+        const SdfPathVector& GetSelection() const;
 
         /**
-         * @brief Set the current prim selection of the model
+         * @brief Set the current prim selection of the model. Setting the
+         * same selection again keeps its generation.
          *
          * @param primPaths the vector containing the prim paths selection
          */
         void SetSelection(SdfPathVector primPaths);
 
+        /**
+         * @brief Get the generation of the selection, incremented each time
+         * the selection changes, so that the views only copy it on change
+         *
+         * @return the generation of the selection
+         */
+        int GetSelectionGeneration() const;
+
+        /**
+         * @brief Check if the given Prim is selected
+         *
+         * @param primPath the path of the Prim
+         * @return true if the Prim is selected
+         * @return false otherwise
+         */
+        bool IsSelected(const SdfPath& primPath) const;
+
         void SetHit(GfVec3f hitPoint, GfVec3f hitNormal);
         int GetHit(GfVec3f& hitPoint, GfVec3f& hitNormal);
 
+        /**
+         * @brief Set the status of the stage being loaded in the background
+         *
+         * @param status the status to display, or an empty string if no load
+         * is in progress
+         */
+        void SetLoadingStatus(const string& status);
+
+        /**
+         * @brief Get the status of the stage being loaded in the background
+         *
+         * @return the status, or an empty string if no load is in progress
+         */
+        string GetLoadingStatus() const;
+
+        /**
+         * @brief Get the Payload Streamer of the current stage
+         *
+         * @return the Payload Streamer
+         */
+        PayloadStreamer* GetPayloadStreamer();
+
+        /**
+         * @brief Set the Time Cache Scene Index of the current stage, which
+         * drives the time of its stage Scene Index. The current time of the
+         * model is applied to it.
+         *
+         * @param sceneIndex the Time Cache Scene Index of the current stage
+         */
+        void SetTimeCacheSceneIndex(TimeCacheSceneIndexRefPtr sceneIndex);
+
+        /**
+         * @brief Get the Time Cache Scene Index of the current stage
+         *
+         * @return the Time Cache Scene Index, or null if no stage is set
+         */
+        TimeCacheSceneIndexRefPtr GetTimeCacheSceneIndex();
+
+        /**
+         * @brief Set the time at which the stage is displayed
+         *
+         * @param time the new time
+         */
+        void SetTime(UsdTimeCode time);
+
+        /**
+         * @brief Get the time at which the stage is displayed
+         *
+         * @return the current time
+         */
+        UsdTimeCode GetTime() const;
+
         void SetActiveCamera(SdfPath prim) { _activeCamera = prim; }
         SdfPath GetActiveCamera() const { return _activeCamera; }
 
     private:
+        /**
+         * @brief Scene Index Observer that keeps the per-type index of the
+         * Prims up to date
+         *
+         */
+        class _SceneIndexObserver : public HdSceneIndexObserver {
+            public:
+                _SceneIndexObserver(Model* model) : _model(model) {}
+
+                void PrimsAdded(const HdSceneIndexBase& sender,
+                                const AddedPrimEntries& entries) override;
+                void PrimsRemoved(const HdSceneIndexBase& sender,
+                                  const RemovedPrimEntries& entries) override;
+                void PrimsDirtied(const HdSceneIndexBase& sender,
+                                  const DirtiedPrimEntries& entries) override;
+                void PrimsRenamed(const HdSceneIndexBase& sender,
+                                  const RenamedPrimEntries& entries) override;
+
+            private:
+                Model* _model;
+        };
+
+        /**
+         * @brief Paths of the Prims of a given type
+         *
+         */
+        struct _TypeIndex {
+                unordered_set<SdfPath, SdfPath::Hash> paths;
+                SdfPathVector sortedPaths;
+                bool isSortedPathsValid = false;
+        };
+
         int _hitGeneration = 0;
         GfVec3f _hitPoint, _hitNormal;
         UsdStageWeakPtr _stage;
         SdfPathVector _selection;
+        unordered_set<SdfPath, SdfPath::Hash> _selectionSet;
+        size_t _selectionHash = 0;
+        int _selectionGeneration = 0;
         HdSceneIndexBaseRefPtr _editableSceneIndex;
         HdMergingSceneIndexRefPtr _sceneIndexBases, _finalSceneIndex;
+        EditOverlaySceneIndexRefPtr _editOverlaySceneIndex;
+        BoundsSceneIndexRefPtr _boundsSceneIndex;
         SdfPath _activeCamera;
+        string _loadingStatus;
+        PayloadStreamer _payloadStreamer;
+        TimeCacheSceneIndexRefPtr _timeCacheSceneIndex;
+        UsdTimeCode _time;
+        recursive_mutex _sceneMutex;
+
+        _SceneIndexObserver _sceneIndexObserver;
+        unordered_map<TfToken, _TypeIndex, TfToken::HashFunctor> _typeIndices;
+        // the type of each indexed Prim, and the same paths ordered so that
+        // a removed subtree is found as a prefixed range
+        unordered_map<SdfPath, TfToken, SdfPath::Hash> _primTypes;
+        SdfPathSet _typedPaths;
+
+        /**
+         * @brief Index the given Prims under their type
+         *
+         * @param entries the added Prims
+         */
+        void _AddToTypeIndices(
+            const HdSceneIndexObserver::AddedPrimEntries& entries);
+
+        /**
+         * @brief Remove a Prim from the index of its type
+         *
+         * @param primPath the path of the Prim
+         * @param primType the indexed type of the Prim
+         */
+        void _RemoveFromTypeIndex(const SdfPath& primPath,
+                                  const TfToken& primType);
+
+        /**
+         * @brief Remove the given Prims and their descendants from the index
+         *
+         * @param entries the removed Prims
+         */
+        void _RemoveFromTypeIndices(
+            const HdSceneIndexObserver::RemovedPrimEntries& entries);
 };
 
 PXR_NAMESPACE_CLOSE_SCOPE
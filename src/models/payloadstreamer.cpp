@@ -0,0 +1,343 @@
+#include "payloadstreamer.h"
+
+#include <pxr/base/gf/bbox3d.h>
+#include <pxr/base/trace/trace.h>
+#include <pxr/usd/usd/primRange.h>
+#include <pxr/usd/usdGeom/tokens.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "memorytracker.h"
+#include "memoryusage.h"
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+// maximum number of payloads loaded or unloaded by a single update
+const size_t BATCH_SIZE = 4;
+// payloads are loaded up to this fraction of the budget, so that the
+// memory doesn't oscillate around the budget
+const double LOAD_THRESHOLD = 0.9;
+// minimum delay between two rankings of the payloads
+const chrono::milliseconds RANKING_DELAY(250);
+// rank penalty of the payloads outside of the camera frustum
+const double OUT_OF_FRUSTUM_PENALTY = 1e12;
+
+/**
+ * @brief Create the cache computing the bounds of the payloads
+ *
+ * @return the bounds cache
+ */
+UsdGeomBBoxCache CreateBBoxCache()
+{
+    // unloaded prims only have their extents hint to provide their bounds
+    return UsdGeomBBoxCache(UsdTimeCode::Default(),
+                            {UsdGeomTokens->default_, UsdGeomTokens->render,
+                             UsdGeomTokens->proxy},
+                            true);
+}
+}  // namespace
+
+PayloadStreamer::PayloadStreamer()
+    : _isEnabled(false),
+      _isRankingDirty(true),
+      _memoryBudget(size_t(8) << 30),
+      _measuredUsage(0),
+      _retainedByteSize(0),
+      _lastUsage(0)
+{
+}
+
+void PayloadStreamer::SetStage(UsdStageRefPtr stage)
+{
+    TRACE_FUNCTION();
+
+    _stage = stage;
+    _payloads.clear();
+    _payloadIndices.clear();
+    _rankedPayloads.clear();
+    _measuredIndices.clear();
+    _retainedByteSize = 0;
+    _isRankingDirty = true;
+
+    if (!stage) return;
+
+    UsdGeomBBoxCache bboxCache = CreateBBoxCache();
+    _IndexPayloads(stage->GetPseudoRoot(), bboxCache);
+}
+
+void PayloadStreamer::SetEnabled(bool enable)
+{
+    _isEnabled = enable;
+    _isRankingDirty = true;
+}
+
+bool PayloadStreamer::IsEnabled() const
+{
+    return _isEnabled;
+}
+
+void PayloadStreamer::SetMemoryBudget(size_t byteSize)
+{
+    _memoryBudget = byteSize;
+}
+
+size_t PayloadStreamer::GetMemoryBudget() const
+{
+    return _memoryBudget;
+}
+
+size_t PayloadStreamer::GetMemoryUsage() const
+{
+    // the GPU memory is polled at a low rate, the resident memory is exact
+    return GetCurrentResidentMemory() + MemoryTracker::GetGpuByteSize();
+}
+
+void PayloadStreamer::SetCamera(const GfFrustum& frustum)
+{
+    if (frustum.GetPosition() == _frustum.GetPosition() &&
+        frustum.GetRotation() == _frustum.GetRotation() &&
+        frustum.GetWindow() == _frustum.GetWindow())
+        return;
+
+    _frustum = frustum;
+    _isRankingDirty = true;
+}
+
+bool PayloadStreamer::HasPayload(const SdfPath& primPath) const
+{
+    return _payloadIndices.count(primPath) > 0;
+}
+
+PayloadStreamer::Mode PayloadStreamer::GetMode(const SdfPath& primPath) const
+{
+    auto it = _payloadIndices.find(primPath);
+    if (it == _payloadIndices.end()) return ModeAutomatic;
+    return _payloads[it->second].mode;
+}
+
+void PayloadStreamer::SetMode(const SdfPath& primPath, Mode mode)
+{
+    auto it = _payloadIndices.find(primPath);
+    if (it == _payloadIndices.end()) return;
+    _payloads[it->second].mode = mode;
+}
+
+size_t PayloadStreamer::GetLoadedCount() const
+{
+    size_t count = 0;
+    for (auto&& payload : _payloads) count += payload.isLoaded;
+    return count;
+}
+
+size_t PayloadStreamer::GetCount() const
+{
+    return _payloads.size();
+}
+
+bool PayloadStreamer::Update()
+{
+    UsdStageRefPtr stage = _stage;
+    if (!stage || _payloads.empty()) return false;
+
+    TRACE_FUNCTION();
+
+    size_t usage = GetMemoryUsage();
+    _UpdateEstimates(usage);
+
+    vector<size_t> loadIndices, unloadIndices;
+
+    // the forced payloads are handled even if the streaming is disabled
+    for (size_t i = 0; i < _payloads.size(); i++) {
+        const _Payload& payload = _payloads[i];
+        if (!payload.isReachable) continue;
+        if (payload.mode == ModeForceLoaded && !payload.isLoaded)
+            loadIndices.push_back(i);
+        else if (payload.mode == ModeForceUnloaded && payload.isLoaded)
+            unloadIndices.push_back(i);
+    }
+
+    if (_isEnabled) {
+        auto now = chrono::steady_clock::now();
+        if (_rankedPayloads.size() != _payloads.size() ||
+            (_isRankingDirty && now - _lastRanking > RANKING_DELAY)) {
+            _RankPayloads();
+            _lastRanking = now;
+        }
+
+        // the memory of the unloaded payloads is considered released
+        size_t memory = usage - std::min(usage, _retainedByteSize);
+        size_t loadBudget = size_t(_memoryBudget * LOAD_THRESHOLD);
+        if (memory < loadBudget) {
+            // load the best ranked unloaded payloads that fit in the budget
+            for (size_t i : _rankedPayloads) {
+                if (loadIndices.size() >= BATCH_SIZE) break;
+                const _Payload& payload = _payloads[i];
+                if (payload.mode != ModeAutomatic || payload.isLoaded ||
+                    !payload.isReachable)
+                    continue;
+
+                memory += _GetEstimatedByteSize(payload);
+                loadIndices.push_back(i);
+                if (memory >= loadBudget) break;
+            }
+        }
+        else if (memory > _memoryBudget) {
+            // unload the worst ranked loaded payloads until their estimated
+            // memory covers the excess
+            size_t excess = memory - loadBudget;
+            for (auto it = _rankedPayloads.rbegin();
+                 it != _rankedPayloads.rend(); ++it) {
+                if (unloadIndices.size() >= BATCH_SIZE) break;
+                const _Payload& payload = _payloads[*it];
+                if (payload.mode != ModeAutomatic || !payload.isLoaded)
+                    continue;
+
+                unloadIndices.push_back(*it);
+                size_t byteSize = _GetEstimatedByteSize(payload);
+                // without any estimate, unload one payload and measure
+                if (byteSize == 0 || byteSize >= excess) break;
+                excess -= byteSize;
+            }
+        }
+    }
+
+    if (loadIndices.empty() && unloadIndices.empty()) return false;
+
+    SdfPathSet loadSet, unloadSet;
+    for (size_t i : loadIndices) {
+        loadSet.insert(_payloads[i].path);
+        _payloads[i].isLoaded = true;
+    }
+    for (size_t i : unloadIndices) {
+        unloadSet.insert(_payloads[i].path);
+        _payloads[i].isLoaded = false;
+        _retainedByteSize += _payloads[i].byteSize;
+
+        // the nested payloads are unloaded with their parent
+        for (auto&& payload : _payloads) {
+            if (payload.path == _payloads[i].path ||
+                !payload.path.HasPrefix(_payloads[i].path))
+                continue;
+            if (payload.isLoaded) _retainedByteSize += payload.byteSize;
+            payload.isLoaded = false;
+            payload.isReachable = false;
+        }
+    }
+
+    // a single recomposition for the whole batch, the nested payloads are
+    // streamed on their own
+    stage->LoadAndUnload(loadSet, unloadSet, UsdLoadWithoutDescendants);
+
+    UsdGeomBBoxCache bboxCache = CreateBBoxCache();
+    for (size_t i : loadIndices) {
+        UsdPrim prim = stage->GetPrimAtPath(_payloads[i].path);
+        if (prim) _IndexPayloads(prim, bboxCache);
+    }
+
+    // a batch that only loads is measured once the renderers synced it
+    _measuredIndices.clear();
+    if (unloadIndices.empty()) {
+        _measuredIndices = loadIndices;
+        _measuredUsage = usage;
+    }
+    return true;
+}
+
+void PayloadStreamer::_IndexPayloads(const UsdPrim& root,
+                                     UsdGeomBBoxCache& bboxCache)
+{
+    TRACE_FUNCTION();
+
+    for (UsdPrim prim : UsdPrimRange(root, UsdPrimAllPrimsPredicate)) {
+        if (!prim.HasAuthoredPayloads()) continue;
+
+        // a payload already indexed becomes reachable again with its parent
+        auto it = _payloadIndices.find(prim.GetPath());
+        if (it != _payloadIndices.end()) {
+            _payloads[it->second].isReachable = true;
+            continue;
+        }
+
+        _Payload payload;
+        payload.path = prim.GetPath();
+        payload.bounds = bboxCache.ComputeWorldBound(prim).ComputeAlignedRange();
+        payload.mode = ModeAutomatic;
+        payload.isLoaded = prim.IsLoaded();
+        payload.isReachable = true;
+        payload.rank = 0;
+        payload.byteSize = 0;
+
+        _payloadIndices[payload.path] = _payloads.size();
+        _payloads.push_back(payload);
+        _isRankingDirty = true;
+    }
+}
+
+void PayloadStreamer::_UpdateEstimates(size_t usage)
+{
+    // the memory the allocator gave back is no longer retained, and loads
+    // reuse the retained memory first
+    if (usage < _lastUsage)
+        _retainedByteSize -= std::min(_retainedByteSize, _lastUsage - usage);
+    _lastUsage = usage;
+
+    if (_measuredIndices.empty()) return;
+
+    size_t growth = usage > _measuredUsage ? usage - _measuredUsage : 0;
+    size_t byteSize = growth / _measuredIndices.size();
+    for (size_t i : _measuredIndices) {
+        _payloads[i].byteSize = std::max(_payloads[i].byteSize, byteSize);
+        _retainedByteSize -= std::min(_retainedByteSize,
+                                      _payloads[i].byteSize);
+    }
+    _measuredIndices.clear();
+}
+
+size_t PayloadStreamer::_GetEstimatedByteSize(const _Payload& payload) const
+{
+    if (payload.byteSize > 0) return payload.byteSize;
+
+    size_t byteSize = 0, count = 0;
+    for (auto&& other : _payloads) {
+        if (other.byteSize == 0) continue;
+        byteSize += other.byteSize;
+        count++;
+    }
+    return count > 0 ? byteSize / count : 0;
+}
+
+void PayloadStreamer::_RankPayloads()
+{
+    TRACE_FUNCTION();
+
+    const GfVec3d eye = _frustum.GetPosition();
+    for (auto&& payload : _payloads) {
+        if (payload.bounds.IsEmpty()) {
+            payload.rank = numeric_limits<double>::max();
+            continue;
+        }
+
+        // distance from the camera to the closest point of the bounds
+        GfVec3d closest;
+        for (int i = 0; i < 3; i++)
+            closest[i] = std::clamp(eye[i], payload.bounds.GetMin()[i],
+                                    payload.bounds.GetMax()[i]);
+        payload.rank = (closest - eye).GetLength();
+
+        if (!_frustum.Intersects(GfBBox3d(payload.bounds)))
+            payload.rank += OUT_OF_FRUSTUM_PENALTY;
+    }
+
+    _rankedPayloads.resize(_payloads.size());
+    for (size_t i = 0; i < _payloads.size(); i++) _rankedPayloads[i] = i;
+    sort(_rankedPayloads.begin(), _rankedPayloads.end(),
+         [&](size_t a, size_t b) {
+             return _payloads[a].rank < _payloads[b].rank;
+         });
+
+    _isRankingDirty = false;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
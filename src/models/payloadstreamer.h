@@ -0,0 +1,221 @@
+/**
+ * @file payloadstreamer.h
+ * @author Raphael Jouretz (rjouretz.com)
+ * @brief PayloadStreamer loads and unloads the payloads of a stage opened
+ * with UsdStage::LoadNone according to the camera and a memory budget.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <pxr/base/gf/frustum.h>
+#include <pxr/base/gf/range3d.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usd/usdGeom/bboxCache.h>
+
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+using namespace std;
+
+/**
+ * @brief PayloadStreamer loads and unloads the payloads of a stage opened
+ * with UsdStage::LoadNone according to the camera and a memory budget.
+ *
+ * Payloads are ranked by visibility in the camera frustum and by distance to
+ * the camera. Every update loads a small batch of the best ranked unloaded
+ * payloads while the resident memory of the process is below the budget, and
+ * unloads the worst ranked loaded ones when it goes above it. Payloads can be
+ * forced loaded or unloaded, in which case they are not streamed anymore.
+ *
+ * The memory of a payload is estimated from the growth of the memory after
+ * its load, so that only the payloads covering the excess are unloaded. The
+ * allocator may keep the memory of unloaded payloads, so their estimate is
+ * considered released until the memory actually falls, instead of unloading
+ * more payloads. Payloads are loaded without their descendants, and the
+ * nested payloads are indexed once their parent is loaded.
+ *
+ */
+class PayloadStreamer {
+    public:
+        /**
+         * @brief The streaming state of a payload
+         *
+         */
+        enum Mode { ModeAutomatic, ModeForceLoaded, ModeForceUnloaded };
+
+        /**
+         * @brief Construct a new Payload Streamer object
+         *
+         */
+        PayloadStreamer();
+
+        /**
+         * @brief Set the stage to stream the payloads of, and index its
+         * payloads with their bounds
+         *
+         * @param stage the stage to stream
+         */
+        void SetStage(UsdStageRefPtr stage);
+
+        /**
+         * @brief Enable or disable the streaming. Disabling it keeps the
+         * loaded payloads as they are.
+         *
+         * @param enable true to enable the streaming
+         */
+        void SetEnabled(bool enable);
+
+        /**
+         * @brief Check if the streaming is enabled
+         *
+         * @return true if the streaming is enabled
+         * @return false otherwise
+         */
+        bool IsEnabled() const;
+
+        /**
+         * @brief Set the memory budget of the process, covering its resident
+         * memory and the GPU memory reported to the MemoryTracker
+         *
+         * @param byteSize the budget in bytes
+         */
+        void SetMemoryBudget(size_t byteSize);
+
+        /**
+         * @brief Get the memory budget of the process
+         *
+         * @return the budget in bytes
+         */
+        size_t GetMemoryBudget() const;
+
+        /**
+         * @brief Get the memory of the process compared to the budget
+         *
+         * @return the resident memory plus the tracked GPU memory, in bytes
+         */
+        size_t GetMemoryUsage() const;
+
+        /**
+         * @brief Set the camera that ranks the payloads
+         *
+         * @param frustum the frustum of the camera
+         */
+        void SetCamera(const GfFrustum& frustum);
+
+        /**
+         * @brief Check if the given prim has a payload handled by the
+         * streamer
+         *
+         * @param primPath the path of the prim
+         * @return true if the prim has a payload
+         * @return false otherwise
+         */
+        bool HasPayload(const SdfPath& primPath) const;
+
+        /**
+         * @brief Get the streaming mode of the payload of the given prim
+         *
+         * @param primPath the path of the prim with a payload
+         * @return the streaming mode of the payload
+         */
+        Mode GetMode(const SdfPath& primPath) const;
+
+        /**
+         * @brief Set the streaming mode of the payload of the given prim
+         *
+         * @param primPath the path of the prim with a payload
+         * @param mode the new streaming mode of the payload
+         */
+        void SetMode(const SdfPath& primPath, Mode mode);
+
+        /**
+         * @brief Get the number of loaded payloads
+         *
+         * @return the number of loaded payloads
+         */
+        size_t GetLoadedCount() const;
+
+        /**
+         * @brief Get the number of payloads
+         *
+         * @return the number of payloads
+         */
+        size_t GetCount() const;
+
+        /**
+         * @brief Load and unload a batch of payloads. Must be called from the
+         * UI thread since it edits the stage.
+         *
+         * @return true if payloads were loaded or unloaded
+         * @return false otherwise
+         */
+        bool Update();
+
+    private:
+        struct _Payload {
+                SdfPath path;
+                GfRange3d bounds;
+                Mode mode;
+                bool isLoaded;
+                // false while the parent payload of a nested payload is
+                // unloaded
+                bool isReachable;
+                double rank;
+                // the estimated memory of the loaded payload, 0 if unknown
+                size_t byteSize;
+        };
+
+        UsdStageWeakPtr _stage;
+        vector<_Payload> _payloads;
+        unordered_map<SdfPath, size_t, SdfPath::Hash> _payloadIndices;
+        vector<size_t> _rankedPayloads;
+
+        bool _isEnabled, _isRankingDirty;
+        size_t _memoryBudget;
+        GfFrustum _frustum;
+        chrono::steady_clock::time_point _lastRanking;
+
+        // the payloads of the last batch, measured on the next update
+        vector<size_t> _measuredIndices;
+        size_t _measuredUsage;
+        // the memory of the unloaded payloads still held by the process
+        size_t _retainedByteSize, _lastUsage;
+
+        /**
+         * @brief Index the payloads of the given prim and its descendants
+         *
+         * @param root the root prim of the payloads to index
+         * @param bboxCache the cache computing the bounds of the payloads
+         */
+        void _IndexPayloads(const UsdPrim& root, UsdGeomBBoxCache& bboxCache);
+
+        /**
+         * @brief Update the estimated memory of the last loaded payloads and
+         * of the retained memory from the current memory usage
+         *
+         * @param usage the memory usage of the process
+         */
+        void _UpdateEstimates(size_t usage);
+
+        /**
+         * @brief Get the estimated memory of a payload, the average of the
+         * known estimates if it was never measured
+         *
+         * @param payload the payload
+         * @return the estimated memory in bytes, 0 if nothing is known
+         */
+        size_t _GetEstimatedByteSize(const _Payload& payload) const;
+
+        /**
+         * @brief Rank the payloads from the camera, the best ranked first
+         *
+         */
+        void _RankPayloads();
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
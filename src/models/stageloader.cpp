@@ -0,0 +1,138 @@
+#include "stageloader.h"
+
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/base/trace/trace.h>
+#include <pxr/imaging/hd/sceneIndexPrimView.h>
+#include <pxr/usdImaging/usdImaging/stageSceneIndex.h>
+
+#include <fstream>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+StageLoader::StageLoader() {}
+
+StageLoader::~StageLoader()
+{
+    _Cancel();
+}
+
+void StageLoader::Start(const string& usdFilePath,
+                        const UsdImagingCreateSceneIndicesInfo& info,
+                        UsdStage::InitialLoadSet loadSet)
+{
+    _Cancel();
+
+    _usdFilePath = usdFilePath;
+    _start = chrono::steady_clock::now();
+    _load = make_shared<_LoadState>();
+    _future = _load->result.get_future();
+
+    shared_ptr<_LoadState> load = _load;
+    _thread = thread([load, usdFilePath, info, loadSet]() {
+        load->result.set_value(_Load(*load, usdFilePath, info, loadSet));
+    });
+}
+
+bool StageLoader::IsLoading() const
+{
+    return _future.valid();
+}
+
+string StageLoader::GetStatus() const
+{
+    if (!IsLoading()) return string();
+
+    string phase;
+    switch (_load->phase) {
+        case _PhaseOpeningLayer: phase = "opening layer"; break;
+        case _PhaseComposingStage: phase = "composing stage"; break;
+        case _PhasePopulatingSceneIndices:
+            phase = "populating scene indices";
+            break;
+        default: phase = "finishing"; break;
+    }
+
+    auto now = chrono::steady_clock::now();
+    double seconds = chrono::duration<double>(now - _start).count();
+    return TfStringPrintf("loading %s\n%s... (%.1fs)",
+                          TfGetBaseName(_usdFilePath).c_str(), phase.c_str(),
+                          seconds);
+}
+
+bool StageLoader::TryGetResult(Result& result)
+{
+    if (!_future.valid()) return false;
+    if (_future.wait_for(chrono::seconds(0)) != future_status::ready)
+        return false;
+
+    // the worker is done once its result is set
+    result = _future.get();
+    _load.reset();
+    if (_thread.joinable()) _thread.join();
+    return true;
+}
+
+void StageLoader::_Cancel()
+{
+    // the previous load stops at its next phase, and its result is dropped
+    // since nothing retrieves it anymore
+    if (_load) _load->isCancelled = true;
+    if (_thread.joinable()) _thread.join();
+    _load.reset();
+    _future = future<Result>();
+}
+
+StageLoader::Result StageLoader::_Load(
+    _LoadState& load, const string usdFilePath,
+    const UsdImagingCreateSceneIndicesInfo info,
+    UsdStage::InitialLoadSet loadSet)
+{
+    TRACE_FUNCTION();
+
+    Result result;
+    if (!ifstream(usdFilePath)) {
+        result.error = "the file does not exist";
+        return result;
+    }
+
+    result.rootLayer = SdfLayer::FindOrOpen(usdFilePath);
+    if (!result.rootLayer) {
+        result.error = "the file can't be opened";
+        return result;
+    }
+    if (load.isCancelled) return result;
+
+    load.phase = _PhaseComposingStage;
+    result.sessionLayer = SdfLayer::CreateAnonymous();
+    result.stage =
+        UsdStage::Open(result.rootLayer, result.sessionLayer, loadSet);
+    if (!result.stage) {
+        result.error = "the stage can't be composed";
+        return result;
+    }
+    result.stage->SetEditTarget(result.sessionLayer);
+    if (load.isCancelled) return result;
+
+    // the scene indices are not observed by the UI yet, so their initial
+    // population can happen on this thread
+    load.phase = _PhasePopulatingSceneIndices;
+    result.sceneIndices = UsdImagingCreateSceneIndices(info);
+    result.sceneIndices.stageSceneIndex->SetStage(result.stage);
+    result.sceneIndices.stageSceneIndex->SetTime(UsdTimeCode::Default());
+
+    // query every prim once so that the data sources cached along the
+    // filtering chain (e.g. flattening) are computed here and not by the
+    // first sync of the render index
+    HdSceneIndexBaseRefPtr finalSceneIndex =
+        result.sceneIndices.finalSceneIndex;
+    for (auto primPath :
+         HdSceneIndexPrimView(finalSceneIndex, SdfPath::AbsoluteRootPath())) {
+        if (load.isCancelled) break;
+        finalSceneIndex->GetPrim(primPath);
+    }
+
+    load.phase = _PhaseDone;
+    return result;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,148 @@
+/**
+ * @file stageloader.h
+ * @author Raphael Jouretz (rjouretz.com)
+ * @brief StageLoader opens and composes a USD stage on a worker thread, and
+ * populates its Hydra scene indices before handing them to the UI thread.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <pxr/usd/sdf/layer.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usdImaging/usdImaging/sceneIndices.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+using namespace std;
+
+/**
+ * @brief StageLoader opens and composes a USD stage on a worker thread, and
+ * populates its Hydra scene indices before handing them to the UI thread.
+ *
+ * Nothing that is observed by the UI is touched by the worker: the loaded
+ * stage and scene indices are only connected to the Model once the UI thread
+ * retrieves them, so the current stage keeps rendering meanwhile.
+ *
+ * A cancelled load stops at its next phase, and its worker is joined so
+ * that no thread outlives the loader or keeps loading in the background.
+ * Every phase checks the cancellation, so the join only waits for the end
+ * of the phase in progress.
+ *
+ */
+class StageLoader {
+    public:
+        /**
+         * @brief The loaded stage and its populated scene indices
+         *
+         */
+        struct Result {
+                SdfLayerRefPtr rootLayer, sessionLayer;
+                UsdStageRefPtr stage;
+                UsdImagingSceneIndices sceneIndices;
+                string error;
+        };
+
+        /**
+         * @brief Construct a new Stage Loader object
+         *
+         */
+        StageLoader();
+
+        /**
+         * @brief Destroy the Stage Loader object. A load in progress is
+         * cancelled and its worker joined.
+         *
+         */
+        ~StageLoader();
+
+        /**
+         * @brief Start loading the given USD file on a worker thread. A load
+         * in progress is cancelled.
+         *
+         * @param usdFilePath the path of the USD file to load
+         * @param info the options of the scene indices to create
+         * @param loadSet the payloads to load with the stage
+         */
+        void Start(const string& usdFilePath,
+                   const UsdImagingCreateSceneIndicesInfo& info,
+                   UsdStage::InitialLoadSet loadSet = UsdStage::LoadAll);
+
+        /**
+         * @brief Check if a load is in progress
+         *
+         * @return true if a load is in progress
+         * @return false otherwise
+         */
+        bool IsLoading() const;
+
+        /**
+         * @brief Get a description of the current phase of the load
+         *
+         * @return the status, or an empty string if no load is in progress
+         */
+        string GetStatus() const;
+
+        /**
+         * @brief Retrieve the result of the load if it is finished, without
+         * blocking
+         *
+         * @param result the result of the load
+         * @return true if the load finished and 'result' was set
+         * @return false otherwise
+         */
+        bool TryGetResult(Result& result);
+
+    private:
+        enum _Phase {
+            _PhaseOpeningLayer,
+            _PhaseComposingStage,
+            _PhasePopulatingSceneIndices,
+            _PhaseDone
+        };
+
+        /**
+         * @brief The state shared by a load and its worker thread
+         *
+         */
+        struct _LoadState {
+                promise<Result> result;
+                atomic<int> phase = _PhaseOpeningLayer;
+                atomic<bool> isCancelled = false;
+        };
+
+        shared_ptr<_LoadState> _load;
+        future<Result> _future;
+        thread _thread;
+        string _usdFilePath;
+        chrono::steady_clock::time_point _start;
+
+        /**
+         * @brief Cancel the load in progress, if any, and join its worker
+         *
+         */
+        void _Cancel();
+
+        /**
+         * @brief Load the stage, run on the worker thread
+         *
+         * @param load the state of the load
+         * @param usdFilePath the path of the USD file to load
+         * @param info the options of the scene indices to create
+         * @param loadSet the payloads to load with the stage
+         * @return the result of the load
+         */
+        static Result _Load(_LoadState& load, const string usdFilePath,
+                            const UsdImagingCreateSceneIndicesInfo info,
+                            UsdStage::InitialLoadSet loadSet);
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
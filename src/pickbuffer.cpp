@@ -0,0 +1,250 @@
+#include "pickbuffer.h"
+
+#include <pxr/base/trace/trace.h>
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+PickBuffer::PickBuffer()
+    : _width(0),
+      _height(0),
+      _tileX(0),
+      _tileY(0),
+      _tileWidth(0),
+      _tileHeight(0),
+      _ndcToWorld(1),
+      _renderCount(0),
+      _isValid(false)
+{
+}
+
+void PickBuffer::Capture(int width, int height, const int32_t* primIds,
+                         const int32_t* instanceIds, const float* depths,
+                         function<SdfPath(int)> primIdToPath,
+                         GfMatrix4d viewProj, size_t renderCount)
+{
+    Capture(GfVec2i(width, height), GfVec2i(0, 0), GfVec2i(width, height),
+            primIds, instanceIds, depths, primIdToPath, viewProj, renderCount);
+}
+
+void PickBuffer::Capture(GfVec2i renderSize, GfVec2i offset, GfVec2i size,
+                         const int32_t* primIds, const int32_t* instanceIds,
+                         const float* depths,
+                         function<SdfPath(int)> primIdToPath,
+                         GfMatrix4d viewProj, size_t renderCount)
+{
+    if (!primIds || !depths || size[0] <= 0 || size[1] <= 0) return;
+
+    TRACE_FUNCTION();
+
+    const size_t pixelCount = size_t(size[0]) * size[1];
+
+    // the ids are resolved once per distinct prim, and the neighbour pixels
+    // usually belong to the same prim
+    vector<int> pathIndices(pixelCount, -1);
+    SdfPathVector paths;
+    unordered_map<int32_t, int> primIdToIndex;
+    int32_t lastPrimId = -1;
+    int lastIndex = -1;
+    for (size_t i = 0; i < pixelCount; i++) {
+        int32_t primId = primIds[i];
+        if (primId < 0) continue;
+
+        if (primId != lastPrimId) {
+            auto it = primIdToIndex.find(primId);
+            if (it == primIdToIndex.end()) {
+                SdfPath path = primIdToPath(primId);
+                int index = -1;
+                if (!path.IsEmpty()) {
+                    index = int(paths.size());
+                    paths.push_back(path);
+                }
+                it = primIdToIndex.insert({primId, index}).first;
+            }
+            lastPrimId = primId;
+            lastIndex = it->second;
+        }
+        pathIndices[i] = lastIndex;
+    }
+
+    vector<int32_t> instances;
+    if (instanceIds) instances.assign(instanceIds, instanceIds + pixelCount);
+
+    vector<float> depthValues(depths, depths + pixelCount);
+
+    // only swap under the lock, so that sampling never waits on a capture
+    lock_guard<mutex> lock(_mutex);
+    _pathIndices.swap(pathIndices);
+    _instanceIds.swap(instances);
+    _depths.swap(depthValues);
+    _paths.swap(paths);
+    _width = renderSize[0];
+    _height = renderSize[1];
+    _tileX = offset[0];
+    _tileY = offset[1];
+    _tileWidth = size[0];
+    _tileHeight = size[1];
+    _ndcToWorld = viewProj.GetInverse();
+    _renderCount = renderCount;
+    _isValid = true;
+}
+
+void PickBuffer::Clear()
+{
+    lock_guard<mutex> lock(_mutex);
+    _pathIndices = vector<int>();
+    _instanceIds = vector<int32_t>();
+    _depths = vector<float>();
+    _paths.clear();
+    _width = 0;
+    _height = 0;
+    _tileWidth = 0;
+    _tileHeight = 0;
+    _renderCount = 0;
+    _isValid = false;
+}
+
+bool PickBuffer::IsValid() const
+{
+    lock_guard<mutex> lock(_mutex);
+    return _isValid;
+}
+
+size_t PickBuffer::GetRenderCount() const
+{
+    lock_guard<mutex> lock(_mutex);
+    return _renderCount;
+}
+
+bool PickBuffer::IsCovering(GfVec2f pos) const
+{
+    lock_guard<mutex> lock(_mutex);
+    if (!_isValid) return false;
+
+    return _GetPixelIndex(int(floor(pos[0] * _width)),
+                          int(floor(pos[1] * _height))) >= 0;
+}
+
+bool PickBuffer::IsTile() const
+{
+    lock_guard<mutex> lock(_mutex);
+    return _isValid && (_tileWidth != _width || _tileHeight != _height);
+}
+
+bool PickBuffer::Sample(GfVec2f pos, Engine::IntersectionResult* result) const
+{
+    lock_guard<mutex> lock(_mutex);
+    if (!_isValid || !result) return false;
+
+    const int x = int(floor(pos[0] * _width));
+    const int y = int(floor(pos[1] * _height));
+    const int pixelIndex = _GetPixelIndex(x, y);
+    if (pixelIndex < 0) return false;
+
+    *result = Engine::IntersectionResult();
+    const int pathIndex = _pathIndices[pixelIndex];
+    if (pathIndex < 0) return true;
+
+    result->path = _paths[pathIndex];
+    if (!_instanceIds.empty())
+        result->instanceIndex = _instanceIds[pixelIndex];
+
+    GfVec3d hitPoint = _Unproject(pixelIndex);
+    result->worldSpaceHitPoint = GfVec3f(hitPoint);
+
+    // the normal is estimated from the neighbour pixels of the same prim,
+    // taken on the opposite side at the borders of the prim
+    int dx = _GetPixelIndex(x + 1, y);
+    if (dx < 0 || _pathIndices[dx] != pathIndex)
+        dx = _GetPixelIndex(x - 1, y);
+    int dy = _GetPixelIndex(x, y - 1);
+    if (dy < 0 || _pathIndices[dy] != pathIndex)
+        dy = _GetPixelIndex(x, y + 1);
+    if (dx < 0 || dy < 0 || _pathIndices[dx] != pathIndex ||
+        _pathIndices[dy] != pathIndex)
+        return true;
+
+    GfVec3d normal =
+        GfCross(_Unproject(dx) - hitPoint, _Unproject(dy) - hitPoint);
+    if (normal.Normalize() < 1e-12) return true;
+
+    // face the camera
+    GfVec3d rayDir = _ndcToWorld.Transform(GfVec3d(0, 0, 1)) -
+                     _ndcToWorld.Transform(GfVec3d(0, 0, -1));
+    if (GfDot(normal, rayDir) > 0) normal = -normal;
+
+    result->worldSpaceHitNormal = GfVec3f(normal);
+    return true;
+}
+
+SdfPathVector PickBuffer::FindPaths(GfVec2f min, GfVec2f max) const
+{
+    lock_guard<mutex> lock(_mutex);
+    if (!_isValid) return {};
+
+    // the rectangle is at least a pixel wide
+    const int minX =
+        std::max(int(floor(std::min(min[0], max[0]) * _width)), 0);
+    const int minY =
+        std::max(int(floor(std::min(min[1], max[1]) * _height)), 0);
+    const int maxX = std::min(
+        std::max(int(ceil(std::max(min[0], max[0]) * _width)), minX + 1),
+        _width);
+    const int maxY = std::min(
+        std::max(int(ceil(std::max(min[1], max[1]) * _height)), minY + 1),
+        _height);
+
+    vector<bool> isFound(_paths.size(), false);
+    SdfPathVector paths;
+    for (int y = minY; y < maxY; y++) {
+        for (int x = minX; x < maxX; x++) {
+            // a tile only holds the pixels around the hover
+            int pixelIndex = _GetPixelIndex(x, y);
+            if (pixelIndex < 0) continue;
+
+            int pathIndex = _pathIndices[pixelIndex];
+            if (pathIndex < 0 || isFound[pathIndex]) continue;
+
+            isFound[pathIndex] = true;
+            paths.push_back(_paths[pathIndex]);
+        }
+    }
+    return paths;
+}
+
+size_t PickBuffer::GetByteSize() const
+{
+    lock_guard<mutex> lock(_mutex);
+    return _pathIndices.capacity() * sizeof(int) +
+           _instanceIds.capacity() * sizeof(int32_t) +
+           _depths.capacity() * sizeof(float) +
+           _paths.capacity() * sizeof(SdfPath);
+}
+
+int PickBuffer::_GetPixelIndex(int x, int y) const
+{
+    // the AOV rows go from the bottom to the top
+    const int column = x - _tileX;
+    const int row = _height - 1 - y - _tileY;
+    if (x < 0 || y < 0 || x >= _width || y >= _height || column < 0 ||
+        row < 0 || column >= _tileWidth || row >= _tileHeight)
+        return -1;
+
+    return row * _tileWidth + column;
+}
+
+GfVec3d PickBuffer::_Unproject(int pixelIndex) const
+{
+    const int x = _tileX + pixelIndex % _tileWidth;
+    const int row = _tileY + pixelIndex / _tileWidth;
+
+    GfVec3d ndc(2.0 * (x + 0.5) / _width - 1.0,
+                2.0 * (row + 0.5) / _height - 1.0,
+                2.0 * _depths[pixelIndex] - 1.0);
+    return _ndcToWorld.Transform(ndc);
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
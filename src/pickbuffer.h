@@ -0,0 +1,189 @@
+/**
+ * @file pickbuffer.h
+ * @author Raphael Jouretz (rjouretz.com)
+ * @brief PickBuffer keeps a CPU copy of the prim id, instance id and depth
+ * AOVs of the last render, so that the hover, the click selection and the
+ * hit points are answered without executing the picking tasks.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/gf/vec2f.h>
+#include <pxr/base/gf/vec2i.h>
+#include <pxr/usd/sdf/path.h>
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "engine.h"
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+using namespace std;
+
+/**
+ * @brief PickBuffer keeps a CPU copy of the prim id, instance id and depth
+ * AOVs of the last render, so that the hover, the click selection and the
+ * hit points are answered without executing the picking tasks.
+ *
+ * The buffer holds either the whole render, for the clicks and the marquee,
+ * or a small tile of it read back asynchronously for the hover. The prim
+ * ids are resolved to paths once per capture, and the hit points are
+ * unprojected from the depth with the camera of the captured render. The
+ * buffer may be captured by the render thread while the UI thread
+ * samples it.
+ *
+ */
+class PickBuffer {
+    public:
+        /**
+         * @brief Construct a new empty Pick Buffer object
+         *
+         */
+        PickBuffer();
+
+        /**
+         * @brief Copy the given AOVs of a render. The rows of the AOVs go
+         * from the bottom to the top of the render.
+         *
+         * @param width the width of the AOVs
+         * @param height the height of the AOVs
+         * @param primIds the prim id AOV
+         * @param instanceIds the instance id AOV, or nullptr if not rendered
+         * @param depths the normalized depth AOV
+         * @param primIdToPath resolves a prim id to the path of its Prim
+         * @param viewProj the view projection matrix of the render
+         * @param renderCount the number of the captured render
+         */
+        void Capture(int width, int height, const int32_t* primIds,
+                     const int32_t* instanceIds, const float* depths,
+                     function<SdfPath(int)> primIdToPath, GfMatrix4d viewProj,
+                     size_t renderCount);
+
+        /**
+         * @brief Copy a tile of the given AOVs of a render, the positions
+         * outside of the tile not being sampled
+         *
+         * @param renderSize the size of the AOVs
+         * @param offset the bottom left pixel of the tile in the AOVs
+         * @param size the size of the tile
+         * @param primIds the prim ids of the tile
+         * @param instanceIds the instance ids of the tile, or nullptr if not
+         * rendered
+         * @param depths the normalized depths of the tile
+         * @param primIdToPath resolves a prim id to the path of its Prim
+         * @param viewProj the view projection matrix of the render
+         * @param renderCount the number of the captured render
+         */
+        void Capture(GfVec2i renderSize, GfVec2i offset, GfVec2i size,
+                     const int32_t* primIds, const int32_t* instanceIds,
+                     const float* depths, function<SdfPath(int)> primIdToPath,
+                     GfMatrix4d viewProj, size_t renderCount);
+
+        /**
+         * @brief Drop the captured AOVs, e.g. when the Engine is replaced
+         *
+         */
+        void Clear();
+
+        /**
+         * @brief Check if AOVs were captured
+         *
+         * @return true if the buffer can be sampled
+         * @return false otherwise
+         */
+        bool IsValid() const;
+
+        /**
+         * @brief Get the number of the captured render
+         *
+         * @return the render count given to the last capture
+         */
+        size_t GetRenderCount() const;
+
+        /**
+         * @brief Check if the captured AOVs cover the given position, i.e.
+         * if the whole render or a tile around the position was captured
+         *
+         * @param pos the normalized position, from the top left
+         * @return true if the position can be sampled
+         * @return false otherwise
+         */
+        bool IsCovering(GfVec2f pos) const;
+
+        /**
+         * @brief Check if only a tile of the render was captured
+         *
+         * @return true if the buffer holds a tile
+         * @return false if it holds the whole render or nothing
+         */
+        bool IsTile() const;
+
+        /**
+         * @brief Find the visible Prim at the given position. The positions
+         * are normalized, so that they stay valid whatever the size of the
+         * captured render (e.g. while the resolution is scaled down).
+         *
+         * @param pos the normalized position, from the top left
+         * @param result the intersection at the position, with an empty
+         * path if no Prim is visible
+         * @return true if the position is inside the captured render or tile
+         * @return false otherwise
+         */
+        bool Sample(GfVec2f pos, Engine::IntersectionResult* result) const;
+
+        /**
+         * @brief Find all the visible Prims inside the given rectangle
+         *
+         * @param min a normalized corner of the rectangle
+         * @param max the opposite normalized corner of the rectangle
+         * @return the paths of the Prims, each reported once
+         */
+        SdfPathVector FindPaths(GfVec2f min, GfVec2f max) const;
+
+        /**
+         * @brief Get the size of the captured AOVs
+         *
+         * @return the size in bytes
+         */
+        size_t GetByteSize() const;
+
+    private:
+        mutable mutex _mutex;
+
+        // the pixels hold an index to the paths, or -1 for the background
+        vector<int> _pathIndices;
+        vector<int32_t> _instanceIds;
+        vector<float> _depths;
+        SdfPathVector _paths;
+        // the size of the render, and the tile of it that was captured
+        int _width, _height;
+        int _tileX, _tileY, _tileWidth, _tileHeight;
+        GfMatrix4d _ndcToWorld;
+        size_t _renderCount;
+        bool _isValid;
+
+        /**
+         * @brief Get the index of the pixel at the given render position
+         *
+         * @param x the column of the pixel, from the left
+         * @param y the row of the pixel, from the top
+         * @return the index of the pixel, or -1 if outside of the tile
+         */
+        int _GetPixelIndex(int x, int y) const;
+
+        /**
+         * @brief Unproject the pixel at the given index to world space
+         *
+         * @param pixelIndex the index of the pixel
+         * @return the world space position of the pixel
+         */
+        GfVec3d _Unproject(int pixelIndex) const;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,172 @@
+#include "picktilereadback.h"
+
+#include <pxr/base/trace/trace.h>
+#include <pxr/imaging/garch/glApi.h>
+#include <pxr/imaging/hgi/tokens.h>
+
+#include "pickbuffer.h"
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+/**
+ * @brief Get the GL format and type to read a single channel AOV texture
+ *
+ * @param desc the descriptor of the AOV texture
+ * @param format the GL format of the pixels
+ * @param type the GL type of the pixels
+ * @return true if the texture has 4 byte pixels that can be read back
+ * @return false otherwise
+ */
+bool GetGlReadFormat(HgiTextureDesc const& desc, GLenum* format,
+                     GLenum* type)
+{
+    // the depth attachments are read as floats, whatever their storage
+    if (desc.usage & HgiTextureUsageBitsDepthTarget) {
+        *format = GL_DEPTH_COMPONENT;
+        *type = GL_FLOAT;
+        return true;
+    }
+
+    switch (desc.format) {
+        case HgiFormatInt32:
+            *format = GL_RED_INTEGER;
+            *type = GL_INT;
+            return true;
+        case HgiFormatFloat32:
+            *format = GL_RED;
+            *type = GL_FLOAT;
+            return true;
+        default: return false;
+    }
+}
+}  // namespace
+
+PickTileReadback::PickTileReadback()
+    : _buffers{0, 0, 0},
+      _bufferByteSize(0),
+      _fence(nullptr),
+      _renderSize(0, 0),
+      _offset(0, 0),
+      _size(0, 0),
+      _viewProj(1),
+      _renderCount(0),
+      _hasInstanceIds(false)
+{
+}
+
+PickTileReadback::~PickTileReadback()
+{
+    if (_fence) glDeleteSync((GLsync)_fence);
+    if (_buffers[0]) glDeleteBuffers(3, _buffers);
+}
+
+bool PickTileReadback::IsSupported(Hgi* hgi)
+{
+    return hgi && hgi->GetAPIName() == HgiTokens->OpenGL;
+}
+
+bool PickTileReadback::Start(HgiTextureHandle const& primIds,
+                             HgiTextureHandle const& instanceIds,
+                             HgiTextureHandle const& depths, GfVec2i offset,
+                             GfVec2i size, GfMatrix4d viewProj,
+                             size_t renderCount)
+{
+    if (_fence) return true;
+    if (!primIds || !depths || size[0] <= 0 || size[1] <= 0) return false;
+
+    HgiTextureHandle textures[3] = {primIds, instanceIds, depths};
+    GLenum formats[3], types[3];
+    const GfVec3i renderSize = primIds->GetDescriptor().dimensions;
+    for (int i = 0; i < 3; i++) {
+        if (!textures[i]) continue;
+
+        HgiTextureDesc const& desc = textures[i]->GetDescriptor();
+        if (desc.dimensions != renderSize ||
+            !GetGlReadFormat(desc, &formats[i], &types[i]))
+            return false;
+    }
+    if (offset[0] < 0 || offset[1] < 0 ||
+        offset[0] + size[0] > renderSize[0] ||
+        offset[1] + size[1] > renderSize[1])
+        return false;
+
+    TRACE_FUNCTION();
+
+    // the buffers only grow, the tiles all being about the same size
+    const size_t byteSize = size_t(size[0]) * size[1] * sizeof(int32_t);
+    if (byteSize > _bufferByteSize) {
+        if (_buffers[0]) glDeleteBuffers(3, _buffers);
+        glCreateBuffers(3, _buffers);
+        for (int i = 0; i < 3; i++)
+            glNamedBufferData(_buffers[i], byteSize, nullptr, GL_STREAM_READ);
+        _bufferByteSize = byteSize;
+    }
+
+    // the copies into the pixel buffers are queued on the GPU, after the
+    // render that wrote the AOVs
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    for (int i = 0; i < 3; i++) {
+        if (!textures[i]) continue;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, _buffers[i]);
+        glGetTextureSubImage(GLuint(textures[i]->GetRawResource()), 0,
+                             offset[0], offset[1], 0, size[0], size[1], 1,
+                             formats[i], types[i], GLsizei(byteSize),
+                             nullptr);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    _fence = (void*)glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+    _renderSize = GfVec2i(renderSize[0], renderSize[1]);
+    _offset = offset;
+    _size = size;
+    _viewProj = viewProj;
+    _renderCount = renderCount;
+    _hasInstanceIds = bool(instanceIds);
+    return true;
+}
+
+bool PickTileReadback::IsPending() const
+{
+    return _fence != nullptr;
+}
+
+bool PickTileReadback::Capture(PickBuffer* pickBuffer,
+                               function<SdfPath(int)> primIdToPath)
+{
+    if (!_fence || !pickBuffer) return false;
+
+    // only poll the fence, the tile is captured on a later call otherwise
+    GLenum status = glClientWaitSync((GLsync)_fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        return false;
+
+    TRACE_FUNCTION();
+
+    glDeleteSync((GLsync)_fence);
+    _fence = nullptr;
+
+    const size_t byteSize = size_t(_size[0]) * _size[1] * sizeof(int32_t);
+    const void* data[3] = {nullptr, nullptr, nullptr};
+    for (int i = 0; i < 3; i++) {
+        if (i == 1 && !_hasInstanceIds) continue;
+        data[i] = glMapNamedBufferRange(_buffers[i], 0, byteSize,
+                                        GL_MAP_READ_BIT);
+    }
+
+    pickBuffer->Capture(_renderSize, _offset, _size,
+                        static_cast<const int32_t*>(data[0]),
+                        static_cast<const int32_t*>(data[1]),
+                        static_cast<const float*>(data[2]), primIdToPath,
+                        _viewProj, _renderCount);
+
+    for (int i = 0; i < 3; i++) {
+        if (data[i]) glUnmapNamedBuffer(_buffers[i]);
+    }
+    return true;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,115 @@
+/**
+ * @file picktilereadback.h
+ * @author Raphael Jouretz (rjouretz.com)
+ * @brief PickTileReadback reads a small tile of the picking AOVs back to the
+ * CPU without waiting on the GPU, so that the hover never stalls a frame.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/gf/vec2i.h>
+#include <pxr/imaging/hgi/hgi.h>
+#include <pxr/imaging/hgi/texture.h>
+#include <pxr/usd/sdf/path.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+using namespace std;
+
+class PickBuffer;
+
+/**
+ * @brief PickTileReadback reads a small tile of the picking AOVs back to the
+ * CPU without waiting on the GPU, so that the hover never stalls a frame.
+ *
+ * The tile is copied from the AOV textures into GL pixel buffers followed
+ * by a fence, and is only captured in a PickBuffer once a later poll finds
+ * the fence signaled. Hgi has no fences and reads whole textures back, so
+ * the readback is only supported with HgiGL; the Engine maps the whole AOVs
+ * with the other backends. All the calls must be made on the thread of the
+ * Engine, with its GL context current.
+ *
+ */
+class PickTileReadback {
+    public:
+        /**
+         * @brief Construct a new Pick Tile Readback object
+         *
+         */
+        PickTileReadback();
+
+        /**
+         * @brief Destroy the Pick Tile Readback object and its GL buffers
+         *
+         */
+        ~PickTileReadback();
+
+        /**
+         * @brief Check if tiles can be read back with the given Hgi
+         *
+         * @param hgi the Hgi of the AOV textures
+         * @return true if the Hgi backend is OpenGL
+         * @return false otherwise
+         */
+        static bool IsSupported(Hgi* hgi);
+
+        /**
+         * @brief Queue the copy of a tile of the given AOV textures, unless
+         * a previous copy is still pending
+         *
+         * @param primIds the prim id AOV texture
+         * @param instanceIds the instance id AOV texture, or an empty
+         * handle if not rendered
+         * @param depths the depth AOV texture
+         * @param offset the bottom left pixel of the tile
+         * @param size the size of the tile, in pixels
+         * @param viewProj the view projection matrix of the render
+         * @param renderCount the number of the render
+         * @return true if the copy was queued
+         * @return false if the textures can't be read back
+         */
+        bool Start(HgiTextureHandle const& primIds,
+                   HgiTextureHandle const& instanceIds,
+                   HgiTextureHandle const& depths, GfVec2i offset,
+                   GfVec2i size, GfMatrix4d viewProj, size_t renderCount);
+
+        /**
+         * @brief Check if a copy was queued and not captured yet
+         *
+         * @return true if a copy is pending
+         * @return false otherwise
+         */
+        bool IsPending() const;
+
+        /**
+         * @brief Capture the pending tile in the given pick buffer if the
+         * GPU is done with its copy, without waiting for it
+         *
+         * @param pickBuffer the pick buffer to update
+         * @param primIdToPath resolves a prim id to the path of its Prim
+         * @return true if the tile was captured
+         * @return false if no copy is pending or it is not done yet
+         */
+        bool Capture(PickBuffer* pickBuffer,
+                     function<SdfPath(int)> primIdToPath);
+
+    private:
+        // the prim id, instance id and depth buffers
+        uint32_t _buffers[3];
+        size_t _bufferByteSize;
+        void* _fence;
+
+        GfVec2i _renderSize, _offset, _size;
+        GfMatrix4d _viewProj;
+        size_t _renderCount;
+        bool _hasInstanceIds;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,163 @@
+#include "profiler.h"
+
+#include <pxr/base/tf/diagnostic.h>
+#include <pxr/base/trace/collector.h>
+#include <pxr/base/trace/reporter.h>
+#include <pxr/imaging/hd/perfLog.h>
+
+#include <fstream>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+// weight of the last value in the average of a sample
+const double SAMPLE_SMOOTHING = 0.1;
+}  // namespace
+
+Profiler& Profiler::GetInstance()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler()
+    : _frameStart(chrono::steady_clock::now()), _countersEnabled(false)
+{
+}
+
+void Profiler::BeginFrame()
+{
+    lock_guard<mutex> lock(_mutex);
+    auto now = chrono::steady_clock::now();
+    double ms =
+        chrono::duration<double, milli>(now - _frameStart).count();
+    _Accumulate(_frameSample, ms);
+    _frameStart = now;
+
+    _counterDeltas.clear();
+    if (!_countersEnabled) return;
+
+    // counters are cumulative, keep the per-frame delta of each of them
+    HdPerfLog& perfLog = HdPerfLog::GetInstance();
+    for (auto&& name : perfLog.GetCounterNames()) {
+        double value = perfLog.GetCounter(name);
+        double delta = value - _counters[name];
+        if (delta != 0) _counterDeltas[name] = delta;
+        _counters[name] = value;
+    }
+}
+
+void Profiler::AddSample(const string& name, double ms)
+{
+    lock_guard<mutex> lock(_mutex);
+    _Accumulate(_samples[name], ms);
+}
+
+Profiler::Sample Profiler::GetSample(const string& name) const
+{
+    lock_guard<mutex> lock(_mutex);
+    auto it = _samples.find(name);
+    if (it == _samples.end()) return Sample();
+    return it->second;
+}
+
+vector<pair<string, Profiler::Sample>> Profiler::GetSamples(
+    const string& prefix) const
+{
+    lock_guard<mutex> lock(_mutex);
+    vector<pair<string, Sample>> samples;
+    for (auto it = _samples.lower_bound(prefix); it != _samples.end(); ++it) {
+        if (it->first.compare(0, prefix.size(), prefix) != 0) break;
+        samples.push_back(*it);
+    }
+    return samples;
+}
+
+Profiler::Sample Profiler::GetFrameSample() const
+{
+    lock_guard<mutex> lock(_mutex);
+    return _frameSample;
+}
+
+vector<pair<TfToken, double>> Profiler::GetCounterDeltas() const
+{
+    lock_guard<mutex> lock(_mutex);
+    return vector<pair<TfToken, double>>(_counterDeltas.begin(),
+                                         _counterDeltas.end());
+}
+
+void Profiler::SetCountersEnabled(bool enable)
+{
+    lock_guard<mutex> lock(_mutex);
+    if (enable == _countersEnabled) return;
+
+    HdPerfLog& perfLog = HdPerfLog::GetInstance();
+    if (enable) perfLog.Enable();
+    else perfLog.Disable();
+
+    _countersEnabled = enable;
+    _counters.clear();
+    _counterDeltas.clear();
+}
+
+bool Profiler::IsCountersEnabled() const
+{
+    lock_guard<mutex> lock(_mutex);
+    return _countersEnabled;
+}
+
+void Profiler::SetTraceRecording(bool enable)
+{
+    TraceCollector::GetInstance().SetEnabled(enable);
+}
+
+bool Profiler::IsTraceRecording() const
+{
+    return TraceCollector::GetInstance().IsEnabled();
+}
+
+bool Profiler::WriteChromeTrace(const string& filePath) const
+{
+    ofstream file(filePath);
+    if (!file) {
+        TF_RUNTIME_ERROR("Unable to write the trace to %s", filePath.c_str());
+        return false;
+    }
+    TraceReporter::GetGlobalReporter()->ReportChromeTracing(file);
+    return true;
+}
+
+bool Profiler::WriteTraceReport(const string& filePath) const
+{
+    ofstream file(filePath);
+    if (!file) {
+        TF_RUNTIME_ERROR("Unable to write the trace report to %s",
+                         filePath.c_str());
+        return false;
+    }
+    TraceReporter::GetGlobalReporter()->Report(file);
+    return true;
+}
+
+void Profiler::_Accumulate(Sample& sample, double ms)
+{
+    if (sample.averageMs == 0) sample.averageMs = ms;
+    else
+        sample.averageMs =
+            sample.averageMs * (1 - SAMPLE_SMOOTHING) + ms * SAMPLE_SMOOTHING;
+    sample.lastMs = ms;
+}
+
+ProfilerScope::ProfilerScope(const string& name)
+    : _name(name), _start(chrono::steady_clock::now())
+{
+}
+
+ProfilerScope::~ProfilerScope()
+{
+    auto end = chrono::steady_clock::now();
+    double ms = chrono::duration<double, milli>(end - _start).count();
+    Profiler::GetInstance().AddSample(_name, ms);
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
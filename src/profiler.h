@@ -0,0 +1,193 @@
+/**
+ * @file profiler.h
+ * @author Raphael Jouretz (rjouretz.com)
+ * @brief Profiler collects per-frame CPU timings and Hydra performance
+ * counters, and records TraceCollector events for offline analysis.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <pxr/base/tf/token.h>
+#include <pxr/base/trace/trace.h>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+using namespace std;
+
+/**
+ * @brief Profiler collects per-frame CPU timings and Hydra performance
+ * counters, and records TraceCollector events for offline analysis.
+ *
+ */
+class Profiler {
+    public:
+        /**
+         * @brief A timing sample
+         *
+         */
+        struct Sample {
+                double lastMs = 0;
+                double averageMs = 0;
+        };
+
+        /**
+         * @brief Get the Profiler instance
+         *
+         * @return the Profiler instance
+         */
+        static Profiler& GetInstance();
+
+        /**
+         * @brief Start a new frame. Update the frame time and the per-frame
+         * deltas of the Hydra performance counters.
+         *
+         */
+        void BeginFrame();
+
+        /**
+         * @brief Add a timing sample
+         *
+         * @param name the name of the sample
+         * @param ms the duration of the sample in milliseconds
+         */
+        void AddSample(const string& name, double ms);
+
+        /**
+         * @brief Get a timing sample
+         *
+         * @param name the name of the sample
+         * @return the sample, zeroed if no sample was added under that name
+         */
+        Sample GetSample(const string& name) const;
+
+        /**
+         * @brief Get all the timing samples whose name starts with the given
+         * prefix
+         *
+         * @param prefix the prefix of the sample names
+         * @return the pairs of sample name and sample
+         */
+        vector<pair<string, Sample>> GetSamples(const string& prefix) const;
+
+        /**
+         * @brief Get the duration of the last frame
+         *
+         * @return the last frame timing sample
+         */
+        Sample GetFrameSample() const;
+
+        /**
+         * @brief Get the per-frame delta of the Hydra performance counters
+         * that changed during the last frame
+         *
+         * @return the pairs of counter name and counter delta
+         */
+        vector<pair<TfToken, double>> GetCounterDeltas() const;
+
+        /**
+         * @brief Enable or disable the Hydra performance counters
+         *
+         * @param enable true to enable the counters
+         */
+        void SetCountersEnabled(bool enable);
+
+        /**
+         * @brief Check if the Hydra performance counters are enabled
+         *
+         * @return true if the counters are enabled
+         * @return false otherwise
+         */
+        bool IsCountersEnabled() const;
+
+        /**
+         * @brief Enable or disable the recording of TraceCollector events
+         *
+         * @param enable true to record the events
+         */
+        void SetTraceRecording(bool enable);
+
+        /**
+         * @brief Check if the TraceCollector events are recorded
+         *
+         * @return true if the events are recorded
+         * @return false otherwise
+         */
+        bool IsTraceRecording() const;
+
+        /**
+         * @brief Write the recorded TraceCollector events as a Chrome trace
+         * (chrome://tracing, Perfetto)
+         *
+         * @param filePath the path of the JSON file to write
+         * @return true if the file was written
+         * @return false otherwise
+         */
+        bool WriteChromeTrace(const string& filePath) const;
+
+        /**
+         * @brief Write the TraceCollector report of the recorded events
+         *
+         * @param filePath the path of the text file to write
+         * @return true if the file was written
+         * @return false otherwise
+         */
+        bool WriteTraceReport(const string& filePath) const;
+
+    private:
+        // the samples are added by the UI and the render threads
+        mutable mutex _mutex;
+        map<string, Sample> _samples;
+        Sample _frameSample;
+        chrono::steady_clock::time_point _frameStart;
+        bool _countersEnabled;
+        map<TfToken, double> _counters, _counterDeltas;
+
+        /**
+         * @brief Construct a new Profiler object
+         *
+         */
+        Profiler();
+
+        /**
+         * @brief Accumulate a new value into a sample
+         *
+         * @param sample the sample to update
+         * @param ms the new value in milliseconds
+         */
+        static void _Accumulate(Sample& sample, double ms);
+};
+
+/**
+ * @brief ProfilerScope adds the duration between its construction and its
+ * destruction as a sample of the Profiler
+ *
+ */
+class ProfilerScope {
+    public:
+        /**
+         * @brief Construct a new Profiler Scope object and start the timer
+         *
+         * @param name the name of the sample
+         */
+        ProfilerScope(const string& name);
+
+        /**
+         * @brief Destroy the Profiler Scope object and add the sample
+         *
+         */
+        ~ProfilerScope();
+
+    private:
+        string _name;
+        chrono::steady_clock::time_point _start;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
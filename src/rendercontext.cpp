@@ -0,0 +1,246 @@
+#include "rendercontext.h"
+
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/base/trace/trace.h>
+#include <pxr/imaging/hd/rendererPluginRegistry.h>
+#include <pxr/imaging/hd/resourceRegistry.h>
+#include <pxr/imaging/hd/tokens.h>
+#include <pxr/imaging/hgi/tokens.h>
+
+#include <algorithm>
+
+#include "memoryusage.h"
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+// maximum number of idle contexts, whatever their memory usage
+const size_t MAX_IDLE_CONTEXTS = 4;
+}  // namespace
+
+RenderContextSharedPtr RenderContext::Get(HdSceneIndexBaseRefPtr sceneIndex,
+                                          TfToken plugin)
+{
+    // an idle context already has the scene synced
+    for (auto it = _idleContexts.begin(); it != _idleContexts.end(); ++it) {
+        RenderContextSharedPtr context = *it;
+        if (context->_sceneIndex == sceneIndex && context->_plugin == plugin) {
+            _idleContexts.erase(it);
+            return context;
+        }
+    }
+
+    // drop the contexts that are destroyed while looking for one in use
+    RenderContextSharedPtr context;
+    for (auto it = _contexts.begin(); it != _contexts.end();) {
+        RenderContextSharedPtr sharedContext = it->lock();
+        if (!sharedContext) {
+            it = _contexts.erase(it);
+            continue;
+        }
+        if (_isSharingEnabled && sharedContext->_sceneIndex == sceneIndex &&
+            sharedContext->_plugin == plugin)
+            context = sharedContext;
+        ++it;
+    }
+    if (context) return context;
+
+    context = make_shared<RenderContext>(sceneIndex, plugin);
+    _contexts.push_back(context);
+    return context;
+}
+
+void RenderContext::Release(RenderContextSharedPtr context)
+{
+    // still used by another Engine
+    if (!context || context.use_count() > 1) return;
+
+    _idleContexts.push_front(context);
+    _EvictIdleContexts();
+}
+
+void RenderContext::ReleaseIdleContexts(TfToken plugin)
+{
+    if (plugin.IsEmpty()) {
+        _idleContexts.clear();
+        return;
+    }
+
+    _idleContexts.remove_if([&](const RenderContextSharedPtr& context) {
+        return context->_plugin == plugin;
+    });
+}
+
+TfTokenVector RenderContext::GetIdleRendererPlugins()
+{
+    TfTokenVector plugins;
+    for (auto&& context : _idleContexts) plugins.push_back(context->_plugin);
+    return plugins;
+}
+
+void RenderContext::SetIdleMemoryBudget(size_t byteSize)
+{
+    _idleMemoryBudget = byteSize;
+    _EvictIdleContexts();
+}
+
+size_t RenderContext::GetIdleMemoryBudget()
+{
+    return _idleMemoryBudget;
+}
+
+size_t RenderContext::GetIdleMemoryUsage(size_t* gpuByteSize)
+{
+    size_t memory = 0;
+    if (gpuByteSize) *gpuByteSize = 0;
+    for (auto&& context : _idleContexts) {
+        bool isGpu = false;
+        size_t byteSize = context->GetMemoryUsage(&isGpu);
+        memory += byteSize;
+        if (gpuByteSize && isGpu) *gpuByteSize += byteSize;
+    }
+    return memory;
+}
+
+void RenderContext::SetSharingEnabled(bool enable)
+{
+    _isSharingEnabled = enable;
+}
+
+bool RenderContext::IsSharingEnabled()
+{
+    return _isSharingEnabled;
+}
+
+RenderContext::RenderContext(HdSceneIndexBaseRefPtr sceneIndex, TfToken plugin)
+    : _sceneIndex(sceneIndex),
+      _batchingSceneIndex(HdNoticeBatchingSceneIndex::New(sceneIndex)),
+      _plugin(plugin),
+      _scenePrefix("/defaultTaskController"),
+      _taskControllerCount(0),
+      _residentMemoryGrowth(0),
+      _isSynced(false),
+      _hgi(Hgi::CreatePlatformDefaultHgi()),
+      _hgiDriver{HgiTokens->renderDriver, VtValue(_hgi.get())},
+      _renderIndex(nullptr)
+{
+    TRACE_FUNCTION();
+
+    const size_t residentMemory = GetCurrentResidentMemory();
+
+    _renderDelegate =
+        HdRendererPluginRegistry::GetInstance().CreateRenderDelegate(plugin);
+    _renderIndex = HdRenderIndex::New(_renderDelegate.Get(), {&_hgiDriver});
+    _renderIndex->InsertSceneIndex(_batchingSceneIndex, _scenePrefix);
+
+    const size_t createdResidentMemory = GetCurrentResidentMemory();
+    if (createdResidentMemory > residentMemory)
+        _residentMemoryGrowth = createdResidentMemory - residentMemory;
+}
+
+RenderContext::~RenderContext()
+{
+    // destroy objects in opposite order of construction
+    if (_renderIndex && _batchingSceneIndex)
+        _renderIndex->RemoveSceneIndex(_batchingSceneIndex);
+
+    delete _renderIndex;
+    _renderDelegate = nullptr;
+}
+
+Hgi* RenderContext::GetHgi() const
+{
+    return _hgi.get();
+}
+
+HdRenderIndex* RenderContext::GetRenderIndex() const
+{
+    return _renderIndex;
+}
+
+HdSceneIndexBaseRefPtr RenderContext::GetSceneIndex() const
+{
+    return _sceneIndex;
+}
+
+TfToken RenderContext::GetRendererPlugin() const
+{
+    return _plugin;
+}
+
+SdfPath RenderContext::GetScenePrefix() const
+{
+    return _scenePrefix;
+}
+
+size_t RenderContext::GetMemoryUsage(bool* isGpu) const
+{
+    if (isGpu) *isGpu = true;
+
+    // the stat type depends on the render delegate
+    auto getByteSize = [](const VtDictionary& stats) -> size_t {
+        auto it = stats.find(HdPerfTokens->gpuMemoryUsed.GetString());
+        if (it == stats.end()) return 0;
+
+        VtValue value = it->second;
+        if (value.CanCast<size_t>()) return value.Cast<size_t>().Get<size_t>();
+        return 0;
+    };
+
+    size_t byteSize = getByteSize(_renderDelegate->GetRenderStats());
+    if (byteSize > 0) return byteSize;
+
+    byteSize = getByteSize(
+        _renderIndex->GetResourceRegistry()->GetResourceAllocation());
+    if (byteSize > 0) return byteSize;
+
+    if (isGpu) *isGpu = false;
+    return _residentMemoryGrowth;
+}
+
+void RenderContext::SyncAll(HdTaskSharedPtrVector* tasks,
+                            HdTaskContext* taskContext)
+{
+    if (_isSynced) {
+        _renderIndex->SyncAll(tasks, taskContext);
+        return;
+    }
+
+    // the first sync populates the render delegate with the whole scene,
+    // which is what stays allocated while the context is idle
+    const size_t residentMemory = GetCurrentResidentMemory();
+    _renderIndex->SyncAll(tasks, taskContext);
+    const size_t syncedResidentMemory = GetCurrentResidentMemory();
+    if (syncedResidentMemory > residentMemory)
+        _residentMemoryGrowth += syncedResidentMemory - residentMemory;
+    _isSynced = true;
+}
+
+void RenderContext::SetNoticeBatchingEnabled(bool enable)
+{
+    // disabling the batching flushes the queued notices
+    if (_batchingSceneIndex->IsBatchingEnabled() != enable)
+        _batchingSceneIndex->SetBatchingEnabled(enable);
+}
+
+SdfPath RenderContext::CreateTaskControllerId()
+{
+    return SdfPath(
+        TfStringPrintf("/taskController%d", _taskControllerCount++));
+}
+
+void RenderContext::_EvictIdleContexts()
+{
+    TRACE_FUNCTION();
+
+    size_t memory = GetIdleMemoryUsage();
+
+    while (!_idleContexts.empty() &&
+           (_idleContexts.size() > MAX_IDLE_CONTEXTS ||
+            memory > _idleMemoryBudget)) {
+        memory -= std::min(memory, _idleContexts.back()->GetMemoryUsage());
+        _idleContexts.pop_back();
+    }
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,262 @@
+/**
+ * @file rendercontext.h
+ * @author Raphael Jouretz (rjouretz.com)
+ * @brief RenderContext holds the Hgi, the render delegate and the render index
+ * that render a Scene Index with a given renderer plugin. It can be shared by
+ * several Engines.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <pxr/base/tf/token.h>
+#include <pxr/imaging/hd/driver.h>
+#include <pxr/imaging/hd/noticeBatchingSceneIndex.h>
+#include <pxr/imaging/hd/pluginRenderDelegateUniqueHandle.h>
+#include <pxr/imaging/hd/renderIndex.h>
+#include <pxr/imaging/hd/sceneIndex.h>
+#include <pxr/imaging/hd/task.h>
+#include <pxr/imaging/hgi/hgi.h>
+#include <pxr/usd/sdf/path.h>
+
+#include <list>
+#include <memory>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+using namespace std;
+
+class RenderContext;
+
+using RenderContextSharedPtr = shared_ptr<RenderContext>;
+
+/**
+ * @brief RenderContext holds the Hgi, the render delegate and the render index
+ * that render a Scene Index with a given renderer plugin. It can be shared by
+ * several Engines.
+ *
+ * The Scene Index is inserted once in the render index, so the Engines
+ * sharing a context only add their own task controller (camera, render size,
+ * AOVs) on top of it: the GPU resources of the scene are allocated once, and
+ * the first Engine to render in a frame syncs the render index for the
+ * others.
+ *
+ * A context released by its last Engine is kept idle, with its synced render
+ * index, so that switching back to its renderer plugin doesn't sync the
+ * whole scene again. The least recently used idle contexts are destroyed
+ * when the idle contexts exceed the memory budget.
+ *
+ * The Scene Index reaches the render index through a notice batching
+ * Scene Index, so that the render tasks can execute without the scene mutex:
+ * the edits made meanwhile only queue their notices, and the render index
+ * is only changed once the notices are flushed with the mutex locked.
+ *
+ * An idle render index still observes the Scene Index, so every scene edit
+ * costs one notice per idle context (its prims are only marked dirty, the
+ * sync is deferred until the context is used again). This is why the idle
+ * contexts are limited in number and not only in memory.
+ *
+ */
+class RenderContext {
+    public:
+        /**
+         * @brief Get a render context for the given Scene Index and renderer
+         * plugin. An idle context is reused first, then if the sharing is
+         * enabled, the context already used by another Engine is returned,
+         * otherwise a new one is created.
+         *
+         * @param sceneIndex the Scene Index to render
+         * @param plugin the renderer plugin
+         * @return the render context
+         */
+        static RenderContextSharedPtr Get(HdSceneIndexBaseRefPtr sceneIndex,
+                                          TfToken plugin);
+
+        /**
+         * @brief Release a render context. If no other Engine uses it, it is
+         * kept idle until it is requested again or evicted.
+         *
+         * @param context the render context to release
+         */
+        static void Release(RenderContextSharedPtr context);
+
+        /**
+         * @brief Destroy the idle render contexts of the given renderer
+         * plugin, or all of them. Must be called before the destruction of
+         * the graphics context.
+         *
+         * @param plugin the renderer plugin, or an empty token for all the
+         * idle contexts
+         */
+        static void ReleaseIdleContexts(TfToken plugin = TfToken());
+
+        /**
+         * @brief Get the renderer plugins of the idle render contexts, the
+         * most recently used first
+         *
+         * @return the renderer plugins
+         */
+        static TfTokenVector GetIdleRendererPlugins();
+
+        /**
+         * @brief Set the memory budget of the idle render contexts
+         *
+         * @param byteSize the budget in bytes
+         */
+        static void SetIdleMemoryBudget(size_t byteSize);
+
+        /**
+         * @brief Get the memory budget of the idle render contexts
+         *
+         * @return the budget in bytes
+         */
+        static size_t GetIdleMemoryBudget();
+
+        /**
+         * @brief Get the memory used by the idle render contexts
+         *
+         * @param gpuByteSize the GPU part of the memory, if not null
+         * @return the memory in bytes
+         */
+        static size_t GetIdleMemoryUsage(size_t* gpuByteSize = nullptr);
+
+        /**
+         * @brief Enable or disable the sharing of the render contexts. Only
+         * the contexts requested afterwards are affected.
+         *
+         * @param enable true to share the render contexts
+         */
+        static void SetSharingEnabled(bool enable);
+
+        /**
+         * @brief Check if the sharing of the render contexts is enabled
+         *
+         * @return true if the render contexts are shared
+         * @return false otherwise
+         */
+        static bool IsSharingEnabled();
+
+        /**
+         * @brief Construct a new Render Context object
+         *
+         * @param sceneIndex the Scene Index to render
+         * @param plugin the renderer plugin
+         */
+        RenderContext(HdSceneIndexBaseRefPtr sceneIndex, TfToken plugin);
+
+        /**
+         * @brief Destroy the Render Context object
+         *
+         */
+        ~RenderContext();
+
+        /**
+         * @brief Get the Hgi of the render context
+         *
+         * @return the Hgi
+         */
+        Hgi* GetHgi() const;
+
+        /**
+         * @brief Get the render index of the render context
+         *
+         * @return the render index
+         */
+        HdRenderIndex* GetRenderIndex() const;
+
+        /**
+         * @brief Get the rendered Scene Index
+         *
+         * @return the Scene Index
+         */
+        HdSceneIndexBaseRefPtr GetSceneIndex() const;
+
+        /**
+         * @brief Get the renderer plugin of the render context
+         *
+         * @return the renderer plugin
+         */
+        TfToken GetRendererPlugin() const;
+
+        /**
+         * @brief Get the prefix of the paths of the Scene Index prims in the
+         * render index
+         *
+         * @return the prefix of the scene paths
+         */
+        SdfPath GetScenePrefix() const;
+
+        /**
+         * @brief Get the memory used by the render delegate. The GPU memory
+         * is read from its render stats or its resource registry, and for
+         * the renderers that report neither (e.g. CPU path tracers), the
+         * growth of the resident memory of the process across the creation
+         * of the context and its first sync is taken as an estimate, so
+         * that the memory allocated later by the other subsystems is never
+         * charged to the context.
+         *
+         * @param isGpu set to true if the memory is GPU memory, if not null
+         * @return the memory in bytes, or 0 if it is unknown
+         */
+        size_t GetMemoryUsage(bool* isGpu = nullptr) const;
+
+        /**
+         * @brief Sync the render index for the given tasks. The first sync
+         * measures the growth of the resident memory of the process, which
+         * is mostly the synced scene.
+         *
+         * @param tasks the tasks to sync
+         * @param taskContext the context of the tasks
+         */
+        void SyncAll(HdTaskSharedPtrVector* tasks,
+                     HdTaskContext* taskContext);
+
+        /**
+         * @brief Queue the notices of the Scene Index instead of forwarding
+         * them to the render index, or forward the queued ones. Must be
+         * called with the scene mutex locked.
+         *
+         * @param enable true to queue the notices, false to flush them
+         */
+        void SetNoticeBatchingEnabled(bool enable);
+
+        /**
+         * @brief Create a new unique id for a task controller of the render
+         * index
+         *
+         * @return the task controller id
+         */
+        SdfPath CreateTaskControllerId();
+
+    private:
+        inline static bool _isSharingEnabled = true;
+        inline static size_t _idleMemoryBudget = size_t(2) << 30;
+        inline static vector<weak_ptr<RenderContext>> _contexts;
+        inline static list<RenderContextSharedPtr> _idleContexts;
+
+        HdSceneIndexBaseRefPtr _sceneIndex;
+        HdNoticeBatchingSceneIndexRefPtr _batchingSceneIndex;
+        TfToken _plugin;
+        SdfPath _scenePrefix;
+        int _taskControllerCount;
+        // the growth of the resident memory across the creation of the
+        // context and its first sync
+        size_t _residentMemoryGrowth;
+        bool _isSynced;
+
+        unique_ptr<Hgi> _hgi;
+        HdDriver _hgiDriver;
+        HdPluginRenderDelegateUniqueHandle _renderDelegate;
+        HdRenderIndex* _renderIndex;
+
+        /**
+         * @brief Destroy the least recently used idle contexts until the
+         * idle contexts fit in the memory budget
+         *
+         */
+        static void _EvictIdleContexts();
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
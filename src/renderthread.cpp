@@ -0,0 +1,96 @@
+#include "renderthread.h"
+
+#include <pxr/base/tf/diagnostic.h>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+void RenderThread::Start(recursive_mutex* sceneMutex,
+                         function<void()> makeContextCurrent)
+{
+    if (!TF_VERIFY(sceneMutex) || _isRunning) return;
+
+    _sceneMutex = sceneMutex;
+    _makeContextCurrent = makeContextCurrent;
+    _isStopped = false;
+    _isRunning = true;
+    _thread = thread(&RenderThread::_Run);
+}
+
+void RenderThread::Stop()
+{
+    if (!_isRunning) return;
+
+    {
+        lock_guard<mutex> lock(_mutex);
+        _isStopped = true;
+    }
+    _condition.notify_one();
+    _thread.join();
+
+    _isRunning = false;
+}
+
+bool RenderThread::IsRunning()
+{
+    return _isRunning;
+}
+
+void RenderThread::Post(const void* key, Job job, bool isSceneLocked)
+{
+    {
+        lock_guard<mutex> lock(_mutex);
+
+        bool isReplaced = false;
+        if (key) {
+            for (auto&& pending : _jobs) {
+                if (pending.key != key) continue;
+                pending.job = move(job);
+                pending.isSceneLocked = isSceneLocked;
+                isReplaced = true;
+                break;
+            }
+        }
+        if (!isReplaced) _jobs.push_back({key, move(job), isSceneLocked});
+    }
+    _condition.notify_one();
+}
+
+recursive_mutex* RenderThread::GetSceneMutex()
+{
+    return _sceneMutex;
+}
+
+void RenderThread::_Run()
+{
+    if (_makeContextCurrent) _makeContextCurrent();
+
+    vector<_Job> jobs;
+    while (true) {
+        {
+            unique_lock<mutex> lock(_mutex);
+            _condition.wait(lock, [] { return _isStopped || !_jobs.empty(); });
+
+            // the pending jobs are still executed on stop, e.g. to release
+            // the Engines with the graphics context alive
+            if (_jobs.empty()) break;
+            jobs.swap(_jobs);
+        }
+
+        // the lock is taken per job, so that the UI thread can edit the
+        // scene between two jobs
+        for (auto&& job : jobs) {
+            if (!job.isSceneLocked) job.job();
+            else {
+                lock_guard<recursive_mutex> sceneLock(*_sceneMutex);
+                job.job();
+            }
+
+            // the captures of a job are released once it is executed, so
+            // that a job waited for by the UI thread holds the last ones
+            job.job = nullptr;
+        }
+        jobs.clear();
+    }
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
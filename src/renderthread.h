@@ -0,0 +1,116 @@
+/**
+ * @file renderthread.h
+ * @author Raphael Jouretz (rjouretz.com)
+ * @brief RenderThread runs the Hydra sync and execute of the Engines on a
+ * dedicated thread, so that a long render doesn't freeze the UI.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <pxr/pxr.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+using namespace std;
+
+/**
+ * @brief RenderThread runs the Hydra sync and execute of the Engines on a
+ * dedicated thread, so that a long render doesn't freeze the UI.
+ *
+ * A single thread is used for all the Engines, since they share the Hgi of
+ * their render context, and the Hgi resources belong to the graphics context
+ * made current on the thread. Once the thread is started, the Engines must
+ * only be created, used and destroyed by the jobs posted to the thread.
+ *
+ * The jobs are executed with the scene mutex locked, except the renders:
+ * they only lock it while the render index is synced with the scene, and
+ * the edits made while their tasks execute only queue their notices (see
+ * RenderContext). So the UI thread waits on a render at most for its sync
+ * when it edits the scene, and never when it only draws.
+ *
+ */
+class RenderThread {
+    public:
+        using Job = function<void()>;
+
+        /**
+         * @brief Start the render thread
+         *
+         * @param sceneMutex the mutex locked while the jobs run
+         * @param makeContextCurrent makes the graphics context shared with
+         * the UI current on the render thread, called once the thread starts
+         */
+        static void Start(recursive_mutex* sceneMutex,
+                          function<void()> makeContextCurrent);
+
+        /**
+         * @brief Execute the pending jobs and stop the render thread
+         *
+         */
+        static void Stop();
+
+        /**
+         * @brief Check if the render thread is running
+         *
+         * @return true if the render thread is running
+         * @return false otherwise
+         */
+        static bool IsRunning();
+
+        /**
+         * @brief Post a job to the render thread. A pending job posted with
+         * the same key is replaced, so that only the latest frame of a view
+         * is rendered when the render thread falls behind. The jobs are
+         * executed in order.
+         *
+         * @param key the key of the job, or nullptr for a job never replaced
+         * @param job the job to execute on the render thread
+         * @param isSceneLocked false if the job locks the scene mutex itself
+         * (see GetSceneMutex), only while it reads the scene
+         */
+        static void Post(const void* key, Job job, bool isSceneLocked = true);
+
+        /**
+         * @brief Get the scene mutex locked while the jobs run
+         *
+         * @return the scene mutex, or nullptr if not started
+         */
+        static recursive_mutex* GetSceneMutex();
+
+    private:
+        inline static thread _thread;
+        inline static mutex _mutex;
+        inline static condition_variable _condition;
+        /**
+         * @brief A job posted to the render thread
+         *
+         */
+        struct _Job {
+                const void* key;
+                Job job;
+                bool isSceneLocked;
+        };
+
+        inline static vector<_Job> _jobs;
+        inline static bool _isRunning = false;
+        inline static bool _isStopped = false;
+        inline static recursive_mutex* _sceneMutex = nullptr;
+        inline static function<void()> _makeContextCurrent;
+
+        /**
+         * @brief Execute the jobs until the thread is stopped
+         *
+         */
+        static void _Run();
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,479 @@
+#include "boundssceneindex.h"
+
+#include <pxr/base/gf/bbox3d.h>
+#include <pxr/base/trace/trace.h>
+#include <pxr/imaging/hd/extentSchema.h>
+#include <pxr/imaging/hd/meshSchema.h>
+#include <pxr/imaging/hd/meshTopologySchema.h>
+#include <pxr/imaging/hd/primvarSchema.h>
+#include <pxr/imaging/hd/primvarsSchema.h>
+#include <pxr/imaging/hd/tokens.h>
+#include <pxr/imaging/hd/visibilitySchema.h>
+#include <pxr/imaging/hd/xformSchema.h>
+
+#include <algorithm>
+#include <limits>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+// maximum number of leaves in a node of the hierarchy
+const size_t MAX_LEAVES_PER_NODE = 4;
+}  // namespace
+
+BoundsSceneIndex::BoundsSceneIndex(
+    const HdSceneIndexBaseRefPtr &inputSceneIndex)
+    : HdSingleInputFilteringSceneIndexBase(inputSceneIndex), _generation(0)
+{
+}
+
+GfRange3d BoundsSceneIndex::GetWorldBounds(const SdfPath &primPath)
+{
+    TRACE_FUNCTION();
+
+    _Update();
+
+    // the descendants follow the Prim in the sorted leaves
+    auto it = std::lower_bound(_leaves.begin(), _leaves.end(), primPath,
+                               [](const _Leaf &leaf, const SdfPath &path) {
+                                   return leaf.path < path;
+                               });
+
+    GfRange3d bounds;
+    for (; it != _leaves.end() && it->path.HasPrefix(primPath); ++it)
+        bounds.UnionWith(it->bounds);
+    return bounds;
+}
+
+SdfPathVector BoundsSceneIndex::FindIntersecting(const GfFrustum &frustum)
+{
+    TRACE_FUNCTION();
+
+    _Update();
+
+    SdfPathVector primPaths;
+    if (_nodes.empty()) return primPaths;
+
+    std::vector<size_t> stack = {0};
+    while (!stack.empty()) {
+        const _Node &node = _nodes[stack.back()];
+        size_t nodeIndex = stack.back();
+        stack.pop_back();
+
+        if (node.bounds.IsEmpty() ||
+            !frustum.Intersects(GfBBox3d(node.bounds)))
+            continue;
+
+        if (node.count == 0) {
+            stack.push_back(nodeIndex + 1);
+            stack.push_back(node.right);
+            continue;
+        }
+
+        for (size_t i = node.first; i < node.first + node.count; i++) {
+            const _Leaf &leaf = _leaves[_order[i]];
+            if (leaf.isVisible && frustum.Intersects(GfBBox3d(leaf.bounds)))
+                primPaths.push_back(leaf.path);
+        }
+    }
+    return primPaths;
+}
+
+bool BoundsSceneIndex::Raycast(const GfRay &ray, SdfPath *primPath,
+                               GfVec3d *hitPoint, GfVec3d *hitNormal)
+{
+    TRACE_FUNCTION();
+
+    _Update();
+
+    if (_nodes.empty()) return false;
+
+    double closestDistance = std::numeric_limits<double>::max();
+    GfVec3d closestNormal;
+    const _Leaf *closestLeaf = nullptr;
+
+    std::vector<size_t> stack = {0};
+    while (!stack.empty()) {
+        size_t nodeIndex = stack.back();
+        const _Node &node = _nodes[nodeIndex];
+        stack.pop_back();
+
+        // skip the nodes behind the closest hit so far
+        double enter, exit;
+        if (node.bounds.IsEmpty() ||
+            !ray.Intersect(node.bounds, &enter, &exit) || exit < 0 ||
+            enter > closestDistance)
+            continue;
+
+        if (node.count == 0) {
+            stack.push_back(nodeIndex + 1);
+            stack.push_back(node.right);
+            continue;
+        }
+
+        for (size_t i = node.first; i < node.first + node.count; i++) {
+            const _Leaf &leaf = _leaves[_order[i]];
+            if (!leaf.isVisible ||
+                !ray.Intersect(leaf.bounds, &enter, &exit) || exit < 0 ||
+                enter > closestDistance)
+                continue;
+
+            if (leaf.isMesh) {
+                if (_IntersectMesh(leaf, ray, closestDistance, closestNormal))
+                    closestLeaf = &leaf;
+            }
+            else {
+                closestDistance = std::max(enter, 0.0);
+                closestNormal = -ray.GetDirection().GetNormalized();
+                closestLeaf = &leaf;
+            }
+        }
+    }
+
+    if (!closestLeaf) return false;
+
+    if (primPath) *primPath = closestLeaf->path;
+    if (hitPoint) *hitPoint = ray.GetPoint(closestDistance);
+    if (hitNormal) *hitNormal = closestNormal;
+    return true;
+}
+
+void BoundsSceneIndex::FindOutside(const GfFrustum &frustum,
+                                   SdfPathVector *outsidePaths)
+{
+    TRACE_FUNCTION();
+
+    _Update();
+
+    // the leaves intersecting the frustum are flagged rather than collected,
+    // so that the query doesn't allocate once the scratch memory is sized
+    _isLeafInside.assign(_leaves.size(), 0);
+    _stack.clear();
+    if (!_nodes.empty()) _stack.push_back(0);
+    while (!_stack.empty()) {
+        const size_t nodeIndex = _stack.back();
+        const _Node &node = _nodes[nodeIndex];
+        _stack.pop_back();
+
+        if (node.bounds.IsEmpty() ||
+            !frustum.Intersects(GfBBox3d(node.bounds)))
+            continue;
+
+        if (node.count == 0) {
+            _stack.push_back(nodeIndex + 1);
+            _stack.push_back(node.right);
+            continue;
+        }
+
+        for (size_t i = node.first; i < node.first + node.count; i++) {
+            const _Leaf &leaf = _leaves[_order[i]];
+            if (leaf.isVisible && frustum.Intersects(GfBBox3d(leaf.bounds)))
+                _isLeafInside[_order[i]] = 1;
+        }
+    }
+
+    // the leaves are sorted by path, so are the outside paths
+    outsidePaths->clear();
+    for (size_t i = 0; i < _leaves.size(); i++) {
+        if (_leaves[i].isVisible && !_isLeafInside[i])
+            outsidePaths->push_back(_leaves[i].path);
+    }
+}
+
+int BoundsSceneIndex::GetGeneration() const
+{
+    return _generation;
+}
+
+HdSceneIndexPrim BoundsSceneIndex::GetPrim(const SdfPath &primPath) const
+{
+    return _GetInputSceneIndex()->GetPrim(primPath);
+}
+
+SdfPathVector BoundsSceneIndex::GetChildPrimPaths(
+    const SdfPath &primPath) const
+{
+    return _GetInputSceneIndex()->GetChildPrimPaths(primPath);
+}
+
+void BoundsSceneIndex::_PrimsAdded(
+    const HdSceneIndexBase &sender,
+    const HdSceneIndexObserver::AddedPrimEntries &entries)
+{
+    // the bounds are read on the next query
+    for (auto &&entry : entries) _dirtyPaths.insert(entry.primPath);
+    if (!entries.empty()) _generation++;
+
+    _SendPrimsAdded(entries);
+}
+
+void BoundsSceneIndex::_PrimsRemoved(
+    const HdSceneIndexBase &sender,
+    const HdSceneIndexObserver::RemovedPrimEntries &entries)
+{
+    for (auto &&entry : entries) _removedPaths.insert(entry.primPath);
+    if (!entries.empty()) _generation++;
+
+    _SendPrimsRemoved(entries);
+}
+
+void BoundsSceneIndex::_PrimsDirtied(
+    const HdSceneIndexBase &sender,
+    const HdSceneIndexObserver::DirtiedPrimEntries &entries)
+{
+    static const HdDataSourceLocatorSet boundsLocators = {
+        HdXformSchema::GetDefaultLocator(),
+        HdExtentSchema::GetDefaultLocator(),
+        HdVisibilitySchema::GetDefaultLocator()};
+
+    for (auto &&entry : entries) {
+        if (!entry.dirtyLocators.Intersects(boundsLocators)) continue;
+
+        _dirtyPaths.insert(entry.primPath);
+        _generation++;
+    }
+
+    _SendPrimsDirtied(entries);
+}
+
+void BoundsSceneIndex::_Update()
+{
+    if (_dirtyPaths.empty() && _removedPaths.empty()) return;
+
+    TRACE_FUNCTION();
+
+    bool isStructureChanged = false;
+
+    // removing a Prim removes the leaves of its whole subtree
+    if (!_removedPaths.empty()) {
+        auto it = std::remove_if(
+            _leaves.begin(), _leaves.end(), [&](const _Leaf &leaf) {
+                return SdfPathFindLongestPrefix(_removedPaths, leaf.path) !=
+                       _removedPaths.end();
+            });
+        if (it != _leaves.end()) {
+            _leaves.erase(it, _leaves.end());
+            _IndexLeaves();
+            isStructureChanged = true;
+        }
+        _removedPaths.clear();
+    }
+
+    // the recorded Prims are read as they are now, so the order of the
+    // notices doesn't matter
+    std::vector<_Leaf> addedLeaves;
+    for (auto &&primPath : _dirtyPaths) {
+        _Leaf leaf;
+        bool hasBounds = _ComputeLeaf(primPath, leaf);
+
+        auto it = _leafIndices.find(primPath);
+        if (it != _leafIndices.end()) {
+            if (hasBounds) {
+                _leaves[it->second] = leaf;
+            }
+            else {
+                // the leaf is dropped by the rebuild
+                _leaves[it->second].path = SdfPath();
+                isStructureChanged = true;
+            }
+        }
+        else if (hasBounds) {
+            addedLeaves.push_back(leaf);
+            isStructureChanged = true;
+        }
+    }
+    _dirtyPaths.clear();
+
+    if (!isStructureChanged) {
+        _Refit();
+        return;
+    }
+
+    _leaves.erase(
+        std::remove_if(_leaves.begin(), _leaves.end(),
+                       [](const _Leaf &leaf) { return leaf.path.IsEmpty(); }),
+        _leaves.end());
+    _leaves.insert(_leaves.end(), addedLeaves.begin(), addedLeaves.end());
+    std::sort(_leaves.begin(), _leaves.end(),
+              [](const _Leaf &a, const _Leaf &b) { return a.path < b.path; });
+    _IndexLeaves();
+    _Build();
+}
+
+bool BoundsSceneIndex::_ComputeLeaf(const SdfPath &primPath,
+                                    _Leaf &leaf) const
+{
+    HdSceneIndexPrim prim = _GetInputSceneIndex()->GetPrim(primPath);
+    if (!prim.dataSource) return false;
+
+    HdExtentSchema extentSchema =
+        HdExtentSchema::GetFromParent(prim.dataSource);
+    if (!extentSchema.GetMin() || !extentSchema.GetMax()) return false;
+
+    HdSampledDataSource::Time time(0);
+    GfRange3d extent(extentSchema.GetMin()->GetTypedValue(time),
+                     extentSchema.GetMax()->GetTypedValue(time));
+    if (extent.IsEmpty()) return false;
+
+    leaf.path = primPath;
+    leaf.xform = GfMatrix4d(1);
+    HdXformSchema xformSchema = HdXformSchema::GetFromParent(prim.dataSource);
+    if (xformSchema.GetMatrix())
+        leaf.xform = xformSchema.GetMatrix()->GetTypedValue(time);
+
+    leaf.bounds = GfBBox3d(extent, leaf.xform).ComputeAlignedRange();
+    leaf.isMesh = prim.primType == HdPrimTypeTokens->mesh;
+
+    leaf.isVisible = true;
+    HdVisibilitySchema visibilitySchema =
+        HdVisibilitySchema::GetFromParent(prim.dataSource);
+    if (visibilitySchema.GetVisibility())
+        leaf.isVisible = visibilitySchema.GetVisibility()->GetTypedValue(time);
+
+    return true;
+}
+
+void BoundsSceneIndex::_IndexLeaves()
+{
+    _leafIndices.clear();
+    _leafIndices.reserve(_leaves.size());
+    for (size_t i = 0; i < _leaves.size(); i++)
+        _leafIndices[_leaves[i].path] = i;
+}
+
+void BoundsSceneIndex::_Build()
+{
+    TRACE_FUNCTION();
+
+    _nodes.clear();
+    _order.resize(_leaves.size());
+    for (size_t i = 0; i < _order.size(); i++) _order[i] = i;
+
+    if (_leaves.empty()) return;
+
+    _nodes.reserve(2 * _leaves.size() / MAX_LEAVES_PER_NODE + 1);
+    _BuildNode(0, _leaves.size());
+}
+
+size_t BoundsSceneIndex::_BuildNode(size_t first, size_t count)
+{
+    size_t nodeIndex = _nodes.size();
+    _nodes.push_back({GfRange3d(), 0, first, count});
+
+    GfRange3d bounds, centroids;
+    for (size_t i = first; i < first + count; i++) {
+        const GfRange3d &leafBounds = _leaves[_order[i]].bounds;
+        bounds.UnionWith(leafBounds);
+        centroids.UnionWith(leafBounds.GetMidpoint());
+    }
+    _nodes[nodeIndex].bounds = bounds;
+
+    if (count <= MAX_LEAVES_PER_NODE) return nodeIndex;
+
+    // split at the median of the longest axis of the centroids
+    GfVec3d size = centroids.GetSize();
+    int axis = 0;
+    if (size[1] > size[axis]) axis = 1;
+    if (size[2] > size[axis]) axis = 2;
+
+    size_t half = count / 2;
+    auto begin = _order.begin() + first;
+    std::nth_element(begin, begin + half, begin + count,
+                     [&](size_t a, size_t b) {
+                         return _leaves[a].bounds.GetMidpoint()[axis] <
+                                _leaves[b].bounds.GetMidpoint()[axis];
+                     });
+
+    // the node without leaves has its left child right after it
+    _nodes[nodeIndex].count = 0;
+    _BuildNode(first, half);
+    size_t right = _BuildNode(first + half, count - half);
+    _nodes[nodeIndex].right = right;
+
+    return nodeIndex;
+}
+
+void BoundsSceneIndex::_Refit()
+{
+    TRACE_FUNCTION();
+
+    // the children of a node are stored after it
+    for (size_t i = _nodes.size(); i-- > 0;) {
+        _Node &node = _nodes[i];
+        GfRange3d bounds;
+        if (node.count == 0) {
+            bounds = GfRange3d::GetUnion(_nodes[i + 1].bounds,
+                                         _nodes[node.right].bounds);
+        }
+        else {
+            for (size_t j = node.first; j < node.first + node.count; j++)
+                bounds.UnionWith(_leaves[_order[j]].bounds);
+        }
+        node.bounds = bounds;
+    }
+}
+
+bool BoundsSceneIndex::_IntersectMesh(const _Leaf &leaf, const GfRay &ray,
+                                      double &distance, GfVec3d &normal) const
+{
+    TRACE_FUNCTION();
+
+    HdSceneIndexPrim prim = _GetInputSceneIndex()->GetPrim(leaf.path);
+    HdSampledDataSource::Time time(0);
+
+    HdMeshTopologySchema topologySchema =
+        HdMeshSchema::GetFromParent(prim.dataSource).GetTopology();
+    HdSampledDataSourceHandle pointsDataSource =
+        HdPrimvarsSchema::GetFromParent(prim.dataSource)
+            .GetPrimvar(HdPrimvarsSchemaTokens->points)
+            .GetPrimvarValue();
+    if (!topologySchema.GetFaceVertexCounts() ||
+        !topologySchema.GetFaceVertexIndices() || !pointsDataSource)
+        return false;
+
+    VtIntArray counts =
+        topologySchema.GetFaceVertexCounts()->GetTypedValue(time);
+    VtIntArray indices =
+        topologySchema.GetFaceVertexIndices()->GetTypedValue(time);
+    VtValue pointsValue = pointsDataSource->GetValue(time);
+    if (!pointsValue.IsHolding<VtVec3fArray>()) return false;
+    const VtVec3fArray &points = pointsValue.UncheckedGet<VtVec3fArray>();
+
+    // the ray is moved to object space, where its distances are unchanged
+    // since its direction isn't normalized
+    GfMatrix4d inverse = leaf.xform.GetInverse();
+    GfRay localRay = ray;
+    localRay.Transform(inverse);
+
+    bool isHit = false;
+    size_t offset = 0;
+    for (int count : counts) {
+        if (offset + count > indices.size()) break;
+
+        // polygons are triangulated as fans
+        for (int i = 1; i + 1 < count; i++) {
+            int i0 = indices[offset], i1 = indices[offset + i],
+                i2 = indices[offset + i + 1];
+            if (i0 < 0 || i1 < 0 || i2 < 0 || size_t(i0) >= points.size() ||
+                size_t(i1) >= points.size() || size_t(i2) >= points.size())
+                continue;
+
+            GfVec3d p0(points[i0]), p1(points[i1]), p2(points[i2]);
+            double hitDistance;
+            if (!localRay.Intersect(p0, p1, p2, &hitDistance, nullptr,
+                                    nullptr, distance))
+                continue;
+
+            distance = hitDistance;
+            GfVec3d localNormal = GfCross(p1 - p0, p2 - p0);
+            normal = inverse.GetTranspose()
+                         .TransformDir(localNormal)
+                         .GetNormalized();
+            isHit = true;
+        }
+        offset += count;
+    }
+    return isHit;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,265 @@
+/**
+ * @file boundssceneindex.h
+ * @author Raphael Jouretz (rjouretz.com)
+ * @brief Hydra Filter Scene Index that keeps a bounding volume hierarchy of
+ * the world space extents of the Hydra Prims, to focus on, cull and pick them
+ * on the CPU.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <pxr/base/gf/frustum.h>
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/gf/range3d.h>
+#include <pxr/base/gf/ray.h>
+#include <pxr/base/gf/vec3d.h>
+#include <pxr/imaging/hd/filteringSceneIndex.h>
+#include <pxr/imaging/hd/sceneIndex.h>
+#include <pxr/pxr.h>
+#include <pxr/usd/sdf/path.h>
+
+#include <unordered_map>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+class BoundsSceneIndex;
+
+TF_DECLARE_REF_PTRS(BoundsSceneIndex);
+
+/**
+ * @class BoundsSceneIndex
+ * @brief Hydra Filter Scene Index that keeps a bounding volume hierarchy of
+ * the world space extents of the Hydra Prims, to focus on, cull and pick them
+ * on the CPU.
+ *
+ * The notices only record the Prims whose xform or extent changed. The
+ * bounds of those Prims are read on the next query, and the hierarchy is
+ * refitted if no Prim gained or lost its bounds, or rebuilt otherwise. The
+ * input Scene Index must be flattened, so that the xforms are in world space.
+ *
+ * The Scene Index doesn't change the Prims it passes through: the hierarchy
+ * is only queried (e.g. by each viewport, which culls for its own Engine).
+ * The queries read the pending notices, so they must be made with the scene
+ * mutex locked.
+ *
+ */
+class BoundsSceneIndex : public HdSingleInputFilteringSceneIndexBase {
+    public:
+        /**
+         * @brief Create a ref pointer to a bounds scene index
+         *
+         * @param inputSceneIndex the flattened scene index to bound
+         * @return BoundsSceneIndexRefPtr the ref pointer to a bounds scene
+         * index
+         */
+        static pxr::BoundsSceneIndexRefPtr New(
+            const pxr::HdSceneIndexBaseRefPtr &inputSceneIndex)
+        {
+            return TfCreateRefPtr(new pxr::BoundsSceneIndex(inputSceneIndex));
+        }
+
+        /**
+         * @brief Construct a new Bounds Scene Index object
+         *
+         * @param inputSceneIndex the flattened scene index to bound
+         */
+        BoundsSceneIndex(const pxr::HdSceneIndexBaseRefPtr &inputSceneIndex);
+
+        /**
+         * @brief Get the world space bounds of a Prim and its descendants,
+         * so that Prims without extent (e.g. xforms, scopes) have bounds
+         *
+         * @param primPath the path of the Prim
+         * @return the world space bounds, empty if neither the Prim nor its
+         * descendants have an extent
+         */
+        pxr::GfRange3d GetWorldBounds(const pxr::SdfPath &primPath);
+
+        /**
+         * @brief Find the visible Prims whose bounds intersect the given
+         * frustum
+         *
+         * @param frustum the world space frustum
+         * @return the paths of the intersecting Prims
+         */
+        pxr::SdfPathVector FindIntersecting(const pxr::GfFrustum &frustum);
+
+        /**
+         * @brief Find the closest visible Prim hit by the given ray. Meshes
+         * are intersected with their triangles, the other Prims with their
+         * bounds.
+         *
+         * @param ray the world space ray
+         * @param primPath the path of the hit Prim
+         * @param hitPoint the world space hit point
+         * @param hitNormal the world space normal at the hit point
+         * @return true if a Prim is hit
+         * @return false otherwise
+         */
+        bool Raycast(const pxr::GfRay &ray, pxr::SdfPath *primPath,
+                     pxr::GfVec3d *hitPoint, pxr::GfVec3d *hitNormal);
+
+        /**
+         * @brief Find the visible Prims whose bounds are outside of the given
+         * frustum, so that they can be culled
+         *
+         * @param frustum the world space frustum
+         * @param outsidePaths the sorted paths of the Prims outside of the
+         * frustum, reusing the memory of the vector
+         */
+        void FindOutside(const pxr::GfFrustum &frustum,
+                         pxr::SdfPathVector *outsidePaths);
+
+        /**
+         * @brief Get the generation of the bounds, incremented by every
+         * notice that changes the bounds of a Prim
+         *
+         * @return the generation of the bounds
+         */
+        int GetGeneration() const;
+
+        /**
+         * @brief Override of
+         * HdSingleInputFilteringSceneIndexBase::GetPrim
+         */
+        virtual pxr::HdSceneIndexPrim GetPrim(
+            const pxr::SdfPath &primPath) const override;
+
+        /**
+         * @brief Override of
+         * HdSingleInputFilteringSceneIndexBase::GetChildPrimPaths
+         */
+        virtual pxr::SdfPathVector GetChildPrimPaths(
+            const pxr::SdfPath &primPath) const override;
+
+    protected:
+        /**
+         * @brief Override of
+         * HdSingleInputFilteringSceneIndexBase::_PrimsAdded
+         */
+        virtual void _PrimsAdded(
+            const pxr::HdSceneIndexBase &sender,
+            const pxr::HdSceneIndexObserver::AddedPrimEntries &entries)
+            override;
+
+        /**
+         * @brief Override of
+         * HdSingleInputFilteringSceneIndexBase::_PrimsRemoved
+         */
+        virtual void _PrimsRemoved(
+            const pxr::HdSceneIndexBase &sender,
+            const pxr::HdSceneIndexObserver::RemovedPrimEntries &entries)
+            override;
+
+        /**
+         * @brief Override of
+         * HdSingleInputFilteringSceneIndexBase::_PrimsDirtied
+         */
+        virtual void _PrimsDirtied(
+            const pxr::HdSceneIndexBase &sender,
+            const pxr::HdSceneIndexObserver::DirtiedPrimEntries &entries)
+            override;
+
+    private:
+        /**
+         * @brief A Prim with an extent
+         *
+         */
+        struct _Leaf {
+                pxr::SdfPath path;
+                pxr::GfRange3d bounds;
+                pxr::GfMatrix4d xform;
+                bool isMesh;
+                bool isVisible;
+        };
+
+        /**
+         * @brief A node of the hierarchy, stored in depth first order so that
+         * its left child follows it. A node with leaves has no child.
+         *
+         */
+        struct _Node {
+                pxr::GfRange3d bounds;
+                size_t right;
+                size_t first, count;
+        };
+
+        // the leaves are sorted by path, so that the descendants of a Prim
+        // are contiguous
+        std::vector<_Leaf> _leaves;
+        std::unordered_map<pxr::SdfPath, size_t, pxr::SdfPath::Hash>
+            _leafIndices;
+        std::vector<size_t> _order;
+        std::vector<_Node> _nodes;
+        // scratch memory of the queries, per leaf and per traversed node
+        std::vector<char> _isLeafInside;
+        std::vector<size_t> _stack;
+
+        pxr::SdfPathSet _dirtyPaths, _removedPaths;
+
+        int _generation;
+
+        /**
+         * @brief Read the bounds of the recorded Prims, then refit or rebuild
+         * the hierarchy
+         *
+         */
+        void _Update();
+
+        /**
+         * @brief Read a Prim of the input Scene Index as a leaf
+         *
+         * @param primPath the path of the Prim
+         * @param leaf the leaf to fill
+         * @return true if the Prim has an extent
+         * @return false otherwise
+         */
+        bool _ComputeLeaf(const pxr::SdfPath &primPath, _Leaf &leaf) const;
+
+        /**
+         * @brief Map the paths of the leaves to their index
+         *
+         */
+        void _IndexLeaves();
+
+        /**
+         * @brief Build the hierarchy from scratch
+         *
+         */
+        void _Build();
+
+        /**
+         * @brief Build the node of the given range of ordered leaves
+         *
+         * @param first the first leaf of the node in the order
+         * @param count the number of leaves of the node
+         * @return the index of the node
+         */
+        size_t _BuildNode(size_t first, size_t count);
+
+        /**
+         * @brief Update the bounds of the nodes from the bounds of the leaves,
+         * without changing the structure of the hierarchy
+         *
+         */
+        void _Refit();
+
+        /**
+         * @brief Intersect a ray with the triangles of a mesh
+         *
+         * @param leaf the leaf of the mesh
+         * @param ray the world space ray
+         * @param distance the distance of the closest hit, updated if a closer
+         * triangle is hit
+         * @param normal the world space normal of the closest hit
+         * @return true if a closer triangle is hit
+         * @return false otherwise
+         */
+        bool _IntersectMesh(const _Leaf &leaf, const pxr::GfRay &ray,
+                            double &distance, pxr::GfVec3d &normal) const;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,329 @@
+#include "editoverlaysceneindex.h"
+
+#include <pxr/base/tf/diagnostic.h>
+#include <pxr/base/vt/value.h>
+#include <pxr/imaging/hd/overlayContainerDataSource.h>
+#include <pxr/imaging/hd/primvarSchema.h>
+#include <pxr/imaging/hd/primvarsSchema.h>
+#include <pxr/imaging/hd/retainedDataSource.h>
+#include <pxr/imaging/hd/tokens.h>
+#include <pxr/imaging/hd/visibilitySchema.h>
+#include <pxr/imaging/hd/xformSchema.h>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+EditOverlaySceneIndex::EditOverlaySceneIndex(
+    const HdSceneIndexBaseRefPtr &inputSceneIndex)
+    : HdSingleInputFilteringSceneIndexBase(inputSceneIndex),
+      _editGeneration(0)
+{
+}
+
+const EditOverlaySceneIndex::_Overrides *EditOverlaySceneIndex::_GetOverrides(
+    const SdfPath &primPath) const
+{
+    auto it = _overrides.find(primPath);
+    if (it == _overrides.end()) return nullptr;
+    return &it->second;
+}
+
+GfMatrix4d EditOverlaySceneIndex::GetXform(const SdfPath &primPath) const
+{
+    const _Overrides *overrides = _GetOverrides(primPath);
+    if (overrides && overrides->hasXform) return overrides->xform;
+
+    HdSceneIndexPrim prim = _GetInputSceneIndex()->GetPrim(primPath);
+
+    HdXformSchema xformSchema = HdXformSchema::GetFromParent(prim.dataSource);
+    if (!xformSchema.IsDefined()) return GfMatrix4d(1);
+
+    HdSampledDataSource::Time time(0);
+    GfMatrix4d xform =
+        xformSchema.GetMatrix()->GetValue(time).Get<GfMatrix4d>();
+
+    return xform;
+}
+
+void EditOverlaySceneIndex::SetXform(const SdfPath &primPath, GfMatrix4d xform)
+{
+    SetXforms({primPath}, {xform});
+}
+
+void EditOverlaySceneIndex::SetXforms(const SdfPathVector &primPaths,
+                                      const std::vector<GfMatrix4d> &xforms)
+{
+    if (!TF_VERIFY(primPaths.size() == xforms.size())) return;
+    if (primPaths.empty()) return;
+
+    HdSceneIndexObserver::DirtiedPrimEntries entries;
+    entries.reserve(primPaths.size());
+    for (size_t i = 0; i < primPaths.size(); i++) {
+        _Overrides &overrides = _overrides[primPaths[i]];
+        overrides.hasXform = true;
+        overrides.xform = xforms[i];
+        entries.push_back({primPaths[i], HdXformSchema::GetDefaultLocator()});
+    }
+    _editGeneration++;
+
+    _SendPrimsDirtied(entries);
+}
+
+GfVec3f EditOverlaySceneIndex::GetDisplayColor(const SdfPath &primPath) const
+{
+    const _Overrides *overrides = _GetOverrides(primPath);
+    if (overrides && overrides->hasDisplayColor)
+        return overrides->displayColor;
+
+    HdSceneIndexPrim prim = _GetInputSceneIndex()->GetPrim(primPath);
+
+    HdPrimvarsSchema primvarsSchema =
+        HdPrimvarsSchema::GetFromParent(prim.dataSource);
+
+    if (!primvarsSchema.IsDefined()) return GfVec3f(-1.f);
+
+    HdPrimvarSchema primvarSchema =
+        primvarsSchema.GetPrimvar(HdTokens->displayColor);
+
+    if (!primvarSchema.IsDefined() || !primvarSchema.GetPrimvarValue())
+        return GfVec3f(-1.f);
+
+    HdSampledDataSource::Time time(0);
+    VtValue colorValue = primvarSchema.GetPrimvarValue()->GetValue(time);
+
+    // the display color is authored as an array of colors, the first one is
+    // used as the constant color
+    if (colorValue.IsHolding<VtVec3fArray>()) {
+        const VtVec3fArray &colors = colorValue.UncheckedGet<VtVec3fArray>();
+        return colors.empty() ? GfVec3f(0.f) : colors[0];
+    }
+    if (colorValue.IsHolding<GfVec3f>())
+        return colorValue.UncheckedGet<GfVec3f>();
+
+    return GfVec3f(-1.f);
+}
+
+void EditOverlaySceneIndex::SetDisplayColor(const SdfPath &primPath,
+                                            GfVec3f color)
+{
+    _Overrides &overrides = _overrides[primPath];
+    overrides.hasDisplayColor = true;
+    overrides.displayColor = color;
+    _editGeneration++;
+
+    HdSceneIndexObserver::DirtiedPrimEntries entries;
+    HdDataSourceLocator locator = HdPrimvarsSchema::GetDefaultLocator().Append(
+        HdTokens->displayColor);
+    entries.push_back({primPath, locator});
+
+    _SendPrimsDirtied(entries);
+}
+
+bool EditOverlaySceneIndex::GetVisibility(const SdfPath &primPath) const
+{
+    const _Overrides *overrides = _GetOverrides(primPath);
+    if (overrides && overrides->hasVisibility) return overrides->visibility;
+
+    HdSceneIndexPrim prim = _GetInputSceneIndex()->GetPrim(primPath);
+
+    HdVisibilitySchema visibilitySchema =
+        HdVisibilitySchema::GetFromParent(prim.dataSource);
+    if (!visibilitySchema.GetVisibility()) return true;
+
+    HdSampledDataSource::Time time(0);
+    return visibilitySchema.GetVisibility()->GetTypedValue(time);
+}
+
+void EditOverlaySceneIndex::SetVisibility(const SdfPath &primPath,
+                                          bool visibility)
+{
+    _Overrides &overrides = _overrides[primPath];
+    overrides.hasVisibility = true;
+    overrides.visibility = visibility;
+    _editGeneration++;
+
+    HdSceneIndexObserver::DirtiedPrimEntries entries;
+    entries.push_back({primPath, HdVisibilitySchema::GetDefaultLocator()});
+
+    _SendPrimsDirtied(entries);
+}
+
+size_t EditOverlaySceneIndex::GetOverrideCount() const
+{
+    return _overrides.size();
+}
+
+size_t EditOverlaySceneIndex::GetByteSize() const
+{
+    // a node per override, plus the bucket array of the table
+    return _overrides.size() *
+               (sizeof(decltype(_overrides)::value_type) + sizeof(void *)) +
+           _overrides.bucket_count() * sizeof(void *);
+}
+
+int EditOverlaySceneIndex::GetEditGeneration() const
+{
+    return _editGeneration;
+}
+
+SdfPathVector EditOverlaySceneIndex::GetOverriddenPaths() const
+{
+    SdfPathVector primPaths;
+    primPaths.reserve(_overrides.size());
+    for (auto &&it : _overrides) primPaths.push_back(it.first);
+    return primPaths;
+}
+
+bool EditOverlaySceneIndex::GetXformOverride(const SdfPath &primPath,
+                                             GfMatrix4d *xform) const
+{
+    const _Overrides *overrides = _GetOverrides(primPath);
+    if (!overrides || !overrides->hasXform) return false;
+
+    if (xform) *xform = overrides->xform;
+    return true;
+}
+
+bool EditOverlaySceneIndex::GetDisplayColorOverride(const SdfPath &primPath,
+                                                    GfVec3f *color) const
+{
+    const _Overrides *overrides = _GetOverrides(primPath);
+    if (!overrides || !overrides->hasDisplayColor) return false;
+
+    if (color) *color = overrides->displayColor;
+    return true;
+}
+
+bool EditOverlaySceneIndex::GetVisibilityOverride(const SdfPath &primPath,
+                                                  bool *visibility) const
+{
+    const _Overrides *overrides = _GetOverrides(primPath);
+    if (!overrides || !overrides->hasVisibility) return false;
+
+    if (visibility) *visibility = overrides->visibility;
+    return true;
+}
+
+void EditOverlaySceneIndex::ClearOverrides(const SdfPathVector &primPaths)
+{
+    HdSceneIndexObserver::DirtiedPrimEntries entries;
+    for (const SdfPath &primPath : primPaths) {
+        auto it = _overrides.find(primPath);
+        if (it == _overrides.end()) continue;
+
+        HdDataSourceLocatorSet locators;
+        if (it->second.hasXform)
+            locators.insert(HdXformSchema::GetDefaultLocator());
+        if (it->second.hasDisplayColor)
+            locators.insert(HdPrimvarsSchema::GetDefaultLocator().Append(
+                HdTokens->displayColor));
+        if (it->second.hasVisibility)
+            locators.insert(HdVisibilitySchema::GetDefaultLocator());
+
+        _overrides.erase(it);
+        entries.push_back({primPath, locators});
+    }
+
+    if (!entries.empty()) _SendPrimsDirtied(entries);
+}
+
+HdSceneIndexPrim EditOverlaySceneIndex::GetPrim(const SdfPath &primPath) const
+{
+    HdSceneIndexPrim prim = _GetInputSceneIndex()->GetPrim(primPath);
+
+    // prims without override are passed through untouched
+    if (_overrides.empty()) return prim;
+
+    const _Overrides *overrides = _GetOverrides(primPath);
+    if (!overrides) return prim;
+
+    // all the overrides of the prim are gathered in a single container, so
+    // that a single overlay is built whatever the number of overrides
+    TfToken names[3];
+    HdDataSourceBaseHandle values[3];
+    size_t count = 0;
+
+    if (overrides->hasXform) {
+        names[count] = HdXformSchemaTokens->xform;
+        values[count++] =
+            HdXformSchema::Builder()
+                .SetMatrix(HdRetainedTypedSampledDataSource<GfMatrix4d>::New(
+                    overrides->xform))
+                .SetResetXformStack(
+                    HdRetainedTypedSampledDataSource<bool>::New(false))
+                .Build();
+    }
+
+    if (overrides->hasDisplayColor) {
+        names[count] = HdPrimvarsSchemaTokens->primvars;
+        values[count++] = HdRetainedContainerDataSource::New(
+            HdTokens->displayColor,
+            HdPrimvarSchema::Builder()
+                .SetPrimvarValue(
+                    HdRetainedTypedSampledDataSource<VtVec3fArray>::New(
+                        {overrides->displayColor}))
+                .SetInterpolation(
+                    HdPrimvarSchema::BuildInterpolationDataSource(
+                        HdPrimvarSchemaTokens->constant))
+                .SetRole(HdPrimvarSchema::BuildRoleDataSource(
+                    HdPrimvarSchemaTokens->color))
+                .Build());
+    }
+
+    if (overrides->hasVisibility) {
+        names[count] = HdVisibilitySchemaTokens->visibility;
+        values[count++] =
+            HdVisibilitySchema::Builder()
+                .SetVisibility(HdRetainedTypedSampledDataSource<bool>::New(
+                    overrides->visibility))
+                .Build();
+    }
+
+    if (count == 0) return prim;
+
+    prim.dataSource = HdOverlayContainerDataSource::New(
+        HdRetainedContainerDataSource::New(count, names, values),
+        prim.dataSource);
+
+    return prim;
+}
+
+SdfPathVector EditOverlaySceneIndex::GetChildPrimPaths(
+    const SdfPath &primPath) const
+{
+    return _GetInputSceneIndex()->GetChildPrimPaths(primPath);
+}
+
+void EditOverlaySceneIndex::_PrimsAdded(
+    const HdSceneIndexBase &sender,
+    const HdSceneIndexObserver::AddedPrimEntries &entries)
+{
+    _SendPrimsAdded(entries);
+}
+
+void EditOverlaySceneIndex::_PrimsRemoved(
+    const HdSceneIndexBase &sender,
+    const HdSceneIndexObserver::RemovedPrimEntries &entries)
+{
+    // the overrides of the removed prims are dropped, so that a reloaded
+    // stage doesn't inherit the edits of the previous one
+    if (!_overrides.empty()) {
+        for (const auto &entry : entries) {
+            for (auto it = _overrides.begin(); it != _overrides.end();) {
+                if (it->first.HasPrefix(entry.primPath))
+                    it = _overrides.erase(it);
+                else ++it;
+            }
+        }
+    }
+
+    _SendPrimsRemoved(entries);
+}
+
+void EditOverlaySceneIndex::_PrimsDirtied(
+    const HdSceneIndexBase &sender,
+    const HdSceneIndexObserver::DirtiedPrimEntries &entries)
+{
+    _SendPrimsDirtied(entries);
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,266 @@
+/**
+ * @file editoverlaysceneindex.h
+ * @author Raphael Jouretz (rjouretz.com)
+ * @brief Hydra Filter Scene Index that overwrites the interactively edited
+ * states of Hydra Prims, such as their xform, display color and visibility.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/imaging/hd/dataSourceLocator.h>
+#include <pxr/imaging/hd/filteringSceneIndex.h>
+#include <pxr/imaging/hd/sceneIndex.h>
+#include <pxr/pxr.h>
+#include <pxr/usd/sdf/path.h>
+
+#include <unordered_map>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+class EditOverlaySceneIndex;
+
+TF_DECLARE_REF_PTRS(EditOverlaySceneIndex);
+
+/**
+ * @class EditOverlaySceneIndex
+ * @brief Hydra Filter Scene Index that overwrites the interactively edited
+ * states of Hydra Prims, such as their xform, display color and visibility.
+ *
+ * A single instance is owned by the Model and shared by all the views, so the
+ * cost of a GetPrim doesn't depend on the number of opened views. All the
+ * overrides of a Prim are stored in a single entry of the path table, and
+ * applied with a single overlay on top of the input Prim.
+ *
+ */
+class EditOverlaySceneIndex : public HdSingleInputFilteringSceneIndexBase {
+    public:
+        /**
+         * @brief Create a ref pointer to an edit overlay scene index
+         *
+         * @param inputSceneIndex the scene index to overwrite from
+         * @return EditOverlaySceneIndexRefPtr the ref pointer to an edit
+         * overlay scene index
+         */
+        static pxr::EditOverlaySceneIndexRefPtr New(
+            const pxr::HdSceneIndexBaseRefPtr &inputSceneIndex)
+        {
+            return TfCreateRefPtr(
+                new pxr::EditOverlaySceneIndex(inputSceneIndex));
+        }
+
+        /**
+         * @brief Construct a new Edit Overlay Scene Index object
+         *
+         * @param inputSceneIndex the scene index to overwrite from
+         */
+        EditOverlaySceneIndex(
+            const pxr::HdSceneIndexBaseRefPtr &inputSceneIndex);
+
+        /**
+         * @brief Get the Xform of a hydra prim at the given path
+         *
+         * @param primPath the path of the prim to get the xform from
+         * @return pxr::GfMatrix4d the xform of the prim
+         */
+        pxr::GfMatrix4d GetXform(const pxr::SdfPath &primPath) const;
+
+        /**
+         * @brief Set the Xform of a hydra prim at the given path
+         *
+         * @param primPath the path to the prim to set the xform
+         * @param xform the new xform to set
+         */
+        void SetXform(const pxr::SdfPath &primPath, pxr::GfMatrix4d xform);
+
+        /**
+         * @brief Set the Xforms of several hydra prims at once, sending a
+         * single dirtied notice for all of them
+         *
+         * @param primPaths the paths to the prims to set the xform
+         * @param xforms the new xforms to set, one per path
+         */
+        void SetXforms(const pxr::SdfPathVector &primPaths,
+                       const std::vector<pxr::GfMatrix4d> &xforms);
+
+        /**
+         * @brief Get the constant display color of a hydra prim at the given
+         * path
+         *
+         * @param primPath the path of the prim to get the display color from
+         * @return pxr::GfVec3f the display color of the prim, or -1 if the
+         * prim has no display color
+         */
+        pxr::GfVec3f GetDisplayColor(const pxr::SdfPath &primPath) const;
+
+        /**
+         * @brief Set the constant display color of a hydra prim at the given
+         * path
+         *
+         * @param primPath the path to the prim to set the display color
+         * @param color the new constant display color to set
+         */
+        void SetDisplayColor(const pxr::SdfPath &primPath, pxr::GfVec3f color);
+
+        /**
+         * @brief Get the visibility of a hydra prim at the given path
+         *
+         * @param primPath the path of the prim to get the visibility from
+         * @return true if the prim is visible
+         * @return false otherwise
+         */
+        bool GetVisibility(const pxr::SdfPath &primPath) const;
+
+        /**
+         * @brief Set the visibility of a hydra prim at the given path
+         *
+         * @param primPath the path to the prim to set the visibility
+         * @param visibility the new visibility to set
+         */
+        void SetVisibility(const pxr::SdfPath &primPath, bool visibility);
+
+        /**
+         * @brief Get the number of prims with at least one override
+         *
+         * @return the number of overridden prims
+         */
+        size_t GetOverrideCount() const;
+
+        /**
+         * @brief Get the approximate size of the override table
+         *
+         * @return the size in bytes
+         */
+        size_t GetByteSize() const;
+
+        /**
+         * @brief Get the generation of the overrides, incremented on each
+         * edit, so that the edits can be detected without comparing them
+         *
+         * @return the generation of the overrides
+         */
+        int GetEditGeneration() const;
+
+        /**
+         * @brief Get the paths of the prims with at least one override
+         *
+         * @return the paths of the overridden prims
+         */
+        pxr::SdfPathVector GetOverriddenPaths() const;
+
+        /**
+         * @brief Get the xform override of a prim
+         *
+         * @param primPath the path of the prim
+         * @param xform the overridden xform
+         * @return true if the xform of the prim is overridden
+         * @return false otherwise
+         */
+        bool GetXformOverride(const pxr::SdfPath &primPath,
+                              pxr::GfMatrix4d *xform) const;
+
+        /**
+         * @brief Get the display color override of a prim
+         *
+         * @param primPath the path of the prim
+         * @param color the overridden display color
+         * @return true if the display color of the prim is overridden
+         * @return false otherwise
+         */
+        bool GetDisplayColorOverride(const pxr::SdfPath &primPath,
+                                     pxr::GfVec3f *color) const;
+
+        /**
+         * @brief Get the visibility override of a prim
+         *
+         * @param primPath the path of the prim
+         * @param visibility the overridden visibility
+         * @return true if the visibility of the prim is overridden
+         * @return false otherwise
+         */
+        bool GetVisibilityOverride(const pxr::SdfPath &primPath,
+                                   bool *visibility) const;
+
+        /**
+         * @brief Remove the overrides of the given prims, e.g. once they are
+         * authored in the input, sending a single dirtied notice for all of
+         * them
+         *
+         * @param primPaths the paths of the prims
+         */
+        void ClearOverrides(const pxr::SdfPathVector &primPaths);
+
+        /**
+         * @brief Override of
+         * HdSingleInputFilteringSceneIndexBase::GetPrim
+         */
+        virtual pxr::HdSceneIndexPrim GetPrim(
+            const pxr::SdfPath &primPath) const override;
+
+        /**
+         * @brief Override of
+         * HdSingleInputFilteringSceneIndexBase::GetChildPrimPaths
+         */
+        virtual pxr::SdfPathVector GetChildPrimPaths(
+            const pxr::SdfPath &primPath) const override;
+
+    protected:
+        /**
+         * @brief Override of
+         * HdSingleInputFilteringSceneIndexBase::_PrimsAdded
+         */
+        virtual void _PrimsAdded(
+            const pxr::HdSceneIndexBase &sender,
+            const pxr::HdSceneIndexObserver::AddedPrimEntries &entries)
+            override;
+
+        /**
+         * @brief Override of
+         * HdSingleInputFilteringSceneIndexBase::_PrimsRemoved
+         */
+        virtual void _PrimsRemoved(
+            const pxr::HdSceneIndexBase &sender,
+            const pxr::HdSceneIndexObserver::RemovedPrimEntries &entries)
+            override;
+
+        /**
+         * @brief Override of
+         * HdSingleInputFilteringSceneIndexBase::_PrimsDirtied
+         */
+        virtual void _PrimsDirtied(
+            const pxr::HdSceneIndexBase &sender,
+            const pxr::HdSceneIndexObserver::DirtiedPrimEntries &entries)
+            override;
+
+    private:
+        /**
+         * @brief The overrides of a Prim, each one only applied if it is set
+         *
+         */
+        struct _Overrides {
+                bool hasXform = false;
+                pxr::GfMatrix4d xform;
+                bool hasDisplayColor = false;
+                pxr::GfVec3f displayColor;
+                bool hasVisibility = false;
+                bool visibility = true;
+        };
+
+        std::unordered_map<pxr::SdfPath, _Overrides, pxr::SdfPath::Hash>
+            _overrides;
+        int _editGeneration;
+
+        /**
+         * @brief Get the overrides of a Prim
+         *
+         * @param primPath the path of the Prim
+         * @return the overrides, or nullptr if the Prim has none
+         */
+        const _Overrides *_GetOverrides(const pxr::SdfPath &primPath) const;
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,370 @@
+#include "timecachesceneindex.h"
+
+#include <pxr/base/trace/trace.h>
+#include <pxr/imaging/hd/overlayContainerDataSource.h>
+#include <pxr/imaging/hd/primvarSchema.h>
+#include <pxr/imaging/hd/primvarsSchema.h>
+#include <pxr/imaging/hd/retainedDataSource.h>
+#include <pxr/imaging/hd/xformSchema.h>
+#include <pxr/usd/usd/primRange.h>
+#include <pxr/usd/usdGeom/pointBased.h>
+#include <pxr/usd/usdGeom/primvarsAPI.h>
+#include <pxr/usd/usdGeom/xformCache.h>
+#include <pxr/usd/usdGeom/xformable.h>
+
+#include <algorithm>
+#include <unordered_set>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+// number of frames prefetched after the current time by default
+const size_t DEFAULT_CACHE_SIZE = 48;
+}  // namespace
+
+TimeCacheSceneIndex::TimeCacheSceneIndex(
+    const HdSceneIndexBaseRefPtr &inputSceneIndex,
+    const UsdImagingStageSceneIndexRefPtr &stageSceneIndex,
+    const UsdStageRefPtr &stage)
+    : HdSingleInputFilteringSceneIndexBase(inputSceneIndex),
+      _stageSceneIndex(stageSceneIndex),
+      _stage(stage),
+      _time(UsdTimeCode::Default()),
+      _isSettingTime(false),
+      _isStopped(false),
+      _isPrefetchEnabled(false),
+      _isPrefetching(false),
+      _isTracked(false),
+      _prefetchTime(UsdTimeCode::Default()),
+      _cacheSize(DEFAULT_CACHE_SIZE),
+      _generation(0)
+{
+}
+
+TimeCacheSceneIndex::~TimeCacheSceneIndex()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _isStopped = true;
+    }
+    _condition.notify_all();
+    if (_worker.joinable()) _worker.join();
+}
+
+void TimeCacheSceneIndex::SetTime(UsdTimeCode time)
+{
+    _time = time;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _prefetchTime = time;
+        _EvictFrames();
+
+        // the frame must be current before the stage scene index dirties
+        // the time-varying prims, since the notices are handled right away
+        _currentFrame.reset();
+        if (!time.IsDefault()) {
+            auto it = _frames.find(time.GetValue());
+            if (it != _frames.end()) _currentFrame = it->second;
+        }
+    }
+    _condition.notify_all();
+
+    _isSettingTime = true;
+    _stageSceneIndex->SetTime(time);
+    _isSettingTime = false;
+}
+
+UsdTimeCode TimeCacheSceneIndex::GetTime() const
+{
+    return _time;
+}
+
+void TimeCacheSceneIndex::SetPrefetchEnabled(bool enable)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _isPrefetchEnabled = enable;
+
+    if (enable) {
+        // the worker is only started for stages that are played
+        if (!_worker.joinable())
+            _worker = std::thread(&TimeCacheSceneIndex::_Run, this);
+        _condition.notify_all();
+    }
+    else {
+        _condition.wait(lock, [&]() { return !_isPrefetching; });
+    }
+}
+
+bool TimeCacheSceneIndex::IsPrefetchEnabled() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _isPrefetchEnabled;
+}
+
+void TimeCacheSceneIndex::SetCacheSize(size_t frameCount)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _cacheSize = std::max<size_t>(frameCount, 1);
+        _EvictFrames();
+    }
+    _condition.notify_all();
+}
+
+size_t TimeCacheSceneIndex::GetCacheSize() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _cacheSize;
+}
+
+size_t TimeCacheSceneIndex::GetCachedFrameCount() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _frames.size();
+}
+
+bool TimeCacheSceneIndex::IsCurrentFrameCached() const
+{
+    return bool(_currentFrame);
+}
+
+HdSceneIndexPrim TimeCacheSceneIndex::GetPrim(const SdfPath &primPath) const
+{
+    HdSceneIndexPrim prim = _GetInputSceneIndex()->GetPrim(primPath);
+    if (!_currentFrame || !prim.dataSource) return prim;
+
+    auto it = _currentFrame->find(primPath);
+    if (it == _currentFrame->end()) return prim;
+
+    const _PrimSample &sample = it->second;
+
+    TfTokenVector names;
+    std::vector<HdDataSourceBaseHandle> dataSources;
+
+    // the input is flattened, so the cached xform is the world one
+    if (sample.hasXform) {
+        names.push_back(HdXformSchemaTokens->xform);
+        dataSources.push_back(
+            HdXformSchema::Builder()
+                .SetMatrix(HdRetainedTypedSampledDataSource<GfMatrix4d>::New(
+                    sample.xform))
+                .Build());
+    }
+
+    if (!sample.primvars.empty()) {
+        TfTokenVector primvarNames;
+        std::vector<HdDataSourceBaseHandle> primvarDataSources;
+        for (auto &&primvar : sample.primvars) {
+            primvarNames.push_back(primvar.first);
+            primvarDataSources.push_back(
+                HdPrimvarSchema::Builder()
+                    .SetPrimvarValue(
+                        HdRetainedSampledDataSource::New(primvar.second))
+                    .Build());
+        }
+        names.push_back(HdPrimvarsSchemaTokens->primvars);
+        dataSources.push_back(HdRetainedContainerDataSource::New(
+            primvarNames.size(), primvarNames.data(),
+            primvarDataSources.data()));
+    }
+
+    prim.dataSource = HdOverlayContainerDataSource::New(
+        HdRetainedContainerDataSource::New(names.size(), names.data(),
+                                           dataSources.data()),
+        prim.dataSource);
+
+    return prim;
+}
+
+SdfPathVector TimeCacheSceneIndex::GetChildPrimPaths(
+    const SdfPath &primPath) const
+{
+    return _GetInputSceneIndex()->GetChildPrimPaths(primPath);
+}
+
+void TimeCacheSceneIndex::_PrimsAdded(
+    const HdSceneIndexBase &sender,
+    const HdSceneIndexObserver::AddedPrimEntries &entries)
+{
+    _Invalidate();
+    _SendPrimsAdded(entries);
+}
+
+void TimeCacheSceneIndex::_PrimsRemoved(
+    const HdSceneIndexBase &sender,
+    const HdSceneIndexObserver::RemovedPrimEntries &entries)
+{
+    _Invalidate();
+    _SendPrimsRemoved(entries);
+}
+
+void TimeCacheSceneIndex::_PrimsDirtied(
+    const HdSceneIndexBase &sender,
+    const HdSceneIndexObserver::DirtiedPrimEntries &entries)
+{
+    // only the time changes are prefetched, anything else is an edit
+    if (!_isSettingTime) _Invalidate();
+    _SendPrimsDirtied(entries);
+}
+
+void TimeCacheSceneIndex::_Run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_isStopped) {
+        double time;
+        if (!_isPrefetchEnabled || !_FindNextFrame(time)) {
+            _condition.wait(lock);
+            continue;
+        }
+
+        _isPrefetching = true;
+        size_t generation = _generation;
+        bool isTracked = _isTracked;
+        lock.unlock();
+
+        if (!isTracked) _TrackTimeVaryingPrims();
+        _FrameConstPtr frame = _ComputeFrame(time);
+
+        lock.lock();
+        _isPrefetching = false;
+
+        // drop the frame if the stage changed meanwhile
+        if (generation == _generation) {
+            _isTracked = true;
+            _frames[time] = frame;
+            _EvictFrames();
+        }
+        _condition.notify_all();
+    }
+}
+
+bool TimeCacheSceneIndex::_FindNextFrame(double &time) const
+{
+    if (_prefetchTime.IsDefault()) return false;
+
+    double startTime = _stage->GetStartTimeCode();
+    double endTime = _stage->GetEndTimeCode();
+    bool hasRange = endTime > startTime;
+
+    for (size_t i = 0; i < _cacheSize; i++) {
+        double frameTime = _prefetchTime.GetValue() + i;
+        // the playback loops over the time range of the stage
+        if (hasRange && frameTime > endTime)
+            frameTime -= endTime - startTime + 1;
+        if (_frames.count(frameTime) == 0) {
+            time = frameTime;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TimeCacheSceneIndex::_EvictFrames()
+{
+    if (_prefetchTime.IsDefault()) return;
+
+    for (auto it = _frames.begin(); it != _frames.end();) {
+        // the previous frame is kept so that stepping back is cached
+        double offset = _GetWindowOffset(it->first);
+        if (offset < -1 || offset >= double(_cacheSize))
+            it = _frames.erase(it);
+        else ++it;
+    }
+}
+
+double TimeCacheSceneIndex::_GetWindowOffset(double time) const
+{
+    double startTime = _stage->GetStartTimeCode();
+    double endTime = _stage->GetEndTimeCode();
+
+    double offset = time - _prefetchTime.GetValue();
+    if (endTime > startTime && offset < -1)
+        offset += endTime - startTime + 1;
+    return offset;
+}
+
+void TimeCacheSceneIndex::_TrackTimeVaryingPrims()
+{
+    TRACE_FUNCTION();
+
+    _trackedPrims.clear();
+
+    // the world xform of a prim varies if any of its ancestors' does
+    std::unordered_set<SdfPath, SdfPath::Hash> xformVaryingPaths;
+
+    for (UsdPrim prim : _stage->Traverse()) {
+        _TrackedPrim trackedPrim;
+        trackedPrim.prim = prim;
+
+        UsdGeomXformable xformable(prim);
+        trackedPrim.isXformVarying =
+            xformable && (xformable.TransformMightBeTimeVarying() ||
+                          xformVaryingPaths.count(prim.GetParent().GetPath()));
+        if (trackedPrim.isXformVarying)
+            xformVaryingPaths.insert(prim.GetPath());
+
+        UsdGeomPointBased pointBased(prim);
+        if (pointBased) {
+            UsdAttribute points = pointBased.GetPointsAttr();
+            if (points.ValueMightBeTimeVarying())
+                trackedPrim.primvars.push_back(
+                    {HdPrimvarsSchemaTokens->points, points});
+
+            UsdAttribute normals = pointBased.GetNormalsAttr();
+            if (normals.ValueMightBeTimeVarying())
+                trackedPrim.primvars.push_back(
+                    {HdPrimvarsSchemaTokens->normals, normals});
+        }
+
+        // indexed primvars are left to the stage scene index, since their
+        // indices would have to be cached as well
+        for (const UsdGeomPrimvar &primvar :
+             UsdGeomPrimvarsAPI(prim).GetPrimvars()) {
+            if (primvar.IsIndexed() || !primvar.ValueMightBeTimeVarying())
+                continue;
+            trackedPrim.primvars.push_back(
+                {primvar.GetPrimvarName(), primvar.GetAttr()});
+        }
+
+        if (trackedPrim.isXformVarying || !trackedPrim.primvars.empty())
+            _trackedPrims.push_back(trackedPrim);
+    }
+}
+
+TimeCacheSceneIndex::_FrameConstPtr TimeCacheSceneIndex::_ComputeFrame(
+    double time)
+{
+    TRACE_FUNCTION();
+
+    auto frame = std::make_shared<_Frame>();
+    UsdGeomXformCache xformCache(time);
+
+    for (auto &&trackedPrim : _trackedPrims) {
+        _PrimSample sample;
+        if (trackedPrim.isXformVarying) {
+            sample.hasXform = true;
+            sample.xform =
+                xformCache.GetLocalToWorldTransform(trackedPrim.prim);
+        }
+        for (auto &&primvar : trackedPrim.primvars) {
+            VtValue value;
+            if (primvar.second.Get(&value, time))
+                sample.primvars.push_back({primvar.first, value});
+        }
+        (*frame)[trackedPrim.prim.GetPath()] = std::move(sample);
+    }
+
+    return frame;
+}
+
+void TimeCacheSceneIndex::_Invalidate()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _frames.clear();
+    _currentFrame.reset();
+    _isTracked = false;
+    _generation++;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
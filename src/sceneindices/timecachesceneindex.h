@@ -0,0 +1,298 @@
+/**
+ * @file timecachesceneindex.h
+ * @author Raphael Jouretz (rjouretz.com)
+ * @brief Hydra Filter Scene Index that drives the time of a stage scene index
+ * and serves the time-varying values of its prims from a cache prefetched on
+ * a worker thread.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <pxr/base/gf/matrix4d.h>
+#include <pxr/base/vt/value.h>
+#include <pxr/imaging/hd/filteringSceneIndex.h>
+#include <pxr/imaging/hd/sceneIndex.h>
+#include <pxr/pxr.h>
+#include <pxr/usd/sdf/path.h>
+#include <pxr/usd/usd/attribute.h>
+#include <pxr/usd/usd/stage.h>
+#include <pxr/usdImaging/usdImaging/stageSceneIndex.h>
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+class TimeCacheSceneIndex;
+
+TF_DECLARE_REF_PTRS(TimeCacheSceneIndex);
+
+/**
+ * @class TimeCacheSceneIndex
+ * @brief Hydra Filter Scene Index that drives the time of a stage scene index
+ * and serves the time-varying values of its prims from a cache prefetched on
+ * a worker thread.
+ *
+ * While the prefetch is enabled, a worker reads the world xforms and the
+ * non-indexed primvars (points, normals, ...) of the time-varying prims for
+ * the frames following the current time, so that a frame already in the
+ * cache is synced without reading the stage on the UI thread. The stage must
+ * not be edited while the prefetch is enabled. Any change that does not come
+ * from a time change flushes the cache.
+ *
+ */
+class TimeCacheSceneIndex : public HdSingleInputFilteringSceneIndexBase {
+    public:
+        /**
+         * @brief Create a ref pointer to a time cache scene index
+         *
+         * @param inputSceneIndex the final scene index of the stage
+         * @param stageSceneIndex the stage scene index at the root of the
+         * input scene index
+         * @param stage the stage of the stage scene index
+         * @return TimeCacheSceneIndexRefPtr the ref pointer to a time cache
+         * scene index
+         */
+        static pxr::TimeCacheSceneIndexRefPtr New(
+            const pxr::HdSceneIndexBaseRefPtr &inputSceneIndex,
+            const pxr::UsdImagingStageSceneIndexRefPtr &stageSceneIndex,
+            const pxr::UsdStageRefPtr &stage)
+        {
+            return TfCreateRefPtr(new pxr::TimeCacheSceneIndex(
+                inputSceneIndex, stageSceneIndex, stage));
+        }
+
+        /**
+         * @brief Construct a new Time Cache Scene Index object
+         *
+         * @param inputSceneIndex the final scene index of the stage
+         * @param stageSceneIndex the stage scene index at the root of the
+         * input scene index
+         * @param stage the stage of the stage scene index
+         */
+        TimeCacheSceneIndex(
+            const pxr::HdSceneIndexBaseRefPtr &inputSceneIndex,
+            const pxr::UsdImagingStageSceneIndexRefPtr &stageSceneIndex,
+            const pxr::UsdStageRefPtr &stage);
+
+        /**
+         * @brief Destroy the Time Cache Scene Index object, and stop the
+         * prefetch worker
+         *
+         */
+        ~TimeCacheSceneIndex();
+
+        /**
+         * @brief Set the time of the stage scene index. The prefetch window
+         * moves to the new time.
+         *
+         * @param time the new time
+         */
+        void SetTime(pxr::UsdTimeCode time);
+
+        /**
+         * @brief Get the time of the stage scene index
+         *
+         * @return the current time
+         */
+        pxr::UsdTimeCode GetTime() const;
+
+        /**
+         * @brief Enable or disable the prefetch worker. Disabling it waits
+         * for the frame being prefetched, so that the stage can be edited
+         * right after.
+         *
+         * @param enable true to enable the prefetch
+         */
+        void SetPrefetchEnabled(bool enable);
+
+        /**
+         * @brief Check if the prefetch worker is enabled
+         *
+         * @return true if the prefetch is enabled
+         * @return false otherwise
+         */
+        bool IsPrefetchEnabled() const;
+
+        /**
+         * @brief Set the maximum number of frames kept in the cache
+         *
+         * @param frameCount the number of frames following the current time
+         * to prefetch
+         */
+        void SetCacheSize(size_t frameCount);
+
+        /**
+         * @brief Get the maximum number of frames kept in the cache
+         *
+         * @return the number of frames
+         */
+        size_t GetCacheSize() const;
+
+        /**
+         * @brief Get the number of frames currently in the cache
+         *
+         * @return the number of cached frames
+         */
+        size_t GetCachedFrameCount() const;
+
+        /**
+         * @brief Check if the current time was served from the cache
+         *
+         * @return true if the current frame is in the cache
+         * @return false otherwise
+         */
+        bool IsCurrentFrameCached() const;
+
+        /**
+         * @brief Override of
+         * HdSingleInputFilteringSceneIndexBase::GetPrim
+         */
+        virtual pxr::HdSceneIndexPrim GetPrim(
+            const pxr::SdfPath &primPath) const override;
+
+        /**
+         * @brief Override of
+         * HdSingleInputFilteringSceneIndexBase::GetChildPrimPaths
+         */
+        virtual pxr::SdfPathVector GetChildPrimPaths(
+            const pxr::SdfPath &primPath) const override;
+
+    protected:
+        /**
+         * @brief Override of
+         * HdSingleInputFilteringSceneIndexBase::_PrimsAdded
+         */
+        virtual void _PrimsAdded(
+            const pxr::HdSceneIndexBase &sender,
+            const pxr::HdSceneIndexObserver::AddedPrimEntries &entries)
+            override;
+
+        /**
+         * @brief Override of
+         * HdSingleInputFilteringSceneIndexBase::_PrimsRemoved
+         */
+        virtual void _PrimsRemoved(
+            const pxr::HdSceneIndexBase &sender,
+            const pxr::HdSceneIndexObserver::RemovedPrimEntries &entries)
+            override;
+
+        /**
+         * @brief Override of
+         * HdSingleInputFilteringSceneIndexBase::_PrimsDirtied
+         */
+        virtual void _PrimsDirtied(
+            const pxr::HdSceneIndexBase &sender,
+            const pxr::HdSceneIndexObserver::DirtiedPrimEntries &entries)
+            override;
+
+    private:
+        /**
+         * @brief The time-varying attributes of a prim
+         *
+         */
+        struct _TrackedPrim {
+                pxr::UsdPrim prim;
+                bool isXformVarying;
+                std::vector<std::pair<pxr::TfToken, pxr::UsdAttribute>>
+                    primvars;
+        };
+
+        /**
+         * @brief The time-varying values of a prim at a given time
+         *
+         */
+        struct _PrimSample {
+                bool hasXform = false;
+                pxr::GfMatrix4d xform;
+                std::vector<std::pair<pxr::TfToken, pxr::VtValue>> primvars;
+        };
+
+        using _Frame =
+            std::unordered_map<pxr::SdfPath, _PrimSample, pxr::SdfPath::Hash>;
+        using _FrameConstPtr = std::shared_ptr<const _Frame>;
+
+        pxr::UsdImagingStageSceneIndexRefPtr _stageSceneIndex;
+        pxr::UsdStageRefPtr _stage;
+        pxr::UsdTimeCode _time;
+        bool _isSettingTime;
+
+        // only read by GetPrim, and only changed with the time, so it is not
+        // guarded by the mutex
+        _FrameConstPtr _currentFrame;
+
+        // shared with the prefetch worker
+        mutable std::mutex _mutex;
+        std::condition_variable _condition;
+        std::thread _worker;
+        bool _isStopped, _isPrefetchEnabled, _isPrefetching, _isTracked;
+        pxr::UsdTimeCode _prefetchTime;
+        size_t _cacheSize, _generation;
+        std::map<double, _FrameConstPtr> _frames;
+
+        // only touched by the prefetch worker
+        std::vector<_TrackedPrim> _trackedPrims;
+
+        /**
+         * @brief Main loop of the prefetch worker
+         *
+         */
+        void _Run();
+
+        /**
+         * @brief Get the next frame of the prefetch window that is not in the
+         * cache. The mutex must be locked.
+         *
+         * @param time the time of the frame to prefetch
+         * @return true if a frame must be prefetched
+         * @return false if the window is complete
+         */
+        bool _FindNextFrame(double &time) const;
+
+        /**
+         * @brief Drop the frames that are not in the prefetch window anymore.
+         * The mutex must be locked.
+         *
+         */
+        void _EvictFrames();
+
+        /**
+         * @brief Get the offset of the given frame from the start of the
+         * prefetch window, wrapping around the time range of the stage
+         *
+         * @param time the time of the frame
+         * @return the offset of the frame, negative if it is before the
+         * window
+         */
+        double _GetWindowOffset(double time) const;
+
+        /**
+         * @brief Find the time-varying prims of the stage
+         *
+         */
+        void _TrackTimeVaryingPrims();
+
+        /**
+         * @brief Read the time-varying values of the tracked prims
+         *
+         * @param time the time to read the values at
+         * @return the values of the frame
+         */
+        _FrameConstPtr _ComputeFrame(double time);
+
+        /**
+         * @brief Flush the cache after a change of the stage
+         *
+         */
+        void _Invalidate();
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -7,6 +7,18 @@
 #include <imgui.h>
 #include <pxr/base/gf/matrix4d.h>
 #include <pxr/base/gf/matrix4f.h>
+#include <pxr/base/gf/vec2d.h>
+#include <pxr/base/gf/vec2f.h>
+#include <pxr/base/gf/vec2i.h>
+#include <pxr/base/gf/vec3d.h>
+#include <pxr/base/gf/vec3f.h>
+#include <pxr/base/gf/vec3i.h>
+#include <pxr/base/gf/vec4d.h>
+#include <pxr/base/gf/vec4f.h>
+#include <pxr/base/gf/vec4i.h>
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/base/trace/trace.h>
+#include <pxr/base/vt/array.h>
 #include <pxr/base/vt/value.h>
 #include <pxr/imaging/hd/overlayContainerDataSource.h>
 #include <pxr/imaging/hd/primvarSchema.h>
@@ -16,16 +28,104 @@
 #include <pxr/usd/usdGeom/camera.h>
 #include <pxr/usd/usdGeom/gprim.h>
 
+#include <algorithm>
 #include <sstream>
+#include <type_traits>
 
 PXR_NAMESPACE_OPEN_SCOPE
 
-Editor::Editor(Model* model, const string label) : View(model, label)
+namespace {
+// number of array elements formatted at once
+const size_t ARRAY_PAGE_SIZE = 256;
+
+// number of array elements visible without scrolling
+const size_t ARRAY_VISIBLE_ROWS = 10;
+
+/**
+ * @brief Format the given range of elements if the value holds an array of T
+ *
+ * @return true if the value holds an array of T
+ */
+template <typename T>
+bool FormatArrayElements(const VtValue& value, size_t first, size_t count,
+                         vector<string>& texts)
+{
+    if (!value.IsHolding<VtArray<T>>()) return false;
+
+    const VtArray<T>& array = value.UncheckedGet<VtArray<T>>();
+    size_t last = std::min(first + count, array.size());
+    for (size_t i = first; i < last; i++)
+        texts.push_back(TfStringify(array[i]));
+    return true;
+}
+
+template <typename... Ts>
+bool FormatArrayElementsOf(const VtValue& value, size_t first, size_t count,
+                           vector<string>& texts)
+{
+    return (FormatArrayElements<Ts>(value, first, count, texts) || ...);
+}
+
+/**
+ * @brief Summarize the elements if the value holds an array of T: the range
+ * and the mean of scalars, or the range of each component of vectors
+ *
+ * @return true if the value holds an array of T
+ */
+template <typename T>
+bool SummarizeArray(const VtValue& value, string& summary)
+{
+    if (!value.IsHolding<VtArray<T>>()) return false;
+
+    const VtArray<T>& array = value.UncheckedGet<VtArray<T>>();
+    if (array.empty()) return true;
+
+    T min = array[0], max = array[0];
+    if constexpr (std::is_arithmetic_v<T>) {
+        double sum = 0;
+        for (const T& element : array) {
+            min = std::min(min, element);
+            max = std::max(max, element);
+            sum += double(element);
+        }
+        summary = TfStringPrintf(
+            "min %s, max %s, mean %g", TfStringify(min).c_str(),
+            TfStringify(max).c_str(), sum / double(array.size()));
+    }
+    else {
+        for (const T& element : array) {
+            for (size_t c = 0; c < T::dimension; c++) {
+                min[c] = std::min(min[c], element[c]);
+                max[c] = std::max(max[c], element[c]);
+            }
+        }
+        summary = TfStringPrintf("min %s, max %s", TfStringify(min).c_str(),
+                                 TfStringify(max).c_str());
+    }
+    return true;
+}
+
+template <typename... Ts>
+bool SummarizeArrayOf(const VtValue& value, string& summary)
 {
-    auto editableSceneIndex = GetModel()->GetEditableSceneIndex();
-    _colorFilterSceneIndex =
-        ColorFilterSceneIndex::New(editableSceneIndex);
-    GetModel()->SetEditableSceneIndex(_colorFilterSceneIndex);
+    return (SummarizeArray<Ts>(value, summary) || ...);
+}
+}  // namespace
+
+Editor::Editor(Model* model, const string label)
+    : View(model, label), _sceneIndexObserver(this), _isInspectorValid(false)
+{
+    // the observers are notified while the scene is locked
+    lock_guard<recursive_mutex> lock(GetModel()->GetSceneMutex());
+    _sceneIndex = GetModel()->GetFinalSceneIndex();
+    _sceneIndex->AddObserver(HdSceneIndexObserverPtr(&_sceneIndexObserver));
+}
+
+Editor::~Editor()
+{
+    lock_guard<recursive_mutex> lock(GetModel()->GetSceneMutex());
+    _sceneIndex->RemoveObserver(
+        HdSceneIndexObserverPtr(&_sceneIndexObserver));
 }
 
 const string Editor::GetViewType()
@@ -45,7 +145,7 @@ void Editor::_Draw()
 
 SdfPath Editor::_GetPrimToDisplay()
 {
-    SdfPathVector primPaths = GetModel()->GetSelection();
+    const SdfPathVector& primPaths = GetModel()->GetSelection();
 
     if (primPaths.size() > 0 && !primPaths[0].IsEmpty())
         _prevSelection = primPaths[0];
@@ -55,7 +155,9 @@ SdfPath Editor::_GetPrimToDisplay()
 
 void Editor::_AppendDisplayColorAttr(SdfPath primPath)
 {
-    GfVec3f color = _colorFilterSceneIndex->GetDisplayColor(primPath);
+    EditOverlaySceneIndexRefPtr overlay =
+        GetModel()->GetEditOverlaySceneIndex();
+    GfVec3f color = overlay->GetDisplayColor(primPath);
 
     if (color == GfVec3f(-1.f)) return;
 
@@ -67,58 +169,267 @@ void Editor::_AppendDisplayColorAttr(SdfPath primPath)
         ImGui::SliderFloat3("", data, 0, 1);
 
     // add opinion only if values change
-    if (color != prevColor)
-        _colorFilterSceneIndex->SetDisplayColor(primPath, color);
+    if (color != prevColor) {
+        lock_guard<recursive_mutex> lock(GetModel()->GetSceneMutex());
+        overlay->SetDisplayColor(primPath, color);
+    }
 }
 
-void Editor::_AppendDataSourceAttrs(
-    HdContainerDataSourceHandle containerDataSource)
+void Editor::_UpdateInspector(SdfPath primPath)
 {
-    for (auto&& token : containerDataSource->GetNames()) {
-        auto dataSource = containerDataSource->Get(token);
-        const char* tokenText = token.GetText();
+    if (primPath != _inspectedPrimPath) _isInspectorValid = false;
+
+    if (_isInspectorValid && _dirtyLocators.IsEmpty()) return;
+
+    TRACE_FUNCTION();
+
+    HdSceneIndexPrim prim = _sceneIndex->GetPrim(primPath);
+
+    // a new prim is read from scratch, while a dirtied one keeps the cache
+    // of its clean data sources
+    if (!_isInspectorValid) {
+        _inspectorRoot = _InspectorNode();
+        _inspectorRoot.dataSource = prim.dataSource;
+        _inspectedPrimPath = primPath;
+        _isInspectorValid = true;
+    }
+    else {
+        _RefreshNode(_inspectorRoot, prim.dataSource, _dirtyLocators);
+    }
+    _dirtyLocators = HdDataSourceLocatorSet();
+}
+
+void Editor::_RefreshNode(_InspectorNode& node,
+                          HdDataSourceBaseHandle dataSource,
+                          const HdDataSourceLocatorSet& locators)
+{
+    node.dataSource = dataSource;
+    node.isValueValid = false;
+    node.isPageValid = false;
+    node.value = VtValue();
+
+    if (node.isChildrenValid) _LoadChildren(node, locators);
+}
+
+void Editor::_LoadChildren(_InspectorNode& node,
+                           const HdDataSourceLocatorSet& locators)
+{
+    vector<_InspectorNode> children;
+
+    auto container = HdContainerDataSource::Cast(node.dataSource);
+    if (container) {
+        for (auto&& name : container->GetNames()) {
+            HdDataSourceLocator locator = node.locator.Append(name);
+            auto it = std::find_if(node.children.begin(), node.children.end(),
+                                   [&](const _InspectorNode& child) {
+                                       return child.name == name;
+                                   });
+
+            // the children that are not dirtied keep their cache
+            if (it != node.children.end()) {
+                _InspectorNode child = std::move(*it);
+                if (locators.Intersects(locator))
+                    _RefreshNode(child, container->Get(name), locators);
+                children.push_back(std::move(child));
+            }
+            else {
+                _InspectorNode child;
+                child.name = name;
+                child.locator = locator;
+                child.dataSource = container->Get(name);
+                children.push_back(std::move(child));
+            }
+        }
+    }
+
+    node.children = std::move(children);
+    node.isChildrenValid = true;
+}
+
+void Editor::_FormatValue(_InspectorNode& node)
+{
+    TRACE_FUNCTION();
+
+    node.isValueValid = true;
+    node.isPageValid = false;
+    node.arraySize = 0;
+    node.text.clear();
+
+    auto sampledDataSource = HdSampledDataSource::Cast(node.dataSource);
+    if (!sampledDataSource) return;
+
+    node.value = sampledDataSource->GetValue(0);
 
-        auto containerDataSource =
-            HdContainerDataSource::Cast(dataSource);
-        if (containerDataSource) {
+    if (!node.value.IsArrayValued()) {
+        std::stringstream ss;
+        ss << node.value;
+        node.text = ss.str();
+        return;
+    }
+
+    // the elements of the arrays are only formatted by pages
+    node.arraySize = node.value.GetArraySize();
+    if (node.arraySize > 0)
+        node.page = std::min(node.page, (node.arraySize - 1) / ARRAY_PAGE_SIZE);
+
+    string summary;
+    SummarizeArrayOf<int, unsigned int, float, double, GfVec2f, GfVec3f,
+                     GfVec4f, GfVec2d, GfVec3d, GfVec4d, GfVec2i, GfVec3i,
+                     GfVec4i>(node.value, summary);
+
+    node.text = TfStringPrintf("%s[%zu]", node.value.GetTypeName().c_str(),
+                               node.arraySize);
+    if (!summary.empty()) node.text += "  " + summary;
+}
+
+void Editor::_FormatPage(_InspectorNode& node)
+{
+    TRACE_FUNCTION();
+
+    node.isPageValid = true;
+    node.pageTexts.clear();
+
+    size_t first = node.page * ARRAY_PAGE_SIZE;
+    bool isFormatted =
+        FormatArrayElementsOf<int, unsigned int, float, double, bool, GfVec2f,
+                              GfVec3f, GfVec4f, GfVec2d, GfVec3d, GfVec4d,
+                              GfVec2i, GfVec3i, GfVec4i, GfMatrix4f,
+                              GfMatrix4d, TfToken, string, SdfPath>(
+            node.value, first, ARRAY_PAGE_SIZE, node.pageTexts);
+
+    if (!isFormatted) node.pageTexts.push_back("(elements not displayable)");
+}
+
+void Editor::_AppendDataSourceAttrs(_InspectorNode& node)
+{
+    if (!node.isChildrenValid) _LoadChildren(node, HdDataSourceLocatorSet());
+
+    for (auto&& child : node.children) {
+        const char* nameText = child.name.GetText();
+
+        if (HdContainerDataSource::Cast(child.dataSource)) {
+            // the children are only read once expanded
             bool clicked =
-                ImGui::TreeNodeEx(tokenText, ImGuiTreeNodeFlags_OpenOnArrow);
+                ImGui::TreeNodeEx(nameText, ImGuiTreeNodeFlags_OpenOnArrow);
 
             if (clicked) {
-                _AppendDataSourceAttrs(containerDataSource);
+                _AppendDataSourceAttrs(child);
                 ImGui::TreePop();
             }
         }
 
-        auto sampledDataSource = HdSampledDataSource::Cast(dataSource);
-        if (sampledDataSource) {
-            ImGui::Columns(2);
-            VtValue value = sampledDataSource->GetValue(0);
-            ImGui::Text("%s", tokenText);
-            ImGui::NextColumn();
-            ImGui::BeginChild(tokenText, ImVec2(0, 14), false);
-            std::stringstream ss;
-            ss << value;
-            ImGui::Text("%s", ss.str().c_str());
-            ImGui::EndChild();
-            ImGui::Columns();
-        }
+        if (HdSampledDataSource::Cast(child.dataSource))
+            _AppendValueAttr(child);
     }
 }
 
-void Editor::_AppendAllPrimAttrs(SdfPath primPath)
+void Editor::_AppendValueAttr(_InspectorNode& node)
 {
-    HdSceneIndexPrim prim = GetModel()->GetFinalSceneIndex()->GetPrim(primPath);
-    if (!prim.dataSource)
+    if (!node.isValueValid) _FormatValue(node);
+
+    const char* nameText = node.name.GetText();
+
+    ImGui::Columns(2);
+    ImGui::Text("%s", nameText);
+    ImGui::NextColumn();
+
+    if (node.arraySize == 0) {
+        ImGui::BeginChild(nameText, ImVec2(0, 14), false);
+        ImGui::TextUnformatted(node.text.c_str());
+        ImGui::EndChild();
+        ImGui::Columns();
         return;
-    
-    TfTokenVector tokens = prim.dataSource->GetNames();
+    }
+
+    bool isOpen = ImGui::TreeNodeEx(nameText, ImGuiTreeNodeFlags_OpenOnArrow,
+                                    "%s", node.text.c_str());
+    if (isOpen) {
+        size_t pageCount =
+            (node.arraySize + ARRAY_PAGE_SIZE - 1) / ARRAY_PAGE_SIZE;
+        size_t first = node.page * ARRAY_PAGE_SIZE;
+        size_t last = std::min(first + ARRAY_PAGE_SIZE, node.arraySize);
 
-    if (tokens.size() < 1) return;
+        if (pageCount > 1) {
+            if (ImGui::ArrowButton("##previous", ImGuiDir_Left) &&
+                node.page > 0) {
+                node.page--;
+                node.isPageValid = false;
+            }
+            ImGui::SameLine();
+            if (ImGui::ArrowButton("##next", ImGuiDir_Right) &&
+                node.page + 1 < pageCount) {
+                node.page++;
+                node.isPageValid = false;
+            }
+            ImGui::SameLine();
+        }
+        ImGui::Text("elements %zu-%zu of %zu", first, last - 1,
+                    node.arraySize);
+
+        if (!node.isPageValid) _FormatPage(node);
+
+        // only the visible rows of the page are drawn
+        float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+        size_t rows = std::min(node.pageTexts.size(), ARRAY_VISIBLE_ROWS);
+        ImGui::BeginChild("##elements", ImVec2(0, rowHeight * rows + 4),
+                          false);
+        ImGuiListClipper clipper;
+        clipper.Begin(int(node.pageTexts.size()));
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+                ImGui::Text("[%zu] %s", first + i,
+                            node.pageTexts[i].c_str());
+            }
+        }
+        ImGui::EndChild();
+        ImGui::TreePop();
+    }
+
+    ImGui::Columns();
+}
+
+void Editor::_AppendAllPrimAttrs(SdfPath primPath)
+{
+    _UpdateInspector(primPath);
+    if (!_inspectorRoot.dataSource) return;
 
     if (ImGui::CollapsingHeader("Hd Prim attributes")) {
-        _AppendDataSourceAttrs(prim.dataSource);
+        _AppendDataSourceAttrs(_inspectorRoot);
     }
 }
 
+void Editor::_SceneIndexObserver::PrimsAdded(const HdSceneIndexBase& sender,
+                                             const AddedPrimEntries& entries)
+{
+    // an added notice may replace the whole prim
+    for (auto&& entry : entries) {
+        if (entry.primPath == _editor->_inspectedPrimPath)
+            _editor->_isInspectorValid = false;
+    }
+}
+
+void Editor::_SceneIndexObserver::PrimsRemoved(
+    const HdSceneIndexBase& sender, const RemovedPrimEntries& entries)
+{
+    for (auto&& entry : entries) {
+        if (_editor->_inspectedPrimPath.HasPrefix(entry.primPath))
+            _editor->_isInspectorValid = false;
+    }
+}
+
+void Editor::_SceneIndexObserver::PrimsDirtied(
+    const HdSceneIndexBase& sender, const DirtiedPrimEntries& entries)
+{
+    for (auto&& entry : entries) {
+        if (entry.primPath == _editor->_inspectedPrimPath)
+            _editor->_dirtyLocators.insert(entry.dirtyLocators);
+    }
+}
+
+void Editor::_SceneIndexObserver::PrimsRenamed(
+    const HdSceneIndexBase& sender, const RenamedPrimEntries& entries)
+{
+    _editor->_isInspectorValid = false;
+}
+
 PXR_NAMESPACE_CLOSE_SCOPE
@@ -9,9 +9,15 @@
  */
 #pragma once
 
+#include <pxr/base/vt/value.h>
+#include <pxr/imaging/hd/dataSource.h>
+#include <pxr/imaging/hd/dataSourceLocator.h>
+#include <pxr/imaging/hd/sceneIndexObserver.h>
 #include <pxr/usd/usd/prim.h>
 
-#include "sceneindices/colorfiltersceneindex.h"
+#include <string>
+#include <vector>
+
 #include "view.h"
 
 PXR_NAMESPACE_OPEN_SCOPE
@@ -23,6 +29,10 @@ using namespace std;
  * @brief Editor view that acts as an attribute editor. It allows to tune
  * attributes from selected UsdPrim.
  *
+ * The data sources of the displayed prim are cached: the containers are only
+ * read once expanded, the values are only formatted once per dirty notice of
+ * their locator, and the arrays are summarized and shown by pages.
+ *
  */
 class Editor : public View {
     public:
@@ -34,7 +44,13 @@ class Editor : public View {
          * @param model the Model of the new Editor view
          * @param label the ImGui label of the new Editor view
          */
-        Editor(const string label = VIEW_TYPE);
+        Editor(Model* model, const string label = VIEW_TYPE);
+
+        /**
+         * @brief Destroy the Editor object
+         *
+         */
+        ~Editor();
 
         /**
          * @brief Override of the View::GetViewType
@@ -43,8 +59,61 @@ class Editor : public View {
         const string GetViewType() override;
 
     private:
+        /**
+         * @brief Scene Index Observer that invalidates the cached data
+         * sources of the displayed prim
+         *
+         */
+        class _SceneIndexObserver : public pxr::HdSceneIndexObserver {
+            public:
+                _SceneIndexObserver(Editor* editor) : _editor(editor) {}
+
+                void PrimsAdded(const pxr::HdSceneIndexBase& sender,
+                                const AddedPrimEntries& entries) override;
+                void PrimsRemoved(const pxr::HdSceneIndexBase& sender,
+                                  const RemovedPrimEntries& entries) override;
+                void PrimsDirtied(const pxr::HdSceneIndexBase& sender,
+                                  const DirtiedPrimEntries& entries) override;
+                void PrimsRenamed(const pxr::HdSceneIndexBase& sender,
+                                  const RenamedPrimEntries& entries) override;
+
+            private:
+                Editor* _editor;
+        };
+
+        /**
+         * @brief Cached state of a data source of the displayed prim
+         *
+         */
+        struct _InspectorNode {
+                pxr::TfToken name;
+                pxr::HdDataSourceLocator locator;
+                pxr::HdDataSourceBaseHandle dataSource;
+
+                // children of a container, read once it is expanded
+                bool isChildrenValid = false;
+                std::vector<_InspectorNode> children;
+
+                // value of a sampled data source, or summary of an array
+                bool isValueValid = false;
+                pxr::VtValue value;
+                std::string text;
+                size_t arraySize = 0;
+
+                // page of array elements currently formatted
+                size_t page = 0;
+                bool isPageValid = false;
+                std::vector<std::string> pageTexts;
+        };
+
         pxr::SdfPath _prevSelection;
-        pxr::ColorFilterSceneIndexRefPtr _colorFilterSceneIndex;
+
+        pxr::HdSceneIndexBaseRefPtr _sceneIndex;
+        _SceneIndexObserver _sceneIndexObserver;
+        pxr::SdfPath _inspectedPrimPath;
+        _InspectorNode _inspectorRoot;
+        bool _isInspectorValid;
+        pxr::HdDataSourceLocatorSet _dirtyLocators;
 
         /**
          * @brief Override of the View::Draw
@@ -69,12 +138,64 @@ class Editor : public View {
         void _AppendDisplayColorAttr(pxr::SdfPath primPath);
 
         /**
-         * @brief Append the data source content to the editor view
+         * @brief Update the cached data sources of the given prim, reading
+         * again only the dirtied ones
+         *
+         * @param primPath the path of the prim to inspect
+         */
+        void _UpdateInspector(pxr::SdfPath primPath);
+
+        /**
+         * @brief Refresh a cached data source and the cached children that
+         * intersect the dirtied locators
+         *
+         * @param node the cached data source
+         * @param dataSource the new data source
+         * @param locators the dirtied locators
+         */
+        void _RefreshNode(_InspectorNode& node,
+                          pxr::HdDataSourceBaseHandle dataSource,
+                          const pxr::HdDataSourceLocatorSet& locators);
+
+        /**
+         * @brief Read the children of a cached container, keeping the cache
+         * of the children that are not dirtied
+         *
+         * @param node the cached container
+         * @param locators the dirtied locators
+         */
+        void _LoadChildren(_InspectorNode& node,
+                           const pxr::HdDataSourceLocatorSet& locators);
+
+        /**
+         * @brief Format the value of a cached sampled data source, or the
+         * summary of its elements if it is an array
+         *
+         * @param node the cached sampled data source
+         */
+        void _FormatValue(_InspectorNode& node);
+
+        /**
+         * @brief Format the current page of elements of a cached array
+         *
+         * @param node the cached sampled data source holding an array
+         */
+        void _FormatPage(_InspectorNode& node);
+
+        /**
+         * @brief Append the children of a cached container to the editor
+         * view
+         *
+         * @param node the cached container to display
+         */
+        void _AppendDataSourceAttrs(_InspectorNode& node);
+
+        /**
+         * @brief Append a cached sampled data source to the editor view
          *
-         * @param containerDataSource the container data source to display
+         * @param node the cached sampled data source to display
          */
-        void _AppendDataSourceAttrs(
-            pxr::HdContainerDataSourceHandle containerDataSource);
+        void _AppendValueAttr(_InspectorNode& node);
 
         /**
          * @brief Append the display color attributes of the given prim
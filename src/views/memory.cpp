@@ -0,0 +1,171 @@
+#include "memory.h"
+
+#include <imgui.h>
+#include <pxr/base/tf/mallocTag.h>
+#include <pxr/base/tf/stringUtils.h>
+#include <pxr/usd/usd/stage.h>
+
+#include <algorithm>
+#include <cfloat>
+
+#include "memoryusage.h"
+#include "rendercontext.h"
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+namespace {
+// the malloc tags of the stage, by prefix of their name
+const vector<pair<string, string>> STAGE_TAGS = {
+    {"Sdf", "layers"}, {"Pcp", "composition"}, {"UsdImaging", "usd imaging"},
+    {"Usd", "prims"},  {"Hd", "hydra"}};
+
+/**
+ * @brief Format a memory size for the UI
+ *
+ * @param byteSize the size in bytes
+ * @return the size in MB
+ */
+string FormatByteSize(size_t byteSize)
+{
+    return TfStringPrintf("%.1f MB", byteSize / double(1 << 20));
+}
+}  // namespace
+
+Memory::Memory(Model* model, const string label)
+    : View(model, label), _residentMemory(0), _peakMemory(0), _layerCount(0)
+{
+    _memorySourceId = MemoryTracker::AddSource(
+        [this](vector<MemoryTracker::Entry>& entries) {
+            _AddMemoryEntries(entries);
+        });
+}
+
+Memory::~Memory()
+{
+    MemoryTracker::RemoveSource(_memorySourceId);
+}
+
+const string Memory::GetViewType()
+{
+    return VIEW_TYPE;
+};
+
+void Memory::_Draw()
+{
+    ImGui::Text("resident: %s (peak %s)",
+                FormatByteSize(_residentMemory).c_str(),
+                FormatByteSize(_peakMemory).c_str());
+    ImGui::Text("tracked: %s CPU, %s GPU",
+                FormatByteSize(MemoryTracker::GetCpuByteSize()).c_str(),
+                FormatByteSize(MemoryTracker::GetGpuByteSize()).c_str());
+    ImGui::Text("stage: %zu layers", _layerCount);
+
+    ImGui::Separator();
+    PayloadStreamer* streamer = GetModel()->GetPayloadStreamer();
+    _DrawBudget("payload streaming", streamer->GetMemoryUsage(),
+                streamer->GetMemoryBudget());
+    size_t idleMemory = 0;
+    for (auto&& entry : MemoryTracker::GetEntries()) {
+        if (entry.group == "renderers") idleMemory += entry.byteSize;
+    }
+    _DrawBudget("idle renderers", idleMemory,
+                RenderContext::GetIdleMemoryBudget());
+
+    ImGui::Separator();
+    if (!TfMallocTag::IsInitialized())
+        ImGui::TextDisabled("start with --malloc-tags for the stage memory");
+
+    ImGuiTableFlags tableFlags = ImGuiTableFlags_RowBg |
+                                 ImGuiTableFlags_BordersInnerV |
+                                 ImGuiTableFlags_ScrollY;
+    if (!ImGui::BeginTable("##memory", 3, tableFlags)) return;
+
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("name");
+    ImGui::TableSetupColumn("CPU");
+    ImGui::TableSetupColumn("GPU");
+    ImGui::TableHeadersRow();
+
+    string group;
+    for (auto&& entry : MemoryTracker::GetEntries()) {
+        if (entry.group != group) {
+            group = entry.group;
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(group.c_str());
+        }
+
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        // the details are already counted by another entry of the group
+        ImGui::Indent(ImGui::GetFontSize() * (entry.isDetail ? 2.f : 1.f));
+        ImGui::TextUnformatted(entry.name.c_str());
+        ImGui::Unindent(ImGui::GetFontSize() * (entry.isDetail ? 2.f : 1.f));
+        ImGui::TableSetColumnIndex(entry.isGpu ? 2 : 1);
+        if (entry.isDetail)
+            ImGui::TextDisabled("%s", FormatByteSize(entry.byteSize).c_str());
+        else ImGui::TextUnformatted(FormatByteSize(entry.byteSize).c_str());
+    }
+
+    ImGui::EndTable();
+}
+
+void Memory::_AddMemoryEntries(vector<MemoryTracker::Entry>& entries)
+{
+    // the process memory is sampled at the rate of the tracker too
+    _residentMemory = GetCurrentResidentMemory();
+    _peakMemory = GetPeakResidentMemory();
+
+    UsdStageRefPtr stage = GetModel()->GetStage();
+    _layerCount = stage ? stage->GetUsedLayers().size() : 0;
+
+    // the allocations are attributed to the innermost malloc tag, so the
+    // call sites are summed up without counting an allocation twice
+    TfMallocTag::CallTree tree;
+    if (TfMallocTag::IsInitialized() && TfMallocTag::GetCallTree(&tree)) {
+        vector<size_t> byteSizes(STAGE_TAGS.size(), 0);
+        for (auto&& site : tree.callSites) {
+            for (size_t i = 0; i < STAGE_TAGS.size(); i++) {
+                if (!TfStringStartsWith(site.name, STAGE_TAGS[i].first))
+                    continue;
+                byteSizes[i] += site.nBytes;
+                break;
+            }
+        }
+        for (size_t i = 0; i < STAGE_TAGS.size(); i++)
+            entries.push_back({"stage", STAGE_TAGS[i].second, byteSizes[i]});
+    }
+
+    EditOverlaySceneIndexRefPtr editOverlay =
+        GetModel()->GetEditOverlaySceneIndex();
+    if (editOverlay) {
+        entries.push_back({"scene indices",
+                           TfStringPrintf("edit overrides (%zu prims)",
+                                          editOverlay->GetOverrideCount()),
+                           editOverlay->GetByteSize()});
+    }
+
+    // the renderers that don't report their GPU memory are estimated from
+    // the resident memory
+    size_t idleGpuMemory = 0;
+    size_t idleMemory = RenderContext::GetIdleMemoryUsage(&idleGpuMemory);
+    string idleName = TfStringPrintf(
+        "idle (%zu)", RenderContext::GetIdleRendererPlugins().size());
+    entries.push_back({"renderers", idleName, idleGpuMemory, true});
+    if (idleMemory > idleGpuMemory) {
+        entries.push_back(
+            {"renderers", idleName, idleMemory - idleGpuMemory, false});
+    }
+}
+
+void Memory::_DrawBudget(const char* label, size_t usage, size_t budget)
+{
+    float fraction = budget > 0 ? float(double(usage) / budget) : 0.f;
+    string overlay = FormatByteSize(usage) + " / " + FormatByteSize(budget);
+
+    ImGui::TextUnformatted(label);
+    ImGui::ProgressBar(std::min(fraction, 1.f), ImVec2(-FLT_MIN, 0),
+                       overlay.c_str());
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
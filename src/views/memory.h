@@ -0,0 +1,84 @@
+/**
+ * @file memory.h
+ * @author Raphael Jouretz (rjouretz.com)
+ * @brief Memory view that reports the CPU and GPU memory of the subsystems
+ * (stage, scene indices, viewports, renderers) and the memory budgets.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <cstddef>
+
+#include "memorytracker.h"
+#include "view.h"
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+using namespace std;
+
+/**
+ * @class Memory
+ * @brief Memory view that reports the CPU and GPU memory of the subsystems
+ * (stage, scene indices, viewports, renderers) and the memory budgets.
+ *
+ * The view only draws the last poll of the MemoryTracker, and adds the
+ * entries of the Model to it. The memory of the stage and its layers is
+ * only known when the malloc tags are enabled (--malloc-tags option).
+ *
+ */
+class Memory : public View {
+    public:
+        inline static const string VIEW_TYPE = "Memory";
+
+        /**
+         * @brief Construct a new Memory object
+         *
+         * @param model the Model of the new Memory view
+         * @param label the ImGui label of the new Memory view
+         */
+        Memory(Model* model, const string label = VIEW_TYPE);
+
+        /**
+         * @brief Destroy the Memory object
+         *
+         */
+        ~Memory();
+
+        /**
+         * @brief Override of the View::GetViewType
+         *
+         */
+        const string GetViewType() override;
+
+    private:
+        int _memorySourceId;
+        size_t _residentMemory, _peakMemory;
+        size_t _layerCount;
+
+        /**
+         * @brief Override of the View::_Draw
+         *
+         */
+        void _Draw() override;
+
+        /**
+         * @brief Append the memory of the stage, the scene indices and the
+         * idle renderers to the MemoryTracker entries
+         *
+         * @param entries the entries of the MemoryTracker
+         */
+        void _AddMemoryEntries(vector<MemoryTracker::Entry>& entries);
+
+        /**
+         * @brief Draw a memory budget with its usage
+         *
+         * @param label the label of the budget
+         * @param usage the memory compared to the budget, in bytes
+         * @param budget the budget in bytes
+         */
+        void _DrawBudget(const char* label, size_t usage, size_t budget);
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -4,7 +4,24 @@
 
 PXR_NAMESPACE_OPEN_SCOPE
 
-Outliner::Outliner(Model* model, const string label) : View(model, label) {}
+Outliner::Outliner(Model* model, const string label)
+    : View(model, label),
+      _sceneIndex(GetModel()->GetFinalSceneIndex()),
+      _sceneIndexObserver(this),
+      _isRowsDirty(true),
+      _selectionGeneration(-1)
+{
+    // the observers are notified while the scene is locked
+    lock_guard<recursive_mutex> lock(GetModel()->GetSceneMutex());
+    _sceneIndex->AddObserver(HdSceneIndexObserverPtr(&_sceneIndexObserver));
+}
+
+Outliner::~Outliner()
+{
+    lock_guard<recursive_mutex> lock(GetModel()->GetSceneMutex());
+    _sceneIndex->RemoveObserver(
+        HdSceneIndexObserverPtr(&_sceneIndexObserver));
+}
 
 const string Outliner::GetViewType()
 {
@@ -13,132 +30,226 @@ const string Outliner::GetViewType()
 
 void Outliner::_Draw()
 {
-    SdfPath root = SdfPath::AbsoluteRootPath();
-    SdfPathVector paths = _sceneIndex->GetChildPrimPaths(root);
-    for (auto primPath : paths) _DrawPrimHierarchy(primPath);
+    if (_isRowsDirty) _RebuildRows();
+    _UpdateSelection();
+
+    float startPosX = ImGui::GetCursorPosX();
+    float indentSpacing = ImGui::GetStyle().IndentSpacing;
+
+    // only draw the rows that are on screen
+    size_t toggledRowIndex = _rows.size();
+    ImGuiListClipper clipper;
+    clipper.Begin(int(_rows.size()));
+    while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+            _Row& row = _rows[i];
+
+            ImGui::SetCursorPosX(startPosX + row.depth * indentSpacing);
+            if (_DrawHierarchyNode(row)) toggledRowIndex = i;
+            else if (ImGui::IsItemClicked())
+                GetModel()->SetSelection({row.path});
+
+            const ImRect rowRect =
+                ImRect(ImGui::GetItemRectMin(), ImGui::GetItemRectMax());
+            _DrawHierarchyDecoration(row, rowRect);
+            _DrawPayloadContextMenu(row);
+        }
+    }
+    clipper.End();
+
+    // the rows can't change while the clipper iterates over them
+    if (toggledRowIndex < _rows.size()) _ToggleRow(toggledRowIndex);
 }
 
-// returns the node's rectangle
-ImRect Outliner::_DrawPrimHierarchy(SdfPath primPath)
+void Outliner::_RebuildRows()
 {
-    bool recurse = _DrawHierarchyNode(primPath);
+    _rows.clear();
+    _AppendChildRows(_rows, SdfPath::AbsoluteRootPath(), 0, 0);
+    _isRowsDirty = false;
+}
 
-    if (ImGui::IsItemClicked() && !ImGui::IsItemToggledOpen()) {
-        GetModel()->SetSelection({primPath});
+void Outliner::_AppendChildRows(vector<_Row>& rows, SdfPath primPath,
+                                int depth, uint64_t nextSiblingMask)
+{
+    SdfPathVector childPaths = _sceneIndex->GetChildPrimPaths(primPath);
+    for (size_t i = 0; i < childPaths.size(); i++) {
+        uint64_t mask = nextSiblingMask;
+        if (i + 1 < childPaths.size() && depth < _MAX_DECORATION_DEPTH)
+            mask |= uint64_t(1) << depth;
+
+        rows.push_back({childPaths[i], depth, -1, mask});
+
+        if (_expandedPaths.count(childPaths[i]) > 0) {
+            size_t rowIndex = rows.size() - 1;
+            _AppendChildRows(rows, childPaths[i], depth + 1, mask);
+            rows[rowIndex].hasChildren = rows.size() > rowIndex + 1;
+        }
     }
+}
 
-    const ImRect curItemRect =
-        ImRect(ImGui::GetItemRectMin(), ImGui::GetItemRectMax());
-
-    if (recurse) {
-        // draw all children and store their rect position
-        vector<ImRect> rects;
-        SdfPathVector primPaths =
-            _sceneIndex->GetChildPrimPaths(primPath);
-
-        for (auto child : primPaths) {
-            ImRect childRect = _DrawPrimHierarchy(child.GetPrimPath());
-            rects.push_back(childRect);
-        }
+void Outliner::_ToggleRow(size_t rowIndex)
+{
+    const _Row row = _rows[rowIndex];
+    auto first = _rows.begin() + rowIndex + 1;
+
+    if (_expandedPaths.erase(row.path) > 0) {
+        // the descendant rows are the next rows deeper than the row
+        auto last = first;
+        while (last != _rows.end() && last->depth > row.depth) ++last;
+        _rows.erase(first, last);
+    }
+    else {
+        _expandedPaths.insert(row.path);
+        vector<_Row> childRows;
+        _AppendChildRows(childRows, row.path, row.depth + 1,
+                         row.nextSiblingMask);
+        _rows.insert(first, childRows.begin(), childRows.end());
+    }
+}
 
-        if (rects.size() > 0) {
-            // draw hierarchy decoration for all children
-            _DrawChildrendHierarchyDecoration(curItemRect, rects);
+void Outliner::_UpdateSelection()
+{
+    // the selection is only walked again when it changed
+    int generation = GetModel()->GetSelectionGeneration();
+    if (generation == _selectionGeneration) return;
+
+    _selectionGeneration = generation;
+    _selectedPaths.clear();
+    _selectionAncestorPaths.clear();
+
+    for (auto&& path : GetModel()->GetSelection()) {
+        _selectedPaths.insert(path);
+
+        // a selected prim is highlighted as a parent of the selection too
+        for (SdfPath p = path; !p.IsEmpty() && !p.IsAbsoluteRootPath();
+             p = p.GetParentPath()) {
+            // the remaining ancestors were inserted by a previous path
+            if (!_selectionAncestorPaths.insert(p).second) break;
         }
-
-        ImGui::TreePop();
     }
-
-    return curItemRect;
 }
 
-ImGuiTreeNodeFlags Outliner::_ComputeDisplayFlags(SdfPath primPath)
+ImGuiTreeNodeFlags Outliner::_ComputeDisplayFlags(_Row& row)
 {
-    ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_None;
+    ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_NoTreePushOnOpen;
 
-    // set the flag if leaf or not
-    SdfPathVector primPaths = _sceneIndex->GetChildPrimPaths(primPath);
+    // set the flag if leaf or not, only querying the children once
+    if (row.hasChildren < 0)
+        row.hasChildren = !_sceneIndex->GetChildPrimPaths(row.path).empty();
 
-    if (primPaths.size() == 0) {
+    if (!row.hasChildren) {
         flags |= ImGuiTreeNodeFlags_Leaf;
         flags |= ImGuiTreeNodeFlags_Bullet;
     }
-    else flags = ImGuiTreeNodeFlags_OpenOnArrow;
+    else flags |= ImGuiTreeNodeFlags_OpenOnArrow;
 
     // if selected prim, set highlight flag
-    bool isSelected = _IsInModelSelection(primPath);
+    bool isSelected = _selectedPaths.count(row.path) > 0;
     if (isSelected) flags |= ImGuiTreeNodeFlags_Selected;
 
     return flags;
 }
 
-bool Outliner::_DrawHierarchyNode(SdfPath primPath)
+bool Outliner::_DrawHierarchyNode(_Row& row)
 {
-    bool recurse = false;
-    const char* primName = primPath.GetName().c_str();
-    ImGuiTreeNodeFlags flags = _ComputeDisplayFlags(primPath);
+    const char* primName = row.path.GetName().c_str();
+    ImGuiTreeNodeFlags flags = _ComputeDisplayFlags(row);
+
+    ImGui::SetNextItemOpen(_expandedPaths.count(row.path) > 0);
 
     // print node in blue if parent of selection
-    if (_IsParentOfModelSelection(primPath)) {
+    if (_selectionAncestorPaths.count(row.path) > 0) {
         ImU32 color = ImGui::GetColorU32(ImGuiCol_HeaderActive, 1.f);
         ImGui::PushStyleColor(ImGuiCol_Text, color);
-        recurse = ImGui::TreeNodeEx(primName, flags);
+        ImGui::TreeNodeEx(row.path.GetText(), flags, "%s", primName);
         ImGui::PopStyleColor();
     }
     else {
-        recurse = ImGui::TreeNodeEx(primName, flags);
+        ImGui::TreeNodeEx(row.path.GetText(), flags, "%s", primName);
     }
-    return recurse;
+    return ImGui::IsItemToggledOpen();
 }
 
-bool Outliner::IsParentOf(SdfPath primPath, SdfPath childPrimPath)
+void Outliner::_DrawPayloadContextMenu(const _Row& row)
 {
-    return primPath.GetCommonPrefix(childPrimPath) == primPath;
+    PayloadStreamer* streamer = GetModel()->GetPayloadStreamer();
+    if (!streamer->HasPayload(row.path)) return;
+    if (!ImGui::BeginPopupContextItem(row.path.GetText())) return;
+
+    PayloadStreamer::Mode mode = streamer->GetMode(row.path);
+    if (ImGui::MenuItem("Load payload", NULL,
+                        mode == PayloadStreamer::ModeForceLoaded))
+        streamer->SetMode(row.path, PayloadStreamer::ModeForceLoaded);
+    if (ImGui::MenuItem("Unload payload", NULL,
+                        mode == PayloadStreamer::ModeForceUnloaded))
+        streamer->SetMode(row.path, PayloadStreamer::ModeForceUnloaded);
+    if (ImGui::MenuItem("Stream payload", NULL,
+                        mode == PayloadStreamer::ModeAutomatic))
+        streamer->SetMode(row.path, PayloadStreamer::ModeAutomatic);
+
+    ImGui::EndPopup();
 }
 
-bool Outliner::_IsParentOfModelSelection(SdfPath primPath)
+void Outliner::_DrawHierarchyDecoration(const _Row& row, ImRect rowRect)
 {
-    // check if primPath is parent of selection
-    for (auto&& p : GetModel()->GetSelection())
-        if (IsParentOf(primPath, p)) return true;
+    if (row.depth == 0 || row.depth >= _MAX_DECORATION_DEPTH) return;
+
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    const ImColor lineColor = ImGui::GetColorU32(ImGuiCol_Text, 0.25f);
+    const float indentSpacing = ImGui::GetStyle().IndentSpacing;
+    const float lineSize = 8.0f;  // hard coded
+
+    // extend the vertical lines over the spacing above the row so that they
+    // connect with the previous row
+    const float top = rowRect.Min.y - ImGui::GetStyle().ItemSpacing.y;
+    const float midpoint = (rowRect.Min.y + rowRect.Max.y) / 2.0f;
+    const int depth = row.depth;
+
+    // the decoration of a depth starts 10 pixels after the parent node
+    auto getLinePosX = [&](int d) {
+        return rowRect.Min.x - (row.depth - d) * indentSpacing +
+               10.0f;  // hard coded
+    };
+
+    // vertical lines of the ancestors that have a next sibling
+    for (int d = 0; d < depth - 1; d++) {
+        if (!(row.nextSiblingMask & (uint64_t(1) << (d + 1)))) continue;
+        float x = getLinePosX(d);
+        drawList->AddLine(ImVec2(x, top), ImVec2(x, rowRect.Max.y), lineColor);
+    }
 
-    return false;
+    // connection from the parent to the row, continued to the next sibling
+    float x = getLinePosX(depth - 1);
+    bool hasNextSibling = row.nextSiblingMask & (uint64_t(1) << depth);
+    drawList->AddLine(ImVec2(x, top),
+                      ImVec2(x, hasNextSibling ? rowRect.Max.y : midpoint),
+                      lineColor);
+    drawList->AddLine(ImVec2(x, midpoint), ImVec2(x + lineSize, midpoint),
+                      lineColor);
 }
 
-bool Outliner::_IsInModelSelection(SdfPath primPath)
+void Outliner::_SceneIndexObserver::PrimsAdded(
+    const HdSceneIndexBase& sender, const AddedPrimEntries& entries)
 {
-    SdfPathVector sel = GetModel()->GetSelection();
-    // check if primPath in model selection
-    return find(sel.begin(), sel.end(), primPath) != sel.end();
+    _outliner->_isRowsDirty = true;
 }
 
-void Outliner::_DrawChildrendHierarchyDecoration(ImRect parentRect,
-                                                 vector<ImRect> childrenRects)
+void Outliner::_SceneIndexObserver::PrimsRemoved(
+    const HdSceneIndexBase& sender, const RemovedPrimEntries& entries)
 {
-    ImDrawList* drawList = ImGui::GetWindowDrawList();
-    const ImColor lineColor = ImGui::GetColorU32(ImGuiCol_Text, 0.25f);
-
-    // all decoration for children will start at horizStartPos
-    float horizStartPos = parentRect.Min.x + 10.0f;  // hard coded
-
-    // save the lineStart of the last children to draw the vertical
-    // line from the parent to the last child
-    ImVec2 lineStart;
-
-    // loop over all children and draw every horizontal line
-    for (auto rect : childrenRects) {
-        const float midpoint = (rect.Min.y + rect.Max.y) / 2.0f;
-        const float lineSize = 8.0f;  // hard coded
-
-        lineStart = ImVec2(horizStartPos, midpoint);
-        ImVec2 lineEnd = lineStart + ImVec2(lineSize, 0);
+    _outliner->_isRowsDirty = true;
+}
 
-        drawList->AddLine(lineStart, lineEnd, lineColor);
-    }
+void Outliner::_SceneIndexObserver::PrimsDirtied(
+    const HdSceneIndexBase& sender, const DirtiedPrimEntries& entries)
+{
+    // dirtied prims don't change the hierarchy
+}
 
-    // draw the vertical line from the parent to the last child
-    ImVec2 lineEnd = ImVec2(horizStartPos, parentRect.Max.y + 2.0f);
-    drawList->AddLine(lineStart, lineEnd, lineColor);
+void Outliner::_SceneIndexObserver::PrimsRenamed(
+    const HdSceneIndexBase& sender, const RenamedPrimEntries& entries)
+{
+    _outliner->_isRowsDirty = true;
 }
 
 PXR_NAMESPACE_CLOSE_SCOPE
@@ -14,8 +14,13 @@
 #endif
 #include <imgui.h>
 #include <imgui_internal.h>
+#include <pxr/imaging/hd/sceneIndexObserver.h>
 #include <pxr/usd/usd/prim.h>
 
+#include <atomic>
+#include <cstdint>
+#include <unordered_set>
+
 #include "view.h"
 
 PXR_NAMESPACE_OPEN_SCOPE
@@ -26,6 +31,11 @@ using namespace std;
  * @brief Outliner view that acts as an outliner. it allows to preview and
  * navigate into the UsdStage hierarchy.
  *
+ * The hierarchy is flattened into a list of rows, one per visible node, that
+ * is only rebuilt when the hierarchy of the Scene Index changes. Only the
+ * rows on screen are drawn, and the children of a node are only queried when
+ * the node is expanded.
+ *
  */
 class Outliner : public View {
     public:
@@ -37,7 +47,13 @@ class Outliner : public View {
          * @param model the Model of the new Outliner view
          * @param label the ImGui label of the new Outliner view
          */
-        Outliner(const string label = VIEW_TYPE);
+        Outliner(Model* model, const string label = VIEW_TYPE);
+
+        /**
+         * @brief Destroy the Outliner object
+         *
+         */
+        ~Outliner();
 
         /**
          * @brief Override of the View::GetViewType
@@ -46,6 +62,60 @@ class Outliner : public View {
         const string GetViewType() override;
 
     private:
+        /**
+         * @brief Scene Index Observer that invalidates the rows when the
+         * hierarchy changes
+         *
+         */
+        class _SceneIndexObserver : public HdSceneIndexObserver {
+            public:
+                _SceneIndexObserver(Outliner* outliner) : _outliner(outliner)
+                {
+                }
+
+                void PrimsAdded(const HdSceneIndexBase& sender,
+                                const AddedPrimEntries& entries) override;
+                void PrimsRemoved(const HdSceneIndexBase& sender,
+                                  const RemovedPrimEntries& entries) override;
+                void PrimsDirtied(const HdSceneIndexBase& sender,
+                                  const DirtiedPrimEntries& entries) override;
+                void PrimsRenamed(const HdSceneIndexBase& sender,
+                                  const RenamedPrimEntries& entries) override;
+
+            private:
+                Outliner* _outliner;
+        };
+
+        /**
+         * @brief A visible node of the hierarchy
+         *
+         */
+        struct _Row {
+                SdfPath path;
+                int depth;
+                // -1 until the row is drawn for the first time
+                int hasChildren;
+                // bit i is set if the ancestor at depth i (the row itself at
+                // bit 'depth') has a next sibling, for the decoration lines
+                uint64_t nextSiblingMask;
+        };
+
+        // the decoration lines are not drawn deeper than this depth
+        static const int _MAX_DECORATION_DEPTH = 64;
+
+        using _PathSet = unordered_set<SdfPath, SdfPath::Hash>;
+
+        HdSceneIndexBaseRefPtr _sceneIndex;
+        _SceneIndexObserver _sceneIndexObserver;
+
+        vector<_Row> _rows;
+        // set by the notices, which may come from the render thread
+        atomic<bool> _isRowsDirty;
+        _PathSet _expandedPaths;
+
+        int _selectionGeneration;
+        _PathSet _selectedPaths, _selectionAncestorPaths;
+
         /**
          * @brief Override of the View::Draw
          *
@@ -53,86 +123,79 @@ class Outliner : public View {
         void _Draw() override;
 
         /**
-         * @brief Draw the hierarchy of all the descendant UsdPrims of the
-         * given UsdPrim in the outliner
+         * @brief Rebuild all the rows from the expanded nodes
          *
-         * @param primPath the SdfPath of the prim for which all the descendant
-         * hierarchy will be drawn in the outliner
-         * @return the ImRect rectangle of the tree node corresponding to the
-         * given 'primPath'
          */
-        ImRect _DrawPrimHierarchy(pxr::SdfPath primPath);
+        void _RebuildRows();
 
         /**
-         * @brief Compute the display flags of the given UsdPrim
+         * @brief Append the rows of the children of the given node, and of
+         * their expanded descendants
          *
-         * @param primPath the SdfPath of the prim to compute the dislay flags
-         * from
-         * @return an ImGuiTreeNodeFlags object.
-         * Default is ImGuiTreeNodeFlags_None.
-         * If 'primPath' has no children, flag contains ImGuiTreeNodeFlags_Leaf
-         * If 'primPath' has children, flags contains
-         * ImGuiTreeNodeFlags_OpenOnArrow
-         * if 'primPath' is part of selection, flags
-         * contains ImGuiTreeNodeFlags_Selected
+         * @param rows the rows to append to
+         * @param primPath the SdfPath of the expanded node
+         * @param depth the depth of the children
+         * @param nextSiblingMask the next sibling mask of the node
+         */
+        void _AppendChildRows(vector<_Row>& rows, SdfPath primPath, int depth,
+                              uint64_t nextSiblingMask);
+
+        /**
+         * @brief Expand or collapse the node of the given row, and insert or
+         * erase the rows of its descendants
          *
+         * @param rowIndex the index of the row to toggle
          */
-        ImGuiTreeNodeFlags _ComputeDisplayFlags(pxr::SdfPath primPath);
+        void _ToggleRow(size_t rowIndex);
 
         /**
-         * @brief Draw the hierarchy tree node of the given UsdPrim. The color
-         * and the behavior of the node will bet set accordingly.
+         * @brief Update the hashed selection and selection ancestors sets if
+         * the Model selection changed
          *
-         * @param primPath the SdfPath of the prim that will be drawn next on
-         * the outliner
-         * @return true if children 'primPath' must be drawn too
-         * @return false otherwise
          */
-        bool _DrawHierarchyNode(pxr::SdfPath primPath);
+        void _UpdateSelection();
 
         /**
-         * @brief Check if a given prim path is parent of another prim path
+         * @brief Compute the display flags of the given row
+         *
+         * @param row the row to compute the dislay flags from
+         * @return an ImGuiTreeNodeFlags object.
+         * If the row has no children, flag contains ImGuiTreeNodeFlags_Leaf
+         * If the row has children, flags contains
+         * ImGuiTreeNodeFlags_OpenOnArrow
+         * if the row is part of selection, flags
+         * contains ImGuiTreeNodeFlags_Selected
          *
-         * @param primPath SdfPath to check if it is parent of
-         * 'childPrimPath'
-         * @param childPrimPath the SdfPath that acts as the child prim path
-         * @return true if 'primPath' is parent of 'childPrimPath'
-         * @return false otherwise
          */
-        bool IsParentOf(pxr::SdfPath primPath, pxr::SdfPath childPrimPath);
+        ImGuiTreeNodeFlags _ComputeDisplayFlags(_Row& row);
 
         /**
-         * @brief Check if the given UsdPrim is parent of a UsdPrim within the
-         * current Model Selection.
+         * @brief Draw the hierarchy tree node of the given row. The color
+         * and the behavior of the node will bet set accordingly.
          *
-         * @param primPath SdfPath to check with
-         * @return true if 'primPath' is parent of a prim within the current
-         * Model selection
+         * @param row the row that will be drawn next on the outliner
+         * @return true if the node was toggled open or closed
          * @return false otherwise
          */
-        bool _IsParentOfModelSelection(pxr::SdfPath primPath);
+        bool _DrawHierarchyNode(_Row& row);
 
         /**
-         * @brief Check if the given UsdPrim is part of the current Model
-         * selection
+         * @brief Draw the context menu of the given row, to force the load
+         * or the unload of its payload, if any
          *
-         * @param prim SdfPath to check with
-         * @return true if 'primPath' is part of the current Model selection
-         * @return false otherwise
+         * @param row the row to draw the context menu of
          */
-        bool _IsInModelSelection(pxr::SdfPath primPath);
+        void _DrawPayloadContextMenu(const _Row& row);
 
         /**
-         * @brief Draw the children hierarchy decoration of the outliner view
-         * (aka the vertical and horizontal lines that connect parent and child
+         * @brief Draw the hierarchy decoration of the given row (aka the
+         * vertical and horizontal lines that connect parent and child
          * nodes).
          *
-         * @param parentRect the ImRect rectangle of the parent node
-         * @param childrenRects a vector of ImRect rectangles of the direct
-         * children node of 'parentRect'
+         * @param row the row to draw the decoration of
+         * @param rowRect the ImRect rectangle of the row node
          */
-        void _DrawChildrendHierarchyDecoration(ImRect parentRect,
-                                               vector<ImRect> childrenRects);
+        void _DrawHierarchyDecoration(const _Row& row, ImRect rowRect);
 };
 
 PXR_NAMESPACE_CLOSE_SCOPE
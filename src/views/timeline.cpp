@@ -0,0 +1,121 @@
+#include "timeline.h"
+
+#include <imgui.h>
+#include <pxr/usd/usd/stage.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+Timeline::Timeline(Model* model, const string label)
+    : View(model, label),
+      _isPlaying(false),
+      _playStartTime(0),
+      _lastFrameIndex(-1),
+      _droppedFrames(0),
+      _uncachedFrames(0)
+{
+}
+
+Timeline::~Timeline()
+{
+    _SetPlaying(false);
+}
+
+const string Timeline::GetViewType()
+{
+    return VIEW_TYPE;
+};
+
+void Timeline::_Draw()
+{
+    UsdStageRefPtr stage = GetModel()->GetStage();
+    if (!stage || !stage->HasAuthoredTimeCodeRange()) {
+        _SetPlaying(false);
+        ImGui::TextDisabled("the stage has no time range");
+        return;
+    }
+
+    double startTime = stage->GetStartTimeCode();
+    double endTime = stage->GetEndTimeCode();
+
+    if (_isPlaying) _UpdatePlayback(startTime, endTime);
+
+    if (ImGui::Button(_isPlaying ? "pause" : "play")) _SetPlaying(!_isPlaying);
+    ImGui::SameLine();
+
+    UsdTimeCode time = GetModel()->GetTime();
+    float frame = time.IsDefault() ? float(startTime) : float(time.GetValue());
+    ImGui::SetNextItemWidth(-FLT_MIN);
+    if (ImGui::SliderFloat("##time", &frame, float(startTime), float(endTime),
+                           "%.0f")) {
+        // scrubbing stops the playback
+        _SetPlaying(false);
+        GetModel()->SetTime(UsdTimeCode(round(frame)));
+    }
+
+    TimeCacheSceneIndexRefPtr timeCache = GetModel()->GetTimeCacheSceneIndex();
+    if (timeCache) {
+        int cacheSize = int(timeCache->GetCacheSize());
+        ImGui::SetNextItemWidth(ImGui::GetFontSize() * 6);
+        if (ImGui::DragInt("cached frames", &cacheSize, 1, 1, 1024))
+            timeCache->SetCacheSize(size_t(cacheSize));
+        ImGui::SameLine();
+        ImGui::Text("(%zu ready)", timeCache->GetCachedFrameCount());
+    }
+
+    ImGui::Text("%zu dropped, %zu uncached", _droppedFrames, _uncachedFrames);
+}
+
+void Timeline::_SetPlaying(bool play)
+{
+    if (play == _isPlaying) return;
+    _isPlaying = play;
+
+    TimeCacheSceneIndexRefPtr timeCache = GetModel()->GetTimeCacheSceneIndex();
+    if (timeCache) timeCache->SetPrefetchEnabled(play);
+
+    if (!play) return;
+
+    // the playback starts from the current frame
+    UsdStageRefPtr stage = GetModel()->GetStage();
+    double startTime = stage->GetStartTimeCode();
+    double endTime = stage->GetEndTimeCode();
+    UsdTimeCode time = GetModel()->GetTime();
+    _playStartTime = time.IsDefault() ? startTime : round(time.GetValue());
+    _playStartTime = std::clamp(_playStartTime, startTime, endTime);
+
+    _playStart = chrono::steady_clock::now();
+    _lastFrameIndex = -1;
+    _droppedFrames = 0;
+    _uncachedFrames = 0;
+}
+
+void Timeline::_UpdatePlayback(double startTime, double endTime)
+{
+    UsdStageRefPtr stage = GetModel()->GetStage();
+    double timeCodesPerSecond = stage->GetTimeCodesPerSecond();
+    auto now = chrono::steady_clock::now();
+    double elapsed = chrono::duration<double>(now - _playStart).count();
+
+    int64_t frameIndex = int64_t(elapsed * timeCodesPerSecond);
+    if (frameIndex == _lastFrameIndex) return;
+
+    // the frames between the previous displayed one and this one didn't
+    // make it to the screen
+    if (_lastFrameIndex >= 0)
+        _droppedFrames += size_t(frameIndex - _lastFrameIndex - 1);
+    _lastFrameIndex = frameIndex;
+
+    double rangeLength = endTime - startTime + 1;
+    double time =
+        startTime + fmod(_playStartTime - startTime + frameIndex, rangeLength);
+    GetModel()->SetTime(UsdTimeCode(time));
+
+    TimeCacheSceneIndexRefPtr timeCache = GetModel()->GetTimeCacheSceneIndex();
+    if (timeCache && !timeCache->IsCurrentFrameCached()) _uncachedFrames++;
+}
+
+PXR_NAMESPACE_CLOSE_SCOPE
@@ -0,0 +1,87 @@
+/**
+ * @file timeline.h
+ * @author Raphael Jouretz (rjouretz.com)
+ * @brief Timeline view that plays and scrubs the time range of the UsdStage,
+ * and reports the frames dropped during the playback.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "view.h"
+
+PXR_NAMESPACE_OPEN_SCOPE
+
+using namespace std;
+
+/**
+ * @class Timeline
+ * @brief Timeline view that plays and scrubs the time range of the UsdStage,
+ * and reports the frames dropped during the playback.
+ *
+ * The playback follows the wall clock at the time codes per second of the
+ * stage and loops over its time range. The time samples of the next frames
+ * are prefetched while playing, a frame displayed before being prefetched is
+ * reported as uncached, and the frames skipped because the previous one took
+ * too long are reported as dropped.
+ *
+ */
+class Timeline : public View {
+    public:
+        inline static const string VIEW_TYPE = "Timeline";
+
+        /**
+         * @brief Construct a new Timeline object
+         *
+         * @param model the Model of the new Timeline view
+         * @param label the ImGui label of the new Timeline view
+         */
+        Timeline(Model* model, const string label = VIEW_TYPE);
+
+        /**
+         * @brief Destroy the Timeline object, and stop the playback
+         *
+         */
+        ~Timeline();
+
+        /**
+         * @brief Override of the View::GetViewType
+         *
+         */
+        const string GetViewType() override;
+
+    private:
+        bool _isPlaying;
+        chrono::steady_clock::time_point _playStart;
+        double _playStartTime;
+        int64_t _lastFrameIndex;
+        size_t _droppedFrames, _uncachedFrames;
+
+        /**
+         * @brief Override of the View::Draw
+         *
+         */
+        void _Draw() override;
+
+        /**
+         * @brief Start or stop the playback from the current time
+         *
+         * @param play true to start the playback
+         */
+        void _SetPlaying(bool play);
+
+        /**
+         * @brief Advance the current time of the Model according to the time
+         * elapsed since the start of the playback
+         *
+         * @param startTime the start of the time range of the stage
+         * @param endTime the end of the time range of the stage
+         */
+        void _UpdatePlayback(double startTime, double endTime);
+};
+
+PXR_NAMESPACE_CLOSE_SCOPE
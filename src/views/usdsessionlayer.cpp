@@ -4,40 +4,56 @@
 #include <ImGuiFileDialog.h>
 #endif
 #include <pxr/imaging/hd/tokens.h>
+#include <pxr/usd/sdf/changeBlock.h>
 #include <pxr/usd/usdGeom/camera.h>
 #include <pxr/usd/usdGeom/capsule.h>
 #include <pxr/usd/usdGeom/cone.h>
 #include <pxr/usd/usdGeom/cube.h>
 #include <pxr/usd/usdGeom/cylinder.h>
+#include <pxr/usd/usdGeom/gprim.h>
+#include <pxr/usd/usdGeom/imageable.h>
 #include <pxr/usd/usdGeom/metrics.h>
 #include <pxr/usd/usdGeom/plane.h>
 #include <pxr/usd/usdGeom/sphere.h>
+#include <pxr/usd/usdGeom/xformable.h>
 #include <pxr/usdImaging/usdImaging/sceneIndices.h>
 
-#include <fstream>
-
 PXR_NAMESPACE_OPEN_SCOPE
 
+namespace {
+// the edits settled for this long without any mouse button down are
+// committed, e.g. after a keyboard navigation
+const chrono::milliseconds EDIT_COMMIT_DELAY(500);
+}  // namespace
+
 UsdSessionLayer::UsdSessionLayer(Model* model, const string label)
-    : View(model, label), _isEditing(false)
+    : View(model, label),
+      _isEditing(false),
+      _isPayloadStreamingEnabled(false),
+      _isPrefetchPaused(false),
+      _sessionLayerVersion(0),
+      _lastLoadedVersion(0),
+      _lastEditGeneration(0),
+      _committedEditGeneration(0)
 {
+    _layersDidChangeKey = TfNotice::Register(
+        TfCreateWeakPtr(this), &UsdSessionLayer::_OnLayersDidChange);
+
     _gizmoWindowFlags = ImGuiWindowFlags_MenuBar;
 
     _editor.SetPalette(_GetPalette());
     _editor.SetLanguageDefinition(_GetUsdLanguageDefinition());
     _editor.SetShowWhitespaces(false);
 
-    UsdImagingCreateSceneIndicesInfo info;
-    info.displayUnloadedPrimsWithBounds = false;
-    const UsdImagingSceneIndices sceneIndices =
-        UsdImagingCreateSceneIndices(info);
-
-    _stageSceneIndex = sceneIndices.stageSceneIndex;
-    GetModel()->AddSceneIndexBase(sceneIndices.finalSceneIndex);
-
     SetEmptyStage();
 }
 
+UsdSessionLayer::~UsdSessionLayer()
+{
+    TfNotice::Revoke(_layersDidChangeKey);
+    GetModel()->RemoveSceneIndexBase(_sceneIndexBase);
+}
+
 const string UsdSessionLayer::GetViewType()
 {
     return VIEW_TYPE;
@@ -50,6 +66,23 @@ ImGuiWindowFlags UsdSessionLayer::_GetGizmoWindowFlags()
 
 void UsdSessionLayer::_Draw()
 {
+    _UpdateStageLoad();
+    _UpdateEditCommit();
+
+    // load and unload a batch of payloads, and sync them right away. The
+    // streaming waits for the end of the playback, since the stage is read
+    // by the prefetch worker meanwhile
+    TimeCacheSceneIndexRefPtr timeCache = GetModel()->GetTimeCacheSceneIndex();
+    bool isPlaying = timeCache && timeCache->IsPrefetchEnabled();
+    if (!isPlaying) {
+        // the batch is deferred while the render thread syncs the scene,
+        // rather than waiting for it
+        unique_lock<recursive_mutex> lock(GetModel()->GetSceneMutex(),
+                                          try_to_lock);
+        if (lock.owns_lock() && GetModel()->GetPayloadStreamer()->Update())
+            _stageSceneIndex->ApplyPendingUpdates();
+    }
+
     if (ImGui::BeginMenuBar()) {
 #ifdef HAVE_IMGUIFD
         if (ImGui::BeginMenu("File")) {
@@ -68,6 +101,7 @@ void UsdSessionLayer::_Draw()
             ImGui::EndMenu();
         }
 #endif
+        _DrawPayloadsMenu();
         if (ImGui::BeginMenu("Objects")) {
             if (ImGui::BeginMenu("Create")) {
                 if (ImGui::MenuItem("Camera"))
@@ -121,56 +155,204 @@ void UsdSessionLayer::SetEmptyStage()
 
 void UsdSessionLayer::SetStage(UsdStageRefPtr stage)
 {
-    if (_sceneIndices.finalSceneIndex) {
-        /// @TODO renderIndex is in Engine
-        _engine->RemoveSceneIndex(_sceneIndices.finalSceneIndex);
-    }
+    lock_guard<recursive_mutex> lock(GetModel()->GetSceneMutex());
 
-    // create scene index for the first time
     UsdImagingCreateSceneIndicesInfo info;
     info.displayUnloadedPrimsWithBounds = false;
     _sceneIndices = UsdImagingCreateSceneIndices(info);
     _stageSceneIndex = _sceneIndices.stageSceneIndex;
-    GetModel()->AddSceneIndexBase(_sceneIndices.finalSceneIndex);
-
     _stageSceneIndex->SetStage(stage);
+
+    TimeCacheSceneIndexRefPtr timeCache = TimeCacheSceneIndex::New(
+        _sceneIndices.finalSceneIndex, _stageSceneIndex, stage);
+    _SetSceneIndexBase(timeCache);
     _stage = stage;
 
     _rootLayer = _stage->GetRootLayer();
     _sessionLayer = _stage->GetSessionLayer();
+    _sessionLayerVersion++;
 
     _stage->SetEditTarget(_sessionLayer);
-    _stageSceneIndex->SetTime(UsdTimeCode::Default());
 
     GetModel()->SetStage(_stage);
+    GetModel()->SetTimeCacheSceneIndex(timeCache);
 }
 
 void UsdSessionLayer::_LoadUsdStage(const string usdFilePath)
 {
-    if (!ifstream(usdFilePath)) {
-        TF_RUNTIME_ERROR(
-            "Error: the file does not exist. Empty stage loaded.");
-        SetEmptyStage();
+    // streamed stages are opened without payloads, which are drawn as
+    // bounding boxes until they are loaded
+    UsdImagingCreateSceneIndicesInfo info;
+    info.displayUnloadedPrimsWithBounds = _isPayloadStreamingEnabled;
+    _stageLoader.Start(usdFilePath, info,
+                       _isPayloadStreamingEnabled ? UsdStage::LoadNone
+                                                  : UsdStage::LoadAll);
+}
+
+void UsdSessionLayer::_DrawPayloadsMenu()
+{
+    if (!ImGui::BeginMenu("Payloads")) return;
+
+    PayloadStreamer* streamer = GetModel()->GetPayloadStreamer();
+
+    if (ImGui::MenuItem("Stream on load", NULL,
+                        _isPayloadStreamingEnabled)) {
+        _isPayloadStreamingEnabled = !_isPayloadStreamingEnabled;
+    }
+    bool isStreaming = streamer->IsEnabled();
+    if (ImGui::MenuItem("Streaming", NULL, isStreaming))
+        streamer->SetEnabled(!isStreaming);
+
+    int budgetMB = int(streamer->GetMemoryBudget() >> 20);
+    if (ImGui::DragInt("Memory budget (MB)", &budgetMB, 64, 256, 1 << 20))
+        streamer->SetMemoryBudget(size_t(budgetMB) << 20);
+
+    ImGui::Separator();
+    ImGui::Text("%zu / %zu loaded", streamer->GetLoadedCount(),
+                streamer->GetCount());
+
+    ImGui::EndMenu();
+}
+
+void UsdSessionLayer::_UpdateStageLoad()
+{
+    GetModel()->SetLoadingStatus(_stageLoader.GetStatus());
+
+    StageLoader::Result result;
+    if (!_stageLoader.TryGetResult(result)) return;
+
+    GetModel()->SetLoadingStatus(string());
+
+    if (!result.error.empty()) {
+        TF_RUNTIME_ERROR("Error: unable to load the stage, %s.",
+                         result.error.c_str());
         return;
     }
-    // reset stage indices completely
-    UsdImagingCreateSceneIndicesInfo info;
-    info.displayUnloadedPrimsWithBounds = false;
-    const UsdImagingSceneIndices sceneIndices =
-        UsdImagingCreateSceneIndices(info);
 
-    _stageSceneIndex = sceneIndices.stageSceneIndex;
-    GetModel()->AddSceneIndexBase(sceneIndices.finalSceneIndex);
+    // swap the loaded stage, already populated by the loader
+    lock_guard<recursive_mutex> lock(GetModel()->GetSceneMutex());
+    _sceneIndices = result.sceneIndices;
+    _stageSceneIndex = _sceneIndices.stageSceneIndex;
 
-    // load the new stage
-    _rootLayer = SdfLayer::FindOrOpen(usdFilePath);
-    _sessionLayer = SdfLayer::CreateAnonymous();
-    _stage = UsdStage::Open(_rootLayer, _sessionLayer);
-    _stage->SetEditTarget(_sessionLayer);
-    _stageSceneIndex->SetStage(_stage);
-    _stageSceneIndex->SetTime(UsdTimeCode::Default());
+    TimeCacheSceneIndexRefPtr timeCache = TimeCacheSceneIndex::New(
+        _sceneIndices.finalSceneIndex, _stageSceneIndex, result.stage);
+    _SetSceneIndexBase(timeCache);
+
+    _rootLayer = result.rootLayer;
+    _sessionLayer = result.sessionLayer;
+    _sessionLayerVersion++;
+    _stage = result.stage;
 
     GetModel()->SetStage(_stage);
+    GetModel()->SetTimeCacheSceneIndex(timeCache);
+    if (_isPayloadStreamingEnabled)
+        GetModel()->GetPayloadStreamer()->SetEnabled(true);
+}
+
+void UsdSessionLayer::_UpdateEditCommit()
+{
+    EditOverlaySceneIndexRefPtr overlay =
+        GetModel()->GetEditOverlaySceneIndex();
+
+    auto now = chrono::steady_clock::now();
+    int generation = overlay->GetEditGeneration();
+    if (generation != _lastEditGeneration) {
+        _lastEditGeneration = generation;
+        _lastEditTime = now;
+    }
+
+    if (generation == _committedEditGeneration) return;
+
+    // the edits are committed when the drag ends, never during the drag
+    if (ImGui::IsAnyMouseDown()) return;
+
+    bool isReleased = false;
+    for (int i = 0; i < ImGuiMouseButton_COUNT; i++)
+        isReleased |= ImGui::IsMouseReleased(i);
+
+    if (!isReleased && now - _lastEditTime < EDIT_COMMIT_DELAY) return;
+
+    _CommitEdits();
+}
+
+void UsdSessionLayer::_CommitEdits()
+{
+    EditOverlaySceneIndexRefPtr overlay =
+        GetModel()->GetEditOverlaySceneIndex();
+    _committedEditGeneration = overlay->GetEditGeneration();
+
+    if (!_stage) return;
+
+    lock_guard<recursive_mutex> lock(GetModel()->GetSceneMutex());
+
+    SdfPathVector primPaths = overlay->GetOverriddenPaths();
+    SdfPathVector committedPaths;
+    committedPaths.reserve(primPaths.size());
+
+    _PauseTimePrefetch(true);
+    {
+        // all the edits are authored to the edit target, i.e. the session
+        // layer, with a single recomposition of the stage
+        SdfChangeBlock changeBlock;
+
+        for (const SdfPath& primPath : primPaths) {
+            UsdPrim prim = _stage->GetPrimAtPath(primPath);
+            if (!prim) continue;
+
+            bool isCommitted = true;
+
+            // the overlay xforms are in world space, the local xform is
+            // relative to the parent xform currently on screen
+            GfMatrix4d xform;
+            if (overlay->GetXformOverride(primPath, &xform)) {
+                UsdGeomXformable xformable(prim);
+                if (xformable) {
+                    GfMatrix4d parentXform =
+                        overlay->GetXform(primPath.GetParentPath());
+                    xformable.MakeMatrixXform().Set(xform *
+                                                    parentXform.GetInverse());
+                }
+                else isCommitted = false;
+            }
+
+            GfVec3f color;
+            if (overlay->GetDisplayColorOverride(primPath, &color)) {
+                UsdGeomGprim gprim(prim);
+                if (gprim) {
+                    gprim.CreateDisplayColorPrimvar(UsdGeomTokens->constant)
+                        .Set(VtVec3fArray({color}));
+                }
+                else isCommitted = false;
+            }
+
+            bool visibility;
+            if (overlay->GetVisibilityOverride(primPath, &visibility)) {
+                UsdGeomImageable imageable(prim);
+                if (imageable) {
+                    imageable.CreateVisibilityAttr().Set(
+                        visibility ? UsdGeomTokens->inherited
+                                   : UsdGeomTokens->invisible);
+                }
+                else isCommitted = false;
+            }
+
+            if (isCommitted) committedPaths.push_back(primPath);
+        }
+    }
+
+    // the overrides are only dropped once the stage scene index has the
+    // authored values, so that the edited prims never flicker
+    _stageSceneIndex->ApplyPendingUpdates();
+    overlay->ClearOverrides(committedPaths);
+    _PauseTimePrefetch(false);
+}
+
+void UsdSessionLayer::_SetSceneIndexBase(HdSceneIndexBaseRefPtr sceneIndex)
+{
+    // the chain of the previous stage is dropped from the Model, so that it
+    // is released with the previous stage instead of staying populated
+    GetModel()->ReplaceSceneIndexBase(_sceneIndexBase, sceneIndex);
+    _sceneIndexBase = sceneIndex;
 }
 
 string UsdSessionLayer::_GetNextAvailableIndexedPath(string primPath)
@@ -191,6 +373,9 @@ void UsdSessionLayer::_CreatePrim(TfToken primType)
 {
     string primPath = _GetNextAvailableIndexedPath("/" + primType.GetString());
 
+    lock_guard<recursive_mutex> lock(GetModel()->GetSceneMutex());
+    _PauseTimePrefetch(true);
+
     if (primType == HdPrimTypeTokens->camera) {
         auto cam = UsdGeomCamera::Define(_stage, SdfPath(primPath));
         cam.CreateFocalLengthAttr(VtValue(18.46f));
@@ -216,31 +401,70 @@ void UsdSessionLayer::_CreatePrim(TfToken primType)
     }
 
     _stageSceneIndex->ApplyPendingUpdates();
+    _PauseTimePrefetch(false);
 }
 
 void UsdSessionLayer::UpdateStageSceneIndex() {
+    lock_guard<recursive_mutex> lock(GetModel()->GetSceneMutex());
     _stageSceneIndex->ApplyPendingUpdates();
 }
 
 bool UsdSessionLayer::_IsUsdSessionLayerUpdated()
 {
-    string layerText;
-    _sessionLayer->ExportToString(&layerText);
-    return _lastLoadedText != layerText;
+    return _sessionLayerVersion != _lastLoadedVersion;
+}
+
+void UsdSessionLayer::_OnLayersDidChange(
+    const SdfNotice::LayersDidChange& notice)
+{
+    for (auto&& layer : notice.GetLayers()) {
+        if (layer == _sessionLayer) {
+            _sessionLayerVersion++;
+            return;
+        }
+    }
 }
 
 void UsdSessionLayer::_LoadSessionTextFromModel()
 {
+    // the layer is serialized once per change, not once per frame
     string layerText;
     _sessionLayer->ExportToString(&layerText);
     _editor.SetText(layerText);
     _lastLoadedText = layerText;
+    _lastLoadedVersion = _sessionLayerVersion;
 }
 
 void UsdSessionLayer::_SaveSessionTextToModel()
 {
     string editedText = _editor.GetText();
-    _sessionLayer->ImportFromString(editedText.c_str());
+
+    // nothing to apply if the text wasn't edited since the last load
+    if (editedText == _lastLoadedText) return;
+
+    // the layer only notifies the specs that differ from the imported text,
+    // and all of them in a single notice
+    _PauseTimePrefetch(true);
+    {
+        SdfChangeBlock changeBlock;
+        _sessionLayer->ImportFromString(editedText);
+    }
+    _PauseTimePrefetch(false);
+}
+
+void UsdSessionLayer::_PauseTimePrefetch(bool pause)
+{
+    TimeCacheSceneIndexRefPtr timeCache = GetModel()->GetTimeCacheSceneIndex();
+    if (!timeCache) return;
+
+    if (pause) {
+        _isPrefetchPaused = timeCache->IsPrefetchEnabled();
+        if (_isPrefetchPaused) timeCache->SetPrefetchEnabled(false);
+    }
+    else if (_isPrefetchPaused) {
+        timeCache->SetPrefetchEnabled(true);
+        _isPrefetchPaused = false;
+    }
 }
 
 TextEditor::Palette UsdSessionLayer::_GetPalette()
@@ -376,6 +600,8 @@ void UsdSessionLayer::_FocusInEvent()
 void UsdSessionLayer::_FocusOutEvent()
 {
     _isEditing = false;
+
+    lock_guard<recursive_mutex> lock(GetModel()->GetSceneMutex());
     _SaveSessionTextToModel();
     _stageSceneIndex->ApplyPendingUpdates();
 };
@@ -13,8 +13,16 @@
 #define IMGUI_DEFINE_MATH_OPERATORS
 #endif
 #include <TextEditor.h>
+#include <pxr/base/tf/notice.h>
+#include <pxr/base/tf/weakBase.h>
+#include <pxr/usd/sdf/notice.h>
 #include <pxr/usdImaging/usdImaging/stageSceneIndex.h>
 
+#include <atomic>
+#include <chrono>
+
+#include "models/stageloader.h"
+#include "sceneindices/timecachesceneindex.h"
 #include "view.h"
 
 PXR_NAMESPACE_OPEN_SCOPE
@@ -26,7 +34,7 @@ using namespace std;
  * the current UsdStage. It allows to preview and edit the USD session layer.
  *
  */
-class UsdSessionLayer : public View {
+class UsdSessionLayer : public View, public TfWeakBase {
     public:
         inline static const string VIEW_TYPE = "Session Layer";
 
@@ -38,6 +46,12 @@ class UsdSessionLayer : public View {
          */
         UsdSessionLayer(Model* model, const string label = VIEW_TYPE);
 
+        /**
+         * @brief Destroy the UsdSessionLayer object
+         *
+         */
+        ~UsdSessionLayer();
+
         /**
          * @brief Override of the View::GetViewType
          *
@@ -62,13 +76,22 @@ class UsdSessionLayer : public View {
 
     private:
         TextEditor _editor;
-        bool _isEditing;
+        bool _isEditing, _isPayloadStreamingEnabled, _isPrefetchPaused;
         string _lastLoadedText;
+        // incremented by the layer notices, which may come from another
+        // thread (e.g. a stage loaded in the background)
+        atomic<size_t> _sessionLayerVersion;
+        size_t _lastLoadedVersion;
+        int _lastEditGeneration, _committedEditGeneration;
+        chrono::steady_clock::time_point _lastEditTime;
+        TfNotice::Key _layersDidChangeKey;
         ImGuiWindowFlags _gizmoWindowFlags;
         pxr::SdfLayerRefPtr _rootLayer, _sessionLayer;
         pxr::UsdImagingStageSceneIndexRefPtr _stageSceneIndex;
         pxr::UsdStageRefPtr _stage;
         pxr::UsdImagingSceneIndices _sceneIndices;
+        pxr::HdSceneIndexBaseRefPtr _sceneIndexBase;
+        StageLoader _stageLoader;
 
         /**
          * @brief Override of the View::Draw
@@ -77,23 +100,78 @@ class UsdSessionLayer : public View {
         void _Draw() override;
 
         /**
-         * @brief Load a Usd Stage based on the given Usd file path
+         * @brief Start loading a Usd Stage based on the given Usd file path
+         * in the background. The current stage stays in the Model until the
+         * new one is loaded.
          *
          * @param usdFilePath a string containing a Usd file path
          */
         void _LoadUsdStage(const string usdFilePath);
 
+        /**
+         * @brief Publish the status of the background load to the Model, and
+         * swap the loaded stage into the Model once it is ready
+         *
+         */
+        void _UpdateStageLoad();
 
         /**
-         * @brief Check if USD session layer was updated since the last load
-         * (different)
+         * @brief Commit the interactive edits of the Model to the session
+         * layer when a drag ends, or once they settled
          *
-         * @return true if USD session layer is different from the last loaded
-         * data
+         */
+        void _UpdateEditCommit();
+
+        /**
+         * @brief Author the overrides of the Edit Overlay Scene Index to the
+         * session layer in a single change block, and drop the committed
+         * overrides
+         *
+         */
+        void _CommitEdits();
+
+        /**
+         * @brief Replace the Scene Index Base of the current stage in the
+         * Model by the given one
+         *
+         * @param sceneIndex the Scene Index Base of the new stage
+         */
+        void _SetSceneIndexBase(pxr::HdSceneIndexBaseRefPtr sceneIndex);
+
+        /**
+         * @brief Draw the Payloads menu, to stream the payloads of the next
+         * loaded stages and set the memory budget of the streaming
+         *
+         */
+        void _DrawPayloadsMenu();
+
+
+        /**
+         * @brief Check if USD session layer was updated since the last load.
+         * The layer is never serialized for the check, only its change
+         * counter is compared.
+         *
+         * @return true if USD session layer changed since the last load
          * @return false otherwise
          */
         bool _IsUsdSessionLayerUpdated();
 
+        /**
+         * @brief Pause the prefetch of the time samples before an edit of the
+         * stage, since the prefetch worker reads it, and resume it after
+         *
+         * @param pause true to pause the prefetch, false to resume it
+         */
+        void _PauseTimePrefetch(bool pause);
+
+        /**
+         * @brief Increment the change counter of the session layer when it
+         * is part of the changed layers
+         *
+         * @param notice the notice of the changed layers
+         */
+        void _OnLayersDidChange(const SdfNotice::LayersDidChange& notice);
+
         /**
          * @brief Load text from the USD session layer of the Model
          *
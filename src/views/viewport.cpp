@@ -2,66 +2,150 @@
 
 #include <pxr/base/gf/camera.h>
 #include <pxr/base/gf/frustum.h>
+#include <pxr/base/gf/math.h>
 #include <pxr/base/gf/matrix4f.h>
+#include <pxr/base/gf/ray.h>
 #include <pxr/base/plug/plugin.h>
+#include <pxr/base/tf/stringUtils.h>
 #include <pxr/imaging/cameraUtil/framing.h>
 #include <pxr/imaging/hd/cameraSchema.h>
-#include <pxr/imaging/hd/extentSchema.h>
+#include <pxr/imaging/hd/tokens.h>
 #include <pxr/usd/usd/stage.h>
-#include <pxr/imaging/hgi/blitCmdsOps.h>
-#include <pxr/imaging/hgi/texture.h>
-#include <pxr/imaging/hdSt/renderBuffer.h>
-
-extern "C"
-int LabCreateRGBAf16Texture(int width, int height, uint8_t* rgba_pixels);
-extern "C"
-void* LabTextureHardwareHandle(int texture);
-extern "C"
-void LabRemoveTexture(int texture);
-extern "C"
-void LabUpdateRGBAf16Texture(int texture, uint8_t* rgba_pixels);
 
-namespace {
-struct TextureCapture {
-    int width = 0;
-    int height = 0;
-    int handle = -1;
-};
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+
+#include "profiler.h"
+#include "renderthread.h"
 
-TextureCapture texcap;
-} // anon
 PXR_NAMESPACE_OPEN_SCOPE
 
+namespace {
+// delay without camera move after which the full resolution is restored
+const std::chrono::milliseconds CAMERA_MOVE_TIMEOUT(150);
+// smallest fraction of the viewport size rendered while the camera moves
+const float MIN_RESOLUTION_SCALE = 0.25f;
+// the scale is quantized so that the render buffers are not reallocated on
+// every frame
+const float RESOLUTION_SCALE_STEPS = 16.f;
+// scale of the window of the culling frustum, and largest move of the camera
+// before culling again, relative to the distance to its focus
+const double CULLING_PADDING = 1.5;
+const double CULLING_MAX_MOVE = 0.1;
+
+/**
+ * @brief Append the memory of the render buffers and the scene resources of
+ * an Engine to the MemoryTracker entries. Must be called on the thread that
+ * uses the Engine.
+ *
+ * @param engine the Engine
+ * @param group the group of the entries
+ * @param entries the entries of the MemoryTracker
+ */
+void AddEngineMemoryEntries(Engine* engine, const string& group,
+                            vector<MemoryTracker::Entry>& entries)
+{
+    entries.push_back(
+        {group, "render buffers", engine->GetRenderBufferByteSize(), true});
+
+    // the scene resources are shared by the viewports of a render context,
+    // and only the total of the render delegate is summed up
+    const void* context = engine->GetRenderContext().get();
+    VtDictionary allocation = engine->GetResourceAllocation();
+    for (auto&& it : allocation) {
+        VtValue value = it.second;
+        if (!value.CanCast<size_t>()) continue;
+
+        bool isTotal = it.first == HdPerfTokens->gpuMemoryUsed.GetString();
+        entries.push_back({group, "scene " + it.first,
+                           value.Cast<size_t>().Get<size_t>(), true,
+                           !isTotal, context});
+    }
+}
+}  // namespace
+
 Viewport::Viewport(Model* model, const string label) : View(model, label)
 {
     _gizmoWindowFlags = ImGuiWindowFlags_MenuBar;
     _isAmbientLightEnabled = true;
     _isDomeLightEnabled = false;
     _isGridEnabled = true;
+    _isRenderOnDemandEnabled = true;
+    _isStatsEnabled = false;
+    _isMarqueeActive = false;
+    _isAovPickingEnabled = false;
+    _isHovered = false;
+    _hasMouseMoved = false;
+    _isHoverPending = false;
+    _selection = std::make_shared<const SdfPathVector>();
+    _selectionGeneration = -1;
+    _isCullingEnabled = false;
+    _culledPaths = std::make_shared<const SdfPathVector>();
+    _culledGeneration = 0;
+    _cullingBoundsGeneration = -1;
+    _isAdaptiveResolutionEnabled = true;
+    _wasCameraMoving = false;
+    _resolutionScale = 1.f;
+    _movingResolutionScale = 1.f;
+    _renderBudgetMs = 1000.f / 60.f;
+    _renderMs = 0;
+    _renderSize = GfVec2i(0, 0);
+    _isActiveCamCached = false;
+    _isActiveCamXformDirty = false;
+    _isCameraDragging = false;
+    _activeCamEditGeneration = -1;
 
     _curOperation = ImGuizmo::TRANSLATE;
     _curMode = ImGuizmo::LOCAL;
 
+    _readbackRing.SetProfilerPrefix(GetViewLabel() + "/");
+    _memorySourceId = MemoryTracker::AddSource(
+        [this](vector<MemoryTracker::Entry>& entries) {
+            _AddMemoryEntries(entries);
+        });
+
     _eye = GfVec3d(5, 5, 5);
     _at = GfVec3d(0, 0, 0);
     _up = GfVec3d::YAxis();
 
     _UpdateActiveCamFromViewport();
 
-    _gridSceneIndex = GridSceneIndex::New();
-    GetModel()->AddSceneIndexBase(_gridSceneIndex);
+    _engine = nullptr;
+    _plugin = Engine::GetDefaultRendererPlugin();
+    _hasPresentedFrame = false;
+    _isEngineCreationDeferred = !RenderThread::IsRunning();
 
-    auto editableSceneIndex = GetModel()->GetEditableSceneIndex();
-    _xformSceneIndex = XformFilterSceneIndex::New(editableSceneIndex);
-    GetModel()->SetEditableSceneIndex(_xformSceneIndex);
-
-    TfToken plugin = Engine::GetDefaultRendererPlugin();
-    _engine = new Engine(GetModel()->GetFinalSceneIndex(), plugin);
+    // the render thread creates the Engine in the background
+    if (!_isEngineCreationDeferred) {
+        _threadedEngine = std::make_shared<_ThreadedEngine>();
+        _SetEngine(_plugin);
+    }
 };
 
 Viewport::~Viewport()
 {
-    delete _engine;
+    MemoryTracker::RemoveSource(_memorySourceId);
+
+    if (!_threadedEngine) {
+        delete _engine;
+        return;
+    }
+
+    // the Engine is destroyed on the render thread, but the frame handoff
+    // on the UI thread, so the job doesn't share the ownership and is waited
+    // for: the jobs before it were released once executed, and hold no
+    // other reference to the handoff
+    _ThreadedEngine* threadedEngine = _threadedEngine.get();
+    promise<void> isDestroyed;
+    RenderThread::Post(nullptr, [threadedEngine, &isDestroyed]() {
+        delete threadedEngine->engine;
+        threadedEngine->engine = nullptr;
+        isDestroyed.set_value();
+    });
+    isDestroyed.get_future().wait();
+    _threadedEngine = nullptr;
 }
 
 const string Viewport::GetViewType()
@@ -74,6 +158,44 @@ ImGuiWindowFlags Viewport::_GetGizmoWindowFlags()
     return _gizmoWindowFlags;
 };
 
+void Viewport::_AddMemoryEntries(vector<MemoryTracker::Entry>& entries)
+{
+    const string group = GetViewLabel();
+    entries.push_back(
+        {group, "readback staging", _readbackRing.GetStagingByteSize()});
+    entries.push_back({group, "pick buffer", _pickBuffer.GetByteSize()});
+    entries.push_back({group, "hover buffer", _hoverBuffer.GetByteSize()});
+
+    if (!_threadedEngine) {
+        if (_engine) AddEngineMemoryEntries(_engine, group, entries);
+        return;
+    }
+
+    entries.push_back(
+        {group, "frame handoff", _threadedEngine->handoff.GetByteSize()});
+    entries.push_back({group, "render thread pick buffer",
+                       _threadedEngine->pickBuffer.GetByteSize()});
+    entries.push_back({group, "render thread hover buffer",
+                       _threadedEngine->hoverBuffer.GetByteSize()});
+
+    // the Engine may be rendering, so its entries are gathered by the render
+    // thread and the last ones are reported meanwhile
+    auto threadedEngine = _threadedEngine;
+    RenderThread::Post(&threadedEngine->memoryMutex, [threadedEngine, group]() {
+        vector<MemoryTracker::Entry> engineEntries;
+        if (threadedEngine->engine)
+            AddEngineMemoryEntries(threadedEngine->engine, group,
+                                   engineEntries);
+
+        lock_guard<mutex> lock(threadedEngine->memoryMutex);
+        threadedEngine->memoryEntries.swap(engineEntries);
+    });
+
+    lock_guard<mutex> lock(threadedEngine->memoryMutex);
+    entries.insert(entries.end(), threadedEngine->memoryEntries.begin(),
+                   threadedEngine->memoryEntries.end());
+}
+
 float Viewport::_GetViewportWidth()
 {
     return GetInnerRect().GetWidth();
@@ -94,16 +216,34 @@ void Viewport::_Draw()
 
     _ConfigureImGuizmo();
 
-    // read from active cam in case it is modify by another view
-    if (!ImGui::IsWindowFocused())
-        _UpdateViewportFromActiveCam();
+    // the camera edit of a drag is published once the drag ends, and the
+    // release isn't seen by the viewport when it happens outside of it
+    if (_isCameraDragging && !ImGui::IsMouseDown(ImGuiMouseButton_Left) &&
+        !ImGui::IsMouseDown(ImGuiMouseButton_Right))
+        _isCameraDragging = false;
+    if (!_isCameraDragging) _PublishActiveCam();
+
+    // follow the edits of the active camera by another view or its
+    // animation, only once they invalidate the cached camera
+    if (!_activeCam.IsEmpty() && !_isCameraDragging) {
+        bool isRefreshed = false;
+        GfFrustum frustum = _GetActiveGfCamera(&isRefreshed).GetFrustum();
+        if (isRefreshed) {
+            _eye = frustum.GetPosition();
+            _at = frustum.ComputeLookAtPoint();
+        }
+    }
 
     _UpdateProjection();
-    _UpdateGrid();
+    _ApplyPickResult();
+    _UpdateHover();
     _UpdateHydraRender();
     _UpdateTransformGuizmo();
     _UpdateCubeGuizmo();
     _UpdatePluginLabel();
+    if (_isStatsEnabled) _UpdateStatsOverlay();
+    _UpdateMarquee();
+    _UpdateLoadingStatus();
 
     ImGuizmo::PopID();
 
@@ -143,16 +283,40 @@ void Viewport::_DrawMenuBar()
         }
         if (ImGui::BeginMenu("renderer")) {
             // get all possible renderer plugins
-            TfTokenVector plugins = _engine->GetRendererPlugins();
-            TfToken curPlugin = _engine->GetCurrentRendererPlugin();
+            TfTokenVector plugins = Engine::GetRendererPlugins();
+            TfToken curPlugin = _plugin;
             for (auto p : plugins) {
                 bool enabled = (p == curPlugin);
-                string name = _engine->GetRendererPluginName(p);
-                if (ImGui::MenuItem(name.c_str(), NULL, enabled)) {
-                    delete _engine;
-                    _engine = new Engine(GetModel()->GetFinalSceneIndex(), p);
-                }
+                string name = Engine::GetRendererPluginName(p);
+                if (ImGui::MenuItem(name.c_str(), NULL, enabled))
+                    _SetEngine(p);
+            }
+            ImGui::Separator();
+            // the render index is shared with the other viewports using the
+            // same renderer, the engine is recreated to join or leave it
+            bool isSharing = RenderContext::IsSharingEnabled();
+            if (ImGui::MenuItem("share render index", NULL, isSharing)) {
+                RenderContext::SetSharingEnabled(!isSharing);
+                _SetEngine(curPlugin);
             }
+            // the prims outside of this viewport are not drawn by its
+            // engine, the other viewports still draw them. Storm already
+            // culls its draw items
+            if (ImGui::MenuItem("frustum culling", NULL, _isCullingEnabled,
+                                !Engine::IsFrustumCullingNative(curPlugin))) {
+                _isCullingEnabled = !_isCullingEnabled;
+                _cullingBoundsGeneration = -1;
+            }
+            ImGui::MenuItem("render on demand", NULL,
+                            &_isRenderOnDemandEnabled);
+            ImGui::MenuItem("adaptive resolution", NULL,
+                            &_isAdaptiveResolutionEnabled);
+            // the picking AOVs are rendered along the color to pick and
+            // hover without executing the picking tasks
+            ImGui::MenuItem("aov picking", NULL, &_isAovPickingEnabled);
+            ImGui::DragFloat("render budget (ms)", &_renderBudgetMs, 0.1f,
+                             4.f, 100.f, "%.1f");
+            _DrawIdleRenderersMenu();
             ImGui::EndMenu();
         }
 
@@ -176,78 +340,251 @@ void Viewport::_DrawMenuBar()
         }
         if (ImGui::BeginMenu("show")) {
             ImGui::MenuItem("grid", NULL, &_isGridEnabled);
+            ImGui::MenuItem("stats", NULL, &_isStatsEnabled);
             ImGui::EndMenu();
         }
         ImGui::EndMenuBar();
     }
 }
 
-void Viewport::_ConfigureImGuizmo()
+void Viewport::_DrawIdleRenderersMenu()
 {
-    ImGuizmo::BeginFrame();
+    // the render contexts are created and released by the render thread
+    lock_guard<recursive_mutex> lock(GetModel()->GetSceneMutex());
 
-    // convert last label char to ID
-    string label = GetViewLabel();
-    ImGuizmo::PushID(int(label[label.size() - 1]));
+    TfTokenVector idlePlugins = RenderContext::GetIdleRendererPlugins();
+    if (!ImGui::BeginMenu("cached renderers", !idlePlugins.empty())) return;
 
-    ImGuizmo::SetDrawlist();
-    ImGuizmo::SetRect(GetInnerRect().Min.x, GetInnerRect().Min.y,
-                      _GetViewportWidth(), _GetViewportHeight());
+    // the cached renderers keep their synced scene, releasing them frees
+    // their resources
+    for (auto&& plugin : idlePlugins) {
+        string label = "release " + Engine::GetRendererPluginName(plugin);
+        if (ImGui::MenuItem(label.c_str())) _ReleaseIdleRenderers(plugin);
+    }
+    ImGui::Separator();
+    if (ImGui::MenuItem("release all")) _ReleaseIdleRenderers(TfToken());
+
+    int budgetMB = int(RenderContext::GetIdleMemoryBudget() >> 20);
+    if (ImGui::DragInt("memory budget (MB)", &budgetMB, 64, 0, 1 << 20))
+        RenderContext::SetIdleMemoryBudget(size_t(budgetMB) << 20);
+
+    ImGui::EndMenu();
 }
 
-void Viewport::_UpdateGrid()
+void Viewport::_ReleaseIdleRenderers(TfToken plugin)
 {
-    _gridSceneIndex->Populate(_isGridEnabled);
+    if (!_threadedEngine) {
+        RenderContext::ReleaseIdleContexts(plugin);
+        return;
+    }
 
-    if (!_isGridEnabled) return;
+    RenderThread::Post(nullptr, [plugin]() {
+        RenderContext::ReleaseIdleContexts(plugin);
+    });
+}
 
-    GfMatrix4f viewF(_getCurViewMatrix());
-    GfMatrix4f projF(_proj);
-    GfMatrix4f identity(1);
-
-    ImGuizmo::DrawGrid(viewF.data(), projF.data(), identity.data(), 10);
-}
-
-static uint8_t*
-GetGPUTexture(
-    Hgi& hgi,
-    HgiTextureHandle const& texHandle,
-    int width,
-    int height,
-    HgiFormat format)
-{
-    // Copy the pixels from gpu into a cpu buffer so we can save it to disk.
-    const size_t bufferByteSize =
-        width * height * HgiGetDataSizeOfFormat(format);
-    static uint8_t* buffer = nullptr;
-    static size_t sz = 0;
-    if (sz < bufferByteSize) {
-        if (buffer) {
-            free(buffer);
-            buffer = nullptr;
+void Viewport::_SetEngine(TfToken plugin)
+{
+    _plugin = plugin;
+    HdSceneIndexBaseRefPtr sceneIndex = GetModel()->GetFinalSceneIndex();
+
+    if (!_threadedEngine) {
+        delete _engine;
+        _engine = new Engine(sceneIndex, plugin);
+        _pickBuffer.Clear();
+        _hoverBuffer.Clear();
+        return;
+    }
+
+    // the Engine is created on the render thread, where its graphics context
+    // is current
+    auto threadedEngine = _threadedEngine;
+    RenderThread::Post(nullptr, [threadedEngine, sceneIndex, plugin]() {
+        delete threadedEngine->engine;
+        threadedEngine->engine = new Engine(sceneIndex, plugin);
+        threadedEngine->pickBuffer.Clear();
+        threadedEngine->hoverBuffer.Clear();
+        threadedEngine->isPickingSupported =
+            threadedEngine->engine->IsPickingSupported();
+    });
+}
+
+bool Viewport::_IsGpuPickingSupported()
+{
+    // the render thread owns its Engine, so its picks are posted to it
+    return _engine && _engine->IsPickingSupported();
+}
+
+bool Viewport::_PostPick(ImVec2 startPos, ImVec2 endPos)
+{
+    if (!_threadedEngine || !_threadedEngine->isPickingSupported)
+        return false;
+
+    auto threadedEngine = _threadedEngine;
+    bool isClick = startPos.x == endPos.x && startPos.y == endPos.y;
+    GfVec2f renderStartPos = _ToRenderPos(startPos);
+    GfVec2f renderEndPos = _ToRenderPos(endPos);
+
+    // the Engine picks with the camera of its last render, and a newer pick
+    // replaces the pending one
+    RenderThread::Post(&threadedEngine->pickMutex, [=]() {
+        Engine* engine = threadedEngine->engine;
+        if (!engine) return;
+
+        SdfPathVector paths;
+        Engine::IntersectionResult hit;
+        if (isClick) {
+            hit = engine->FindIntersection(renderStartPos);
+            if (!hit.path.IsEmpty()) paths.push_back(hit.path);
         }
-        sz = 0;
+        else {
+            for (auto&& intr :
+                 engine->FindIntersections(renderStartPos, renderEndPos))
+                paths.push_back(intr.path);
+        }
+
+        lock_guard<mutex> lock(threadedEngine->pickMutex);
+        threadedEngine->hasPickResult = true;
+        threadedEngine->pickedPaths = paths;
+        threadedEngine->pickHit = hit;
+    });
+    return true;
+}
+
+void Viewport::_ApplyPickResult()
+{
+    if (!_threadedEngine) return;
+
+    SdfPathVector paths;
+    Engine::IntersectionResult hit;
+    {
+        lock_guard<mutex> lock(_threadedEngine->pickMutex);
+        if (!_threadedEngine->hasPickResult) return;
+
+        _threadedEngine->hasPickResult = false;
+        paths.swap(_threadedEngine->pickedPaths);
+        hit = _threadedEngine->pickHit;
     }
-    if (!buffer) {
-        buffer = (uint8_t*) malloc(bufferByteSize);
-        sz = bufferByteSize;
+
+    GetModel()->SetSelection(paths);
+    if (!hit.path.IsEmpty())
+        GetModel()->SetHit(hit.worldSpaceHitPoint, hit.worldSpaceHitNormal);
+}
+
+PickBuffer* Viewport::_UpdatePickBuffer()
+{
+    if (!_isAovPickingEnabled) return nullptr;
+
+    if (!_threadedEngine) {
+        if (!_engine || !_engine->UpdatePickBuffer(&_pickBuffer))
+            return nullptr;
+        return &_pickBuffer;
     }
 
-    HgiTextureGpuToCpuOp copyOp;
-    copyOp.gpuSourceTexture = texHandle;
-    copyOp.sourceTexelOffset = GfVec3i(0);
-    copyOp.mipLevel = 0;
-    copyOp.cpuDestinationBuffer = buffer;
-    copyOp.destinationByteOffset = 0;
-    copyOp.destinationBufferByteSize = bufferByteSize;
+    // the capture waits on the GPU, so it is left to the render thread and
+    // the previous capture is sampled meanwhile
+    auto threadedEngine = _threadedEngine;
+    RenderThread::Post(&threadedEngine->pickBuffer, [threadedEngine]() {
+        Engine* engine = threadedEngine->engine;
+        if (engine) engine->UpdatePickBuffer(&threadedEngine->pickBuffer);
+    });
+
+    if (!threadedEngine->pickBuffer.IsValid()) return nullptr;
+    return &threadedEngine->pickBuffer;
+}
+
+PickBuffer* Viewport::_UpdateHoverBuffer(ImVec2 pos, bool* isPending)
+{
+    *isPending = false;
+    if (!_isAovPickingEnabled) return nullptr;
+
+    const GfVec2f normalizedPos = _ToNormalizedPos(pos);
+    if (!_threadedEngine) {
+        if (!_engine || !_engine->IsAovPickingSupported()) return nullptr;
+
+        *isPending = !_engine->UpdatePickTile(normalizedPos, &_hoverBuffer);
+        if (!_hoverBuffer.IsValid()) return nullptr;
+        return &_hoverBuffer;
+    }
+
+    auto threadedEngine = _threadedEngine;
+    RenderThread::Post(
+        &threadedEngine->hoverBuffer, [threadedEngine, normalizedPos]() {
+            Engine* engine = threadedEngine->engine;
+            if (!engine) return;
+
+            // the renderers without picking AOVs leave nothing to wait for
+            bool isCurrent =
+                !engine->IsAovPickingSupported() ||
+                engine->UpdatePickTile(normalizedPos,
+                                       &threadedEngine->hoverBuffer);
+
+            lock_guard<mutex> lock(threadedEngine->pickMutex);
+            threadedEngine->hoverPos = normalizedPos;
+            threadedEngine->isHoverCurrent = isCurrent;
+        });
+
+    {
+        lock_guard<mutex> lock(threadedEngine->pickMutex);
+        *isPending = threadedEngine->hoverPos != normalizedPos ||
+                     !threadedEngine->isHoverCurrent;
+    }
+
+    if (!threadedEngine->hoverBuffer.IsValid()) return nullptr;
+    return &threadedEngine->hoverBuffer;
+}
+
+Engine::IntersectionResult Viewport::_FindIntersection(ImVec2 pos,
+                                                       bool* isPosted)
+{
+    *isPosted = false;
+    Engine::IntersectionResult intr;
+    PickBuffer* pickBuffer = _UpdatePickBuffer();
+    if (pickBuffer && pickBuffer->Sample(_ToNormalizedPos(pos), &intr))
+        return intr;
+
+    if (_IsGpuPickingSupported())
+        return _engine->FindIntersection(_ToRenderPos(pos));
 
-    HgiBlitCmdsUniquePtr blitCmds = hgi.CreateBlitCmds();
-    blitCmds->CopyTextureGpuToCpu(copyOp);
-    hgi.SubmitCmds(blitCmds.get(), HgiSubmitWaitTypeWaitUntilCompleted);
+    *isPosted = _PostPick(pos, pos);
+    if (*isPosted) return intr;
+
+    return _RaycastBounds(pos);
+}
 
-    return buffer;
+void Viewport::_UpdateHover()
+{
+    // the hover is only sampled from a tile of the picking AOVs, so that it
+    // never executes the picking tasks nor waits on the GPU, once the mouse
+    // moved and until the tile under the mouse was read back
+    if (!_isHovered || ImGui::IsAnyMouseDown() || ImGuizmo::IsOver()) {
+        _hoveredPath = SdfPath();
+        _isHoverPending = false;
+        return;
+    }
+    if (!_hasMouseMoved && !_isHoverPending) return;
+
+    _hasMouseMoved = false;
+    Engine::IntersectionResult intr;
+    PickBuffer* hoverBuffer = _UpdateHoverBuffer(_mousePos, &_isHoverPending);
+    if (hoverBuffer && hoverBuffer->Sample(_ToNormalizedPos(_mousePos), &intr))
+        _hoveredPath = intr.path;
+    else if (!_isHoverPending)
+        _hoveredPath = SdfPath();
 }
 
+void Viewport::_ConfigureImGuizmo()
+{
+    ImGuizmo::BeginFrame();
+
+    // convert last label char to ID
+    string label = GetViewLabel();
+    ImGuizmo::PushID(int(label[label.size() - 1]));
+
+    ImGuizmo::SetDrawlist();
+    ImGuizmo::SetRect(GetInnerRect().Min.x, GetInnerRect().Min.y,
+                      _GetViewportWidth(), _GetViewportHeight());
+}
 
 void Viewport::_UpdateHydraRender()
 {
@@ -260,62 +597,152 @@ void Viewport::_UpdateHydraRender()
     float height = _GetViewportHeight();
 
     // set selection
-    SdfPathVector paths;
-    for (auto&& prim : model->GetSelection())
-        paths.push_back(prim.GetPrimPath());
+    if (model->GetSelectionGeneration() != _selectionGeneration) {
+        _selectionGeneration = model->GetSelectionGeneration();
+        _selection = std::make_shared<const SdfPathVector>(
+            model->GetSelection());
+    }
+
+    // the render is stretched to the viewport when its resolution is scaled
+    _UpdateResolutionScale();
+    _renderSize = GfVec2i(std::max(int(width * _resolutionScale), 1),
+                          std::max(int(height * _resolutionScale), 1));
+
+    // the focused viewport drives the payload streaming, every viewport
+    // culls for its own engine
+    GfCamera cam;
+    cam.SetFromViewAndProjectionMatrix(view, _proj);
+    if (ImGui::IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows))
+        model->GetPayloadStreamer()->SetCamera(cam.GetFrustum());
+    _UpdateCulling(cam.GetFrustum());
+
+    if (_threadedEngine) {
+        _PostRender(view, _hoveredPath);
+
+        void* textureId = _threadedEngine->handoff.Present();
+        _renderMs = _threadedEngine->handoff.TakeRenderMs();
+        if (!textureId) return;
+
+        ImGui::Image((ImTextureID)textureId, ImVec2(width, height),
+                     ImVec2(0, 1), ImVec2(1, 0));
+        _hasPresentedFrame = true;
+        return;
+    }
+
+    if (!_engine) {
+        // the first frame only shows the UI and the status of the renderer
+        if (_isEngineCreationDeferred) {
+            _isEngineCreationDeferred = false;
+            return;
+        }
+        ProfilerScope scope(GetViewLabel() + "/engine creation");
+        _SetEngine(_plugin);
+    }
 
-    _engine->SetSelection(paths);
-    _engine->SetRenderSize(width, height);
+    _engine->SetRenderOnDemand(_isRenderOnDemandEnabled);
+    _engine->SetGridEnabled(_isGridEnabled);
+    _engine->SetAovPickingEnabled(_isAovPickingEnabled);
+    _engine->SetSelection(*_selection, _selectionGeneration);
+    _engine->SetCulledPaths(*_culledPaths, _culledGeneration);
+    _engine->SetHoveredPath(_hoveredPath);
+    _engine->SetRenderSize(_renderSize[0], _renderSize[1]);
     _engine->SetCameraMatrices(view, _proj);
-    _engine->Prepare();
-
-    // do the render
-    _engine->Render();
-
-    auto tc = _engine->GetHdxTaskController();
-    HdRenderBuffer* buffer = tc->GetRenderOutput(HdAovTokens->color);
-    buffer->Resolve();
-    VtValue aov = buffer->GetResource(false);
-    if (aov.IsHolding<HgiTextureHandle>()) {
-        HgiTextureHandle textureHandle = aov.Get<HgiTextureHandle>();
-        if (textureHandle) {
-            HgiTextureDesc const& desc = textureHandle->GetDescriptor();
-
-            Hgi* hgi = _engine->GetHgi();
-            if (hgi) {
-                auto buffer = GetGPUTexture(*hgi,
-                                            textureHandle,
-                                            width, height,
-                                            desc.format);
-
-                if (texcap.width != width || texcap.height != height || texcap.handle < 0) {
-                    if (texcap.handle > 0) {
-                        LabRemoveTexture(texcap.handle);
-                    }
-                    texcap.width = width;
-                    texcap.height = height;
-                    texcap.handle = LabCreateRGBAf16Texture(width, height, buffer);
-                }
-                else {
-                    LabUpdateRGBAf16Texture(texcap.handle, (uint8_t*) buffer);
-                }
 
-                ImGui::Image((ImTextureID) LabTextureHardwareHandle(texcap.handle),
-                             ImVec2(width, height),
-                             ImVec2(0, 1), ImVec2(1, 0));
-            }
+    // do the render only if the last one is out of date
+    const string prefix = GetViewLabel() + "/";
+    bool rendered = _engine->NeedsRender();
+    if (rendered) {
+        {
+            ProfilerScope scope(prefix + "prepare");
+            _engine->Prepare();
+        }
+        {
+            ProfilerScope scope(prefix + "render");
+            _engine->Render();
         }
+        _renderMs = Profiler::GetInstance().GetSample(prefix + "render").lastMs;
     }
+
+    // present the render texture directly if it can be shared with the UI,
+    // otherwise read it back and upload it to a UI texture
+    void* textureId = _engine->GetRenderBufferData();
+    if (!textureId)
+        textureId =
+            rendered ? _ReadbackRenderTexture() : _readbackRing.Present();
+    if (!textureId) return;
+
+    ImGui::Image((ImTextureID)textureId, ImVec2(width, height), ImVec2(0, 1),
+                 ImVec2(1, 0));
+    _hasPresentedFrame = true;
+}
+
+void Viewport::_PostRender(GfMatrix4d view, SdfPath hoveredPath)
+{
+    auto threadedEngine = _threadedEngine;
+    auto selection = _selection;
+    int selectionGeneration = _selectionGeneration;
+    auto culledPaths = _culledPaths;
+    int culledGeneration = _culledGeneration;
+    bool isRenderOnDemand = _isRenderOnDemandEnabled;
+    bool isGridEnabled = _isGridEnabled;
+    bool isAovPickingEnabled = _isAovPickingEnabled;
+    GfVec2i renderSize = _renderSize;
+    GfMatrix4d proj = _proj;
+
+    // the render of the previous UI frame is replaced if it didn't start yet.
+    // The scene mutex is only locked while the Engine changes the render
+    // index, not while the render tasks execute
+    RenderThread::Post(
+        threadedEngine.get(),
+        [=]() {
+            Engine* engine = threadedEngine->engine;
+            if (!engine) return;
+
+            recursive_mutex* sceneMutex = RenderThread::GetSceneMutex();
+            {
+                lock_guard<recursive_mutex> sceneLock(*sceneMutex);
+                engine->SetRenderOnDemand(isRenderOnDemand);
+                engine->SetGridEnabled(isGridEnabled);
+                engine->SetAovPickingEnabled(isAovPickingEnabled);
+                engine->SetSelection(*selection, selectionGeneration);
+                engine->SetCulledPaths(*culledPaths, culledGeneration);
+                engine->SetHoveredPath(hoveredPath);
+                engine->SetRenderSize(renderSize[0], renderSize[1]);
+                engine->SetCameraMatrices(view, proj);
+
+                if (!engine->NeedsRender()) return;
+
+                engine->Prepare();
+            }
+            auto start = std::chrono::steady_clock::now();
+            engine->Render(sceneMutex);
+            std::chrono::duration<double, std::milli> renderMs =
+                std::chrono::steady_clock::now() - start;
+            threadedEngine->handoff.Publish(engine->GetHgi(),
+                                            engine->GetRenderTexture(),
+                                            engine->IsConverged(),
+                                            renderMs.count());
+        },
+        false);
+}
+
+void* Viewport::_ReadbackRenderTexture()
+{
+    return _readbackRing.Update(_engine->GetHgi(),
+                                _engine->GetRenderTexture());
 }
 
 void Viewport::_UpdateTransformGuizmo()
 {
-    SdfPathVector primPaths = GetModel()->GetSelection();
+    const SdfPathVector& primPaths = GetModel()->GetSelection();
     if (primPaths.size() == 0 || primPaths[0].IsEmpty()) return;
 
+    // the gizmo is placed on the first selected prim
     SdfPath primPath = primPaths[0];
 
-    GfMatrix4d transform = _xformSceneIndex->GetXform(primPath);
+    EditOverlaySceneIndexRefPtr overlay =
+        GetModel()->GetEditOverlaySceneIndex();
+    GfMatrix4d transform = overlay->GetXform(primPath);
     GfMatrix4f transformF(transform);
 
     GfMatrix4d view = _getCurViewMatrix();
@@ -326,8 +753,21 @@ void Viewport::_UpdateTransformGuizmo()
     ImGuizmo::Manipulate(viewF.data(), projF.data(), _curOperation, _curMode,
                          transformF.data());
 
-    if (transformF != GfMatrix4f(transform))
-        _xformSceneIndex->SetXform(primPath, GfMatrix4d(transformF));
+    if (transformF == GfMatrix4f(transform)) return;
+
+    // apply the delta of the first prim to the whole selection, and edit
+    // all of them at once so that Hydra syncs them in a single pass
+    GfMatrix4d newTransform(transformF);
+    GfMatrix4d delta = transform.GetInverse() * newTransform;
+
+    vector<GfMatrix4d> xforms;
+    xforms.reserve(primPaths.size());
+    xforms.push_back(newTransform);
+    for (size_t i = 1; i < primPaths.size(); i++)
+        xforms.push_back(overlay->GetXform(primPaths[i]) * delta);
+
+    lock_guard<recursive_mutex> lock(GetModel()->GetSceneMutex());
+    overlay->SetXforms(primPaths, xforms);
 }
 
 void Viewport::_UpdateCubeGuizmo()
@@ -342,6 +782,7 @@ void Viewport::_UpdateCubeGuizmo()
         ImVec2(128, 128), IM_COL32_BLACK_TRANS);
 
     if (viewF != currView) {
+        _NotifyCameraMove();
         view = GfMatrix4d(viewF);
         GfFrustum frustum;
         frustum.SetPositionAndRotationFromMatrix(view.GetInverse());
@@ -354,8 +795,7 @@ void Viewport::_UpdateCubeGuizmo()
 
 void Viewport::_UpdatePluginLabel()
 {
-    TfToken curPlugin = _engine->GetCurrentRendererPlugin();
-    string pluginText = _engine->GetRendererPluginName(curPlugin);
+    string pluginText = Engine::GetRendererPluginName(_plugin);
     string text = pluginText;
 
     ImDrawList* draw_list = ImGui::GetWindowDrawList();
@@ -372,10 +812,60 @@ void Viewport::_UpdatePluginLabel()
     // draw text
     draw_list->AddText(ImVec2(xPos, yPos), ImColor(1.f, 1.f, 1.f),
                        text.c_str());
+
+    _pluginLabelPos = ImVec2(xPos - margin, yPos - margin);
+}
+
+void Viewport::_UpdateStatsOverlay()
+{
+    Profiler& profiler = Profiler::GetInstance();
+
+    // build the overlay text from the samples of this viewport
+    const string prefix = GetViewLabel() + "/";
+    Profiler::Sample frame = profiler.GetFrameSample();
+
+    string text = TfStringPrintf("frame      %6.2f ms (%.0f fps)",
+                                 frame.averageMs,
+                                 frame.averageMs > 0 ? 1000 / frame.averageMs
+                                                     : 0.0);
+    for (auto&& sample : profiler.GetSamples(prefix)) {
+        string name = sample.first.substr(prefix.size());
+        text += TfStringPrintf("\n%-10s %6.2f ms", name.c_str(),
+                               sample.second.averageMs);
+    }
+    for (auto&& counter : profiler.GetCounterDeltas()) {
+        text += TfStringPrintf("\n%s %.0f", counter.first.GetText(),
+                               counter.second);
+    }
+    size_t culled = _culledPaths->size();
+    if (culled > 0) text += TfStringPrintf("\nculled %zu prims", culled);
+    if (_resolutionScale < 1.f)
+        text += TfStringPrintf("\nresolution %.0f%%", _resolutionScale * 100);
+    bool isConverged = _threadedEngine ? _threadedEngine->handoff.IsConverged()
+                                       : !_engine || _engine->IsConverged();
+    if (!isConverged) text += "\nconverging...";
+
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+
+    // draw the overlay on the left of the plugin label
+    ImVec2 textSize = ImGui::CalcTextSize(text.c_str());
+    float margin = 6;
+    float xPos = _pluginLabelPos.x - margin * 2 - textSize.x;
+    float yPos = _pluginLabelPos.y + margin;
+    // draw background color
+    draw_list->AddRectFilled(
+        ImVec2(xPos - margin, yPos - margin),
+        ImVec2(xPos + textSize.x + margin, yPos + textSize.y + margin),
+        ImColor(.0f, .0f, .0f, .2f), margin);
+    // draw text
+    draw_list->AddText(ImVec2(xPos, yPos), ImColor(1.f, 1.f, 1.f),
+                       text.c_str());
 }
 
 void Viewport::_PanActiveCam(ImVec2 mouseDeltaPos)
 {
+    _NotifyCameraMove();
+
     GfVec3d camFront = _at - _eye;
     GfVec3d camRight = GfCross(camFront, _up).GetNormalized();
     GfVec3d camUp = GfCross(camRight, camFront).GetNormalized();
@@ -391,6 +881,8 @@ void Viewport::_PanActiveCam(ImVec2 mouseDeltaPos)
 
 void Viewport::_OrbitActiveCam(ImVec2 mouseDeltaPos)
 {
+    _NotifyCameraMove();
+
     GfRotation rot(_up, mouseDeltaPos.x / 2);
     GfMatrix4d rotMatrix = GfMatrix4d(1).SetRotate(rot);
     GfVec3d e = _eye - _at;
@@ -426,6 +918,8 @@ void Viewport::_OrbitActiveCam(ImVec2 mouseDeltaPos)
 
 void Viewport::_ZoomActiveCam(ImVec2 mouseDeltaPos)
 {
+    _NotifyCameraMove();
+
     GfVec3d camToFocus = _eye - _at;
     float focusDistance = camToFocus.GetLength();
     const float feel = 0.02f;
@@ -438,6 +932,8 @@ void Viewport::_ZoomActiveCam(ImVec2 mouseDeltaPos)
 
 void Viewport::_ZoomActiveCam(float scrollWheel)
 {
+    _NotifyCameraMove();
+
     GfVec3d camToFocus = _eye - _at;
     float focusDistance = camToFocus.GetLength();
     const float feel = 0.02f;
@@ -448,14 +944,170 @@ void Viewport::_ZoomActiveCam(float scrollWheel)
     _UpdateActiveCamFromViewport();
 }
 
+void Viewport::_NotifyCameraMove()
+{
+    _lastCameraMove = std::chrono::steady_clock::now();
+}
+
+void Viewport::_UpdateResolutionScale()
+{
+    auto now = std::chrono::steady_clock::now();
+    bool isCameraMoving = _isAdaptiveResolutionEnabled &&
+                          now - _lastCameraMove < CAMERA_MOVE_TIMEOUT;
+
+    // the render time only reflects the scaled render if the previous frame
+    // was already rendered while moving. It is measured on the render itself,
+    // the UI frame time being capped by the vsync
+    float renderMs = float(_renderMs);
+    _renderMs = 0;
+    if (isCameraMoving && _wasCameraMoving && renderMs > 0) {
+        if (renderMs > _renderBudgetMs * 1.2f ||
+            renderMs < _renderBudgetMs * 0.8f) {
+            // the render time is roughly proportional to the pixel count
+            float scale =
+                _movingResolutionScale * sqrt(_renderBudgetMs / renderMs);
+            scale = round(scale * RESOLUTION_SCALE_STEPS) /
+                    RESOLUTION_SCALE_STEPS;
+            _movingResolutionScale =
+                std::clamp(scale, MIN_RESOLUTION_SCALE, 1.f);
+        }
+    }
+
+    // once the camera stops, the full resolution render is refined by the
+    // render delegate until it converges (e.g. progressive path tracing)
+    _resolutionScale = isCameraMoving ? _movingResolutionScale : 1.f;
+    _wasCameraMoving = isCameraMoving;
+}
+
+GfVec2f Viewport::_ToRenderPos(ImVec2 pos)
+{
+    if (_renderSize[0] <= 0 || _renderSize[1] <= 0)
+        return GfVec2f(pos.x, pos.y);
+
+    return GfVec2f(pos.x * _renderSize[0] / _GetViewportWidth(),
+                   pos.y * _renderSize[1] / _GetViewportHeight());
+}
+
+GfVec2f Viewport::_ToNormalizedPos(ImVec2 pos)
+{
+    return GfVec2f(pos.x / _GetViewportWidth(),
+                   pos.y / _GetViewportHeight());
+}
+
+GfFrustum Viewport::_GetFrustum()
+{
+    GfCamera cam;
+    cam.SetFromViewAndProjectionMatrix(_getCurViewMatrix(), _proj);
+    return cam.GetFrustum();
+}
+
+Engine::IntersectionResult Viewport::_RaycastBounds(ImVec2 pos)
+{
+    GfVec2d ndc(2.0 * pos.x / _GetViewportWidth() - 1.0,
+                1.0 - 2.0 * pos.y / _GetViewportHeight());
+    GfRay ray = _GetFrustum().ComputePickRay(ndc);
+
+    SdfPath primPath;
+    GfVec3d hitPoint, hitNormal;
+    lock_guard<recursive_mutex> lock(GetModel()->GetSceneMutex());
+    if (!GetModel()->GetBoundsSceneIndex()->Raycast(ray, &primPath, &hitPoint,
+                                                   &hitNormal))
+        return {};
+
+    return {primPath, GfVec3f(hitPoint), GfVec3f(hitNormal)};
+}
+
+SdfPathVector Viewport::_FindPrimsInRegion(ImVec2 startPos, ImVec2 endPos)
+{
+    float width = _GetViewportWidth();
+    float height = _GetViewportHeight();
+
+    // the half extent of the rectangle in normalized coordinates, at least
+    // a pixel wide
+    GfVec2d center((startPos.x + endPos.x) / width - 1.0,
+                   1.0 - (startPos.y + endPos.y) / height);
+    GfVec2d size(std::max(double(fabs(endPos.x - startPos.x)), 1.0) / width,
+                 std::max(double(fabs(endPos.y - startPos.y)), 1.0) / height);
+
+    GfFrustum frustum = _GetFrustum().ComputeNarrowedFrustum(center, size);
+    lock_guard<recursive_mutex> lock(GetModel()->GetSceneMutex());
+    return GetModel()->GetBoundsSceneIndex()->FindIntersecting(frustum);
+}
+
+void Viewport::_UpdateCulling(const GfFrustum& frustum)
+{
+    BoundsSceneIndexRefPtr bounds = GetModel()->GetBoundsSceneIndex();
+    if (!_isCullingEnabled || Engine::IsFrustumCullingNative(_plugin)) {
+        if (_culledPaths->empty()) return;
+
+        _culledPaths = std::make_shared<const SdfPathVector>();
+        _culledGeneration++;
+        return;
+    }
+
+    const bool isCameraMoving = frustum != _previousFrustum;
+    _previousFrustum = frustum;
+    if (bounds->GetGeneration() == _cullingBoundsGeneration &&
+        frustum == _cullingFrustum)
+        return;
+
+    // while the camera moves, the padding of the last culling keeps the
+    // prims entering the view, until the camera turns or moves past it
+    if (isCameraMoving && _cullingBoundsGeneration >= 0) {
+        const GfVec2d windowSize = frustum.GetWindow().GetSize();
+        const double halfSize = std::min(windowSize[0], windowSize[1]) / 2;
+        const double maxAngle =
+            frustum.GetProjectionType() == GfFrustum::Perspective
+                ? GfRadiansToDegrees(atan(halfSize * CULLING_PADDING) -
+                                     atan(halfSize))
+                : 0;
+        const GfVec3d viewDir = frustum.ComputeViewDirection();
+        const double angle = GfRadiansToDegrees(
+            acos(std::clamp(GfDot(viewDir,
+                                  _cullingFrustum.ComputeViewDirection()),
+                            -1.0, 1.0)));
+        const double move =
+            (frustum.GetPosition() - _cullingFrustum.GetPosition())
+                .GetLength();
+        if (angle < maxAngle &&
+            move < CULLING_MAX_MOVE * (_at - _eye).GetLength())
+            return;
+    }
+
+    unique_lock<recursive_mutex> lock(GetModel()->GetSceneMutex(),
+                                      try_to_lock);
+    if (!lock.owns_lock()) return;
+
+    _cullingBoundsGeneration = bounds->GetGeneration();
+    _cullingFrustum = frustum;
+
+    const GfRange2d window = frustum.GetWindow();
+    const GfVec2d halfPadded = window.GetSize() * CULLING_PADDING / 2;
+    GfFrustum paddedFrustum = frustum;
+    paddedFrustum.SetWindow(GfRange2d(window.GetMidpoint() - halfPadded,
+                                      window.GetMidpoint() + halfPadded));
+
+    {
+        ProfilerScope scope(GetViewLabel() + "/culling");
+        bounds->FindOutside(paddedFrustum, &_outsidePaths);
+    }
+    if (_outsidePaths == *_culledPaths) return;
+
+    _culledPaths = std::make_shared<const SdfPathVector>(_outsidePaths);
+    _culledGeneration++;
+}
+
 void Viewport::_SetFreeCamAsActive()
 {
+    _PublishActiveCam();
     _activeCam = SdfPath();
 }
 
 void Viewport::_SetActiveCam(SdfPath primPath)
 {
+    _PublishActiveCam();
     _activeCam = primPath;
+    _isActiveCamCached = false;
     _UpdateViewportFromActiveCam();
 }
 
@@ -464,12 +1116,13 @@ void Viewport::_UpdateViewportFromActiveCam()
     if (_activeCam.IsEmpty())
         return;
 
+    // a pending edit is published before the camera is read back
+    _PublishActiveCam();
+
     auto model = GetModel();
     model->SetActiveCamera(_activeCam);
 
-    HdSceneIndexPrim prim = model->GetFinalSceneIndex()->GetPrim(_activeCam);
-    GfCamera gfCam = _ToGfCamera(prim);
-    GfFrustum frustum = gfCam.GetFrustum();
+    GfFrustum frustum = _GetActiveGfCamera().GetFrustum();
     _eye = frustum.GetPosition();
     _at = frustum.ComputeLookAtPoint();
 }
@@ -484,19 +1137,55 @@ void Viewport::_UpdateActiveCamFromViewport()
     if (_activeCam.IsEmpty())
         return;
 
-    HdSceneIndexPrim prim = GetModel()->GetFinalSceneIndex()->GetPrim(_activeCam);
-    GfCamera gfCam = _ToGfCamera(prim);
+    // while dragging, the render follows the viewport matrices, so the
+    // camera prim isn't dirtied and synced on every mouse move
+    _isActiveCamXformDirty = true;
+    if (!_isCameraDragging) _PublishActiveCam();
+}
+
+GfCamera Viewport::_GetActiveGfCamera(bool* isRefreshed)
+{
+    auto model = GetModel();
+    int editGeneration =
+        model->GetEditOverlaySceneIndex()->GetEditGeneration();
+    UsdTimeCode time = model->GetTime();
+
+    // the pending xform isn't in the scene yet, so the other edits don't
+    // invalidate the cache while dragging
+    bool isOutdated = !_isActiveCamCached || time != _activeCamTime ||
+                      (editGeneration != _activeCamEditGeneration &&
+                       !_isActiveCamXformDirty);
+    if (isOutdated) {
+        HdSceneIndexPrim prim =
+            model->GetFinalSceneIndex()->GetPrim(_activeCam);
+        _activeCamCache = _ToGfCamera(prim);
+        _activeCamTime = time;
+        _activeCamEditGeneration = editGeneration;
+        _isActiveCamCached = true;
+    }
+    if (isRefreshed) *isRefreshed = isOutdated;
+    return _activeCamCache;
+}
 
-    GfFrustum prevFrustum = gfCam.GetFrustum();
+void Viewport::_PublishActiveCam()
+{
+    if (!_isActiveCamXformDirty) return;
+    _isActiveCamXformDirty = false;
+    if (_activeCam.IsEmpty()) return;
 
-    GfMatrix4d view = _getCurViewMatrix();
-    GfMatrix4d prevView = prevFrustum.ComputeViewMatrix();
-    GfMatrix4d prevProj = prevFrustum.ComputeProjectionMatrix();
+    GfMatrix4d xform = _getCurViewMatrix().GetInverse();
+    if (_GetActiveGfCamera().GetTransform() == xform) return;
 
-    if (view == prevView && _proj == prevProj)
-        return;
+    auto model = GetModel();
+    EditOverlaySceneIndexRefPtr overlay = model->GetEditOverlaySceneIndex();
+    {
+        lock_guard<recursive_mutex> lock(model->GetSceneMutex());
+        overlay->SetXform(_activeCam, xform);
+    }
 
-    _xformSceneIndex->SetXform(_activeCam, view.GetInverse());
+    // the cache follows the published edit without reading the scene back
+    _activeCamCache.SetTransform(xform);
+    _activeCamEditGeneration = overlay->GetEditGeneration();
 }
 
 void Viewport::_UpdateProjection()
@@ -506,8 +1195,7 @@ void Viewport::_UpdateProjection()
     float farPlane = _FREE_CAM_FAR;
 
     if (!_activeCam.IsEmpty()) {
-        HdSceneIndexPrim prim = GetModel()->GetFinalSceneIndex()->GetPrim(_activeCam);
-        GfCamera gfCam = _ToGfCamera(prim);
+        GfCamera gfCam = _GetActiveGfCamera();
         fov = gfCam.GetFieldOfView(GfCamera::FOVVertical);
         nearPlane = gfCam.GetClippingRange().GetMin();
         farPlane = gfCam.GetClippingRange().GetMax();
@@ -563,29 +1251,65 @@ GfCamera Viewport::_ToGfCamera(HdSceneIndexPrim prim)
     return cam;
 }
 
-void Viewport::_FocusOnPrim(SdfPath primPath)
+void Viewport::_UpdateLoadingStatus()
 {
-    if (primPath.IsEmpty()) return;
+    string text = GetModel()->GetLoadingStatus();
 
-    HdSceneIndexPrim prim = GetModel()->GetFinalSceneIndex()->GetPrim(primPath);
+    // the renderer is starting until its first frame is presented
+    if (text.empty() && !_hasPresentedFrame) text = "starting renderer...";
+    if (text.empty()) return;
 
-    HdExtentSchema extentSchema =
-        HdExtentSchema::GetFromParent(prim.dataSource);
-    if (!extentSchema.IsDefined()) {
-        TF_WARN("Prim at %s has no extent; skipping focus.",
-                primPath.GetAsString().c_str());
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+
+    ImVec2 textSize = ImGui::CalcTextSize(text.c_str());
+    float margin = 6;
+    ImVec2 pos = GetInnerRect().GetCenter() - textSize / 2;
+    // draw background color
+    draw_list->AddRectFilled(pos - ImVec2(margin, margin),
+                             pos + textSize + ImVec2(margin, margin),
+                             ImColor(.0f, .0f, .0f, .4f), margin);
+    // draw text
+    draw_list->AddText(pos, ImColor(1.f, 1.f, 1.f), text.c_str());
+}
+
+void Viewport::_UpdateMarquee()
+{
+    if (!_isMarqueeActive) return;
+
+    // the release may happen outside of the viewport
+    if (!ImGui::IsMouseDown(ImGuiMouseButton_Left)) {
+        _isMarqueeActive = false;
         return;
     }
 
-    HdSampledDataSource::Time time(0);
-    GfVec3d extentMin = extentSchema.GetMin()->GetValue(time).Get<GfVec3d>();
-    GfVec3d extentMax = extentSchema.GetMax()->GetValue(time).Get<GfVec3d>();
+    ImVec2 delta = ImGui::GetMouseDragDelta(ImGuiMouseButton_Left);
+    ImVec2 startPos = GetInnerRect().Min + _marqueeStartPos;
 
-    GfRange3d extentRange(extentMin, extentMax);
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    draw_list->AddRectFilled(startPos, startPos + delta,
+                             ImColor(1.f, 1.f, 1.f, .1f));
+    draw_list->AddRect(startPos, startPos + delta, ImColor(1.f, 1.f, 1.f));
+}
+
+void Viewport::_FocusOnPrim(SdfPath primPath)
+{
+    if (primPath.IsEmpty()) return;
+
+    // the bounds of the descendants are used for the prims without extent
+    GfRange3d bounds;
+    {
+        lock_guard<recursive_mutex> lock(GetModel()->GetSceneMutex());
+        bounds = GetModel()->GetBoundsSceneIndex()->GetWorldBounds(primPath);
+    }
+    if (bounds.IsEmpty()) {
+        TF_WARN("Prim at %s has no bounds; skipping focus.",
+                primPath.GetAsString().c_str());
+        return;
+    }
 
-    _at = extentRange.GetMidpoint();
+    _at = bounds.GetMidpoint();
     _eye = _at + (_eye - _at).GetNormalized() *
-                     extentRange.GetSize().GetLength() * 2;
+                     bounds.GetSize().GetLength() * 2;
 
     _UpdateActiveCamFromViewport();
 }
@@ -593,7 +1317,7 @@ void Viewport::_FocusOnPrim(SdfPath primPath)
 void Viewport::_KeyPressEvent(ImGuiKey key)
 {
     if (key == ImGuiKey_F) {
-        SdfPathVector primPaths = GetModel()->GetSelection();
+        const SdfPathVector& primPaths = GetModel()->GetSelection();
         if (primPaths.size() > 0) _FocusOnPrim(primPaths[0]);
     }
     else if (key == ImGuiKey_W) {
@@ -610,55 +1334,118 @@ void Viewport::_KeyPressEvent(ImGuiKey key)
     }
 }
 
+void Viewport::_MousePressEvent(ImGuiMouseButton_ button, ImVec2 mousePos)
+{
+    // the cube gizmo is drawn in the top right corner of the viewport
+    bool isOverCubeGuizmo = mousePos.x > _GetViewportWidth() - 128 &&
+                            mousePos.y > 18 && mousePos.y < 18 + 128;
+
+    // left drag without modifier and outside of the gizmos selects a region
+    _isMarqueeActive = button == ImGuiMouseButton_Left &&
+                       !ImGuizmo::IsOver() && !isOverCubeGuizmo &&
+                       !ImGui::IsKeyDown(ImGuiKey_LeftAlt) &&
+                       !ImGui::IsKeyDown(ImGuiKey_RightAlt) &&
+                       !ImGui::IsKeyDown(ImGuiKey_LeftShift) &&
+                       !ImGui::IsKeyDown(ImGuiKey_RightShift);
+    _marqueeStartPos = mousePos;
+}
+
 void Viewport::_MouseMoveEvent(ImVec2 prevPos, ImVec2 curPos)
 {
     ImVec2 deltaMousePos = curPos - prevPos;
 
+    if (curPos.x != _mousePos.x || curPos.y != _mousePos.y) {
+        _mousePos = curPos;
+        _hasMouseMoved = true;
+    }
+
     ImGuiIO& io = ImGui::GetIO();
     if (io.MouseWheel) _ZoomActiveCam(io.MouseWheel);
 
+    // the drag is set before the camera moves, so that the move isn't
+    // published to the scene until the drag ends
     if (ImGui::IsMouseDown(ImGuiMouseButton_Left) &&
         (ImGui::IsKeyDown(ImGuiKey_LeftAlt) ||
          ImGui::IsKeyDown(ImGuiKey_RightAlt))) {
+        _isCameraDragging = true;
         _OrbitActiveCam(deltaMousePos);
     }
     if (ImGui::IsMouseDown(ImGuiMouseButton_Left) &&
         (ImGui::IsKeyDown(ImGuiKey_LeftShift) ||
          ImGui::IsKeyDown(ImGuiKey_RightShift))) {
+        _isCameraDragging = true;
         _PanActiveCam(deltaMousePos);
     }
     if (ImGui::IsMouseDown(ImGuiMouseButton_Right) &&
         (ImGui::IsKeyDown(ImGuiKey_LeftAlt) ||
          ImGui::IsKeyDown(ImGuiKey_RightAlt))) {
+        _isCameraDragging = true;
         _ZoomActiveCam(deltaMousePos);
     }
 }
 
 void Viewport::_MouseReleaseEvent(ImGuiMouseButton_ button, ImVec2 mousePos)
 {
+    // the camera edit of the drag is published on the next draw
+    if (!ImGui::IsMouseDown(ImGuiMouseButton_Left) &&
+        !ImGui::IsMouseDown(ImGuiMouseButton_Right))
+        _isCameraDragging = false;
+
     if (button == ImGuiMouseButton_Left) {
         ImVec2 delta = ImGui::GetMouseDragDelta(ImGuiMouseButton_Left);
         if (fabs(delta.x) + fabs(delta.y) < 0.001f) {
-            GfVec2f gfMousePos(mousePos[0], mousePos[1]);
-            Engine::IntersectionResult intr = _engine->FindIntersection(gfMousePos);
+            ProfilerScope scope(GetViewLabel() + "/pick");
+            bool isPosted;
+            Engine::IntersectionResult intr =
+                _FindIntersection(mousePos, &isPosted);
 
-            if (intr.path.IsEmpty())
+            // a pick posted to the render thread is selected once done
+            if (!isPosted && intr.path.IsEmpty())
                 GetModel()->SetSelection({});
-            else {
+            else if (!isPosted) {
                 GetModel()->SetSelection({intr.path});
                 GetModel()->SetHit(intr.worldSpaceHitPoint, intr.worldSpaceHitNormal);
             }
         }
+        else if (_isMarqueeActive) {
+            GfVec2f gfStartPos = _ToRenderPos(_marqueeStartPos);
+            GfVec2f gfMousePos = _ToRenderPos(mousePos);
+            ProfilerScope scope(GetViewLabel() + "/pick");
+            SdfPathVector primPaths;
+            bool isPosted = false;
+            PickBuffer* pickBuffer = _UpdatePickBuffer();
+            if (pickBuffer) {
+                primPaths = pickBuffer->FindPaths(
+                    _ToNormalizedPos(_marqueeStartPos),
+                    _ToNormalizedPos(mousePos));
+            }
+            else if (_IsGpuPickingSupported()) {
+                vector<Engine::IntersectionResult> intrs =
+                    _engine->FindIntersections(gfStartPos, gfMousePos);
+                for (auto&& intr : intrs) primPaths.push_back(intr.path);
+            }
+            else {
+                isPosted = _PostPick(_marqueeStartPos, mousePos);
+                if (!isPosted)
+                    primPaths = _FindPrimsInRegion(_marqueeStartPos, mousePos);
+            }
+            // a pick posted to the render thread is selected once done
+            if (!isPosted) GetModel()->SetSelection(primPaths);
+        }
+        _isMarqueeActive = false;
     }
 }
 
 void Viewport::_HoverInEvent()
 {
     _gizmoWindowFlags |= ImGuiWindowFlags_NoMove;
+    _isHovered = true;
+    _hasMouseMoved = true;
 }
 void Viewport::_HoverOutEvent()
 {
     _gizmoWindowFlags &= ~ImGuiWindowFlags_NoMove;
+    _isHovered = false;
 }
 
 PXR_NAMESPACE_CLOSE_SCOPE
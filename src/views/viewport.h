@@ -18,11 +18,20 @@
 #include <imgui_internal.h>
 // clang-format on
 #include <ImGuizmo.h>
+#include <pxr/base/gf/camera.h>
 #include <pxr/usd/usd/prim.h>
 
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "aovreadbackring.h"
 #include "engine.h"
-#include "sceneindices/gridsceneindex.h"
-#include "sceneindices/xformfiltersceneindex.h"
+#include "framehandoff.h"
+#include "memorytracker.h"
+#include "pickbuffer.h"
 #include "view.h"
 
 PXR_NAMESPACE_OPEN_SCOPE
@@ -71,19 +80,110 @@ class Viewport : public View {
         const float _FREE_CAM_FAR = 10000.f;
 
         bool _isAmbientLightEnabled, _isDomeLightEnabled, _isGridEnabled;
+        bool _isRenderOnDemandEnabled, _isStatsEnabled;
+        bool _isMarqueeActive;
+        ImVec2 _pluginLabelPos, _marqueeStartPos;
+
+        // the hovered prim is sampled from a tile of the picking AOVs when
+        // the mouse moves over the viewport, and until the tile under the
+        // mouse was read back
+        bool _isAovPickingEnabled, _isHovered, _hasMouseMoved;
+        bool _isHoverPending;
+        ImVec2 _mousePos;
+        pxr::SdfPath _hoveredPath;
+
+        // the selection is only copied when its generation changes, and
+        // shared with the render thread jobs
+        std::shared_ptr<const pxr::SdfPathVector> _selection;
+        int _selectionGeneration;
+
+        // the prims culled by the engine of this viewport, recomputed when
+        // the bounds change or the camera stops or moves past the padding of
+        // the last culling frustum
+        bool _isCullingEnabled;
+        std::shared_ptr<const pxr::SdfPathVector> _culledPaths;
+        int _culledGeneration, _cullingBoundsGeneration;
+        pxr::GfFrustum _cullingFrustum, _previousFrustum;
+        pxr::SdfPathVector _outsidePaths;
+
+        // the render size follows a fraction of the viewport size while the
+        // camera moves, adapted to the render time budget. The duration of
+        // the last render is 0 once taken into account
+        bool _isAdaptiveResolutionEnabled, _wasCameraMoving;
+        float _resolutionScale, _movingResolutionScale, _renderBudgetMs;
+        double _renderMs;
+        std::chrono::steady_clock::time_point _lastCameraMove;
+        pxr::GfVec2i _renderSize;
         pxr::SdfPath _activeCam;
 
+        // the active camera is read from the scene once per time or edit,
+        // and while it is dragged its xform is only published to the scene
+        // when the drag ends, the render following the viewport matrices
+        pxr::GfCamera _activeCamCache;
+        bool _isActiveCamCached, _isActiveCamXformDirty;
+        // set while this viewport orbits, pans or zooms with the mouse
+        bool _isCameraDragging;
+        pxr::UsdTimeCode _activeCamTime;
+        int _activeCamEditGeneration;
+
         pxr::GfVec3d _eye, _at, _up;
         pxr::GfMatrix4d _proj;
 
+        /**
+         * @brief The Engine used by the jobs of the render thread, which
+         * hand its frames over to the UI
+         *
+         */
+        struct _ThreadedEngine {
+                Engine* engine = nullptr;
+                FrameHandoff handoff;
+                PickBuffer pickBuffer, hoverBuffer;
+                std::atomic<bool> isPickingSupported = false;
+
+                // the result of a GPU pick done by the render thread, set
+                // as the selection by the UI thread
+                std::mutex pickMutex;
+                bool hasPickResult = false;
+                pxr::SdfPathVector pickedPaths;
+                Engine::IntersectionResult pickHit;
+
+                // the position of the last hover tile update, and whether
+                // the hover buffer covered it for the last render
+                pxr::GfVec2f hoverPos;
+                bool isHoverCurrent = false;
+
+                // the memory entries of the Engine, gathered by the render
+                // thread
+                std::mutex memoryMutex;
+                std::vector<MemoryTracker::Entry> memoryEntries;
+        };
+
+        // with the render thread, the Engine is only used by the render
+        // thread jobs, otherwise the UI thread uses it directly
         Engine* _engine;
-        pxr::GridSceneIndexRefPtr _gridSceneIndex;
-        pxr::XformFilterSceneIndexRefPtr _xformSceneIndex;
+        std::shared_ptr<_ThreadedEngine> _threadedEngine;
+
+        // without the render thread, the Engine is only created once the
+        // viewport was drawn, so that the UI shows before the renderer
+        // initializes
+        bool _isEngineCreationDeferred, _hasPresentedFrame;
+        pxr::TfToken _plugin;
+        AovReadbackRing _readbackRing;
+        PickBuffer _pickBuffer, _hoverBuffer;
+        int _memorySourceId;
         ImGuiWindowFlags _gizmoWindowFlags;
 
         ImGuizmo::OPERATION _curOperation;
         ImGuizmo::MODE _curMode;
 
+        /**
+         * @brief Append the memory of the viewport and its Engine to the
+         * MemoryTracker entries
+         *
+         * @param entries the entries of the MemoryTracker
+         */
+        void _AddMemoryEntries(vector<MemoryTracker::Entry>& entries);
+
         /**
          * @brief Get the width of the viewport
          *
@@ -111,16 +211,115 @@ class Viewport : public View {
         void _DrawMenuBar();
 
         /**
-         * @brief Configure ImGuizmo
+         * @brief Draw the menu of the cached renderers, to release them or
+         * set their memory budget
          *
          */
-        void _ConfigureImGuizmo();
+        void _DrawIdleRenderersMenu();
+
+        /**
+         * @brief Release the cached renderers of the given renderer plugin,
+         * on the render thread if it is running
+         *
+         * @param plugin the renderer plugin, or an empty token for all the
+         * cached renderers
+         */
+        void _ReleaseIdleRenderers(pxr::TfToken plugin);
 
         /**
-         * @brief Update the grid within the viewport
+         * @brief Replace the Engine of the viewport by a new one, created on
+         * the render thread if it is running
          *
+         * @param plugin the renderer plugin of the new Engine
          */
-        void _UpdateGrid();
+        void _SetEngine(pxr::TfToken plugin);
+
+        /**
+         * @brief Check if the Engine can pick from the render on the GPU
+         *
+         * @return true if the GPU picking is supported
+         * @return false if the picking must fall back to the bounds
+         */
+        bool _IsGpuPickingSupported();
+
+        /**
+         * @brief Post a GPU pick of the given region to the render thread,
+         * which owns the Engine. The picked prims are selected once the
+         * result is handed back.
+         *
+         * @param startPos a corner of the region, in the viewport
+         * @param endPos the opposite corner, equal to startPos for a click
+         * @return true if the pick was posted
+         * @return false if there is no render thread or its Engine doesn't
+         * support the picking tasks
+         */
+        bool _PostPick(ImVec2 startPos, ImVec2 endPos);
+
+        /**
+         * @brief Set the result of the last GPU pick done by the render
+         * thread as the selection, if it was handed back
+         *
+         */
+        void _ApplyPickResult();
+
+        /**
+         * @brief Capture the picking AOVs of the last render, on the render
+         * thread if it is running, in which case the previous capture is
+         * returned meanwhile
+         *
+         * @return the pick buffer, or nullptr if the picking AOVs are not
+         * available
+         */
+        PickBuffer* _UpdatePickBuffer();
+
+        /**
+         * @brief Read back a tile of the picking AOVs of the last render
+         * around the given position, on the render thread if it is running.
+         * The tile is read back without waiting on the GPU, so the previous
+         * tile is returned meanwhile.
+         *
+         * @param pos the position in the viewport
+         * @param isPending set to true if the returned buffer doesn't cover
+         * the position for the last render yet
+         * @return the hover buffer, or nullptr if the picking AOVs are not
+         * available
+         */
+        PickBuffer* _UpdateHoverBuffer(ImVec2 pos, bool* isPending);
+
+        /**
+         * @brief Find the Prim under the given position, from the pick
+         * buffer if available, otherwise with the picking tasks or the
+         * bounds. With the render thread, the picking tasks are posted to it
+         * (see _PostPick).
+         *
+         * @param pos the position in the viewport
+         * @param isPosted set to true if the pick was posted to the render
+         * thread, in which case the returned intersection is empty
+         * @return the intersection, with an empty path if no Prim is hit
+         */
+        pxr::Engine::IntersectionResult _FindIntersection(ImVec2 pos,
+                                                          bool* isPosted);
+
+        /**
+         * @brief Update the Prim highlighted under the cursor from the hover
+         * buffer
+         *
+         */
+        void _UpdateHover();
+
+        /**
+         * @brief Post the render of the current frame to the render thread
+         *
+         * @param view the view matrix of the frame
+         * @param hoveredPath the hovered path
+         */
+        void _PostRender(pxr::GfMatrix4d view, pxr::SdfPath hoveredPath);
+
+        /**
+         * @brief Configure ImGuizmo
+         *
+         */
+        void _ConfigureImGuizmo();
 
         /**
          * @brief Update the USD render
@@ -128,6 +327,16 @@ class Viewport : public View {
          */
         void _UpdateHydraRender();
 
+        /**
+         * @brief Read the render texture back to the CPU and upload it to a
+         * UI texture. Fallback for render textures that can't be shared
+         * with the UI.
+         *
+         * @return the native handle of the UI texture, or nullptr if no
+         * readback has completed yet
+         */
+        void* _ReadbackRenderTexture();
+
         /**
          * @brief Update the transform Guizmo (the 3 axis of a selection)
          *
@@ -147,6 +356,13 @@ class Viewport : public View {
          */
         void _UpdatePluginLabel();
 
+        /**
+         * @brief Update the overlay of the timings and the Hydra counters of
+         * the viewport (next to the plugin label)
+         *
+         */
+        void _UpdateStatsOverlay();
+
         /**
          * @brief Pan the active camera by the mouse position delta
          *
@@ -175,6 +391,81 @@ class Viewport : public View {
          */
         void _ZoomActiveCam(float scrollWheel);
 
+        /**
+         * @brief Record that the camera moved, so that the next frames are
+         * rendered at the adaptive resolution
+         *
+         */
+        void _NotifyCameraMove();
+
+        /**
+         * @brief Update the resolution scale of the render. While the camera
+         * moves, the scale is adapted so that the measured render time
+         * meets the budget, and it goes back to the full resolution once the
+         * camera stops.
+         *
+         */
+        void _UpdateResolutionScale();
+
+        /**
+         * @brief Convert a position in the viewport to a position in the
+         * render, which is smaller while the resolution is scaled down
+         *
+         * @param pos the position in the viewport
+         * @return the position in the render
+         */
+        pxr::GfVec2f _ToRenderPos(ImVec2 pos);
+
+        /**
+         * @brief Convert a position in the viewport to a position normalized
+         * by the viewport size, as sampled in the pick buffer
+         *
+         * @param pos the position in the viewport
+         * @return the normalized position
+         */
+        pxr::GfVec2f _ToNormalizedPos(ImVec2 pos);
+
+        /**
+         * @brief Get the world space frustum of the viewport
+         *
+         * @return the frustum
+         */
+        pxr::GfFrustum _GetFrustum();
+
+        /**
+         * @brief Find the Prim under the given position with the Bounds
+         * Scene Index, for the renderers without picking support
+         *
+         * @param pos the position in the viewport
+         * @return the intersection, with an empty path if no Prim is hit
+         */
+        pxr::Engine::IntersectionResult _RaycastBounds(ImVec2 pos);
+
+        /**
+         * @brief Update the prims culled by the engine from the bounds
+         * outside of the given frustum, padded so that the prims entering the
+         * view aren't missing while the camera moves. Every change of the
+         * culled prims filters the draw items of the engine again, so the
+         * culling is only updated when the camera stops or moves past the
+         * padding, and only with the renderers that don't cull by themselves.
+         * The culling is kept as is while the scene is locked by the render
+         * thread.
+         *
+         * @param frustum the world space frustum of the viewport
+         */
+        void _UpdateCulling(const pxr::GfFrustum& frustum);
+
+        /**
+         * @brief Find the Prims whose bounds are inside the given rectangle
+         * with the Bounds Scene Index, for the renderers without picking
+         * support
+         *
+         * @param startPos a corner of the rectangle in the viewport
+         * @param endPos the opposite corner of the rectangle in the viewport
+         * @return the paths of the Prims
+         */
+        pxr::SdfPathVector _FindPrimsInRegion(ImVec2 startPos, ImVec2 endPos);
+
         /**
          * @brief Set the free camera as the active one
          *
@@ -207,6 +498,23 @@ class Viewport : public View {
          */
         void _UpdateActiveCamFromViewport();
 
+        /**
+         * @brief Get the active camera, from the cache if the scene time and
+         * the edits didn't change since it was read
+         *
+         * @param isRefreshed set to true if the camera was read back from
+         * the scene, or nullptr
+         * @return the active camera
+         */
+        pxr::GfCamera _GetActiveGfCamera(bool* isRefreshed = nullptr);
+
+        /**
+         * @brief Publish the pending xform of the active camera to the scene
+         * with a single edit
+         *
+         */
+        void _PublishActiveCam();
+
         /**
          * @brief Update Viewport projection matrix from the active camera
          *
@@ -223,6 +531,7 @@ class Viewport : public View {
 
         /**
          * @brief Focus the active camera and the viewport on the given prim
+         * and its descendants
          *
          * @param primPath the prim to focus on
          */
@@ -234,6 +543,26 @@ class Viewport : public View {
          */
         void _KeyPressEvent(ImGuiKey key) override;
 
+        /**
+         * @brief Draw the status of the stage loaded in the background, if
+         * any, at the center of the viewport
+         *
+         */
+        void _UpdateLoadingStatus();
+
+        /**
+         * @brief Draw the rectangle of the marquee selection
+         *
+         */
+        void _UpdateMarquee();
+
+        /**
+         * @brief Override of the View::_MousePressEvent
+         *
+         */
+        void _MousePressEvent(ImGuiMouseButton_ button,
+                              ImVec2 mousePos) override;
+
         /**
          * @brief Override of the View::_MouseMoveEvent
          *